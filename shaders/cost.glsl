@@ -0,0 +1,34 @@
+// Per-pixel cost counters for the heatmap view, compiled in by the raytrace_cost variant
+// (VRAYT_COST_HEATMAP=1) and compiled out of the regular kernel.
+//
+// In raytrace.comp.glsl: include this file after the descriptor declarations, call COST_BOUNCE() once per
+// path segment, COST_INTERSECTIONS(n) after testing n primitives (and, once a BVH exists, COST_NODES(n) per
+// traversal step), and COST_STORE(pixel) once per invocation after the sample loop.
+//
+// The cost image is RG32UI: x = bounces, y = intersection tests, summed over the samples of the frame.
+
+#ifndef VRAYT_COST_GLSL
+#define VRAYT_COST_GLSL
+
+#if defined(VRAYT_COST_HEATMAP) && VRAYT_COST_HEATMAP
+
+layout(binding = 4, rg32ui) uniform writeonly uimage2D costImage;
+
+uint gCostBounces = 0u;
+uint gCostIntersections = 0u;
+
+#define COST_BOUNCE() gCostBounces += 1u
+#define COST_INTERSECTIONS(n) gCostIntersections += uint(n)
+#define COST_NODES(n) gCostIntersections += uint(n)
+#define COST_STORE(pixel) imageStore(costImage, ivec2(pixel), uvec4(gCostBounces, gCostIntersections, 0u, 0u))
+
+#else
+
+#define COST_BOUNCE()
+#define COST_INTERSECTIONS(n)
+#define COST_NODES(n)
+#define COST_STORE(pixel)
+
+#endif
+
+#endif
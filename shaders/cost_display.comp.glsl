@@ -0,0 +1,60 @@
+#version 460
+
+// Maps one cost metric to a false-colour (Turbo) heatmap over the output image, normalised by the min/max
+// produced by cost_reduce.comp.glsl in the same frame.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0, rg32ui) uniform readonly uimage2D costImage;
+
+layout(std430, binding = 1) readonly buffer CostStats
+{
+    uint minValue[2];
+    uint maxValue[2];
+    uint sumLow[2];
+    uint sumHigh[2];
+} stats;
+
+layout(binding = 2, rgba8) uniform writeonly image2D outputImage;
+
+layout(push_constant) uniform Push
+{
+    uint metric; // 0 = bounces, 1 = intersection tests.
+} push;
+
+// Polynomial fit of the Turbo colormap (Mikhailov, 2019).
+vec3 turbo(float x)
+{
+    const vec4 kRedVec4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+    const vec4 kGreenVec4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+    const vec4 kBlueVec4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+    const vec2 kRedVec2 = vec2(-152.94239396, 59.28637943);
+    const vec2 kGreenVec2 = vec2(4.27729857, 2.82956604);
+    const vec2 kBlueVec2 = vec2(-89.90310912, 27.34824973);
+
+    x = clamp(x, 0.0, 1.0);
+    vec4 v4 = vec4(1.0, x, x * x, x * x * x);
+    vec2 v2 = v4.zw * v4.z;
+
+    return vec3(
+        dot(v4, kRedVec4) + dot(v2, kRedVec2),
+        dot(v4, kGreenVec4) + dot(v2, kGreenVec2),
+        dot(v4, kBlueVec4) + dot(v2, kBlueVec2));
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(pixel, imageSize(outputImage))))
+    {
+        return;
+    }
+
+    uint value = imageLoad(costImage, pixel)[push.metric];
+    float lowest = float(stats.minValue[push.metric]);
+    float highest = float(stats.maxValue[push.metric]);
+    float t = highest > lowest ? (float(value) - lowest) / (highest - lowest) : 0.0;
+
+    imageStore(outputImage, pixel, vec4(turbo(t), 1.0));
+}
@@ -0,0 +1,52 @@
+#version 460
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_KHR_shader_subgroup_basic : require
+
+// Reduces the cost image to per-metric min/max/sum. Each subgroup reduces in registers and one lane issues
+// the global atomics. The stats buffer must be reset (min = ~0u, everything else 0) before dispatch.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(binding = 0, rg32ui) uniform readonly uimage2D costImage;
+
+layout(std430, binding = 1) buffer CostStats
+{
+    uint minValue[2];
+    uint maxValue[2];
+    uint sumLow[2]; // 64-bit sums as two words; see addWide.
+    uint sumHigh[2];
+} stats;
+
+void addWide(uint metric, uint value)
+{
+    uint previous = atomicAdd(stats.sumLow[metric], value);
+
+    // Carry into the high word when the low word wrapped.
+    if (previous + value < previous)
+    {
+        atomicAdd(stats.sumHigh[metric], 1u);
+    }
+}
+
+void main()
+{
+    ivec2 size = imageSize(costImage);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    bool inside = all(lessThan(pixel, size));
+    uvec2 cost = inside ? imageLoad(costImage, pixel).xy : uvec2(0u);
+
+    for (uint metric = 0u; metric < 2u; ++metric)
+    {
+        uint value = cost[metric];
+        uint lowest = subgroupMin(inside ? value : 0xFFFFFFFFu);
+        uint highest = subgroupMax(inside ? value : 0u);
+        uint total = subgroupAdd(inside ? value : 0u);
+
+        if (subgroupElect())
+        {
+            atomicMin(stats.minValue[metric], lowest);
+            atomicMax(stats.maxValue[metric], highest);
+            addWide(metric, total);
+        }
+    }
+}
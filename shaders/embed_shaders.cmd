@@ -0,0 +1,31 @@
+@echo off
+rem Compiles every compute kernel variant to SPIR-V and writes it as a C initializer list
+rem (shaders\generated\*.inc) that src\rt\ShaderLibrary.cpp embeds as constexpr word arrays.
+rem Keep the variant list below in sync with shaders::variants() and tools\regression\CMakeLists.txt.
+setlocal
+
+if not defined VULKAN_SDK (echo VULKAN_SDK is not set. Install the Vulkan SDK or set VULKAN_SDK to compile shaders. & exit /b 1)
+
+set "GLSLC=%VULKAN_SDK%\Bin\glslc.exe"
+set "SHADER_DIR=%~dp0"
+set "OUT_DIR=%~dp0generated"
+
+if not exist "%OUT_DIR%" mkdir "%OUT_DIR%"
+
+call :embed raytrace.comp.glsl raytrace.comp.inc || exit /b 1
+call :embed raytrace.comp.glsl raytrace_cost.comp.inc "-DVRAYT_COST_HEATMAP=1" || exit /b 1
+call :embed cost_reduce.comp.glsl cost_reduce.comp.inc || exit /b 1
+call :embed cost_display.comp.glsl cost_display.comp.inc || exit /b 1
+call :embed rng_kat.comp.glsl rng_kat.comp.inc || exit /b 1
+
+exit /b 0
+
+rem %1 = GLSL source, %2 = generated include, remaining arguments = extra glslc flags (variant defines, quoted
+rem because cmd splits arguments on '=').
+:embed
+set "SOURCE=%~1"
+set "OUTPUT=%~2"
+shift
+shift
+"%GLSLC%" -fshader-stage=compute --target-env=vulkan1.3 -O -mfmt=num %1 %2 %3 %4 -o "%OUT_DIR%\%OUTPUT%" "%SHADER_DIR%%SOURCE%"
+exit /b %errorlevel%
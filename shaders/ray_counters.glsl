@@ -0,0 +1,77 @@
+// Ray throughput counters, one 64-bit total per category for the frame.
+//
+// In raytrace.comp.glsl: include this file directly after #version, since it enables subgroup extensions. Call
+// COUNT_PRIMARY_RAY() per camera ray, COUNT_BOUNCE_RAY() per scattered ray, COUNT_SHADOW_RAY() per visibility ray
+// and COUNT_INTERSECTIONS(n) after testing n primitives. Call COUNTERS_FLUSH() once at the end of main, in uniform control flow: invocations
+// outside the image must skip tracing but still reach the flush, or the subgroup totals are undefined.
+//
+// Counts live in registers until the flush, which adds them across the subgroup and issues one set of atomics
+// from a single lane. Define VRAYT_RAY_COUNTERS=0 to compile them out.
+
+#ifndef VRAYT_RAY_COUNTERS_GLSL
+#define VRAYT_RAY_COUNTERS_GLSL
+
+#ifndef VRAYT_RAY_COUNTERS
+#define VRAYT_RAY_COUNTERS 1
+#endif
+
+#if VRAYT_RAY_COUNTERS
+
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_KHR_shader_subgroup_basic : require
+
+// x = primary, y = bounce, z = shadow, w = intersection tests. Reset to zero before each dispatch.
+layout(std430, binding = 5) buffer RayCounters
+{
+    uvec4 countLow;
+    uvec4 countHigh; // Carries out of countLow.
+} rayCounters;
+
+uvec4 gRayCounts = uvec4(0u);
+
+#define COUNT_PRIMARY_RAY() gRayCounts.x += 1u
+#define COUNT_BOUNCE_RAY() gRayCounts.y += 1u
+#define COUNT_SHADOW_RAY() gRayCounts.z += 1u
+#define COUNT_INTERSECTIONS(n) gRayCounts.w += uint(n)
+
+void addCounter(uint index, uint value)
+{
+    if (value == 0u)
+    {
+        return;
+    }
+
+    uint previous = atomicAdd(rayCounters.countLow[index], value);
+
+    if (previous + value < previous)
+    {
+        atomicAdd(rayCounters.countHigh[index], 1u);
+    }
+}
+
+void flushRayCounters()
+{
+    uvec4 total = subgroupAdd(gRayCounts);
+
+    if (subgroupElect())
+    {
+        addCounter(0u, total.x);
+        addCounter(1u, total.y);
+        addCounter(2u, total.z);
+        addCounter(3u, total.w);
+    }
+}
+
+#define COUNTERS_FLUSH() flushRayCounters()
+
+#else
+
+#define COUNT_PRIMARY_RAY()
+#define COUNT_BOUNCE_RAY()
+#define COUNT_SHADOW_RAY()
+#define COUNT_INTERSECTIONS(n)
+#define COUNTERS_FLUSH()
+
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+// Counter-based random numbers: Philox4x32-10 keyed on the pixel, addressed by global sample index and dimension.
+//
+// In raytrace.comp.glsl: per sample s of the frame's samplesPerFrame, create
+//     Rng rng = rngCreate(gl_GlobalInvocationID.xy + params.sampleKey.zw, params.sampleKey.xy, s);
+// and draw each random decision with rngNext / rngNext2, in the same order for every sample. The pixel is in
+// full-image coordinates (sampleKey.zw is the view window's offset) and the sample index is global (sampleKey.xy
+// is the frame's first sample, frameIndex * samplesPerFrame), so a sample's numbers do not depend on how frames,
+// tiles or processes split the render. rngSeek jumps to a dimension, for example to reserve 0..1 for the lens
+// and 2..3 for the pixel jitter whatever the path length.
+//
+// No state carries between samples or frames. src/rt/Rng.h is the CPU twin and must stay bit-identical.
+
+#ifndef VRAYT_RNG_GLSL
+#define VRAYT_RNG_GLSL
+
+const uint PHILOX_M0 = 0xD2511F53u;
+const uint PHILOX_M1 = 0xCD9E8D57u;
+const uint PHILOX_W0 = 0x9E3779B9u;
+const uint PHILOX_W1 = 0xBB67AE85u;
+
+uvec4 philox4x32(uvec4 counter, uvec2 key)
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        uint hi0;
+        uint lo0;
+        uint hi1;
+        uint lo1;
+        umulExtended(PHILOX_M0, counter.x, hi0, lo0);
+        umulExtended(PHILOX_M1, counter.z, hi1, lo1);
+        counter = uvec4(hi1 ^ counter.y ^ key.x, lo1, hi0 ^ counter.w ^ key.y, lo0);
+        key += uvec2(PHILOX_W0, PHILOX_W1);
+    }
+
+    return counter;
+}
+
+struct Rng
+{
+    uvec2 key; // Pixel.
+    uvec2 sampleIndex; // Low, high 32 bits.
+    uint dimension; // Next dimension to draw.
+    uint blockIndex;
+    uvec4 block; // Dimensions 4 * blockIndex .. 4 * blockIndex + 3.
+};
+
+void rngRefill(inout Rng rng)
+{
+    rng.blockIndex = rng.dimension >> 2;
+    rng.block = philox4x32(uvec4(rng.sampleIndex, rng.blockIndex, 0u), rng.key);
+}
+
+void rngSeek(inout Rng rng, uint dimension)
+{
+    rng.dimension = dimension;
+
+    if ((dimension >> 2) != rng.blockIndex)
+    {
+        rngRefill(rng);
+    }
+}
+
+Rng rngCreate(uvec2 pixel, uvec2 sampleBase, uint sampleOffset)
+{
+    Rng rng;
+    uint carry;
+    rng.key = pixel;
+    rng.sampleIndex.x = uaddCarry(sampleBase.x, sampleOffset, carry);
+    rng.sampleIndex.y = sampleBase.y + carry;
+    rng.dimension = 0u;
+    rngRefill(rng);
+
+    return rng;
+}
+
+// Uniform in [0, 1) with 24 bits, exact in float so the CPU twin matches.
+float rngNext(inout Rng rng)
+{
+    if ((rng.dimension >> 2) != rng.blockIndex)
+    {
+        rngRefill(rng);
+    }
+
+    uint bits = rng.block[rng.dimension & 3u];
+    rng.dimension += 1u;
+
+    return float(bits >> 8) * (1.0 / 16777216.0);
+}
+
+vec2 rngNext2(inout Rng rng)
+{
+    float x = rngNext(rng);
+
+    return vec2(x, rngNext(rng));
+}
+
+#endif
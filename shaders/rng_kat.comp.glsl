@@ -0,0 +1,45 @@
+#version 460
+
+// Known-answer check of rng.glsl, run by the regression tool against src/rt/Rng.h and the Random123 Philox4x32-10
+// vectors. One invocation per case: the raw Philox block of the case's counter and key, then the first eight
+// rngNext draws (two blocks) of the sample the key and sample index select, as float bits.
+
+#include "rng.glsl"
+
+layout(local_size_x = 1) in;
+
+struct KatCase
+{
+    uvec4 counter;
+    uvec4 key; // xy = Philox key and Rng pixel, zw = Rng sample index (low, high).
+};
+
+layout(std430, binding = 0) readonly buffer Cases
+{
+    KatCase cases[];
+};
+
+layout(std430, binding = 1) writeonly buffer Results
+{
+    uvec4 results[]; // Three per case.
+};
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    KatCase katCase = cases[index];
+
+    results[index * 3u] = philox4x32(katCase.counter, katCase.key.xy);
+
+    Rng rng = rngCreate(katCase.key.xy, katCase.key.zw, 0u);
+
+    for (uint block = 1u; block < 3u; ++block)
+    {
+        vec4 draws;
+        draws.x = rngNext(rng);
+        draws.y = rngNext(rng);
+        draws.z = rngNext(rng);
+        draws.w = rngNext(rng);
+        results[index * 3u + block] = floatBitsToUint(draws);
+    }
+}
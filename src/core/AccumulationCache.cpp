@@ -0,0 +1,569 @@
+#include "AccumulationCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+#include "../rt/RayTracer.h"
+#include "../util/Check.h"
+#include "../util/Checkpoint.h"
+#include "../util/Env.h"
+#include "../util/Hash.h"
+#include "../util/Logger.h"
+#include "../util/Profiler.h"
+#include "../vk/VulkanContext.h"
+
+namespace
+{
+    // The previous view is copied out while the next one is restored, so both need a device buffer.
+    const uint32_t minDeviceEntries = 2;
+
+    uint32_t envUint(const char* name, uint32_t fallback)
+    {
+        const std::string value = readEnv(name);
+
+        if (value.empty())
+        {
+            return fallback;
+        }
+
+        return static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+    }
+
+    std::string defaultDirectory()
+    {
+        // Per process, so two instances never share spill files.
+        char suffix[17];
+        std::random_device random;
+        std::snprintf(suffix, sizeof(suffix), "%08x%08x", random(), random());
+        std::error_code error;
+        const std::filesystem::path temporary = std::filesystem::temp_directory_path(error);
+
+        return ((error ? std::filesystem::path(".") : temporary) / ("vrayt_accum_cache_" + std::string(suffix))).string();
+    }
+
+    VkBuffer createHostBuffer(VulkanContext& vulkanContext, VkDeviceSize bytes, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+        VmaAllocation& allocation, VmaAllocationInfo& info)
+    {
+        VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = bytes;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = memoryUsage;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &buffer, &allocation, &info));
+        vulkanContext.trackAllocation(allocation, MemoryCategory::Readback, "Accumulation cache staging");
+
+        return buffer;
+    }
+
+    void destroyHostBuffer(VulkanContext& vulkanContext, VkBuffer buffer, VmaAllocation allocation)
+    {
+        vulkanContext.untrackAllocation(allocation, MemoryCategory::Readback);
+        vmaDestroyBuffer(vulkanContext.allocator(), buffer, allocation);
+    }
+
+    void removeFile(const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+}
+
+AccumulationCacheSettings accumulationCacheSettingsFromEnv()
+{
+    AccumulationCacheSettings settings;
+    settings.deviceEntries = envUint("VRAYT_ACCUM_CACHE_DEVICE", settings.deviceEntries);
+    settings.diskEntries = envUint("VRAYT_ACCUM_CACHE_DISK", settings.diskEntries);
+    settings.minSamples = std::max(envUint("VRAYT_ACCUM_CACHE_MIN_SPP", settings.minSamples), 1u);
+    settings.directory = readEnv("VRAYT_ACCUM_CACHE_DIR");
+
+    return settings;
+}
+
+void AccumulationCache::create(const AccumulationCacheSettings& settings)
+{
+    mSettings = settings;
+
+    if (!enabled())
+    {
+        return;
+    }
+
+    mSettings.deviceEntries = std::max(mSettings.deviceEntries, minDeviceEntries);
+    mDirectory = mSettings.directory.empty() ? defaultDirectory() : mSettings.directory;
+    mWriter.start(1, "accumulation cache");
+}
+
+void AccumulationCache::destroy(VulkanContext& vulkanContext)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    vulkanContext.waitIdle();
+    mWriter.stop();
+
+    for (Entry& entry : mEntries)
+    {
+        releaseBuffer(vulkanContext, entry);
+
+        if (!entry.path.empty())
+        {
+            removeFile(entry.path);
+        }
+    }
+
+    mEntries.clear();
+
+    // Only a directory this cache made; a configured one may hold other files.
+    if (mSettings.directory.empty() && mSpillIndex > 0)
+    {
+        std::error_code error;
+        std::filesystem::remove_all(mDirectory, error);
+    }
+}
+
+uint32_t AccumulationCache::update(VulkanContext& vulkanContext, RayTracer& tracer, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (!enabled())
+    {
+        return frameIndex;
+    }
+
+    const uint64_t key = viewKey(tracer);
+
+    if (mHasKey && key == mKey)
+    {
+        mLastFrame = frameIndex;
+
+        return frameIndex;
+    }
+
+    PROFILE_ZONE("AccumulationCache");
+    const VkExtent2D extent = tracer.accumulationExtent();
+
+    // Views of a replaced scene can never come back.
+    if (mHasKey && tracer.sceneVersion() != mSceneVersion)
+    {
+        while (!mEntries.empty())
+        {
+            erase(vulkanContext, mEntries.back().key);
+        }
+
+        mHasKey = false;
+    }
+
+    // Made resident before the previous view is saved, so making room for that never spills this one.
+    Entry* next = find(key);
+
+    if (next)
+    {
+        next->lastUse = ++mClock;
+
+        if (!next->path.empty() && !load(vulkanContext, *next))
+        {
+            erase(vulkanContext, key);
+        }
+    }
+
+    // The accumulation still holds the previous view: settings changes only clear it in the next render.
+    if (mHasKey && tracer.hasAccumulation() && tracer.completedSamples() >= mSettings.minSamples)
+    {
+        Entry* previous = find(mKey);
+
+        if (!previous)
+        {
+            mEntries.push_back({});
+            previous = &mEntries.back();
+            previous->key = mKey;
+        }
+        else if (!previous->path.empty())
+        {
+            // Superseded by the samples added since it was restored.
+            mWriter.waitIdle();
+            removeFile(previous->path);
+            previous->path.clear();
+        }
+
+        previous->lastUse = ++mClock;
+        previous->sceneHash = tracer.sceneHash();
+        previous->settingsHash = mSettingsHash;
+        previous->extent = extent;
+        previous->nextFrame = static_cast<uint64_t>(mLastFrame) + 1;
+        previous->samplesPerFrame = mSamplesPerFrame;
+        previous->completedSamples = tracer.completedSamples();
+
+        if (acquireBuffer(vulkanContext, *previous, tracer.accumulationBytes(), find(key)))
+        {
+            // Orders the copy after earlier copies into and out of a reused buffer.
+            VkBufferMemoryBarrier reuse{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            reuse.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            reuse.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            reuse.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            reuse.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            reuse.buffer = previous->buffer;
+            reuse.size = VK_WHOLE_SIZE;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &reuse, 0, nullptr);
+
+            tracer.recordAccumulationCopy(commandBuffer, previous->buffer, 0);
+        }
+        else
+        {
+            erase(vulkanContext, mKey);
+        }
+    }
+
+    // Vector growth above may have moved it.
+    next = find(key);
+
+    if (next && next->buffer && next->extent.width == extent.width && next->extent.height == extent.height)
+    {
+        tracer.recordAccumulationRestore(commandBuffer, next->buffer, 0, next->completedSamples);
+
+        // Past every sample index the sums used, so continuing adds new samples rather than repeating them.
+        const uint64_t samplesPerFrame = std::max(tracer.samplesPerPixel(), 1u);
+        const uint64_t usedSamples = next->nextFrame * next->samplesPerFrame;
+        frameIndex = static_cast<uint32_t>(std::min<uint64_t>((usedSamples + samplesPerFrame - 1) / samplesPerFrame, UINT32_MAX));
+        ++mRestores;
+    }
+
+    trimDisk();
+
+    mKey = key;
+    mHasKey = true;
+    mSceneVersion = tracer.sceneVersion();
+    mSettingsHash = tracer.settingsHash(extent);
+    mSamplesPerFrame = tracer.samplesPerPixel();
+    mLastFrame = frameIndex;
+
+    return frameIndex;
+}
+
+uint32_t AccumulationCache::deviceEntryCount() const
+{
+    return static_cast<uint32_t>(std::count_if(mEntries.begin(), mEntries.end(), [](const Entry& entry)
+    {
+        return entry.buffer != VK_NULL_HANDLE;
+    }));
+}
+
+uint32_t AccumulationCache::diskEntryCount() const
+{
+    return static_cast<uint32_t>(std::count_if(mEntries.begin(), mEntries.end(), [](const Entry& entry)
+    {
+        return !entry.path.empty();
+    }));
+}
+
+uint64_t AccumulationCache::viewKey(const RayTracer& tracer) const
+{
+    return hashValue(tracer.sceneVersion(), tracer.settingsHash(tracer.accumulationExtent()));
+}
+
+AccumulationCache::Entry* AccumulationCache::find(uint64_t key)
+{
+    for (Entry& entry : mEntries)
+    {
+        if (entry.key == key)
+        {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+bool AccumulationCache::acquireBuffer(VulkanContext& vulkanContext, Entry& entry, VkDeviceSize bytes, const Entry* keep)
+{
+    if (entry.buffer && entry.bytes == bytes)
+    {
+        return true;
+    }
+
+    if (entry.buffer)
+    {
+        // In-flight frames may still copy into or out of it.
+        vulkanContext.waitIdle();
+        releaseBuffer(vulkanContext, entry);
+    }
+
+    auto leastRecent = [&]() -> Entry*
+    {
+        Entry* victim = nullptr;
+
+        for (Entry& candidate : mEntries)
+        {
+            if (candidate.buffer && &candidate != &entry && &candidate != keep && (!victim || candidate.lastUse < victim->lastUse))
+            {
+                victim = &candidate;
+            }
+        }
+
+        return victim;
+    };
+
+    while (deviceEntryCount() >= mSettings.deviceEntries)
+    {
+        Entry* victim = leastRecent();
+
+        if (!victim)
+        {
+            break;
+        }
+
+        spill(vulkanContext, *victim);
+    }
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = bytes;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // Within budget only: cached views are worth less than anything the frame itself needs.
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+
+    while (true)
+    {
+        const VkResult result = vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &entry.buffer, &entry.allocation, nullptr);
+
+        if (result == VK_SUCCESS)
+        {
+            break;
+        }
+
+        entry.buffer = VK_NULL_HANDLE;
+        entry.allocation = VK_NULL_HANDLE;
+
+        if (result != VK_ERROR_OUT_OF_DEVICE_MEMORY && result != VK_ERROR_OUT_OF_HOST_MEMORY)
+        {
+            VK_CHECK(result);
+        }
+
+        Entry* victim = leastRecent();
+
+        if (!victim)
+        {
+            logger::warn("Accumulation cache: no device memory within budget for a %.1f MiB view", static_cast<double>(bytes) / (1024.0 * 1024.0));
+
+            return false;
+        }
+
+        spill(vulkanContext, *victim);
+    }
+
+    entry.bytes = bytes;
+    vulkanContext.trackAllocation(entry.allocation, MemoryCategory::Accumulation, "Accumulation cache");
+
+    return true;
+}
+
+void AccumulationCache::releaseBuffer(VulkanContext& vulkanContext, Entry& entry)
+{
+    if (entry.buffer && entry.allocation)
+    {
+        vulkanContext.untrackAllocation(entry.allocation, MemoryCategory::Accumulation);
+        vmaDestroyBuffer(vulkanContext.allocator(), entry.buffer, entry.allocation);
+    }
+
+    entry.buffer = VK_NULL_HANDLE;
+    entry.allocation = VK_NULL_HANDLE;
+    entry.bytes = 0;
+}
+
+void AccumulationCache::spill(VulkanContext& vulkanContext, Entry& entry)
+{
+    PROFILE_ZONE("AccumulationCacheSpill");
+
+    if (mSettings.diskEntries == 0)
+    {
+        // Dropped; trimDisk removes the empty entry.
+        vulkanContext.waitIdle();
+        releaseBuffer(vulkanContext, entry);
+
+        return;
+    }
+
+    VmaAllocation stagingAlloc = VK_NULL_HANDLE;
+    VmaAllocationInfo stagingInfo{};
+    VkBuffer staging = createHostBuffer(vulkanContext, entry.bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, stagingAlloc, stagingInfo);
+
+    // Waits for every earlier submission too, so the buffer is free to release afterwards.
+    vulkanContext.submitImmediate([&](VkCommandBuffer commandBuffer)
+    {
+        VkBufferMemoryBarrier toRead{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+        toRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toRead.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        toRead.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toRead.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toRead.buffer = entry.buffer;
+        toRead.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &toRead, 0, nullptr);
+
+        VkBufferCopy region{ 0, 0, entry.bytes };
+        vkCmdCopyBuffer(commandBuffer, entry.buffer, staging, 1, &region);
+
+        VkBufferMemoryBarrier toHost = toRead;
+        toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        toHost.buffer = staging;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+    });
+
+    vmaInvalidateAllocation(vulkanContext.allocator(), stagingAlloc, 0, VK_WHOLE_SIZE);
+
+    Checkpoint checkpoint;
+    checkpoint.width = entry.extent.width;
+    checkpoint.height = entry.extent.height;
+    checkpoint.sceneHash = entry.sceneHash;
+    checkpoint.settingsHash = entry.settingsHash;
+    checkpoint.nextFrame = entry.nextFrame;
+    checkpoint.samplesPerPixel = entry.completedSamples;
+    checkpoint.samplesPerFrame = entry.samplesPerFrame;
+    checkpoint.sums.resize(static_cast<size_t>(entry.extent.width) * entry.extent.height);
+    std::memcpy(checkpoint.sums.data(), stagingInfo.pMappedData, checkpoint.sums.size() * sizeof(glm::vec4));
+
+    destroyHostBuffer(vulkanContext, staging, stagingAlloc);
+    releaseBuffer(vulkanContext, entry);
+
+    std::error_code error;
+    std::filesystem::create_directories(mDirectory, error);
+
+    if (error)
+    {
+        logger::warn("Accumulation cache: cannot create %s: %s", mDirectory, error.message());
+
+        return;
+    }
+
+    entry.path = (std::filesystem::path(mDirectory) / ("view_" + std::to_string(mSpillIndex++) + ".ckpt")).string();
+
+    // Checkpoints are written through a temporary file, so the frame loop never sees a partial one.
+    mWriter.submit([path = entry.path, checkpoint = std::move(checkpoint)]()
+    {
+        try
+        {
+            writeCheckpoint(path, checkpoint);
+        }
+        catch (const std::exception& writeError)
+        {
+            logger::warn("Accumulation cache: %s", writeError.what());
+        }
+    });
+}
+
+bool AccumulationCache::load(VulkanContext& vulkanContext, Entry& entry)
+{
+    PROFILE_ZONE("AccumulationCacheLoad");
+    mWriter.waitIdle();
+
+    Checkpoint checkpoint;
+
+    try
+    {
+        checkpoint = readCheckpoint(entry.path);
+    }
+    catch (const std::exception& error)
+    {
+        logger::warn("Accumulation cache: %s", error.what());
+
+        return false;
+    }
+
+    if (checkpoint.width != entry.extent.width || checkpoint.height != entry.extent.height ||
+        checkpoint.sceneHash != entry.sceneHash || checkpoint.settingsHash != entry.settingsHash ||
+        checkpoint.samplesPerFrame != entry.samplesPerFrame)
+    {
+        logger::warn("Accumulation cache: %s does not match its view", entry.path);
+
+        return false;
+    }
+
+    const VkDeviceSize bytes = checkpoint.sums.size() * sizeof(glm::vec4);
+
+    if (!acquireBuffer(vulkanContext, entry, bytes, nullptr))
+    {
+        return false;
+    }
+
+    VmaAllocation stagingAlloc = VK_NULL_HANDLE;
+    VmaAllocationInfo stagingInfo{};
+    VkBuffer staging = createHostBuffer(vulkanContext, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingAlloc, stagingInfo);
+    std::memcpy(stagingInfo.pMappedData, checkpoint.sums.data(), static_cast<size_t>(bytes));
+    vmaFlushAllocation(vulkanContext.allocator(), stagingAlloc, 0, VK_WHOLE_SIZE);
+
+    // The restore's barrier makes the write visible to its copy.
+    vulkanContext.submitImmediate([&](VkCommandBuffer commandBuffer)
+    {
+        VkBufferCopy region{ 0, 0, bytes };
+        vkCmdCopyBuffer(commandBuffer, staging, entry.buffer, 1, &region);
+    });
+
+    destroyHostBuffer(vulkanContext, staging, stagingAlloc);
+    removeFile(entry.path);
+    entry.path.clear();
+
+    return true;
+}
+
+void AccumulationCache::trimDisk()
+{
+    // Entries spilled with nothing to spill to.
+    mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(), [](const Entry& entry)
+    {
+        return !entry.buffer && entry.path.empty();
+    }), mEntries.end());
+
+    while (diskEntryCount() > mSettings.diskEntries)
+    {
+        auto oldest = mEntries.end();
+
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+        {
+            if (!it->path.empty() && (oldest == mEntries.end() || it->lastUse < oldest->lastUse))
+            {
+                oldest = it;
+            }
+        }
+
+        mWriter.waitIdle();
+        removeFile(oldest->path);
+        mEntries.erase(oldest);
+    }
+}
+
+void AccumulationCache::erase(VulkanContext& vulkanContext, uint64_t key)
+{
+    auto it = std::find_if(mEntries.begin(), mEntries.end(), [key](const Entry& entry)
+    {
+        return entry.key == key;
+    });
+
+    if (it == mEntries.end())
+    {
+        return;
+    }
+
+    if (it->buffer)
+    {
+        vulkanContext.waitIdle();
+        releaseBuffer(vulkanContext, *it);
+    }
+    if (!it->path.empty())
+    {
+        mWriter.waitIdle();
+        removeFile(it->path);
+    }
+
+    mEntries.erase(it);
+}
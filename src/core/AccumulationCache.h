@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../util/WorkerPool.h"
+#include "vma/vk_mem_alloc.h"
+
+class RayTracer;
+class VulkanContext;
+
+struct AccumulationCacheSettings
+{
+    uint32_t deviceEntries = 4; // Most recent views kept in device memory; 0 disables the cache.
+    uint32_t diskEntries = 16; // Older views spilled to files; 0 drops them instead.
+    uint32_t minSamples = 64; // Views left with fewer samples per pixel are not kept.
+    std::string directory; // Spill directory, empty for one under the system temporary directory.
+};
+
+// Reads VRAYT_ACCUM_CACHE_DEVICE, VRAYT_ACCUM_CACHE_DISK, VRAYT_ACCUM_CACHE_MIN_SPP and VRAYT_ACCUM_CACHE_DIR.
+AccumulationCacheSettings accumulationCacheSettingsFromEnv();
+
+// Keeps the accumulation of views the user left, so returning to one continues from its samples instead of from
+// zero. Views are keyed by the tracer's settings hash (camera, depth and resolution) and scene version. The most
+// recently used entries stay in device memory and are saved and restored by copies recorded into the frame's
+// command buffer; older ones are read back and written as checkpoints (src/util/Checkpoint.h) on a worker thread,
+// and uploaded again when their view comes back. Only those disk transfers wait for the device.
+class AccumulationCache
+{
+public:
+    AccumulationCache() = default;
+    ~AccumulationCache() = default;
+
+    AccumulationCache(const AccumulationCache&) = delete;
+    AccumulationCache& operator=(const AccumulationCache&) = delete;
+
+    void create(const AccumulationCacheSettings& settings);
+
+    // Waits for the device, then frees the entries and removes the spill directory.
+    void destroy(VulkanContext& vulkanContext);
+
+    bool enabled() const
+    {
+        return mSettings.deviceEntries > 0;
+    }
+
+    // Call right before the tracer records the frame, after the frame's settings changes. When the view differs
+    // from the previous frame's, records a copy of the previous view's accumulation and, if the new view is
+    // cached, a restore of its sums. Returns the frame index to render with: frameIndex, or past every sample the
+    // restored sums already hold.
+    uint32_t update(VulkanContext& vulkanContext, RayTracer& tracer, VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    uint32_t deviceEntryCount() const;
+    uint32_t diskEntryCount() const;
+
+    uint64_t restores() const
+    {
+        return mRestores;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key = 0;
+        uint64_t lastUse = 0;
+        uint64_t sceneHash = 0;
+        uint64_t settingsHash = 0;
+        VkExtent2D extent{ 0, 0 };
+        uint64_t nextFrame = 0; // Frame indices below it, at samplesPerFrame each, went into the sums.
+        uint32_t samplesPerFrame = 0;
+        uint32_t completedSamples = 0;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VkDeviceSize bytes = 0;
+        std::string path; // Set while the entry is on disk.
+    };
+
+    uint64_t viewKey(const RayTracer& tracer) const;
+    Entry* find(uint64_t key);
+
+    // Gives entry a device buffer of bytes, spilling the least recently used other entries (never keep) to make
+    // room. False when device memory is exhausted.
+    bool acquireBuffer(VulkanContext& vulkanContext, Entry& entry, VkDeviceSize bytes, const Entry* keep);
+    void releaseBuffer(VulkanContext& vulkanContext, Entry& entry);
+
+    // Reads the entry back and queues its file; the buffer is released. Waits for the device.
+    void spill(VulkanContext& vulkanContext, Entry& entry);
+
+    // Uploads a spilled entry into a device buffer. Waits for the device; false drops the entry.
+    bool load(VulkanContext& vulkanContext, Entry& entry);
+
+    void trimDisk();
+    void erase(VulkanContext& vulkanContext, uint64_t key);
+
+    AccumulationCacheSettings mSettings;
+    WorkerPool mWriter;
+    std::vector<Entry> mEntries;
+    std::string mDirectory; // Created by the first spill.
+
+    // The view rendered last frame.
+    uint64_t mKey = 0;
+    bool mHasKey = false;
+    uint64_t mSceneVersion = 0;
+    uint64_t mSettingsHash = 0;
+    uint32_t mSamplesPerFrame = 0;
+    uint32_t mLastFrame = 0;
+
+    uint64_t mClock = 0;
+    uint64_t mRestores = 0;
+    uint32_t mSpillIndex = 0;
+};
@@ -4,6 +4,9 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
 
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -13,18 +16,44 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
 
+#include "../util/Env.h"
 #include "../util/Logger.h"
+#include "../util/Profiler.h"
 #include "../util/Timer.h"
 #include "../util/Check.h"
 #include "../platform/Window.h"
 #include "../vk/VulkanContext.h"
 #include "../vk/Swapchain.h"
 #include "../rt/RayTracer.h"
+#include "AccumulationCache.h"
+#include "FrameExporter.h"
+#include "FrameStream.h"
+#include "GpuScheduler.h"
+#include "Telemetry.h"
 
 static const uint32_t windowWidth = 1920;
 static const uint32_t windowHeight = 1080;
 static const uint32_t maxFramesInFlight = 2;
 static const uint32_t imguiMinImageCount = 2;
+static const uint16_t defaultMetricsPort = 9464;
+static const double memoryWarnFraction = 0.9;
+static const uint32_t defragIdleFrames = 120;
+static const double defragCheckSeconds = 10.0;
+static const double defragFragmentationThreshold = 0.1;
+static const size_t maxSavedViews = 8;
+
+// A camera and the settings that change what it converges to, restored exactly so cached accumulation matches.
+struct SavedView
+{
+    glm::vec3 position;
+    glm::vec3 direction;
+    float yaw;
+    float pitch;
+    float focusDistance;
+    float fov;
+    float aperture;
+    int maxDepth;
+};
 
 static VkDescriptorPool createImguiPool(VkDevice device)
 {
@@ -118,8 +147,227 @@ static void recreateImageSemaphores(VkDevice device, uint32_t imageCount, std::v
     }
 }
 
+// Serves Prometheus metrics on loopback; VRAYT_METRICS_PORT overrides the port, 0 disables the endpoint.
+static void startMetricsEndpoint(Telemetry& telemetry)
+{
+    uint16_t port = defaultMetricsPort;
+    std::string portOverride = readEnv("VRAYT_METRICS_PORT");
+
+    if (!portOverride.empty())
+    {
+        port = static_cast<uint16_t>(std::strtoul(portOverride.c_str(), nullptr, 10));
+    }
+
+    if (port != 0)
+    {
+        telemetry.startEndpoint("127.0.0.1", port);
+    }
+}
+
+static void drawMemoryWindow(const VulkanContext& vulkanContext)
+{
+    static uint32_t dumpIndex = 0;
+    const double mib = 1.0 / (1024.0 * 1024.0);
+
+    ImGui::SetNextWindowSize(ImVec2(360, 0), ImGuiCond_FirstUseEver);
+
+    if (!ImGui::Begin("GPU Memory"))
+    {
+        ImGui::End();
+
+        return;
+    }
+
+    ImGui::Text("Budget source: %s", vulkanContext.memoryBudgetEnabled() ? "VK_EXT_memory_budget" : "estimate (80%% of heap)");
+
+    for (const HeapBudget& heap : vulkanContext.heapBudgets())
+    {
+        const double fraction = heap.budget ? static_cast<double>(heap.usage) / static_cast<double>(heap.budget) : 0.0;
+        char label[96];
+        std::snprintf(label, sizeof(label), "%.0f / %.0f MiB", static_cast<double>(heap.usage) * mib, static_cast<double>(heap.budget) * mib);
+
+        ImGui::Text("Heap %u (%s, %.0f MiB)", heap.heapIndex, heap.deviceLocal ? "device" : "host", static_cast<double>(heap.size) * mib);
+
+        if (fraction >= memoryWarnFraction)
+        {
+            ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+            ImGui::ProgressBar(static_cast<float>(fraction), ImVec2(-1, 0), label);
+            ImGui::PopStyleColor();
+        }
+        else
+        {
+            ImGui::ProgressBar(static_cast<float>(fraction), ImVec2(-1, 0), label);
+        }
+
+        ImGui::Text("  VMA: %.1f MiB allocated in %.1f MiB of blocks", static_cast<double>(heap.allocationBytes) * mib, static_cast<double>(heap.blockBytes) * mib);
+    }
+
+    ImGui::Separator();
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryPool::Count); ++i)
+    {
+        MemoryPool pool = static_cast<MemoryPool>(i);
+        PoolStats stats = vulkanContext.poolStats(pool);
+        ImGui::Text("%s pool: %u allocs, %.1f / %.1f MiB in %u blocks", memoryPoolName(pool), stats.allocationCount,
+            static_cast<double>(stats.allocationBytes) * mib, static_cast<double>(stats.blockBytes) * mib, stats.blockCount);
+        ImGui::Text("  %u free ranges, largest %.1f MiB, fragmentation %.0f%%", stats.freeRangeCount,
+            static_cast<double>(stats.largestFreeRange) * mib, stats.fragmentation * 100.0);
+    }
+
+    ImGui::Separator();
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); ++i)
+    {
+        MemoryCategory category = static_cast<MemoryCategory>(i);
+        ImGui::Text("%-13s %8.2f MiB", memoryCategoryName(category), static_cast<double>(vulkanContext.categoryBytes(category)) * mib);
+    }
+
+    if (ImGui::Button("Dump VMA Stats"))
+    {
+        std::string path = "vrayt_vma_stats_" + std::to_string(dumpIndex++) + ".json";
+
+        if (vulkanContext.writeAllocatorStatsJson(path))
+        {
+            logger::info("VMA statistics written to %s", path);
+        }
+        else
+        {
+            logger::error("Failed to write VMA statistics %s", path);
+        }
+    }
+
+    ImGui::End();
+}
+
+// Background renders of the current view; view carries the camera and settings to snapshot.
+static void drawBatchWindow(VulkanContext& vulkanContext, GpuScheduler& scheduler, const RayTracer& tracer, const BatchJobDesc& view)
+{
+    static uint32_t jobIndex = 0;
+    static int size[2] = { 1920, 1080 };
+    static int spp = 1024;
+    static int priority = static_cast<int>(BatchPriority::Normal);
+    static float deadlineMinutes = 0.0f;
+
+    ImGui::SetNextWindowSize(ImVec2(360, 0), ImGuiCond_FirstUseEver);
+
+    if (!ImGui::Begin("Background Renders"))
+    {
+        ImGui::End();
+
+        return;
+    }
+
+    float budgetMs = static_cast<float>(scheduler.frameBudget() * 1e3);
+
+    if (ImGui::SliderFloat("Frame Budget (ms)", &budgetMs, 4.0f, 50.0f, "%.1f"))
+    {
+        scheduler.setFrameBudget(budgetMs * 1e-3);
+    }
+
+    ImGui::InputInt2("Size", size);
+    ImGui::InputInt("Samples", &spp);
+    ImGui::Combo("Priority", &priority, "Low\0Normal\0High\0");
+    ImGui::InputFloat("Deadline (min)", &deadlineMinutes, 1.0f, 10.0f, "%.1f");
+
+    if (ImGui::Button("Queue Current View") && size[0] > 0 && size[1] > 0 && spp > 0)
+    {
+        BatchJobDesc desc = view;
+        desc.name = "batch " + std::to_string(jobIndex);
+        desc.basePath = "vrayt_batch_" + std::to_string(jobIndex++);
+        desc.extent = { static_cast<uint32_t>(size[0]), static_cast<uint32_t>(size[1]) };
+        desc.targetSpp = static_cast<uint32_t>(spp);
+        desc.priority = static_cast<BatchPriority>(priority);
+        desc.deadlineSeconds = std::max(0.0f, deadlineMinutes) * 60.0;
+        scheduler.addJob(vulkanContext, tracer, desc);
+    }
+
+    ImGui::Text("Batch share %.0f%%, %.2f ms per frame", scheduler.batchShare() * 100.0, scheduler.lastBatchSeconds() * 1e3);
+    ImGui::Separator();
+
+    for (const BatchJobStatus& job : scheduler.status())
+    {
+        char label[96];
+        std::snprintf(label, sizeof(label), "%u / %u spp", job.samplesDone, job.targetSpp);
+
+        ImGui::PushID(static_cast<int>(job.id));
+        ImGui::Text("%s (%s)%s", job.name.c_str(), batchPriorityName(job.priority), job.saving ? ", saving" : "");
+        ImGui::ProgressBar(static_cast<float>(job.samplesDone) / static_cast<float>(job.targetSpp), ImVec2(-1, 0), label);
+
+        if (job.secondsPerSample > 0.0)
+        {
+            ImGui::Text("%.2f ms per sample per pixel", job.secondsPerSample * 1e3);
+        }
+        if (job.hasDeadline)
+        {
+            ImGui::Text(job.secondsToDeadline >= 0.0 ? "Deadline in %.0f s" : "Deadline missed by %.0f s", std::abs(job.secondsToDeadline));
+        }
+        if (!job.saving && ImGui::SmallButton("Cancel"))
+        {
+            scheduler.cancelJob(job.id);
+        }
+
+        ImGui::PopID();
+    }
+
+    ImGui::End();
+}
+
+static bool poolsNeedDefragmentation(const VulkanContext& vulkanContext)
+{
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryPool::Count); ++i)
+    {
+        PoolStats stats = vulkanContext.poolStats(static_cast<MemoryPool>(i));
+
+        // Empty blocks are released by defragmentation as well.
+        if (stats.fragmentation > defragFragmentationThreshold || stats.blockCount > 1)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Warns once each time a heap crosses the warning threshold, well before allocations start failing.
+static void checkMemoryBudget(const VulkanContext& vulkanContext, std::vector<bool>& heapWarned)
+{
+    std::vector<HeapBudget> heaps = vulkanContext.heapBudgets();
+    heapWarned.resize(heaps.size(), false);
+
+    for (const HeapBudget& heap : heaps)
+    {
+        const bool over = heap.budget && static_cast<double>(heap.usage) >= memoryWarnFraction * static_cast<double>(heap.budget);
+
+        if (over && !heapWarned[heap.heapIndex])
+        {
+            logger::warn("Memory heap %u at %.0f%% of its budget (%.0f MiB of %.0f MiB).", heap.heapIndex,
+                100.0 * static_cast<double>(heap.usage) / static_cast<double>(heap.budget),
+                static_cast<double>(heap.usage) / (1024.0 * 1024.0), static_cast<double>(heap.budget) / (1024.0 * 1024.0));
+        }
+
+        heapWarned[heap.heapIndex] = over;
+    }
+}
+
+static void dumpCpuTrace()
+{
+    static uint32_t dumpIndex = 0;
+    std::string path = "vrayt_trace_" + std::to_string(dumpIndex++) + ".json";
+
+    if (profiler::writeChromeTrace(path))
+    {
+        logger::info("CPU trace written to %s", path);
+    }
+    else
+    {
+        logger::error("Failed to write CPU trace %s", path);
+    }
+}
+
 int App::run()
 {
+    profiler::setThreadName("main");
+
     try
     {
         // Window.
@@ -151,10 +399,43 @@ int App::run()
 
         // Ray tracer.
         RayTracer tracer;
-        tracer.create(vulkanContext, swapchain);
+        tracer.create(vulkanContext, swapchain.renderTarget());
         tracer.setSamplesPerPixel(4);
         tracer.setAperture(0.05f);
 
+        // Telemetry.
+        Telemetry telemetry;
+        startMetricsEndpoint(telemetry);
+        std::vector<bool> heapWarned;
+
+        // Image capture, encoded and written off the frame loop.
+        FrameExporter exporter;
+        exporter.create();
+        uint32_t captureIndex = 0;
+        bool captureRequested = false;
+
+        // Raw video of the presented frames for an external encoder, when VRAYT_FRAME_STREAM is set.
+        FrameStream frameStream;
+        frameStream.create(frameStreamSettingsFromEnv());
+        const bool streamFrames = frameStream.enabled() && (swapchain.bundle().imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+
+        if (frameStream.enabled() && !streamFrames)
+        {
+            logger::warn("Frame stream: swapchain images cannot be copied from on this surface, nothing will be streamed");
+        }
+
+        // Accumulation of views left behind, continued when they come back.
+        AccumulationCache accumCache;
+        accumCache.create(accumulationCacheSettingsFromEnv());
+
+        // Background renders in the GPU time the interactive frames leave.
+        GpuScheduler scheduler;
+        scheduler.create(vulkanContext, maxFramesInFlight);
+
+        // Incremental defragmentation on idle frames.
+        bool defragActive = false;
+        Timer defragCheckTimer;
+
         // Per-swapchain-image sync (to avoid reusing present semaphores still in use).
         std::vector<VkSemaphore> imageRenderFinished;
         std::vector<VkFence> imagesInFlight;
@@ -188,6 +469,8 @@ int App::run()
         window.setCursorMode(GLFW_CURSOR_DISABLED);
         bool cameraPaused = false;
         bool escPrev = false;
+        bool traceKeyPrev = false;
+        bool captureKeyPrev = false;
 
         // UI state.
         int uiSpp = 4;
@@ -195,10 +478,20 @@ int App::run()
         float uiFocusDist = glm::length(glm::vec3(0.0f, 1.0f, 0.0f) - camPos);
         float uiFov = 20.0f;
         int uiMaxDepth = 12;
+        bool uiBoundedDispatch = false;
+        float uiDispatchBudgetMs = 8.0f;
+        int uiViewMode = static_cast<int>(ViewMode::Color);
+        std::vector<SavedView> savedViews;
 
         while (!window.shouldClose())
         {
-            window.poll();
+            PROFILE_ZONE("Frame");
+
+            {
+                PROFILE_ZONE("Poll");
+                window.poll();
+            }
+
             double deltaTime = frameTimer.elapsedSeconds();
             frameTimer.reset();
             bool camChanged = false;
@@ -218,7 +511,7 @@ int App::run()
                 }
 
                 swapchain.recreate(vulkanContext, window);
-                tracer.resize(vulkanContext, swapchain);
+                tracer.resize(vulkanContext, swapchain.renderTarget());
                 recreateImageSemaphores(vulkanContext.device(), static_cast<uint32_t>(swapchain.bundle().images.size()), imageRenderFinished, imagesInFlight);
                 sampleFrame = 0;
                 window.clearFramebufferResized();
@@ -250,12 +543,32 @@ int App::run()
 
             escPrev = escPressed;
 
+            // Dump the CPU trace with F12.
+            bool traceKeyPressed = window.keyState(GLFW_KEY_F12) == GLFW_PRESS;
+
+            if (traceKeyPressed && !traceKeyPrev)
+            {
+                dumpCpuTrace();
+            }
+
+            traceKeyPrev = traceKeyPressed;
+
+            // Save the current image with F11.
+            bool captureKeyPressed = window.keyState(GLFW_KEY_F11) == GLFW_PRESS;
+
+            if (captureKeyPressed && !captureKeyPrev)
+            {
+                captureRequested = true;
+            }
+
+            captureKeyPrev = captureKeyPressed;
+
             // Handle resize (recreate swapchain on demand).
             if (window.framebufferResized())
             {
                 window.clearFramebufferResized();
                 swapchain.recreate(vulkanContext, window);
-                tracer.resize(vulkanContext, swapchain);
+                tracer.resize(vulkanContext, swapchain.renderTarget());
                 sampleFrame = 0;
 
                 continue;
@@ -367,18 +680,48 @@ int App::run()
                 sampleFrame = 0;
             }
 
+            // Applied between frames: switching may create descriptor sets that are bound while recording.
+            if (static_cast<ViewMode>(uiViewMode) != tracer.viewMode())
+            {
+                tracer.setViewMode(vulkanContext, static_cast<ViewMode>(uiViewMode));
+            }
+
+            // Idle means the view has been still long enough that a short stall is not noticed.
+            if (sampleFrame >= defragIdleFrames)
+            {
+                if (!defragActive && defragCheckTimer.elapsedSeconds() >= defragCheckSeconds)
+                {
+                    defragActive = poolsNeedDefragmentation(vulkanContext);
+                    defragCheckTimer.reset();
+                }
+
+                if (defragActive)
+                {
+                    PROFILE_ZONE("Defragment");
+                    defragActive = tracer.defragmentStep(vulkanContext);
+                }
+            }
+
             auto& frameSync = vulkanContext.frames()[currentFrame];
 
             // Wait for GPU.
-            VK_CHECK(vkWaitForFences(vulkanContext.device(), 1, &frameSync.inFlight, VK_TRUE, UINT64_MAX));
+            {
+                PROFILE_ZONE("WaitForFences");
+                VK_CHECK(vkWaitForFences(vulkanContext.device(), 1, &frameSync.inFlight, VK_TRUE, UINT64_MAX));
+            }
 
             uint32_t imageIndex = 0;
-            VkResult acquireResult = swapchain.acquireNextImage(vulkanContext, frameSync.imageAvailable, &imageIndex);
+            VkResult acquireResult = VK_SUCCESS;
+
+            {
+                PROFILE_ZONE("AcquireNextImage");
+                acquireResult = swapchain.acquireNextImage(vulkanContext, frameSync.imageAvailable, &imageIndex);
+            }
 
             if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
             {
                 swapchain.recreate(vulkanContext, window);
-                tracer.resize(vulkanContext, swapchain);
+                tracer.resize(vulkanContext, swapchain.renderTarget());
                 recreateImageSemaphores(vulkanContext.device(), static_cast<uint32_t>(swapchain.bundle().images.size()), imageRenderFinished, imagesInFlight);
                 sampleFrame = 0;
 
@@ -390,17 +733,39 @@ int App::run()
             // If this swapchain image is already in flight, wait for the fence that owns it.
             if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
             {
+                PROFILE_ZONE("WaitForImage");
                 VK_CHECK(vkWaitForFences(vulkanContext.device(), 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX));
             }
 
             imagesInFlight[imageIndex] = frameSync.inFlight;
             VK_CHECK(vkResetFences(vulkanContext.device(), 1, &frameSync.inFlight));
 
-            VK_CHECK(vkResetCommandBuffer(frameSync.cmdBuf, 0));
-            VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-            VK_CHECK(vkBeginCommandBuffer(frameSync.cmdBuf, &beginInfo));
+            {
+                PROFILE_ZONE("RecordCompute");
+                VK_CHECK(vkResetCommandBuffer(frameSync.cmdBuf, 0));
+                VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+                VK_CHECK(vkBeginCommandBuffer(frameSync.cmdBuf, &beginInfo));
+
+                // Every settings change of the frame is applied by now, so this sees the view about to render.
+                sampleFrame = accumCache.update(vulkanContext, tracer, frameSync.cmdBuf, sampleFrame);
+                tracer.render(vulkanContext, swapchain.renderTarget(), frameSync.cmdBuf, imageIndex, sampleFrame);
+
+                // While every staging buffer is busy the request stays pending for a later frame.
+                if (captureRequested && exporter.capture(vulkanContext, tracer, frameSync.cmdBuf, "vrayt_capture_" + std::to_string(captureIndex)))
+                {
+                    ++captureIndex;
+                    captureRequested = false;
+                }
+
+                // Before the overlay pass, so the stream carries the image without the UI.
+                if (streamFrames)
+                {
+                    const auto& bundle = swapchain.bundle();
+                    frameStream.capture(vulkanContext, frameSync.cmdBuf, bundle.images[imageIndex], bundle.imageFormat, bundle.extent);
+                }
+            }
 
-            tracer.render(vulkanContext, swapchain, frameSync.cmdBuf, imageIndex, sampleFrame);
+            uint64_t imguiBegin = profiler::now();
 
             // Overlay.
             ImGuiWindowFlags overlayFlags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
@@ -412,7 +777,26 @@ int App::run()
             if (ImGui::Begin("Overlay", nullptr, overlayFlags))
             {
                 ImGui::Text("FPS: %.1f", fpsFrames / std::max(0.0001, fpsTimeAcc));
+
+                const RayCounts rays = tracer.lastRayCounts();
+                const double gpuSeconds = tracer.lastGpuSeconds();
+
+                if (gpuSeconds > 0.0 && rays.rays() > 0)
+                {
+                    const double scale = 1e-6 / gpuSeconds;
+                    ImGui::Text("Mrays/s: %.1f (primary %.1f, bounce %.1f, shadow %.1f)", rays.rays() * scale,
+                        rays.primary * scale, rays.bounce * scale, rays.shadow * scale);
+                    ImGui::Text("Mtests/s: %.1f", rays.intersections * scale);
+                }
+
                 ImGui::Text("Press ESC to pause camera for UI");
+                ImGui::Text("Press F11 to save the image");
+                ImGui::Text("Press F12 to dump a CPU trace");
+
+                if (exporter.capturesPending() > 0)
+                {
+                    ImGui::Text("Saving %u image(s)...", exporter.capturesPending());
+                }
             }
 
             ImGui::End();
@@ -447,9 +831,92 @@ int App::run()
                 sampleFrame = 0;
             }
 
+            // Long dispatches at high samples and depth can stall the UI or trip driver timeouts.
+            bool dispatchChanged = ImGui::Checkbox("Bounded Dispatch", &uiBoundedDispatch);
+
+            if (uiBoundedDispatch)
+            {
+                dispatchChanged |= ImGui::SliderFloat("Dispatch Budget (ms)", &uiDispatchBudgetMs, 1.0f, 50.0f, "%.1f");
+            }
+            if (dispatchChanged)
+            {
+                tracer.setDispatchBudget(uiBoundedDispatch ? uiDispatchBudgetMs * 1e-3 : 0.0);
+            }
+
+            static const char* viewModes[] = { "Color", "Cost: bounces", "Cost: intersections" };
+            ImGui::Combo("View", &uiViewMode, viewModes, IM_ARRAYSIZE(viewModes));
+
+            if (tracer.viewMode() != ViewMode::Color)
+            {
+                const CostStats stats = tracer.costStats();
+                ImGui::Text("Per pixel: min %u  max %u  mean %.2f", stats.minValue, stats.maxValue, stats.mean);
+            }
+
+            // Switching views keeps the one left in the accumulation cache.
+            if (ImGui::Button("Save View") && savedViews.size() < maxSavedViews)
+            {
+                savedViews.push_back({ camPos, camDir, yaw, pitch, uiFocusDist, uiFov, uiAperture, uiMaxDepth });
+            }
+
+            for (size_t i = 0; i < savedViews.size(); ++i)
+            {
+                ImGui::SameLine();
+
+                if (ImGui::Button(std::to_string(i + 1).c_str()))
+                {
+                    const SavedView& view = savedViews[i];
+                    camPos = view.position;
+                    camDir = view.direction;
+                    yaw = view.yaw;
+                    pitch = view.pitch;
+                    uiFocusDist = view.focusDistance;
+                    uiFov = view.fov;
+                    uiAperture = view.aperture;
+                    uiMaxDepth = view.maxDepth;
+                    tracer.setCamera(camPos, camDir, uiFocusDist);
+                    tracer.setFov(uiFov);
+                    tracer.setAperture(uiAperture);
+                    tracer.setMaxDepth(static_cast<uint32_t>(uiMaxDepth));
+                    sampleFrame = 0;
+                }
+            }
+
+            if (accumCache.enabled())
+            {
+                ImGui::Text("Cached views: %u on device, %u on disk", accumCache.deviceEntryCount(), accumCache.diskEntryCount());
+            }
+
+            if (ImGui::Button("Save Image"))
+            {
+                captureRequested = true;
+            }
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Dump CPU Trace"))
+            {
+                dumpCpuTrace();
+            }
+
             ImGui::End();
 
+            telemetry.drawImGui();
+            drawMemoryWindow(vulkanContext);
+
+            {
+                BatchJobDesc view;
+                view.cameraPosition = camPos;
+                view.cameraDirection = camDir;
+                view.focusDistance = uiFocusDist;
+                view.fov = uiFov;
+                view.aperture = uiAperture;
+                view.maxDepth = static_cast<uint32_t>(uiMaxDepth);
+                drawBatchWindow(vulkanContext, scheduler, tracer, view);
+            }
+
             ImGui::Render();
+            profiler::record("ImGuiBuild", imguiBegin, profiler::now());
+            uint64_t overlayBegin = profiler::now();
 
             const auto& swapchainBundle = swapchain.bundle();
             VkRenderPassBeginInfo renderPassInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
@@ -465,6 +932,7 @@ int App::run()
             vkCmdEndRenderPass(frameSync.cmdBuf);
 
             VK_CHECK(vkEndCommandBuffer(frameSync.cmdBuf));
+            profiler::record("RecordOverlay", overlayBegin, profiler::now());
 
             // Submit.
             VkSemaphore waitSemaphores[2]{};
@@ -492,16 +960,30 @@ int App::run()
             submitInfo.signalSemaphoreCount = 2;
             submitInfo.pSignalSemaphores = signalSemaphores;
 
-            VK_CHECK(vkQueueSubmit(vulkanContext.graphicsQueue(), 1, &submitInfo, frameSync.inFlight));
+            {
+                PROFILE_ZONE("Submit");
+                VK_CHECK(vkQueueSubmit(vulkanContext.graphicsQueue(), 1, &submitInfo, frameSync.inFlight));
+            }
+
             hasSubmitted = true;
+            exporter.submitted(vulkanContext);
+            exporter.poll(vulkanContext);
+            frameStream.submitted(vulkanContext);
+            frameStream.poll(vulkanContext);
+            scheduler.submitSlices(vulkanContext, currentFrame, tracer.lastGpuSeconds());
 
             // Present.
-            VkResult presentResult = swapchain.present(vulkanContext, imageRenderFinished[imageIndex], imageIndex);
+            VkResult presentResult = VK_SUCCESS;
+
+            {
+                PROFILE_ZONE("Present");
+                presentResult = swapchain.present(vulkanContext, imageRenderFinished[imageIndex], imageIndex);
+            }
 
             if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
             {
                 swapchain.recreate(vulkanContext, window);
-                tracer.resize(vulkanContext, swapchain);
+                tracer.resize(vulkanContext, swapchain.renderTarget());
                 recreateImageSemaphores(vulkanContext.device(), static_cast<uint32_t>(swapchain.bundle().images.size()), imageRenderFinished, imagesInFlight);
                 sampleFrame = 0;
             }
@@ -510,13 +992,33 @@ int App::run()
                 VK_CHECK(presentResult);
             }
 
-            // FPS.
-            fpsTimeAcc += fpsTimer.elapsedSeconds();
+            // Telemetry and FPS.
+            double frameSeconds = fpsTimer.elapsedSeconds();
+            fpsTimeAcc += frameSeconds;
             ++fpsFrames;
 
+            {
+                FrameTelemetry frameTelemetry;
+                frameTelemetry.frameSeconds = frameSeconds;
+                frameTelemetry.gpuSeconds = tracer.lastGpuSeconds();
+                frameTelemetry.samplesTraced = tracer.lastPixelSamples();
+                frameTelemetry.accumulatedSpp = tracer.completedSamples();
+                vulkanContext.queryMemoryUsage(frameTelemetry.gpuMemoryUsage, frameTelemetry.gpuMemoryBudget);
+
+                const RayCounts rays = tracer.lastRayCounts();
+                frameTelemetry.primaryRays = rays.primary;
+                frameTelemetry.bounceRays = rays.bounce;
+                frameTelemetry.shadowRays = rays.shadow;
+                frameTelemetry.intersectionTests = rays.intersections;
+                telemetry.recordFrame(frameTelemetry);
+            }
+
             if (fpsTimeAcc >= 1.0)
             {
-                logger::info("FPS: %d", fpsFrames);
+                TelemetrySnapshot stats = telemetry.snapshot();
+                logger::info("FPS: %d (frame p50 %.2f ms, p99 %.2f ms; GPU p50 %.2f ms; %.1f Msamples/s; %.1f Mrays/s)",
+                    fpsFrames, stats.frameP50Ms, stats.frameP99Ms, stats.gpuP50Ms, stats.samplesPerSecond * 1e-6, stats.raysPerSecond * 1e-6);
+                checkMemoryBudget(vulkanContext, heapWarned);
                 fpsFrames = 0;
                 fpsTimeAcc = 0.0;
             }
@@ -528,6 +1030,11 @@ int App::run()
         }
 
         vulkanContext.waitIdle();
+        exporter.destroy(vulkanContext);
+        frameStream.destroy(vulkanContext);
+        accumCache.destroy(vulkanContext);
+        scheduler.destroy(vulkanContext);
+        telemetry.stopEndpoint();
         imguiShutdown(vulkanContext.device(), imguiPool);
 
         if (computeSerial)
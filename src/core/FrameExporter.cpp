@@ -0,0 +1,150 @@
+#include "FrameExporter.h"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "../rt/RayTracer.h"
+#include "../util/Logger.h"
+#include "../util/Profiler.h"
+#include "../vk/VulkanContext.h"
+
+void FrameExporter::create(uint32_t slotCount, uint32_t workerThreads)
+{
+    mSlotCount = slotCount;
+    mSlotCaptures.assign(slotCount, SlotCapture{});
+    mWorkers.start(workerThreads, "encoder");
+}
+
+void FrameExporter::destroy(VulkanContext& vulkanContext)
+{
+    flush(vulkanContext);
+    mWorkers.stop();
+    mRing.destroy(vulkanContext);
+}
+
+bool FrameExporter::capture(VulkanContext& vulkanContext, const RayTracer& tracer, VkCommandBuffer commandBuffer, const std::string& basePath)
+{
+    if (mRecordedSlot >= 0)
+    {
+        return false;
+    }
+
+    // Staging buffers follow the accumulation size, but are only swapped once nothing references them.
+    if (mRing.slotBytes() != tracer.accumulationBytes())
+    {
+        if (!mRing.idle())
+        {
+            return false;
+        }
+
+        mRing.create(vulkanContext, mSlotCount, tracer.accumulationBytes());
+    }
+
+    const int32_t slot = mRing.acquire();
+
+    if (slot < 0)
+    {
+        return false;
+    }
+
+    const VkExtent2D extent = tracer.accumulationExtent();
+    tracer.recordAccumulationCopy(commandBuffer, mRing.buffer(static_cast<uint32_t>(slot)), 0);
+    mSlotCaptures[slot] = { basePath, mFormats, extent.width, extent.height };
+    mRecordedSlot = slot;
+    ++mCapturesPending;
+
+    return true;
+}
+
+bool FrameExporter::canCapture(const RayTracer& tracer) const
+{
+    if (mRecordedSlot >= 0)
+    {
+        return false;
+    }
+
+    return mRing.slotBytes() == tracer.accumulationBytes() ? mRing.hasFreeSlot() : mRing.idle();
+}
+
+void FrameExporter::submitted(VulkanContext& vulkanContext)
+{
+    if (mRecordedSlot < 0)
+    {
+        return;
+    }
+
+    mRing.submit(vulkanContext, static_cast<uint32_t>(mRecordedSlot));
+    mRecordedSlot = -1;
+}
+
+void FrameExporter::poll(VulkanContext& vulkanContext)
+{
+    PROFILE_ZONE("ExportPoll");
+    mReady.clear();
+    mRing.poll(vulkanContext, mReady);
+
+    for (uint32_t slot : mReady)
+    {
+        SlotCapture capture = mSlotCaptures[slot];
+
+        mWorkers.submit([this, slot, capture]()
+        {
+            // Resolve first so the staging buffer goes back to the ring before the slow part.
+            auto image = std::make_shared<Image>(resolveAccumulation(static_cast<const glm::vec4*>(mRing.data(slot)), capture.width, capture.height));
+            mRing.release(slot);
+
+            auto remaining = std::make_shared<std::atomic<uint32_t>>(static_cast<uint32_t>(capture.formats.size()));
+
+            for (ImageFormat format : capture.formats)
+            {
+                mWorkers.submit([this, image, remaining, format, basePath = capture.basePath]()
+                {
+                    const std::string path = basePath + "." + imageFormatExtension(format);
+
+                    try
+                    {
+                        writeFileMapped(path, encodeImage(*image, format));
+                        ++mFilesWritten;
+                        logger::info("Saved %s", path);
+                    }
+                    catch (const std::exception& error)
+                    {
+                        ++mFilesFailed;
+                        logger::error("Failed to save %s: %s", path, error.what());
+                    }
+
+                    if (--*remaining == 0)
+                    {
+                        --mCapturesPending;
+                    }
+                });
+            }
+
+            if (capture.formats.empty())
+            {
+                --mCapturesPending;
+            }
+        });
+    }
+}
+
+void FrameExporter::flush(VulkanContext& vulkanContext)
+{
+    if (mRecordedSlot >= 0)
+    {
+        // Recorded into a command buffer that was never submitted.
+        mRing.cancel(static_cast<uint32_t>(mRecordedSlot));
+        mRecordedSlot = -1;
+        --mCapturesPending;
+    }
+
+    while (mCapturesPending.load() > 0)
+    {
+        poll(vulkanContext);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    mWorkers.waitIdle();
+}
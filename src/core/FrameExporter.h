@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../util/ImageEncode.h"
+#include "../util/WorkerPool.h"
+#include "../vk/ReadbackRing.h"
+
+class RayTracer;
+class VulkanContext;
+
+// Saves the accumulation image without stalling the frame loop. The copy is recorded into the frame's own
+// command buffer, its completion is polled rather than waited on, and resolving, encoding and writing run on
+// worker threads, one job per output format.
+class FrameExporter
+{
+public:
+    FrameExporter() = default;
+    ~FrameExporter() = default;
+
+    // 0 worker threads picks one per spare hardware thread. Staging buffers are allocated on the first capture.
+    void create(uint32_t slotCount = 3, uint32_t workerThreads = 0);
+
+    // Finishes outstanding captures, then frees the staging buffers.
+    void destroy(VulkanContext& vulkanContext);
+
+    void setFormats(const std::vector<ImageFormat>& formats)
+    {
+        mFormats = formats;
+    }
+
+    // Records a copy of the accumulation after the frame's dispatch; the files are <basePath>.<extension>.
+    // Returns false, without waiting, when every staging buffer is still busy.
+    bool capture(VulkanContext& vulkanContext, const RayTracer& tracer, VkCommandBuffer commandBuffer, const std::string& basePath);
+
+    // True when capture would succeed for the tracer's current accumulation size.
+    bool canCapture(const RayTracer& tracer) const;
+
+    // Call right after submitting the command buffer given to capture.
+    void submitted(VulkanContext& vulkanContext);
+
+    // Call once per frame. Non-blocking: hands finished copies to the workers.
+    void poll(VulkanContext& vulkanContext);
+
+    // Blocks until every capture so far is on disk. For shutdown and batch tools, never the frame loop.
+    void flush(VulkanContext& vulkanContext);
+
+    uint64_t filesWritten() const
+    {
+        return mFilesWritten.load();
+    }
+
+    uint64_t filesFailed() const
+    {
+        return mFilesFailed.load();
+    }
+
+    // Captures copied or encoding but not yet written.
+    uint32_t capturesPending() const
+    {
+        return mCapturesPending.load();
+    }
+
+private:
+    struct SlotCapture
+    {
+        std::string basePath;
+        std::vector<ImageFormat> formats;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    ReadbackRing mRing;
+    WorkerPool mWorkers;
+    std::vector<SlotCapture> mSlotCaptures;
+    std::vector<uint32_t> mReady;
+    std::vector<ImageFormat> mFormats{ ImageFormat::Pfm, ImageFormat::ExrHalf, ImageFormat::Png };
+    uint32_t mSlotCount = 0;
+    int32_t mRecordedSlot = -1;
+    std::atomic<uint64_t> mFilesWritten{ 0 };
+    std::atomic<uint64_t> mFilesFailed{ 0 };
+    std::atomic<uint32_t> mCapturesPending{ 0 };
+};
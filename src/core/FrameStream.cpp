@@ -0,0 +1,546 @@
+#include "FrameStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "../util/Env.h"
+#include "../util/Logger.h"
+#include "../util/Profiler.h"
+#include "../vk/VulkanContext.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t streamSlotCount = 2;
+    const double reopenIntervalSeconds = 1.0;
+
+    uint32_t envUint(const char* name, uint32_t fallback)
+    {
+        const std::string value = readEnv(name);
+
+        if (value.empty())
+        {
+            return fallback;
+        }
+
+        return static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+    }
+
+    // BT.601 limited range, 8-bit fixed point.
+    uint8_t lumaOf(int r, int g, int b)
+    {
+        return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+
+    uint8_t blueDifferenceOf(int r, int g, int b)
+    {
+        return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    }
+
+    uint8_t redDifferenceOf(int r, int g, int b)
+    {
+        return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    bool streamableFormat(VkFormat format, bool& bgra)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            bgra = true;
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            bgra = false;
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
+FrameStreamSettings frameStreamSettingsFromEnv()
+{
+    FrameStreamSettings settings;
+    settings.path = readEnv("VRAYT_FRAME_STREAM");
+
+    const std::string format = readEnv("VRAYT_FRAME_STREAM_FORMAT");
+
+    if (format == "rgb")
+    {
+        settings.format = FrameStreamFormat::Rgb;
+    }
+    else if (!format.empty() && format != "y4m")
+    {
+        logger::warn("Unknown VRAYT_FRAME_STREAM_FORMAT '%s', streaming Y4M", format);
+    }
+
+    settings.every = std::max(envUint("VRAYT_FRAME_STREAM_EVERY", settings.every), 1u);
+    settings.fps = std::max(envUint("VRAYT_FRAME_STREAM_FPS", settings.fps), 1u);
+
+    return settings;
+}
+
+void FrameStream::create(const FrameStreamSettings& settings)
+{
+    mSettings = settings;
+
+    if (!enabled())
+    {
+        return;
+    }
+
+    mSlotFrames.assign(streamSlotCount, SlotFrame{});
+    mWriter.start(1, "frame stream");
+
+#ifndef _WIN32
+    // A reader closing the pipe surfaces as EPIPE from write instead of killing the process.
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (mSettings.path == "-")
+    {
+        // Log lines would interleave with the video otherwise.
+        logger::setConsoleStream(stderr);
+        mStdout = true;
+    }
+
+    logger::info("Streaming %s frames to %s", mSettings.format == FrameStreamFormat::Y4m ? "Y4M" : "RGB",
+        mStdout ? "stdout" : mSettings.path);
+}
+
+void FrameStream::destroy(VulkanContext& vulkanContext)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    if (mRecordedSlot >= 0)
+    {
+        mRing.cancel(static_cast<uint32_t>(mRecordedSlot));
+        mRecordedSlot = -1;
+    }
+
+    // Copies still in flight land and are written before the output closes.
+    while (!mRing.idle())
+    {
+        poll(vulkanContext);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    mWriter.stop();
+    mRing.destroy(vulkanContext);
+    closeOutput();
+
+    logger::info("Frame stream: %llu frames written, %llu dropped", static_cast<unsigned long long>(mFramesWritten.load()),
+        static_cast<unsigned long long>(mFramesDropped.load()));
+}
+
+void FrameStream::capture(VulkanContext& vulkanContext, VkCommandBuffer commandBuffer, VkImage image, VkFormat format, const VkExtent2D& extent)
+{
+    if (!enabled() || mRecordedSlot >= 0)
+    {
+        return;
+    }
+
+    // The writer detaches on its own thread; reopening waits until it has nothing left to write.
+    if (!mAttached.load() && !openOutput())
+    {
+        return;
+    }
+
+    if (mFrameCounter++ % mSettings.every != 0)
+    {
+        return;
+    }
+
+    bool bgra = false;
+
+    if (!streamableFormat(format, bgra))
+    {
+        if (!mFormatWarned)
+        {
+            logger::warn("Frame stream: swapchain format %d is not RGBA8 or BGRA8, nothing will be streamed", static_cast<int>(format));
+            mFormatWarned = true;
+        }
+
+        return;
+    }
+
+    const VkDeviceSize bytes = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+    // Staging buffers follow the window size, but are only swapped once nothing references them.
+    if (mRing.slotBytes() != bytes)
+    {
+        if (!mRing.idle())
+        {
+            ++mFramesDropped;
+            return;
+        }
+
+        mRing.create(vulkanContext, streamSlotCount, bytes);
+    }
+
+    const int32_t slot = mRing.acquire();
+
+    if (slot < 0)
+    {
+        ++mFramesDropped;
+        return;
+    }
+
+    PROFILE_ZONE("FrameStreamCopy");
+    const VkBuffer buffer = mRing.buffer(static_cast<uint32_t>(slot));
+
+    VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toTransfer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    // Back to where the UI pass expects it.
+    VkImageMemoryBarrier toAttachment = toTransfer;
+    toAttachment.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toAttachment.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toAttachment.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toAttachment.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkBufferMemoryBarrier toHost{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = buffer;
+    toHost.size = bytes;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        0, 0, nullptr, 1, &toHost, 1, &toAttachment);
+
+    mSlotFrames[slot] = { extent, bgra };
+    mRecordedSlot = slot;
+}
+
+void FrameStream::submitted(VulkanContext& vulkanContext)
+{
+    if (mRecordedSlot < 0)
+    {
+        return;
+    }
+
+    mRing.submit(vulkanContext, static_cast<uint32_t>(mRecordedSlot));
+    mRecordedSlot = -1;
+}
+
+void FrameStream::poll(VulkanContext& vulkanContext)
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    PROFILE_ZONE("FrameStreamPoll");
+    mReady.clear();
+    mRing.poll(vulkanContext, mReady);
+
+    for (uint32_t slot : mReady)
+    {
+        mWriter.submit([this, slot]()
+        {
+            writeFrame(slot);
+        });
+    }
+}
+
+bool FrameStream::openOutput()
+{
+    // Stdout is attached once; after its reader goes away there is nothing to reopen.
+    if (mWriter.pending() > 0 || (mStdout && mOpenAttempted))
+    {
+        return false;
+    }
+
+    // Probing a FIFO without a reader is cheap, but there is no need to do it every frame.
+    if (mOpenAttempted && mSinceOpenAttempt.elapsedSeconds() < reopenIntervalSeconds)
+    {
+        return false;
+    }
+
+    mOpenAttempted = true;
+    mSinceOpenAttempt.reset();
+    closeOutput();
+
+#ifdef _WIN32
+    if (mStdout)
+    {
+        mFile = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+    else
+    {
+        // Named pipes (\\.\pipe\name) are created by the reader and only exist while it listens.
+        const bool pipe = mSettings.path.rfind("\\\\.\\pipe\\", 0) == 0;
+        HANDLE file = CreateFileA(mSettings.path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, pipe ? OPEN_EXISTING : CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        mFile = file == INVALID_HANDLE_VALUE ? nullptr : file;
+    }
+
+    if (!mFile)
+    {
+        return false;
+    }
+#else
+    if (mStdout)
+    {
+        mFile = STDOUT_FILENO;
+    }
+    else
+    {
+        struct stat info{};
+
+        if (stat(mSettings.path.c_str(), &info) == 0 && S_ISFIFO(info.st_mode))
+        {
+            // Without a reader a non-blocking open fails with ENXIO instead of waiting for one.
+            mFile = open(mSettings.path.c_str(), O_WRONLY | O_NONBLOCK);
+
+            if (mFile >= 0)
+            {
+                fcntl(mFile, F_SETFL, fcntl(mFile, F_GETFL) & ~O_NONBLOCK);
+            }
+        }
+        else
+        {
+            mFile = open(mSettings.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+    }
+
+    if (mFile < 0)
+    {
+        if (errno != ENXIO)
+        {
+            logger::warn("Frame stream: cannot open %s", mSettings.path);
+        }
+
+        return false;
+    }
+#endif
+
+    mHeaderWritten = false;
+    mAttached = true;
+
+    if (!mStdout)
+    {
+        logger::info("Frame stream: reader attached to %s", mSettings.path);
+    }
+
+    return true;
+}
+
+void FrameStream::closeOutput()
+{
+#ifdef _WIN32
+    if (mFile && !mStdout)
+    {
+        CloseHandle(static_cast<HANDLE>(mFile));
+    }
+
+    mFile = nullptr;
+#else
+    if (mFile >= 0 && !mStdout)
+    {
+        ::close(mFile);
+    }
+
+    mFile = -1;
+#endif
+}
+
+void FrameStream::writeFrame(uint32_t slot)
+{
+    const SlotFrame frame = mSlotFrames[slot];
+
+    if (!mAttached.load())
+    {
+        mRing.release(slot);
+        ++mFramesDropped;
+        return;
+    }
+
+    if (!mHeaderWritten)
+    {
+        mStreamExtent = frame.extent;
+    }
+    else if (frame.extent.width != mStreamExtent.width || frame.extent.height != mStreamExtent.height)
+    {
+        mRing.release(slot);
+        ++mFramesDropped;
+
+        if (!mSizeWarned)
+        {
+            logger::warn("Frame stream: window resized to %ux%u, dropping frames until it is %ux%u again", frame.extent.width,
+                frame.extent.height, mStreamExtent.width, mStreamExtent.height);
+            mSizeWarned = true;
+        }
+
+        return;
+    }
+
+    PROFILE_ZONE("FrameStreamWrite");
+    const uint32_t width = frame.extent.width;
+    const uint32_t height = frame.extent.height;
+    const uint8_t* pixels = static_cast<const uint8_t*>(mRing.data(slot));
+    const int red = frame.bgra ? 2 : 0;
+    const int blue = frame.bgra ? 0 : 2;
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+
+    std::string header;
+
+    if (mSettings.format == FrameStreamFormat::Y4m)
+    {
+        if (!mHeaderWritten)
+        {
+            char line[128];
+            std::snprintf(line, sizeof(line), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, mSettings.fps);
+            header = line;
+        }
+
+        header += "FRAME\n";
+
+        // Full-resolution luma, then chroma averaged over each 2x2 block (clamped at odd edges).
+        const uint32_t chromaWidth = (width + 1) / 2;
+        const uint32_t chromaHeight = (height + 1) / 2;
+        const size_t chromaCount = static_cast<size_t>(chromaWidth) * chromaHeight;
+        mPlanes.resize(pixelCount + 2 * chromaCount);
+        uint8_t* luma = mPlanes.data();
+        uint8_t* blueDifference = luma + pixelCount;
+        uint8_t* redDifference = blueDifference + chromaCount;
+
+        for (size_t i = 0; i < pixelCount; ++i)
+        {
+            const uint8_t* pixel = pixels + i * 4;
+            luma[i] = lumaOf(pixel[red], pixel[1], pixel[blue]);
+        }
+
+        for (uint32_t y = 0; y < chromaHeight; ++y)
+        {
+            const uint32_t y0 = y * 2;
+            const uint32_t y1 = std::min(y0 + 1, height - 1);
+
+            for (uint32_t x = 0; x < chromaWidth; ++x)
+            {
+                const uint32_t x0 = x * 2;
+                const uint32_t x1 = std::min(x0 + 1, width - 1);
+                const uint8_t* quad[4] = { pixels + (static_cast<size_t>(y0) * width + x0) * 4, pixels + (static_cast<size_t>(y0) * width + x1) * 4,
+                    pixels + (static_cast<size_t>(y1) * width + x0) * 4, pixels + (static_cast<size_t>(y1) * width + x1) * 4 };
+                int r = 2;
+                int g = 2;
+                int b = 2;
+
+                for (const uint8_t* pixel : quad)
+                {
+                    r += pixel[red];
+                    g += pixel[1];
+                    b += pixel[blue];
+                }
+
+                blueDifference[static_cast<size_t>(y) * chromaWidth + x] = blueDifferenceOf(r / 4, g / 4, b / 4);
+                redDifference[static_cast<size_t>(y) * chromaWidth + x] = redDifferenceOf(r / 4, g / 4, b / 4);
+            }
+        }
+    }
+    else
+    {
+        mPlanes.resize(pixelCount * 3);
+
+        for (size_t i = 0; i < pixelCount; ++i)
+        {
+            const uint8_t* pixel = pixels + i * 4;
+            mPlanes[i * 3 + 0] = pixel[red];
+            mPlanes[i * 3 + 1] = pixel[1];
+            mPlanes[i * 3 + 2] = pixel[blue];
+        }
+    }
+
+    // Converted, so the staging buffer can take the next copy while this one is written.
+    mRing.release(slot);
+
+    if (!writeBytes(header.data(), header.size()) || !writeBytes(mPlanes.data(), mPlanes.size()))
+    {
+        ++mFramesDropped;
+
+        logger::info("Frame stream: reader detached from %s", mStdout ? "stdout" : mSettings.path);
+
+        // Closed before detaching, so the render thread never reopens over a live handle.
+        closeOutput();
+        mHeaderWritten = false;
+        mSizeWarned = false;
+        mAttached = false;
+
+        return;
+    }
+
+    mHeaderWritten = true;
+    ++mFramesWritten;
+}
+
+bool FrameStream::writeBytes(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    while (size > 0)
+    {
+#ifdef _WIN32
+        DWORD written = 0;
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+
+        if (!WriteFile(static_cast<HANDLE>(mFile), bytes, chunk, &written, nullptr) || written == 0)
+        {
+            return false;
+        }
+#else
+        const ssize_t written = write(mFile, bytes, size);
+
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+#endif
+
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../util/Timer.h"
+#include "../util/WorkerPool.h"
+#include "../vk/ReadbackRing.h"
+
+class VulkanContext;
+
+enum class FrameStreamFormat
+{
+    Y4m, // YUV4MPEG2, 4:2:0, BT.601 limited range.
+    Rgb // Raw rgb24 rows, top to bottom, no header.
+};
+
+struct FrameStreamSettings
+{
+    std::string path; // "-" for stdout, otherwise a FIFO or a file. Empty disables streaming.
+    FrameStreamFormat format = FrameStreamFormat::Y4m;
+    uint32_t every = 1; // Streams every Nth presented frame.
+    uint32_t fps = 60; // Nominal rate written into the Y4M header.
+};
+
+// Reads VRAYT_FRAME_STREAM (path), VRAYT_FRAME_STREAM_FORMAT (y4m or rgb), VRAYT_FRAME_STREAM_EVERY and
+// VRAYT_FRAME_STREAM_FPS.
+FrameStreamSettings frameStreamSettingsFromEnv();
+
+// Streams presented frames as raw video to stdout, a named pipe or a file, for an encoder to read. The copy is
+// recorded into the frame's own command buffer and lands in one of two staging buffers; a writer thread converts
+// and writes it while the next frame renders. When both buffers are still being written, the frame is dropped
+// rather than waited for. A FIFO is only written while a reader has it open, and nothing is recorded otherwise;
+// when the reader goes away, streaming pauses until the next one opens it and gets a fresh header.
+//
+// The stream keeps the size of its first frame; frames of another size (after a window resize) are dropped.
+class FrameStream
+{
+public:
+    FrameStream() = default;
+    ~FrameStream() = default;
+
+    void create(const FrameStreamSettings& settings);
+
+    // Finishes the frames being written, then frees the staging buffers and closes the output.
+    void destroy(VulkanContext& vulkanContext);
+
+    bool enabled() const
+    {
+        return !mSettings.path.empty();
+    }
+
+    // Records a copy of a presentable image the ray tracer has handed over in COLOR_ATTACHMENT_OPTIMAL, when a
+    // reader is attached, the frame is due and a staging buffer is free. The image needs TRANSFER_SRC usage and an
+    // RGBA8 or BGRA8 format.
+    void capture(VulkanContext& vulkanContext, VkCommandBuffer commandBuffer, VkImage image, VkFormat format, const VkExtent2D& extent);
+
+    // Call right after submitting the command buffer given to capture.
+    void submitted(VulkanContext& vulkanContext);
+
+    // Call once per frame. Non-blocking: hands finished copies to the writer.
+    void poll(VulkanContext& vulkanContext);
+
+    uint64_t framesWritten() const
+    {
+        return mFramesWritten.load();
+    }
+
+    uint64_t framesDropped() const
+    {
+        return mFramesDropped.load();
+    }
+
+private:
+    struct SlotFrame
+    {
+        VkExtent2D extent{};
+        bool bgra = false;
+    };
+
+    // Opens the output when a reader is there. Main thread, while the writer is idle.
+    bool openOutput();
+    void closeOutput();
+
+    // Writer thread.
+    void writeFrame(uint32_t slot);
+    bool writeBytes(const void* data, size_t size);
+
+    FrameStreamSettings mSettings;
+    ReadbackRing mRing;
+    WorkerPool mWriter;
+    std::vector<SlotFrame> mSlotFrames;
+    std::vector<uint32_t> mReady;
+    std::vector<uint8_t> mPlanes; // Writer thread only.
+    int32_t mRecordedSlot = -1;
+    uint64_t mFrameCounter = 0;
+    Timer mSinceOpenAttempt;
+    bool mOpenAttempted = false;
+    bool mStdout = false;
+    std::atomic<bool> mAttached{ false };
+    VkExtent2D mStreamExtent{}; // Set by the first frame after opening; writer thread only.
+    bool mHeaderWritten = false; // Writer thread only.
+    bool mSizeWarned = false; // Writer thread only.
+    bool mFormatWarned = false;
+#ifdef _WIN32
+    void* mFile = nullptr;
+#else
+    int mFile = -1;
+#endif
+    std::atomic<uint64_t> mFramesWritten{ 0 };
+    std::atomic<uint64_t> mFramesDropped{ 0 };
+};
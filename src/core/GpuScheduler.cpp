@@ -0,0 +1,420 @@
+#include "GpuScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../util/Check.h"
+#include "../util/Logger.h"
+#include "../util/Profiler.h"
+#include "../vk/VulkanContext.h"
+
+namespace
+{
+    const double budgetHeadroom = 0.9; // Of the frame budget, to absorb timing noise.
+    const double interactiveSmoothing = 0.2;
+    const double costSmoothing = 0.3;
+    const double shareBackoff = 0.7;
+    const double shareRecovery = 0.02;
+    const double minBatchShare = 0.05;
+
+    // A job that finds no time left still gets a slice every this many frames while nothing else runs, so it
+    // finishes eventually.
+    const uint32_t starvationFrames = 30;
+    const double starvedTileShare = 0.1; // Of the frame budget, for a starved job too costly for whole-image slices.
+}
+
+const char* batchPriorityName(BatchPriority priority)
+{
+    switch (priority)
+    {
+    case BatchPriority::Low:
+        return "Low";
+    case BatchPriority::High:
+        return "High";
+    default:
+        return "Normal";
+    }
+}
+
+void GpuScheduler::create(VulkanContext& vulkanContext, uint32_t slotCount)
+{
+    mSlotCount = slotCount;
+
+    VkCommandPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    poolInfo.queueFamilyIndex = vulkanContext.graphicsFamilyIndex();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK(vkCreateCommandPool(vulkanContext.device(), &poolInfo, nullptr, &mCommandPool));
+
+    mCommandBuffers.assign(slotCount, VK_NULL_HANDLE);
+    VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    allocInfo.commandPool = mCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = slotCount;
+    VK_CHECK(vkAllocateCommandBuffers(vulkanContext.device(), &allocInfo, mCommandBuffers.data()));
+
+    mFences.assign(slotCount, VK_NULL_HANDLE);
+    mSlotSerials.assign(slotCount, 0);
+
+    for (VkFence& fence : mFences)
+    {
+        VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VK_CHECK(vkCreateFence(vulkanContext.device(), &fenceInfo, nullptr, &fence));
+    }
+
+    // Finished jobs are saved through their own staging ring, so their sizes never churn the interactive one.
+    mExporter.create(1, 2);
+}
+
+void GpuScheduler::destroy(VulkanContext& vulkanContext)
+{
+    if (!mCommandPool)
+    {
+        return;
+    }
+
+    vulkanContext.waitIdle();
+    mExporter.destroy(vulkanContext);
+
+    for (auto* jobs : { &mJobs, &mRetired })
+    {
+        for (auto& job : *jobs)
+        {
+            job->tracer->destroy(vulkanContext);
+            job->target.destroy(vulkanContext);
+        }
+
+        jobs->clear();
+    }
+
+    for (VkFence fence : mFences)
+    {
+        vkDestroyFence(vulkanContext.device(), fence, nullptr);
+    }
+
+    vkDestroyCommandPool(vulkanContext.device(), mCommandPool, nullptr);
+    mCommandPool = VK_NULL_HANDLE;
+    mCommandBuffers.clear();
+    mFences.clear();
+    mSlotSerials.clear();
+}
+
+uint64_t GpuScheduler::addJob(VulkanContext& vulkanContext, const RayTracer& sceneSource, const BatchJobDesc& desc)
+{
+    if (desc.extent.width == 0 || desc.extent.height == 0 || desc.targetSpp == 0)
+    {
+        throw std::runtime_error("Batch jobs need a non-empty extent and sample count");
+    }
+
+    auto job = std::make_unique<Job>();
+    job->id = mNextJobId++;
+    job->desc = desc;
+    job->slotSamples.assign(mSlotCount, 0);
+    job->slotTiled.assign(mSlotCount, false);
+
+    // One image per slot: params, counters and timestamps are per image, so slots in flight never share them.
+    job->target.create(vulkanContext, desc.extent, mSlotCount);
+    job->tracer = std::make_unique<RayTracer>();
+    job->tracer->create(vulkanContext, job->target.target());
+
+    if (job->tracer->sceneHash() != sceneSource.sceneHash())
+    {
+        job->tracer->setScene(vulkanContext, sceneSource.spheres());
+    }
+
+    RayTracer& tracer = *job->tracer;
+    tracer.setCamera(desc.cameraPosition, desc.cameraDirection, desc.focusDistance);
+    tracer.setFov(desc.fov);
+    tracer.setAperture(desc.aperture);
+    tracer.setMaxDepth(desc.maxDepth);
+
+    logger::info("Batch job %llu (%s): %ux%u, %u spp, priority %s", static_cast<unsigned long long>(job->id), desc.name, desc.extent.width,
+        desc.extent.height, desc.targetSpp, batchPriorityName(desc.priority));
+
+    mJobs.push_back(std::move(job));
+
+    return mJobs.back()->id;
+}
+
+void GpuScheduler::cancelJob(uint64_t id)
+{
+    for (auto& job : mJobs)
+    {
+        if (job->id == id)
+        {
+            job->cancelled = true;
+        }
+    }
+}
+
+std::vector<GpuScheduler::Slice> GpuScheduler::planSlices(double interactiveGpuSeconds)
+{
+    if (interactiveGpuSeconds > 0.0)
+    {
+        mInteractiveSeconds = mInteractiveSeconds > 0.0
+            ? mInteractiveSeconds + (interactiveGpuSeconds - mInteractiveSeconds) * interactiveSmoothing
+            : interactiveGpuSeconds;
+    }
+
+    double available = std::max(0.0, mFrameBudgetSeconds * budgetHeadroom - mInteractiveSeconds) * mBatchShare;
+
+    std::vector<Job*> order;
+
+    for (auto& job : mJobs)
+    {
+        if (!job->saving && !job->cancelled)
+        {
+            order.push_back(job.get());
+        }
+    }
+
+    // Priority first, then earliest deadline; jobs without one go last, in submission order.
+    std::sort(order.begin(), order.end(), [](const Job* a, const Job* b)
+    {
+        if (a->desc.priority != b->desc.priority)
+        {
+            return a->desc.priority > b->desc.priority;
+        }
+
+        const bool aDeadline = a->desc.deadlineSeconds > 0.0;
+        const bool bDeadline = b->desc.deadlineSeconds > 0.0;
+
+        if (aDeadline != bDeadline)
+        {
+            return aDeadline;
+        }
+        if (aDeadline)
+        {
+            const double aLeft = a->desc.deadlineSeconds - a->age.elapsedSeconds();
+            const double bLeft = b->desc.deadlineSeconds - b->age.elapsedSeconds();
+
+            if (aLeft != bLeft)
+            {
+                return aLeft < bLeft;
+            }
+        }
+
+        return a->id < b->id;
+    });
+
+    std::vector<Slice> slices;
+    mLastBatchSeconds = 0.0;
+
+    for (Job* job : order)
+    {
+        const uint32_t remaining = job->desc.targetSpp - job->samplesDone;
+        uint32_t samples = 0;
+
+        if (job->secondsPerSample <= 0.0)
+        {
+            // Unknown cost: probe with one sample and leave the rest of the frame alone until it is measured.
+            samples = available > 0.0 ? 1 : 0;
+        }
+        else
+        {
+            samples = static_cast<uint32_t>(std::min(available / job->secondsPerSample, static_cast<double>(remaining)));
+        }
+
+        double tiledSeconds = 0.0;
+
+        if (samples == 0)
+        {
+            // One sample of the whole image does not fit: trace tiles of it with bounded dispatch instead, in the
+            // time left or, once starved, in a small share of the frame.
+            if (job->secondsPerSample > 0.0 && available > 0.0)
+            {
+                tiledSeconds = available;
+            }
+            else if (!slices.empty() || ++job->starvedFrames < starvationFrames)
+            {
+                continue;
+            }
+            else if (job->secondsPerSample > 0.0)
+            {
+                tiledSeconds = mFrameBudgetSeconds * starvedTileShare;
+            }
+            else
+            {
+                samples = 1;
+            }
+        }
+
+        job->starvedFrames = 0;
+        samples = std::min(samples, remaining);
+        const double cost = tiledSeconds > 0.0 ? tiledSeconds : job->secondsPerSample > 0.0 ? samples * job->secondsPerSample : available;
+        available = std::max(0.0, available - cost);
+        mLastBatchSeconds += cost;
+        slices.push_back({ job, samples, tiledSeconds });
+    }
+
+    return slices;
+}
+
+void GpuScheduler::retireJobs(VulkanContext& vulkanContext)
+{
+    for (auto& job : mJobs)
+    {
+        if (job->cancelled)
+        {
+            logger::info("Batch job %llu (%s) cancelled at %u spp", static_cast<unsigned long long>(job->id), job->desc.name, job->samplesDone);
+            mRetired.push_back(std::move(job));
+        }
+    }
+
+    mJobs.erase(std::remove(mJobs.begin(), mJobs.end(), nullptr), mJobs.end());
+
+    for (auto& job : mRetired)
+    {
+        if (job->lastSerial <= mCompletedSerial)
+        {
+            job->tracer->destroy(vulkanContext);
+            job->target.destroy(vulkanContext);
+            job.reset();
+        }
+    }
+
+    mRetired.erase(std::remove(mRetired.begin(), mRetired.end(), nullptr), mRetired.end());
+}
+
+void GpuScheduler::submitSlices(VulkanContext& vulkanContext, uint32_t slot, double interactiveGpuSeconds)
+{
+    PROFILE_ZONE("BatchSlices");
+
+    VK_CHECK(vkWaitForFences(vulkanContext.device(), 1, &mFences[slot], VK_TRUE, UINT64_MAX));
+    mCompletedSerial = std::max(mCompletedSerial, mSlotSerials[slot]);
+    retireJobs(vulkanContext);
+    mExporter.poll(vulkanContext);
+
+    if (mJobs.empty())
+    {
+        mLastBatchSeconds = 0.0;
+
+        return;
+    }
+
+    std::vector<Slice> slices = planSlices(interactiveGpuSeconds);
+    const bool saving = std::any_of(mJobs.begin(), mJobs.end(), [](const std::unique_ptr<Job>& job) { return job->saving; });
+
+    if (slices.empty() && !saving)
+    {
+        return;
+    }
+
+    VkCommandBuffer commandBuffer = mCommandBuffers[slot];
+    VK_CHECK(vkResetFences(vulkanContext.device(), 1, &mFences[slot]));
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    const uint64_t serial = mNextSerial++;
+    double measuredSeconds = 0.0;
+
+    for (const Slice& slice : slices)
+    {
+        Job& job = *slice.job;
+        RayTracer& tracer = *job.tracer;
+        const uint32_t previousSamples = job.slotSamples[slot];
+        const bool previousTiled = job.slotTiled[slot];
+
+        // Rendering this slot reads back the timestamps of the slice it ran last time.
+        tracer.setDispatchSamples(std::max(1u, slice.samples));
+        tracer.setDispatchBudget(slice.tiledSeconds);
+        tracer.setSampleBase(job.nextSample);
+        tracer.render(vulkanContext, job.target.target(), commandBuffer, slot, job.nextFrame);
+
+        if ((previousSamples > 0 || previousTiled) && tracer.lastGpuSeconds() > 0.0)
+        {
+            measuredSeconds += tracer.lastGpuSeconds();
+
+            // Tiled slices cover part of the image, so only whole-image slices price a sample.
+            if (!previousTiled)
+            {
+                const double perSample = tracer.lastGpuSeconds() / previousSamples;
+                job.secondsPerSample = job.secondsPerSample > 0.0 ? job.secondsPerSample + (perSample - job.secondsPerSample) * costSmoothing : perSample;
+            }
+        }
+
+        job.slotSamples[slot] = slice.samples;
+        job.slotTiled[slot] = slice.tiledSeconds > 0.0;
+        job.samplesDone = tracer.completedSamples();
+        job.lastSerial = serial;
+        job.nextSample = tracer.nextSample();
+        ++job.nextFrame;
+
+        if (job.samplesDone >= job.desc.targetSpp)
+        {
+            job.saving = true;
+        }
+    }
+
+    // Overrunning the budget means the interactive frame paid for the slices; back off, otherwise creep back.
+    if (mInteractiveSeconds + measuredSeconds > mFrameBudgetSeconds)
+    {
+        mBatchShare = std::max(minBatchShare, mBatchShare * shareBackoff);
+    }
+    else
+    {
+        mBatchShare = std::min(1.0, mBatchShare + shareRecovery);
+    }
+
+    // One capture per submission; the others retry next frame.
+    bool captured = false;
+
+    for (auto& job : mJobs)
+    {
+        if (!job->saving || captured)
+        {
+            continue;
+        }
+
+        mExporter.setFormats(job->desc.formats);
+
+        if (mExporter.capture(vulkanContext, *job->tracer, commandBuffer, job->desc.basePath))
+        {
+            logger::info("Batch job %llu (%s) reached %u spp in %.1f s, saving %s", static_cast<unsigned long long>(job->id), job->desc.name,
+                job->samplesDone, job->age.elapsedSeconds(), job->desc.basePath);
+            job->lastSerial = serial;
+            mRetired.push_back(std::move(job));
+            captured = true;
+        }
+    }
+
+    mJobs.erase(std::remove(mJobs.begin(), mJobs.end(), nullptr), mJobs.end());
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    VK_CHECK(vkQueueSubmit(vulkanContext.graphicsQueue(), 1, &submitInfo, mFences[slot]));
+    mSlotSerials[slot] = serial;
+
+    if (captured)
+    {
+        mExporter.submitted(vulkanContext);
+    }
+}
+
+std::vector<BatchJobStatus> GpuScheduler::status() const
+{
+    std::vector<BatchJobStatus> result;
+
+    for (const auto& job : mJobs)
+    {
+        BatchJobStatus status;
+        status.id = job->id;
+        status.name = job->desc.name;
+        status.priority = job->desc.priority;
+        status.samplesDone = std::min(job->samplesDone, job->desc.targetSpp);
+        status.targetSpp = job->desc.targetSpp;
+        status.secondsPerSample = job->secondsPerSample;
+        status.hasDeadline = job->desc.deadlineSeconds > 0.0;
+        status.secondsToDeadline = status.hasDeadline ? job->desc.deadlineSeconds - job->age.elapsedSeconds() : 0.0;
+        status.saving = job->saving;
+        result.push_back(status);
+    }
+
+    return result;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "FrameExporter.h"
+#include "../rt/RayTracer.h"
+#include "../util/Timer.h"
+#include "../vk/OffscreenTarget.h"
+
+class VulkanContext;
+
+enum class BatchPriority : uint32_t
+{
+    Low,
+    Normal,
+    High
+};
+
+const char* batchPriorityName(BatchPriority priority);
+
+// A background render: the view, settings and sample count to reach, and where to save the result.
+struct BatchJobDesc
+{
+    std::string name;
+    VkExtent2D extent{ 1920, 1080 };
+    glm::vec3 cameraPosition{ 13.0f, 2.0f, 3.0f };
+    glm::vec3 cameraDirection{ -1.0f, 0.0f, 0.0f };
+    float focusDistance = 10.0f;
+    float fov = 20.0f;
+    float aperture = 0.05f;
+    uint32_t maxDepth = 12;
+    uint32_t targetSpp = 1024;
+    BatchPriority priority = BatchPriority::Normal;
+    double deadlineSeconds = 0.0; // From submission; 0 means none.
+    std::string basePath; // Files are <basePath>.<extension>.
+    std::vector<ImageFormat> formats{ ImageFormat::ExrHalf, ImageFormat::Png };
+};
+
+struct BatchJobStatus
+{
+    uint64_t id = 0;
+    std::string name;
+    BatchPriority priority = BatchPriority::Normal;
+    uint32_t samplesDone = 0;
+    uint32_t targetSpp = 0;
+    double secondsPerSample = 0.0; // Measured GPU time of one sample per pixel, 0 until known.
+    double secondsToDeadline = 0.0; // Negative once missed; 0 without a deadline.
+    bool hasDeadline = false;
+    bool saving = false;
+};
+
+// Shares the queue between the interactive view and background batch renders. Each frame, after the interactive
+// submission, the batch jobs get what is left of the frame's GPU budget: jobs run in priority order, earliest
+// deadline first within a priority, as slices of a whole number of samples per pixel sized from each job's
+// measured cost. A job too costly for one sample of its whole image gets tiles of it through bounded dispatch.
+// The batch share backs off multiplicatively whenever the interactive frame plus its slices overrun the budget
+// and recovers slowly, so the interactive frame time stays within budget.
+class GpuScheduler
+{
+public:
+    GpuScheduler() = default;
+    ~GpuScheduler() = default;
+
+    // slotCount is the number of frames in flight; slot indices passed to submitSlices cycle through them.
+    void create(VulkanContext& vulkanContext, uint32_t slotCount);
+    void destroy(VulkanContext& vulkanContext);
+
+    // GPU time per frame shared by the interactive frame and batch slices.
+    void setFrameBudget(double seconds)
+    {
+        mFrameBudgetSeconds = seconds;
+    }
+
+    double frameBudget() const
+    {
+        return mFrameBudgetSeconds;
+    }
+
+    // Creates the job's tracer and accumulation image on the interactive tracer's scene. Waits for the device.
+    uint64_t addJob(VulkanContext& vulkanContext, const RayTracer& sceneSource, const BatchJobDesc& desc);
+    void cancelJob(uint64_t id);
+
+    // Call once per frame right after the interactive frame is submitted, with that tracer's latest GPU time.
+    // Waits for the slot's previous batch submission, then plans and submits this frame's slices behind the
+    // interactive work.
+    void submitSlices(VulkanContext& vulkanContext, uint32_t slot, double interactiveGpuSeconds);
+
+    std::vector<BatchJobStatus> status() const;
+
+    // Fraction of the budget left after the interactive frame that batch slices may use.
+    double batchShare() const
+    {
+        return mBatchShare;
+    }
+
+    double lastBatchSeconds() const
+    {
+        return mLastBatchSeconds;
+    }
+
+    bool hasJobs() const
+    {
+        return !mJobs.empty();
+    }
+
+private:
+    struct Job
+    {
+        uint64_t id = 0;
+        BatchJobDesc desc;
+        OffscreenTarget target;
+        std::unique_ptr<RayTracer> tracer;
+        uint32_t samplesDone = 0;
+        uint32_t nextFrame = 0;
+        uint64_t nextSample = 0; // Sample indices dispatched so far; slices vary in size, so frames cannot key them.
+        double secondsPerSample = 0.0;
+        std::vector<uint32_t> slotSamples; // Samples of the slice last recorded in each slot.
+        std::vector<bool> slotTiled; // Whether that slice was tiled.
+        uint32_t starvedFrames = 0;
+        Timer age;
+        bool saving = false; // Target reached; waiting for the exporter to take the copy.
+        bool cancelled = false;
+        uint64_t lastSerial = 0; // Submission that last used the job's resources.
+    };
+
+    struct Slice
+    {
+        Job* job = nullptr;
+        uint32_t samples = 0;
+        double tiledSeconds = 0.0; // Above 0: tiles of the image within this GPU time, not whole-image samples.
+    };
+
+    std::vector<Slice> planSlices(double interactiveGpuSeconds);
+    void retireJobs(VulkanContext& vulkanContext);
+
+    std::vector<std::unique_ptr<Job>> mJobs;
+    std::vector<std::unique_ptr<Job>> mRetired; // Finished or cancelled, freed once the GPU is done with them.
+    FrameExporter mExporter;
+
+    VkCommandPool mCommandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> mCommandBuffers;
+    std::vector<VkFence> mFences;
+    std::vector<uint64_t> mSlotSerials;
+    uint64_t mNextSerial = 1;
+    uint64_t mCompletedSerial = 0;
+    uint32_t mSlotCount = 0;
+    uint64_t mNextJobId = 1;
+
+    double mFrameBudgetSeconds = 1.0 / 60.0;
+    double mInteractiveSeconds = 0.0; // Smoothed.
+    double mBatchShare = 0.5;
+    double mLastBatchSeconds = 0.0; // Estimated GPU time of the last frame's slices.
+};
@@ -0,0 +1,264 @@
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cinttypes>
+#include <cstdio>
+#include <stdexcept>
+
+#include "imgui.h"
+
+#include "../util/Logger.h"
+
+namespace
+{
+    void appendSummary(std::string& out, const char* name, const char* help, const Histogram& histogram, double scale)
+    {
+        static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+        char line[256];
+
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+        out += line;
+
+        for (double quantile : quantiles)
+        {
+            std::snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.9g\n", name, quantile,
+                static_cast<double>(histogram.valueAtPercentile(quantile * 100.0)) * scale);
+            out += line;
+        }
+
+        std::snprintf(line, sizeof(line), "%s_sum %.9g\n%s_count %" PRIu64 "\n", name, histogram.sum() * scale, name, histogram.count());
+        out += line;
+    }
+
+    void appendMetric(std::string& out, const char* name, const char* type, const char* help, double value)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n", name, help, name, type, name, value);
+        out += line;
+    }
+
+    void appendRayCounters(std::string& out, uint64_t primary, uint64_t bounce, uint64_t shadow)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line),
+            "# HELP vrayt_rays_total Rays traced, by kind.\n# TYPE vrayt_rays_total counter\n"
+            "vrayt_rays_total{kind=\"primary\"} %" PRIu64 "\nvrayt_rays_total{kind=\"bounce\"} %" PRIu64 "\n"
+            "vrayt_rays_total{kind=\"shadow\"} %" PRIu64 "\n",
+            primary, bounce, shadow);
+        out += line;
+    }
+}
+
+Telemetry::Telemetry() = default;
+
+Telemetry::~Telemetry()
+{
+    stopEndpoint();
+}
+
+void Telemetry::recordFrame(const FrameTelemetry& frame)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mFrameTimeUs.record(static_cast<uint64_t>(frame.frameSeconds * 1e6));
+    mFrameHistoryMs[mHistoryPos] = static_cast<float>(frame.frameSeconds * 1e3);
+
+    if (frame.gpuSeconds > 0.0)
+    {
+        mGpuTimeUs.record(static_cast<uint64_t>(frame.gpuSeconds * 1e6));
+    }
+
+    mGpuHistoryMs[mHistoryPos] = static_cast<float>(frame.gpuSeconds * 1e3);
+    mHistoryPos = (mHistoryPos + 1) % historyLength;
+
+    if (frame.frameSeconds > 0.0 && frame.samplesTraced > 0)
+    {
+        mSamplesPerSecond.record(static_cast<uint64_t>(static_cast<double>(frame.samplesTraced) / frame.frameSeconds));
+    }
+
+    const uint64_t rays = frame.primaryRays + frame.bounceRays + frame.shadowRays;
+
+    if (frame.gpuSeconds > 0.0 && rays > 0)
+    {
+        mRaysPerSecond.record(static_cast<uint64_t>(static_cast<double>(rays) / frame.gpuSeconds));
+    }
+
+    mPrimaryRaysTotal += frame.primaryRays;
+    mBounceRaysTotal += frame.bounceRays;
+    mShadowRaysTotal += frame.shadowRays;
+    mIntersectionTestsTotal += frame.intersectionTests;
+    mAccumulatedSpp.record(frame.accumulatedSpp);
+    mSamplesTotal += frame.samplesTraced;
+    mLastSpp = frame.accumulatedSpp;
+    mGpuMemoryUsage = frame.gpuMemoryUsage;
+    mGpuMemoryBudget = frame.gpuMemoryBudget;
+    mGpuMemoryPeak = std::max(mGpuMemoryPeak, frame.gpuMemoryUsage);
+    ++mFrames;
+}
+
+void Telemetry::reset()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mFrameTimeUs.reset();
+    mGpuTimeUs.reset();
+    mSamplesPerSecond.reset();
+    mRaysPerSecond.reset();
+    mAccumulatedSpp.reset();
+    mGpuMemoryPeak = mGpuMemoryUsage;
+}
+
+TelemetrySnapshot Telemetry::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    TelemetrySnapshot result;
+    result.frames = mFrames;
+    result.frameP50Ms = static_cast<double>(mFrameTimeUs.valueAtPercentile(50.0)) * 1e-3;
+    result.frameP99Ms = static_cast<double>(mFrameTimeUs.valueAtPercentile(99.0)) * 1e-3;
+    result.gpuP50Ms = static_cast<double>(mGpuTimeUs.valueAtPercentile(50.0)) * 1e-3;
+    result.gpuP99Ms = static_cast<double>(mGpuTimeUs.valueAtPercentile(99.0)) * 1e-3;
+    result.samplesPerSecond = static_cast<double>(mSamplesPerSecond.valueAtPercentile(50.0));
+    result.raysPerSecond = static_cast<double>(mRaysPerSecond.valueAtPercentile(50.0));
+    result.accumulatedSpp = mLastSpp;
+    result.gpuMemoryUsage = mGpuMemoryUsage;
+    result.gpuMemoryBudget = mGpuMemoryBudget;
+
+    return result;
+}
+
+std::string Telemetry::prometheusText() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::string out;
+    out.reserve(4096);
+
+    appendSummary(out, "vrayt_frame_time_seconds", "CPU frame-to-frame time.", mFrameTimeUs, 1e-6);
+    appendSummary(out, "vrayt_gpu_pass_seconds", "Ray tracing compute pass time measured with timestamp queries.", mGpuTimeUs, 1e-6);
+    appendSummary(out, "vrayt_samples_per_second", "Pixel samples traced per second, per frame.", mSamplesPerSecond, 1.0);
+    appendSummary(out, "vrayt_rays_per_second", "Rays traced per second of GPU pass time, per frame.", mRaysPerSecond, 1.0);
+    appendSummary(out, "vrayt_accumulated_spp", "Accumulated samples per pixel at each frame.", mAccumulatedSpp, 1.0);
+    appendMetric(out, "vrayt_frames_total", "counter", "Frames presented.", static_cast<double>(mFrames));
+    appendMetric(out, "vrayt_samples_total", "counter", "Pixel samples traced.", static_cast<double>(mSamplesTotal));
+    appendRayCounters(out, mPrimaryRaysTotal, mBounceRaysTotal, mShadowRaysTotal);
+    appendMetric(out, "vrayt_intersection_tests_total", "counter", "Ray-primitive intersection tests.", static_cast<double>(mIntersectionTestsTotal));
+    appendMetric(out, "vrayt_current_spp", "gauge", "Samples per pixel in the current accumulation.", static_cast<double>(mLastSpp));
+    appendMetric(out, "vrayt_gpu_memory_usage_bytes", "gauge", "Device memory in use across all heaps.", static_cast<double>(mGpuMemoryUsage));
+    appendMetric(out, "vrayt_gpu_memory_budget_bytes", "gauge", "Device memory budget across all heaps.", static_cast<double>(mGpuMemoryBudget));
+    appendMetric(out, "vrayt_gpu_memory_peak_bytes", "gauge", "Peak device memory in use since the last reset.", static_cast<double>(mGpuMemoryPeak));
+
+    return out;
+}
+
+bool Telemetry::startEndpoint(const std::string& host, uint16_t port)
+{
+    try
+    {
+        mServer.start(host, port, [this](const std::string& method, const std::string& path)
+        {
+            net::HttpResponse response;
+
+            if (method != "GET")
+            {
+                response.status = 405;
+                response.body = "Only GET is supported\n";
+            }
+            else if (path == "/metrics")
+            {
+                response.contentType = "text/plain; version=0.0.4; charset=utf-8";
+                response.body = prometheusText();
+            }
+            else
+            {
+                response.status = 404;
+                response.body = "Metrics are served at /metrics\n";
+            }
+
+            return response;
+        });
+    }
+    catch (const std::exception& error)
+    {
+        logger::warn("Telemetry endpoint disabled: %s", error.what());
+
+        return false;
+    }
+
+    logger::info("Telemetry endpoint at http://%s:%u/metrics", host, static_cast<uint32_t>(mServer.port()));
+
+    return true;
+}
+
+void Telemetry::stopEndpoint()
+{
+    mServer.stop();
+}
+
+void Telemetry::drawImGui()
+{
+    if (drawWindow())
+    {
+        reset();
+    }
+}
+
+bool Telemetry::drawWindow() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    ImGui::SetNextWindowSize(ImVec2(360, 0), ImGuiCond_FirstUseEver);
+
+    if (!ImGui::Begin("Telemetry"))
+    {
+        ImGui::End();
+
+        return false;
+    }
+
+    const int offset = static_cast<int>(mHistoryPos);
+    ImGui::PlotLines("Frame ms", mFrameHistoryMs.data(), static_cast<int>(historyLength), offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+    ImGui::PlotLines("GPU ms", mGpuHistoryMs.data(), static_cast<int>(historyLength), offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+
+    if (ImGui::BeginTable("Percentiles", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchSame))
+    {
+        ImGui::TableSetupColumn("");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("max");
+        ImGui::TableHeadersRow();
+
+        auto row = [](const char* label, const Histogram& histogram, double scale)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(label);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", static_cast<double>(histogram.valueAtPercentile(50.0)) * scale);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", static_cast<double>(histogram.valueAtPercentile(99.0)) * scale);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", static_cast<double>(histogram.max()) * scale);
+        };
+
+        row("Frame ms", mFrameTimeUs, 1e-3);
+        row("GPU ms", mGpuTimeUs, 1e-3);
+        row("Msamples/s", mSamplesPerSecond, 1e-6);
+        row("Mrays/s", mRaysPerSecond, 1e-6);
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("Accumulated spp: %" PRIu64, mLastSpp);
+    ImGui::Text("Frames: %" PRIu64, mFrames);
+
+    const double usageMiB = static_cast<double>(mGpuMemoryUsage) / (1024.0 * 1024.0);
+    const double budgetMiB = static_cast<double>(mGpuMemoryBudget) / (1024.0 * 1024.0);
+    char memoryLabel[64];
+    std::snprintf(memoryLabel, sizeof(memoryLabel), "%.0f / %.0f MiB", usageMiB, budgetMiB);
+    ImGui::ProgressBar(budgetMiB > 0.0 ? static_cast<float>(usageMiB / budgetMiB) : 0.0f, ImVec2(-1, 0), memoryLabel);
+
+    const bool resetRequested = ImGui::Button("Reset Histograms");
+    ImGui::End();
+
+    return resetRequested;
+}
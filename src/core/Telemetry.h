@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "../net/HttpServer.h"
+#include "../util/Histogram.h"
+
+// One rendered frame as seen by the telemetry module.
+struct FrameTelemetry
+{
+    double frameSeconds = 0.0; // CPU frame-to-frame time.
+    double gpuSeconds = 0.0; // Ray tracing pass time from timestamp queries, 0 when unavailable.
+    uint64_t samplesTraced = 0; // Pixel samples dispatched this frame.
+    uint64_t accumulatedSpp = 0;
+    uint64_t gpuMemoryUsage = 0; // Bytes across all heaps.
+    uint64_t gpuMemoryBudget = 0;
+
+    // Kernel counters of the pass timed by gpuSeconds.
+    uint64_t primaryRays = 0;
+    uint64_t bounceRays = 0;
+    uint64_t shadowRays = 0;
+    uint64_t intersectionTests = 0;
+};
+
+struct TelemetrySnapshot
+{
+    uint64_t frames = 0;
+    double frameP50Ms = 0.0;
+    double frameP99Ms = 0.0;
+    double gpuP50Ms = 0.0;
+    double gpuP99Ms = 0.0;
+    double samplesPerSecond = 0.0; // Median.
+    double raysPerSecond = 0.0; // Median over GPU pass time, all ray kinds.
+    uint64_t accumulatedSpp = 0;
+    uint64_t gpuMemoryUsage = 0;
+    uint64_t gpuMemoryBudget = 0;
+};
+
+// Renderer health metrics. Distributions are kept in HDR histograms for the lifetime of the process (or until
+// reset) and are exposed both in the ImGui overlay and, optionally, as Prometheus text on a loopback HTTP endpoint.
+class Telemetry
+{
+public:
+    Telemetry();
+    ~Telemetry();
+
+    void recordFrame(const FrameTelemetry& frame);
+    void reset();
+
+    TelemetrySnapshot snapshot() const;
+
+    // Prometheus text exposition format (version 0.0.4).
+    std::string prometheusText() const;
+
+    // Serves GET /metrics on host:port. Returns false (and logs) if the address cannot be bound.
+    bool startEndpoint(const std::string& host, uint16_t port);
+    void stopEndpoint();
+
+    // Draws the telemetry window; call between ImGui::NewFrame and ImGui::Render.
+    void drawImGui();
+
+private:
+    static const size_t historyLength = 240;
+
+    // Returns true when the reset button was pressed.
+    bool drawWindow() const;
+
+    mutable std::mutex mMutex;
+    Histogram mFrameTimeUs;
+    Histogram mGpuTimeUs;
+    Histogram mSamplesPerSecond;
+    Histogram mRaysPerSecond;
+    Histogram mAccumulatedSpp;
+    std::array<float, historyLength> mFrameHistoryMs{};
+    std::array<float, historyLength> mGpuHistoryMs{};
+    size_t mHistoryPos = 0;
+    uint64_t mFrames = 0;
+    uint64_t mSamplesTotal = 0;
+    uint64_t mPrimaryRaysTotal = 0;
+    uint64_t mBounceRaysTotal = 0;
+    uint64_t mShadowRaysTotal = 0;
+    uint64_t mIntersectionTestsTotal = 0;
+    uint64_t mLastSpp = 0;
+    uint64_t mGpuMemoryUsage = 0;
+    uint64_t mGpuMemoryBudget = 0;
+    uint64_t mGpuMemoryPeak = 0;
+
+    net::HttpServer mServer;
+};
@@ -1,13 +1,13 @@
 #include "core/App.h"
+#include "util/Logger.h"
 
 int main()
 {
     App app;
+    const int result = app.run();
 
-    if (!app.run())
-    {
-        return 1;
-    }
+    // Drain the asynchronous logger before the process exits.
+    logger::flush();
 
-    return 0;
+    return result;
 }
\ No newline at end of file
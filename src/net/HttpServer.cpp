@@ -0,0 +1,136 @@
+#include "HttpServer.h"
+
+#include "../util/Logger.h"
+
+namespace
+{
+    const int pollIntervalMs = 200;
+    const int requestTimeoutMs = 2000;
+    const size_t maxRequestBytes = 16 * 1024;
+
+    const char* statusText(int status)
+    {
+        switch (status)
+        {
+        case 200:
+            return "OK";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        default:
+            return "Internal Server Error";
+        }
+    }
+}
+
+namespace net
+{
+    HttpServer::~HttpServer()
+    {
+        stop();
+    }
+
+    void HttpServer::start(const std::string& host, uint16_t port, Handler handler)
+    {
+        stop();
+
+        mListener = Socket::listenTcp(host, port);
+        mPort = mListener.localPort();
+        mHandler = std::move(handler);
+        mRunning.store(true, std::memory_order_release);
+        mThread = std::thread([this]() { serve(); });
+    }
+
+    void HttpServer::stop()
+    {
+        mRunning.store(false, std::memory_order_release);
+
+        if (mThread.joinable())
+        {
+            mThread.join();
+        }
+
+        mListener.close();
+    }
+
+    void HttpServer::serve()
+    {
+        while (mRunning.load(std::memory_order_acquire))
+        {
+            // Poll so stop() is noticed without having to unblock accept().
+            if (!mListener.waitReadable(pollIntervalMs))
+            {
+                continue;
+            }
+
+            Socket client = mListener.accept();
+
+            if (client.valid())
+            {
+                handleClient(client);
+            }
+        }
+    }
+
+    void HttpServer::handleClient(const Socket& client)
+    {
+        std::string request;
+        char buffer[2048];
+
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < maxRequestBytes)
+        {
+            if (!client.waitReadable(requestTimeoutMs))
+            {
+                return;
+            }
+
+            long long received = client.receive(buffer, sizeof(buffer));
+
+            if (received <= 0)
+            {
+                return;
+            }
+
+            request.append(buffer, static_cast<size_t>(received));
+        }
+
+        HttpResponse response;
+        const size_t methodEnd = request.find(' ');
+        const size_t pathEnd = methodEnd == std::string::npos ? std::string::npos : request.find(' ', methodEnd + 1);
+
+        if (pathEnd == std::string::npos)
+        {
+            response.status = 400;
+            response.body = "Bad request\n";
+        }
+        else
+        {
+            std::string method = request.substr(0, methodEnd);
+            std::string path = request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+            try
+            {
+                response = mHandler(method, path);
+            }
+            catch (const std::exception& error)
+            {
+                logger::error("HTTP handler failed for %s: %s", path, error.what());
+                response.status = 500;
+                response.body = "Internal error\n";
+            }
+        }
+
+        std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " + statusText(response.status) + "\r\n" +
+            "Content-Type: " + response.contentType + "\r\n" +
+            "Content-Length: " + std::to_string(response.body.size()) + "\r\n" +
+            "Connection: close\r\n\r\n";
+
+        if (client.sendAll(head.data(), head.size()))
+        {
+            client.sendAll(response.body.data(), response.body.size());
+        }
+    }
+}
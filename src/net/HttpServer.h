@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "Socket.h"
+
+namespace net
+{
+    struct HttpResponse
+    {
+        int status = 200;
+        std::string contentType = "text/plain; charset=utf-8";
+        std::string body;
+    };
+
+    // Minimal HTTP/1.1 server for local tooling endpoints. Requests are served one at a time on a background
+    // thread with `Connection: close`; only the request line is interpreted.
+    class HttpServer
+    {
+    public:
+        using Handler = std::function<HttpResponse(const std::string& method, const std::string& path)>;
+
+        HttpServer() = default;
+        ~HttpServer();
+
+        HttpServer(const HttpServer&) = delete;
+        HttpServer& operator=(const HttpServer&) = delete;
+
+        // Throws std::runtime_error if the address cannot be bound.
+        void start(const std::string& host, uint16_t port, Handler handler);
+        void stop();
+
+        uint16_t port() const
+        {
+            return mPort;
+        }
+
+    private:
+        void serve();
+        void handleClient(const Socket& client);
+
+        Socket mListener;
+        Handler mHandler;
+        std::thread mThread;
+        std::atomic<bool> mRunning{ false };
+        uint16_t mPort = 0;
+    };
+}
@@ -0,0 +1,71 @@
+#include "LineReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace net
+{
+    LineReader::Result LineReader::next(const Socket& socket, std::string& line, int timeoutMs)
+    {
+        while (true)
+        {
+            const size_t end = mBuffer.find('\n');
+
+            if (end != std::string::npos)
+            {
+                line.assign(mBuffer, 0, end > 0 && mBuffer[end - 1] == '\r' ? end - 1 : end);
+                mBuffer.erase(0, end + 1);
+
+                return Result::Line;
+            }
+
+            if (mBuffer.size() > mMaxLineBytes)
+            {
+                return Result::Closed;
+            }
+
+            if (!socket.waitReadable(timeoutMs))
+            {
+                return Result::Timeout;
+            }
+
+            char chunk[4096];
+            const long long received = socket.receive(chunk, sizeof(chunk));
+
+            if (received <= 0)
+            {
+                return Result::Closed;
+            }
+
+            mBuffer.append(chunk, static_cast<size_t>(received));
+        }
+    }
+
+    bool LineReader::read(const Socket& socket, void* data, size_t size, int timeoutMs)
+    {
+        uint8_t* out = static_cast<uint8_t*>(data);
+        const size_t buffered = std::min(size, mBuffer.size());
+        std::memcpy(out, mBuffer.data(), buffered);
+        mBuffer.erase(0, buffered);
+        size_t filled = buffered;
+
+        while (filled < size)
+        {
+            if (!socket.waitReadable(timeoutMs))
+            {
+                return false;
+            }
+
+            const long long received = socket.receive(out + filled, size - filled);
+
+            if (received <= 0)
+            {
+                return false;
+            }
+
+            filled += static_cast<size_t>(received);
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "Socket.h"
+
+namespace net
+{
+    // Splits a stream socket's bytes into newline-terminated lines, for line-delimited JSON protocols.
+    class LineReader
+    {
+    public:
+        enum class Result
+        {
+            Line,
+            Timeout,
+            Closed // Orderly close, error, or a line longer than the limit.
+        };
+
+        explicit LineReader(size_t maxLineBytes = 1 << 20) : mMaxLineBytes(maxLineBytes) {}
+
+        // Waits up to timeoutMs for more data when no complete line is buffered; a negative timeout waits forever.
+        // The line excludes the newline and any carriage return before it.
+        Result next(const Socket& socket, std::string& line, int timeoutMs);
+
+        // Reads exactly size bytes following the last line, such as a binary payload announced by it. Each wait
+        // for more data is bounded by timeoutMs. Returns false on timeout, close or error.
+        bool read(const Socket& socket, void* data, size_t size, int timeoutMs);
+
+    private:
+        std::string mBuffer;
+        size_t mMaxLineBytes = 0;
+    };
+}
@@ -0,0 +1,101 @@
+#include "Message.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Protects against a corrupt or hostile header; a 16k x 16k RGBA32F tile is 4 GiB.
+    const double maxPayloadBytes = 4.0 * 1024 * 1024 * 1024;
+    const size_t maxDescriptorMessageBytes = 64 * 1024;
+}
+
+namespace net
+{
+    bool sendMessage(const Socket& socket, const JsonValue& message, const void* payload, size_t bytes)
+    {
+        const std::string line = message.dump() + "\n";
+
+        return socket.sendAll(line.data(), line.size()) && (bytes == 0 || socket.sendAll(payload, bytes));
+    }
+
+    LineReader::Result receiveMessage(const Socket& socket, LineReader& reader, JsonValue& message, std::vector<uint8_t>& payload,
+        int timeoutMs)
+    {
+        std::string line;
+        LineReader::Result result = LineReader::Result::Line;
+
+        do
+        {
+            result = reader.next(socket, line, timeoutMs);
+        }
+        while (result == LineReader::Result::Line && line.empty());
+
+        if (result != LineReader::Result::Line)
+        {
+            return result;
+        }
+
+        message = JsonValue::parse(line);
+        payload.clear();
+        const double bytes = message.numberOr("bytes", 0.0);
+
+        if (!(bytes >= 0.0 && bytes <= maxPayloadBytes))
+        {
+            throw std::runtime_error("Payload size out of range");
+        }
+
+        if (bytes > 0.0)
+        {
+            payload.resize(static_cast<size_t>(bytes));
+
+            // The payload follows its header at once; a stall here is a dead peer, not an idle one.
+            if (!reader.read(socket, payload.data(), payload.size(), timeoutMs < 0 ? -1 : std::max(timeoutMs, 10000)))
+            {
+                return LineReader::Result::Closed;
+            }
+        }
+
+        return result;
+    }
+
+    bool sendMessageWithDescriptors(const Socket& socket, const JsonValue& message, const std::vector<int>& descriptors)
+    {
+        const std::string line = message.dump() + "\n";
+
+        return socket.sendWithDescriptors(line.data(), line.size(), descriptors);
+    }
+
+    LineReader::Result receiveMessageWithDescriptors(const Socket& socket, JsonValue& message, std::vector<int>& descriptors,
+        int timeoutMs)
+    {
+        std::string line;
+
+        while (true)
+        {
+            if (!socket.waitReadable(timeoutMs))
+            {
+                return line.empty() ? LineReader::Result::Timeout : LineReader::Result::Closed;
+            }
+
+            char byte = 0;
+
+            if (socket.receiveWithDescriptors(&byte, 1, descriptors) != 1 || line.size() >= maxDescriptorMessageBytes)
+            {
+                return LineReader::Result::Closed;
+            }
+
+            if (byte == '\n')
+            {
+                break;
+            }
+
+            line += byte;
+        }
+
+        message = JsonValue::parse(line);
+
+        return LineReader::Result::Line;
+    }
+}
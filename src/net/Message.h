@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "LineReader.h"
+#include "Socket.h"
+#include "../util/Json.h"
+
+// Messages as one JSON object per line. A message with a "bytes" member is followed by that many raw bytes,
+// so binary data (accumulation sums, encoded frames) rides on the same stream as its header.
+namespace net
+{
+    bool sendMessage(const Socket& socket, const JsonValue& message, const void* payload = nullptr, size_t bytes = 0);
+
+    // Reads the next message and the payload it announces. Malformed JSON throws.
+    LineReader::Result receiveMessage(const Socket& socket, LineReader& reader, JsonValue& message, std::vector<uint8_t>& payload,
+        int timeoutMs);
+
+    // A message with file descriptors attached, over a local socket (POSIX only). The peer reads it with
+    // receiveMessageWithDescriptors, before any LineReader buffers bytes past it, and must answer before the sender
+    // writes again.
+    bool sendMessageWithDescriptors(const Socket& socket, const JsonValue& message, const std::vector<int>& descriptors);
+
+    // Reads one message byte by byte, so nothing after its line is consumed. The caller owns the descriptors, also
+    // when parsing throws.
+    LineReader::Result receiveMessageWithDescriptors(const Socket& socket, JsonValue& message, std::vector<int>& descriptors,
+        int timeoutMs);
+}
@@ -0,0 +1,432 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+#ifndef _WIN32
+    // Enough for a ring of shared images plus their semaphore.
+    const size_t maxPassedDescriptors = 16;
+#endif
+
+#ifdef _WIN32
+    void ensureStarted()
+    {
+        static std::once_flag once;
+
+        std::call_once(once, []()
+        {
+            WSADATA data{};
+
+            if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+            {
+                throw std::runtime_error("WSAStartup failed");
+            }
+        });
+    }
+
+    void closeNative(net::NativeSocket handle)
+    {
+        closesocket(static_cast<SOCKET>(handle));
+    }
+#else
+    void ensureStarted()
+    {
+    }
+
+    void closeNative(net::NativeSocket handle)
+    {
+        ::close(handle);
+    }
+#endif
+
+    sockaddr_un localAddress(const std::string& path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error("Invalid local socket path " + path);
+        }
+
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        return address;
+    }
+}
+
+namespace net
+{
+    NativeSocket Socket::invalidHandle()
+    {
+#ifdef _WIN32
+        return static_cast<NativeSocket>(INVALID_SOCKET);
+#else
+        return -1;
+#endif
+    }
+
+    Socket::~Socket()
+    {
+        close();
+    }
+
+    Socket::Socket(Socket&& other) noexcept : mHandle(other.mHandle)
+    {
+        other.mHandle = invalidHandle();
+    }
+
+    Socket& Socket::operator=(Socket&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            mHandle = other.mHandle;
+            other.mHandle = invalidHandle();
+        }
+
+        return *this;
+    }
+
+    Socket Socket::listenTcp(const std::string& host, uint16_t port, int backlog)
+    {
+        ensureStarted();
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+        {
+            throw std::runtime_error("Invalid listen address " + host);
+        }
+
+        Socket socket(static_cast<NativeSocket>(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)));
+
+        if (!socket.valid())
+        {
+            throw std::runtime_error("Failed to create socket");
+        }
+
+        int reuse = 1;
+        setsockopt(socket.mHandle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        if (bind(socket.mHandle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            throw std::runtime_error("Failed to bind " + host + ":" + std::to_string(port));
+        }
+
+        if (listen(socket.mHandle, backlog) != 0)
+        {
+            throw std::runtime_error("Failed to listen on " + host + ":" + std::to_string(port));
+        }
+
+        return socket;
+    }
+
+    Socket Socket::listenLocal(const std::string& path, int backlog)
+    {
+        ensureStarted();
+
+        const sockaddr_un address = localAddress(path);
+        Socket socket(static_cast<NativeSocket>(::socket(AF_UNIX, SOCK_STREAM, 0)));
+
+        if (!socket.valid())
+        {
+            throw std::runtime_error("Failed to create socket");
+        }
+
+        // A socket file outlives its process; binding fails while it exists.
+#ifdef _WIN32
+        DeleteFileA(path.c_str());
+#else
+        unlink(path.c_str());
+#endif
+
+        if (bind(socket.mHandle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            throw std::runtime_error("Failed to bind " + path);
+        }
+
+        if (listen(socket.mHandle, backlog) != 0)
+        {
+            throw std::runtime_error("Failed to listen on " + path);
+        }
+
+        return socket;
+    }
+
+    Socket Socket::connectLocal(const std::string& path)
+    {
+        ensureStarted();
+
+        const sockaddr_un address = localAddress(path);
+        Socket socket(static_cast<NativeSocket>(::socket(AF_UNIX, SOCK_STREAM, 0)));
+
+        if (socket.valid() && connect(socket.mHandle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            socket.close();
+        }
+
+        return socket;
+    }
+
+    Socket Socket::connectTcp(const std::string& host, uint16_t port)
+    {
+        ensureStarted();
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        addrinfo* addresses = nullptr;
+
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+        {
+            return Socket();
+        }
+
+        Socket socket;
+
+        for (const addrinfo* address = addresses; address && !socket.valid(); address = address->ai_next)
+        {
+            socket = Socket(static_cast<NativeSocket>(::socket(address->ai_family, address->ai_socktype, address->ai_protocol)));
+
+            if (socket.valid() && connect(socket.mHandle, address->ai_addr, static_cast<int>(address->ai_addrlen)) != 0)
+            {
+                socket.close();
+            }
+        }
+
+        freeaddrinfo(addresses);
+
+        if (socket.valid())
+        {
+            int noDelay = 1;
+            setsockopt(socket.mHandle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        }
+
+        return socket;
+    }
+
+    Socket Socket::accept() const
+    {
+        Socket client(static_cast<NativeSocket>(::accept(mHandle, nullptr, nullptr)));
+
+        if (client.valid())
+        {
+            int noDelay = 1;
+            setsockopt(client.mHandle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        }
+
+        return client;
+    }
+
+    bool Socket::waitReadable(int timeoutMs) const
+    {
+#ifdef _WIN32
+        WSAPOLLFD descriptor{};
+        descriptor.fd = static_cast<SOCKET>(mHandle);
+        descriptor.events = POLLRDNORM;
+
+        return WSAPoll(&descriptor, 1, timeoutMs) > 0;
+#else
+        pollfd descriptor{};
+        descriptor.fd = mHandle;
+        descriptor.events = POLLIN;
+
+        return poll(&descriptor, 1, timeoutMs) > 0;
+#endif
+    }
+
+    bool Socket::sendAll(const void* data, size_t size) const
+    {
+        const char* bytes = static_cast<const char*>(data);
+
+        while (size > 0)
+        {
+#ifdef _WIN32
+            int sent = send(static_cast<SOCKET>(mHandle), bytes, static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+#else
+            ssize_t sent = send(mHandle, bytes, size, MSG_NOSIGNAL);
+
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            if (sent <= 0)
+            {
+                return false;
+            }
+
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+
+        return true;
+    }
+
+    long long Socket::receive(void* data, size_t size) const
+    {
+#ifdef _WIN32
+        return recv(static_cast<SOCKET>(mHandle), static_cast<char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+#else
+        ssize_t received = 0;
+
+        do
+        {
+            received = recv(mHandle, data, size, 0);
+        }
+        while (received < 0 && errno == EINTR);
+
+        return received;
+#endif
+    }
+
+    bool Socket::sendWithDescriptors(const void* data, size_t size, const std::vector<int>& descriptors) const
+    {
+#ifdef _WIN32
+        (void)data;
+        (void)size;
+        (void)descriptors;
+
+        return false;
+#else
+        if (size == 0 || descriptors.size() > maxPassedDescriptors)
+        {
+            return false;
+        }
+
+        // The descriptors ride on the first byte; the rest goes out as plain data.
+        iovec vector{ const_cast<void*>(data), 1 };
+        alignas(cmsghdr) char control[CMSG_SPACE(maxPassedDescriptors * sizeof(int))]{};
+        msghdr header{};
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+
+        if (!descriptors.empty())
+        {
+            header.msg_control = control;
+            header.msg_controllen = CMSG_SPACE(descriptors.size() * sizeof(int));
+            cmsghdr* message = CMSG_FIRSTHDR(&header);
+            message->cmsg_level = SOL_SOCKET;
+            message->cmsg_type = SCM_RIGHTS;
+            message->cmsg_len = CMSG_LEN(descriptors.size() * sizeof(int));
+            std::memcpy(CMSG_DATA(message), descriptors.data(), descriptors.size() * sizeof(int));
+        }
+
+        ssize_t sent = 0;
+
+        do
+        {
+            sent = sendmsg(mHandle, &header, MSG_NOSIGNAL);
+        }
+        while (sent < 0 && errno == EINTR);
+
+        return sent == 1 && sendAll(static_cast<const char*>(data) + 1, size - 1);
+#endif
+    }
+
+    long long Socket::receiveWithDescriptors(void* data, size_t size, std::vector<int>& descriptors) const
+    {
+#ifdef _WIN32
+        (void)descriptors;
+
+        return receive(data, size);
+#else
+        iovec vector{ data, size };
+        alignas(cmsghdr) char control[CMSG_SPACE(maxPassedDescriptors * sizeof(int))]{};
+        msghdr header{};
+        header.msg_iov = &vector;
+        header.msg_iovlen = 1;
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+
+        ssize_t received = 0;
+
+        do
+        {
+            received = recvmsg(mHandle, &header, 0);
+        }
+        while (received < 0 && errno == EINTR);
+
+        for (cmsghdr* message = CMSG_FIRSTHDR(&header); received > 0 && message; message = CMSG_NXTHDR(&header, message))
+        {
+            if (message->cmsg_level != SOL_SOCKET || message->cmsg_type != SCM_RIGHTS)
+            {
+                continue;
+            }
+
+            const size_t count = (message->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                int descriptor = -1;
+                std::memcpy(&descriptor, CMSG_DATA(message) + i * sizeof(int), sizeof(int));
+                descriptors.push_back(descriptor);
+            }
+        }
+
+        return received;
+#endif
+    }
+
+    uint16_t Socket::localPort() const
+    {
+        sockaddr_in address{};
+#ifdef _WIN32
+        int length = sizeof(address);
+#else
+        socklen_t length = sizeof(address);
+#endif
+
+        if (getsockname(mHandle, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+        {
+            return 0;
+        }
+
+        return ntohs(address.sin_port);
+    }
+
+    bool Socket::valid() const
+    {
+        return mHandle != invalidHandle();
+    }
+
+    void Socket::close()
+    {
+        if (valid())
+        {
+            closeNative(mHandle);
+            mHandle = invalidHandle();
+        }
+    }
+}
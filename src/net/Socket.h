@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Thin RAII wrapper over a blocking TCP or local (Unix domain) stream socket (Winsock or BSD sockets).
+namespace net
+{
+#ifdef _WIN32
+    using NativeSocket = uintptr_t;
+#else
+    using NativeSocket = int;
+#endif
+
+    class Socket
+    {
+    public:
+        Socket() = default;
+        explicit Socket(NativeSocket handle) : mHandle(handle) {}
+        ~Socket();
+
+        Socket(Socket&& other) noexcept;
+        Socket& operator=(Socket&& other) noexcept;
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        // Binds and listens; host is a numeric IPv4 address. Throws std::runtime_error on failure.
+        static Socket listenTcp(const std::string& host, uint16_t port, int backlog = 16);
+
+        // Unix domain socket at path, replacing a stale socket file left by a previous process. Throws
+        // std::runtime_error on failure. Windows 10 1803 and later support these too.
+        static Socket listenLocal(const std::string& path, int backlog = 16);
+
+        // Returns an invalid socket on failure.
+        static Socket connectLocal(const std::string& path);
+
+        // host is a name or numeric address, resolved to IPv4 or IPv6. Returns an invalid socket on failure.
+        static Socket connectTcp(const std::string& host, uint16_t port);
+
+        // Returns an invalid socket on failure.
+        Socket accept() const;
+
+        // Waits up to timeoutMs for the socket to become readable (or, when listening, for a connection).
+        bool waitReadable(int timeoutMs) const;
+
+        bool sendAll(const void* data, size_t size) const;
+
+        // Returns bytes read, 0 on orderly close, -1 on error.
+        long long receive(void* data, size_t size) const;
+
+        // Local sockets on POSIX only: sends the bytes with file descriptors attached (SCM_RIGHTS); the peer receives
+        // duplicates and the caller keeps its own. Returns false on error, and always on Windows.
+        bool sendWithDescriptors(const void* data, size_t size, const std::vector<int>& descriptors) const;
+
+        // Like receive, also appending the descriptors that arrived with the bytes; the caller owns them.
+        long long receiveWithDescriptors(void* data, size_t size, std::vector<int>& descriptors) const;
+
+        // Local port, useful when listening on port 0.
+        uint16_t localPort() const;
+
+        bool valid() const;
+        void close();
+
+        NativeSocket handle() const
+        {
+            return mHandle;
+        }
+
+    private:
+        NativeSocket mHandle = invalidHandle();
+
+        static NativeSocket invalidHandle();
+    };
+}
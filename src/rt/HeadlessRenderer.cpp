@@ -0,0 +1,126 @@
+#include "HeadlessRenderer.h"
+
+#include <algorithm>
+
+#include "../util/Check.h"
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+    destroy();
+}
+
+void HeadlessRenderer::create(const VkExtent2D& extent, bool enableValidation, uint32_t exportedImages)
+{
+    mExportedImages = exportedImages;
+    mContext.createInstance(enableValidation, true);
+    mContext.setupDebugMessenger(enableValidation);
+    mContext.pickPhysicalDevice();
+    mContext.createDevice();
+    mContext.createAllocator();
+    mContext.createCommandPoolsAndBuffers(1);
+    mContext.createSyncObjects(1);
+
+    mTarget.create(mContext, extent, std::max(mExportedImages, 1u), mExportedImages > 0);
+    mTracer.create(mContext, mTarget.target());
+    mCreated = true;
+}
+
+void HeadlessRenderer::destroy()
+{
+    if (!mCreated)
+    {
+        return;
+    }
+
+    mContext.waitIdle();
+    mTracer.destroy(mContext);
+    mTarget.destroy(mContext);
+    mContext.destroy();
+    mCreated = false;
+}
+
+void HeadlessRenderer::resize(const VkExtent2D& extent)
+{
+    if (extent.width == this->extent().width && extent.height == this->extent().height)
+    {
+        return;
+    }
+
+    mContext.waitIdle();
+    mTarget.destroy(mContext);
+    mTarget.create(mContext, extent, std::max(mExportedImages, 1u), mExportedImages > 0);
+    mTracer.resize(mContext, mTarget.target());
+}
+
+void HeadlessRenderer::renderFrame(uint32_t frameIndex, const std::function<void(VkCommandBuffer)>& recordAfter)
+{
+    const FrameSync& frameSync = mContext.frames()[0];
+    beginFrame(frameIndex, 0);
+
+    if (recordAfter)
+    {
+        recordAfter(frameSync.cmdBuf);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(frameSync.cmdBuf));
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameSync.cmdBuf;
+    VK_CHECK(vkQueueSubmit(mContext.graphicsQueue(), 1, &submitInfo, frameSync.inFlight));
+    waitFrame();
+}
+
+void HeadlessRenderer::submitFrame(uint32_t frameIndex, uint32_t imageIndex, uint64_t readyValue)
+{
+    const FrameSync& frameSync = mContext.frames()[0];
+    beginFrame(frameIndex, imageIndex);
+    mTarget.recordReleaseToExternal(frameSync.cmdBuf, imageIndex, mContext.graphicsFamilyIndex());
+    VK_CHECK(vkEndCommandBuffer(frameSync.cmdBuf));
+
+    const VkSemaphore ready = mTarget.readySemaphore();
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &readyValue;
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineInfo };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameSync.cmdBuf;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &ready;
+    VK_CHECK(vkQueueSubmit(mContext.graphicsQueue(), 1, &submitInfo, frameSync.inFlight));
+}
+
+void HeadlessRenderer::waitFrame()
+{
+    const FrameSync& frameSync = mContext.frames()[0];
+    VK_CHECK(vkWaitForFences(mContext.device(), 1, &frameSync.inFlight, VK_TRUE, UINT64_MAX));
+}
+
+void HeadlessRenderer::beginFrame(uint32_t frameIndex, uint32_t imageIndex)
+{
+    const FrameSync& frameSync = mContext.frames()[0];
+
+    VK_CHECK(vkResetFences(mContext.device(), 1, &frameSync.inFlight));
+    VK_CHECK(vkResetCommandBuffer(frameSync.cmdBuf, 0));
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(frameSync.cmdBuf, &beginInfo));
+
+    if (mTarget.exportable())
+    {
+        mTarget.recordAcquireFromExternal(frameSync.cmdBuf, imageIndex, mContext.graphicsFamilyIndex());
+    }
+
+    mTracer.render(mContext, mTarget.target(), frameSync.cmdBuf, imageIndex, frameIndex);
+}
+
+Image HeadlessRenderer::readImage()
+{
+    std::vector<glm::vec4> accumulation;
+    mTracer.readAccumulation(mContext, accumulation);
+
+    return resolveAccumulation(accumulation, extent().width, extent().height);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <functional>
+
+#include "RayTracer.h"
+#include "../util/Image.h"
+#include "../vk/OffscreenTarget.h"
+#include "../vk/VulkanContext.h"
+
+// Ray tracer on a headless context and an offscreen target, rendering one synchronous frame at a time.
+// For tools and benchmarks; works on any compute-capable device, including lavapipe.
+class HeadlessRenderer
+{
+public:
+    HeadlessRenderer() = default;
+    ~HeadlessRenderer();
+
+    // exportedImages > 0 renders into that many exportable images instead (OffscreenTarget), for sharing frames
+    // with another local process through submitFrame.
+    void create(const VkExtent2D& extent, bool enableValidation, uint32_t exportedImages = 0);
+    void destroy();
+
+    // Recreates the target and the tracer's size-dependent resources; pipelines and the scene stay.
+    void resize(const VkExtent2D& extent);
+
+    // Records, submits and waits for one frame. Frame 0 and any tracer setting change restart accumulation.
+    // recordAfter can append commands, such as a readback, behind the frame's dispatch.
+    void renderFrame(uint32_t frameIndex, const std::function<void(VkCommandBuffer)>& recordAfter = {});
+
+    // Exportable targets: renders into image imageIndex, hands it to VK_QUEUE_FAMILY_EXTERNAL and signals the
+    // target's ready semaphore with readyValue. Returns once submitted; call waitFrame before the next frame.
+    void submitFrame(uint32_t frameIndex, uint32_t imageIndex, uint64_t readyValue);
+    void waitFrame();
+
+    // The accumulation so far, divided by its sample count.
+    Image readImage();
+
+    // Records a copy of the displayed RGBA8 output into buffer, for use in renderFrame's recordAfter.
+    void recordOutputCopy(VkCommandBuffer commandBuffer, VkBuffer buffer) const
+    {
+        mTarget.recordReadback(commandBuffer, 0, buffer, 0);
+    }
+
+    VkDeviceSize outputBytes() const
+    {
+        return mTarget.imageBytes();
+    }
+
+    RayTracer& tracer()
+    {
+        return mTracer;
+    }
+
+    VulkanContext& context()
+    {
+        return mContext;
+    }
+
+    const VkExtent2D& extent() const
+    {
+        return mTarget.target().extent;
+    }
+
+    OffscreenTarget& target()
+    {
+        return mTarget;
+    }
+
+private:
+    void beginFrame(uint32_t frameIndex, uint32_t imageIndex);
+
+    VulkanContext mContext;
+    OffscreenTarget mTarget;
+    RayTracer mTracer;
+    uint32_t mExportedImages = 0;
+    bool mCreated = false;
+};
@@ -1,140 +1,111 @@
 #include "RayTracer.h"
 
 #include "../vk/VulkanContext.h"
-#include "../vk/Swapchain.h"
+#include "../vk/RenderTarget.h"
 #include "../util/Check.h"
+#include "../util/Hash.h"
 #include "../util/Logger.h"
+#include "ShaderLibrary.h"
 
-#include <shaderc/shaderc.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/constants.hpp>
-#include <fstream>
 #include <stdexcept>
 #include <array>
 #include <cstring>
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 
 namespace
 {
-    // Reads an entire text file into a std::string.
-    std::string readFileText(const std::string& path)
+    VkShaderModule compileCompute(VkDevice device, const std::string& variant)
     {
-        std::ifstream inputStream(path, std::ios::binary);
+        std::vector<uint32_t> spirv = shaders::loadSpirv(variant);
 
-        if (!inputStream)
-        {
-            throw std::runtime_error("Failed to open file: " + path);
-        }
-
-        return std::string((std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>());
-    }
-
-    std::vector<uint32_t> readFileBinaryWords(const std::string& path)
-    {
-        std::ifstream inputStream(path, std::ios::binary | std::ios::ate);
-
-        if (!inputStream)
-        {
-            throw std::runtime_error("Failed to open file: " + path);
-        }
+        VkShaderModuleCreateInfo createInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+        createInfo.pCode = spirv.data();
 
-        const std::streamsize size = inputStream.tellg();
-        if (size <= 0 || (size % 4) != 0)
-        {
-            throw std::runtime_error("Invalid SPIR-V file size: " + path);
-        }
+        VkShaderModule module = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &module));
 
-        std::vector<uint32_t> data(static_cast<size_t>(size) / 4);
-        inputStream.seekg(0);
-        inputStream.read(reinterpret_cast<char*>(data.data()), size);
+        return module;
+    }
 
-        if (!inputStream)
-        {
-            throw std::runtime_error("Failed to read file: " + path);
-        }
+    const VkDeviceSize defragBytesPerPass = 64ull * 1024 * 1024;
+    const uint32_t defragAllocationsPerPass = 16;
 
-        return data;
+    VkImageCreateInfo accumulationImageInfo(const VkExtent2D& extent)
+    {
+        VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { extent.width, extent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        return imageInfo;
     }
 
-    VkShaderModule compileCompute(VkDevice device, const std::string& path)
+    VkBufferCreateInfo sphereBufferInfo(VkDeviceSize size)
     {
-        std::vector<uint32_t> spirv;
-
-#if defined(_DEBUG)
-        std::string spvPath = path;
-        if (spvPath.size() > 5 && spvPath.substr(spvPath.size() - 5) == ".glsl")
-        {
-            spvPath = spvPath.substr(0, spvPath.size() - 5) + ".spv";
-        }
-        else
-        {
-            spvPath += ".spv";
-        }
-
-        spirv = readFileBinaryWords(spvPath);
-#else
-        auto source = readFileText(path);
+        VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        shaderc::Compiler compiler;
-        shaderc::CompileOptions options;
-        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
-        options.SetOptimizationLevel(shaderc_optimization_level_performance);
-
-        auto result = compiler.CompileGlslToSpv(source, shaderc_compute_shader, path.c_str(), options);
+        return bufferInfo;
+    }
 
-        if (result.GetCompilationStatus() != shaderc_compilation_status_success)
-        {
-            throw std::runtime_error(result.GetErrorMessage());
-        }
+    VkImageView createColorView(VkDevice device, VkImage image, VkFormat format)
+    {
+        VkImageViewCreateInfo viewInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        VkImageView view = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view));
+
+        return view;
+    }
 
-        spirv.assign(result.cbegin(), result.cend());
-#endif
+    // Size of one per-swapchain-image slot holding `size` bytes in a storage buffer.
+    VkDeviceSize storageSlotStride(VkPhysicalDevice physical, VkDeviceSize size)
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physical, &properties);
+        const VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
 
-        VkShaderModuleCreateInfo createInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-        createInfo.codeSize = spirv.size() * sizeof(uint32_t);
-        createInfo.pCode = spirv.data();
+        return (size + alignment - 1) / alignment * alignment;
+    }
 
-        VkShaderModule module = VK_NULL_HANDLE;
-        VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &module));
+    // uvec4 low words + uvec4 carries, see shaders/ray_counters.glsl.
+    const VkDeviceSize rayCounterBytes = 8 * sizeof(uint32_t);
 
-        return module;
-    }
+    // Bounded dispatch tile sides, powers of two so tiles stay multiples of the workgroup.
+    const uint32_t minDispatchTile = 32;
+    const uint32_t maxDispatchTile = 1024;
+    const double dispatchCostSmoothing = 0.3;
 }
 
 void RayTracer::buildScene()
 {
     mSpheres.clear();
-
-    GPUSphere ground{};
-    ground.centerRadius = { 0.0f, -1000.0f, 0.0f, 1000.0f };
-    ground.albedo = { 0.75f, 0.8f, 0.9f, 0.0f };
-    ground.misc = { 0.0f, 0.0f, 1.0f, 1.0f }; // Lambert with checker flag.
-    mSpheres.push_back(ground);
-
-    GPUSphere center{};
-    center.centerRadius = { 0.0f, 1.0f, 0.0f, 1.0f };
-    center.albedo = { 0.9f, 0.25f, 0.25f, 0.0f }; // Vibrant red.
-    center.misc = { 0.0f, 0.0f, 1.0f, 0.0f }; // Lambert.
-    mSpheres.push_back(center);
-
-    GPUSphere left{};
-    left.centerRadius = { -4.0f, 1.0f, 0.0f, 1.0f };
-    left.albedo = { 1.0f, 1.0f, 1.0f, 0.0f }; // Glass stays neutral.
-    left.misc = { 2.0f, 0.0f, 1.5f, 0.0f }; // Dielectric, refIdx 1.5.
-    mSpheres.push_back(left);
-
-    GPUSphere right{};
-    right.centerRadius = { 4.0f, 1.0f, 0.0f, 1.0f };
-    right.albedo = { 0.95f, 0.65f, 0.15f, 0.0f }; // Warmer metal.
-    right.misc = { 1.0f, 0.03f, 1.0f, 0.0f }; // Metal with small fuzz.
-    mSpheres.push_back(right);
-
-    GPUSphere mirror{};
-    mirror.centerRadius = { 2.5f, 0.5f, 2.5f, 0.5f };
-    mirror.albedo = { 0.95f, 0.95f, 0.98f, 0.0f }; // Bright reflective.
-    mirror.misc = { 1.0f, 0.0f, 1.0f, 0.0f }; // Perfect mirror (fuzz=0).
-    mSpheres.push_back(mirror);
+    mSpheres.push_back(packSphere({ 0.0f, -1000.0f, 0.0f }, 1000.0f, { 0.75f, 0.8f, 0.9f }, SphereMaterial::Lambert, 0.0f, 1.0f, true)); // Checkered ground.
+    mSpheres.push_back(packSphere({ 0.0f, 1.0f, 0.0f }, 1.0f, { 0.9f, 0.25f, 0.25f }, SphereMaterial::Lambert)); // Vibrant red.
+    mSpheres.push_back(packSphere({ -4.0f, 1.0f, 0.0f }, 1.0f, { 1.0f, 1.0f, 1.0f }, SphereMaterial::Dielectric, 0.0f, 1.5f)); // Glass stays neutral.
+    mSpheres.push_back(packSphere({ 4.0f, 1.0f, 0.0f }, 1.0f, { 0.95f, 0.65f, 0.15f }, SphereMaterial::Metal, 0.03f)); // Warmer metal with small fuzz.
+    mSpheres.push_back(packSphere({ 2.5f, 0.5f, 2.5f }, 0.5f, { 0.95f, 0.95f, 0.98f }, SphereMaterial::Metal)); // Perfect mirror (fuzz = 0).
 }
 
 GPUParams RayTracer::makeCameraParams(const VkExtent2D& extent) const
@@ -145,8 +116,10 @@ GPUParams RayTracer::makeCameraParams(const VkExtent2D& extent) const
     const glm::vec3 vup = { 0.0f, 1.0f, 0.0f };
     float verticalFov = mVerticalFov;
     float aperture = mAperture;
+    const bool windowed = mViewFullExtent.width > 0 && mViewFullExtent.height > 0;
+    const VkExtent2D viewExtent = windowed ? mViewFullExtent : extent;
 
-    float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+    float aspect = static_cast<float>(viewExtent.width) / static_cast<float>(viewExtent.height);
     float theta = glm::radians(verticalFov);
     float halfHeight = tanf(theta * 0.5f);
     float viewportHeight = 2.0f * halfHeight;
@@ -162,6 +135,18 @@ GPUParams RayTracer::makeCameraParams(const VkExtent2D& extent) const
     glm::vec3 vertical = focusDistance * viewportHeight * v;
     glm::vec3 lowerLeft = lookFrom - horizontal * 0.5f - vertical * 0.5f - focusDistance * w;
 
+    if (windowed)
+    {
+        // Cut the viewport down to the window: move the corner to the window's lower-left (rows count from the
+        // top, the viewport from the bottom) and scale the spans to its share of the full image.
+        const float fullWidth = static_cast<float>(viewExtent.width);
+        const float fullHeight = static_cast<float>(viewExtent.height);
+        const float bottom = fullHeight - static_cast<float>(mViewOffset.y) - static_cast<float>(extent.height);
+        lowerLeft += horizontal * (static_cast<float>(mViewOffset.x) / fullWidth) + vertical * (bottom / fullHeight);
+        horizontal *= static_cast<float>(extent.width) / fullWidth;
+        vertical *= static_cast<float>(extent.height) / fullHeight;
+    }
+
     GPUParams params{};
     params.originLens = { lookFrom, aperture * 0.5f };
     params.lowerLeft = { lowerLeft, 0.0f };
@@ -176,14 +161,14 @@ GPUParams RayTracer::makeCameraParams(const VkExtent2D& extent) const
     return params;
 }
 
-void RayTracer::create(VulkanContext& vulkanContext, Swapchain& swapchain)
+void RayTracer::create(VulkanContext& vulkanContext, const RenderTarget& target)
 {
-    const auto& extent = swapchain.bundle().extent;
+    const auto& extent = target.extent;
     mWidth = extent.width;
     mHeight = extent.height;
     mResetAccum = true;
     mAccumInitialized = false;
-    mSwapchainImageInitialized.assign(swapchain.bundle().images.size(), false);
+    mOutputImageInitialized.assign(target.images.size(), false);
 
     buildScene();
     {
@@ -195,25 +180,21 @@ void RayTracer::create(VulkanContext& vulkanContext, Swapchain& swapchain)
     uploadScene(vulkanContext);
     createPipeline(vulkanContext);
     createAccumulationImage(vulkanContext, extent);
-    createDescriptors(vulkanContext, swapchain);
+    createDisplayImage(vulkanContext, target);
+    createRayCounters(vulkanContext, static_cast<uint32_t>(target.images.size()));
+    createDescriptors(vulkanContext, target);
+    createTimestampQueries(vulkanContext, static_cast<uint32_t>(target.images.size()));
 }
 
-void RayTracer::resize(VulkanContext& vulkanContext, Swapchain& swapchain)
+void RayTracer::resize(VulkanContext& vulkanContext, const RenderTarget& target)
 {
     vkDeviceWaitIdle(vulkanContext.device());
-
-    if (mAccumView)
-    {
-        vkDestroyImageView(vulkanContext.device(), mAccumView, nullptr);
-    }
-    if (mAccumImage && mAccumAlloc)
-    {
-        vmaDestroyImage(vulkanContext.allocator(), mAccumImage, mAccumAlloc);
-    }
-
-    mAccumImage = VK_NULL_HANDLE;
-    mAccumView = VK_NULL_HANDLE;
-    mAccumAlloc = VK_NULL_HANDLE;
+    cancelDefragmentation(vulkanContext);
+    destroyCostResources(vulkanContext);
+    destroyAccumulationImage(vulkanContext);
+    destroyDisplayImage(vulkanContext);
+    destroyParamsBuffers(vulkanContext);
+    destroyRayCounters(vulkanContext);
 
     if (mDescriptorPool)
     {
@@ -222,20 +203,33 @@ void RayTracer::resize(VulkanContext& vulkanContext, Swapchain& swapchain)
     mDescriptorPool = VK_NULL_HANDLE;
     mDescriptorSets.clear();
 
-    const auto& extent = swapchain.bundle().extent;
+    const auto& extent = target.extent;
     mWidth = extent.width;
     mHeight = extent.height;
     mResetAccum = true;
     mAccumInitialized = false;
-    mSwapchainImageInitialized.assign(swapchain.bundle().images.size(), false);
+    mOutputImageInitialized.assign(target.images.size(), false);
 
     createAccumulationImage(vulkanContext, extent);
-    createDescriptors(vulkanContext, swapchain);
+    createDisplayImage(vulkanContext, target);
+    createRayCounters(vulkanContext, static_cast<uint32_t>(target.images.size()));
+    createDescriptors(vulkanContext, target);
+    createTimestampQueries(vulkanContext, static_cast<uint32_t>(target.images.size()));
+
+    if (mViewMode != ViewMode::Color)
+    {
+        createCostResources(vulkanContext);
+    }
 }
 
 void RayTracer::destroy(VulkanContext& vulkanContext)
 {
     vkDeviceWaitIdle(vulkanContext.device());
+    cancelDefragmentation(vulkanContext);
+    destroyTimestampQueries(vulkanContext);
+    destroyRayCounters(vulkanContext);
+    destroyCostResources(vulkanContext);
+    destroyCostPipelines(vulkanContext);
 
     if (mDescriptorPool)
     {
@@ -262,34 +256,101 @@ void RayTracer::destroy(VulkanContext& vulkanContext)
     mPipelineLayout = VK_NULL_HANDLE;
     mSetLayout = VK_NULL_HANDLE;
 
+    destroyAccumulationImage(vulkanContext);
+    destroyDisplayImage(vulkanContext);
+
+    if (mSphereBuffer && mSphereAlloc)
+    {
+        vulkanContext.untrackAllocation(mSphereAlloc, MemoryCategory::Scene);
+        vmaDestroyBuffer(vulkanContext.allocator(), mSphereBuffer, mSphereAlloc);
+    }
+
+    mSphereBuffer = VK_NULL_HANDLE;
+    mSphereAlloc = VK_NULL_HANDLE;
+    destroyParamsBuffers(vulkanContext);
+}
+
+void RayTracer::destroyAccumulationImage(VulkanContext& vulkanContext)
+{
     if (mAccumView)
     {
         vkDestroyImageView(vulkanContext.device(), mAccumView, nullptr);
     }
     if (mAccumImage && mAccumAlloc)
     {
+        vulkanContext.untrackAllocation(mAccumAlloc, MemoryCategory::Accumulation);
         vmaDestroyImage(vulkanContext.allocator(), mAccumImage, mAccumAlloc);
     }
 
     mAccumImage = VK_NULL_HANDLE;
     mAccumView = VK_NULL_HANDLE;
     mAccumAlloc = VK_NULL_HANDLE;
+}
 
-    if (mSphereBuffer && mSphereAlloc)
+void RayTracer::createDisplayImage(VulkanContext& vulkanContext, const RenderTarget& target)
+{
+    mDisplayInitialized = false;
+
+    // Offscreen targets keep their own contents between renders; swapchain images without transfer writes fall
+    // back to whole-image renders.
+    if (!target.presentable || !target.transferDst)
     {
-        vmaDestroyBuffer(vulkanContext.allocator(), mSphereBuffer, mSphereAlloc);
+        mTilesAllowed = !target.presentable;
+
+        return;
+    }
+
+    VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { target.extent.width, target.extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = target.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.pool = vulkanContext.pool(MemoryPool::RenderTargets);
+    VK_CHECK(vmaCreateImage(vulkanContext.allocator(), &imageInfo, &allocInfo, &mDisplayImage, &mDisplayAlloc, nullptr));
+    vulkanContext.trackAllocation(mDisplayAlloc, MemoryCategory::Accumulation, "Display image");
+
+    mDisplayView = createColorView(vulkanContext.device(), mDisplayImage, imageInfo.format);
+    mTilesAllowed = true;
+}
+
+void RayTracer::destroyDisplayImage(VulkanContext& vulkanContext)
+{
+    if (mDisplayView)
+    {
+        vkDestroyImageView(vulkanContext.device(), mDisplayView, nullptr);
+    }
+    if (mDisplayImage && mDisplayAlloc)
+    {
+        vulkanContext.untrackAllocation(mDisplayAlloc, MemoryCategory::Accumulation);
+        vmaDestroyImage(vulkanContext.allocator(), mDisplayImage, mDisplayAlloc);
     }
-    
+
+    mDisplayImage = VK_NULL_HANDLE;
+    mDisplayView = VK_NULL_HANDLE;
+    mDisplayAlloc = VK_NULL_HANDLE;
+    mDisplayInitialized = false;
+}
+
+void RayTracer::destroyParamsBuffers(VulkanContext& vulkanContext)
+{
     for (size_t i = 0; i < mParamsBuffers.size(); ++i)
     {
         if (mParamsBuffers[i] && mParamsAllocs[i])
         {
+            vulkanContext.untrackAllocation(mParamsAllocs[i], MemoryCategory::Uniform);
             vmaDestroyBuffer(vulkanContext.allocator(), mParamsBuffers[i], mParamsAllocs[i]);
         }
     }
 
-    mSphereBuffer = VK_NULL_HANDLE;
-    mSphereAlloc = VK_NULL_HANDLE;
     mParamsBuffers.clear();
     mParamsAllocs.clear();
     mParamsMapped.clear();
@@ -314,6 +375,29 @@ void RayTracer::setSamplesPerPixel(uint32_t samplesPerPixel)
     mResetAccum = true;
 }
 
+void RayTracer::setDispatchSamples(uint32_t samplesPerPixel)
+{
+    mSamplesPerPixel = std::max(1u, samplesPerPixel);
+}
+
+void RayTracer::setSampleBase(uint64_t firstSample)
+{
+    mRunningSampleKey = true;
+    mSampleBase = firstSample;
+}
+
+void RayTracer::setDispatchBudget(double seconds)
+{
+    if (seconds > 0.0 && !mTimestampPool)
+    {
+        logger::warn("Bounded dispatch needs timestamp queries; tracing whole frames.");
+
+        return;
+    }
+
+    mDispatchBudget = std::max(0.0, seconds);
+}
+
 void RayTracer::setAperture(float aperture)
 {
     mAperture = std::max(0.0f, aperture);
@@ -341,6 +425,27 @@ void RayTracer::setMaxDepth(uint32_t depth)
     mResetAccum = true;
 }
 
+uint64_t RayTracer::sceneHash() const
+{
+    return hashBytes(mSpheres.data(), mSpheres.size() * sizeof(GPUSphere));
+}
+
+uint64_t RayTracer::settingsHash(const VkExtent2D& extent) const
+{
+    GPUParams params = makeCameraParams(extent);
+    params.frameSampleDepthCount = { 0, 0, mMaxDepth, 0 };
+
+    // The sample key only addresses random numbers, so checkpoints from before it existed stay compatible.
+    return hashBytes(&params, offsetof(GPUParams, sampleKey));
+}
+
+void RayTracer::setViewWindow(const VkExtent2D& fullExtent, const VkOffset2D& offset)
+{
+    mViewFullExtent = fullExtent;
+    mViewOffset = offset;
+    mResetAccum = true;
+}
+
 void RayTracer::createPipeline(VulkanContext& vulkanContext)
 {
     VkDescriptorSetLayoutBinding accumBinding{};
@@ -367,12 +472,27 @@ void RayTracer::createPipeline(VulkanContext& vulkanContext)
     paramsBinding.descriptorCount = 1;
     paramsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 4> bindings
+    // Only the raytrace_cost variant uses the cost image.
+    VkDescriptorSetLayoutBinding costBinding{};
+    costBinding.binding = 4;
+    costBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    costBinding.descriptorCount = 1;
+    costBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutBinding counterBinding{};
+    counterBinding.binding = 5;
+    counterBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    counterBinding.descriptorCount = 1;
+    counterBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 6> bindings
     {
         accumBinding,
         swapBinding,
         sphereBinding,
-        paramsBinding
+        paramsBinding,
+        costBinding,
+        counterBinding
     };
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
@@ -385,7 +505,7 @@ void RayTracer::createPipeline(VulkanContext& vulkanContext)
     pipelineLayoutInfo.pSetLayouts = &mSetLayout;
     VK_CHECK(vkCreatePipelineLayout(vulkanContext.device(), &pipelineLayoutInfo, nullptr, &mPipelineLayout));
 
-    VkShaderModule computeModule = compileCompute(vulkanContext.device(), "shaders/raytrace.comp.glsl");
+    VkShaderModule computeModule = compileCompute(vulkanContext.device(), "raytrace");
 
     VkPipelineShaderStageCreateInfo stageInfo{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
     stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
@@ -395,19 +515,21 @@ void RayTracer::createPipeline(VulkanContext& vulkanContext)
     VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
     pipelineInfo.stage = stageInfo;
     pipelineInfo.layout = mPipelineLayout;
+    pipelineInfo.flags = VK_PIPELINE_CREATE_DISPATCH_BASE_BIT; // Bounded dispatch traces tiles with a base workgroup.
 
     VK_CHECK(vkCreateComputePipelines(vulkanContext.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mPipeline));
     vkDestroyShaderModule(vulkanContext.device(), computeModule, nullptr);
 }
 
-void RayTracer::createDescriptors(VulkanContext& vulkanContext, Swapchain& swapchain)
+void RayTracer::createDescriptors(VulkanContext& vulkanContext, const RenderTarget& target)
 {
-    const size_t imageCount = swapchain.bundle().images.size();
+    const size_t imageCount = target.images.size();
+    mOutputViews = mDisplayView ? std::vector<VkImageView>(imageCount, mDisplayView) : target.imageViews;
     VkDescriptorPoolSize poolSizes[3]{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(imageCount * 2);
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(imageCount * 3);
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(imageCount);
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(imageCount * 2);
     poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[2].descriptorCount = static_cast<uint32_t>(imageCount);
 
@@ -443,6 +565,7 @@ void RayTracer::createDescriptors(VulkanContext& vulkanContext, Swapchain& swapc
     {
         VmaAllocationInfo allocationInfo{};
         VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &paramsAllocInfo, &mParamsBuffers[i], &mParamsAllocs[i], &allocationInfo));
+        vulkanContext.trackAllocation(mParamsAllocs[i], MemoryCategory::Uniform, "Params UBO");
         mParamsMapped[i] = allocationInfo.pMappedData;
 
         VkDescriptorImageInfo accumInfo{};
@@ -451,7 +574,7 @@ void RayTracer::createDescriptors(VulkanContext& vulkanContext, Swapchain& swapc
 
         VkDescriptorImageInfo swapInfo{};
         swapInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-        swapInfo.imageView = swapchain.bundle().imageViews[i];
+        swapInfo.imageView = mOutputViews[i];
 
         VkDescriptorBufferInfo sphereInfo{};
         sphereInfo.buffer = mSphereBuffer;
@@ -461,7 +584,12 @@ void RayTracer::createDescriptors(VulkanContext& vulkanContext, Swapchain& swapc
         paramsInfo.buffer = mParamsBuffers[i];
         paramsInfo.range = sizeof(GPUParams);
 
-        std::array<VkWriteDescriptorSet, 4> writes{};
+        VkDescriptorBufferInfo counterInfo{};
+        counterInfo.buffer = mCounterBuffer;
+        counterInfo.offset = mCounterStride * i;
+        counterInfo.range = rayCounterBytes;
+
+        std::array<VkWriteDescriptorSet, 5> writes{};
 
         writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         writes[0].dstSet = mDescriptorSets[i];
@@ -491,157 +619,959 @@ void RayTracer::createDescriptors(VulkanContext& vulkanContext, Swapchain& swapc
         writes[3].descriptorCount = 1;
         writes[3].pBufferInfo = &paramsInfo;
 
+        writes[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[4].dstSet = mDescriptorSets[i];
+        writes[4].dstBinding = 5;
+        writes[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[4].descriptorCount = 1;
+        writes[4].pBufferInfo = &counterInfo;
+
         vkUpdateDescriptorSets(vulkanContext.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
     }
 }
 
 void RayTracer::createAccumulationImage(VulkanContext& vulkanContext, const VkExtent2D& extent)
 {
-    VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent = { extent.width, extent.height, 1 };
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkImageCreateInfo imageInfo = accumulationImageInfo(extent);
 
     VmaAllocationCreateInfo allocInfo{};
     allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+    allocInfo.pool = vulkanContext.pool(MemoryPool::RenderTargets);
+
+    VkResult result = vmaCreateImage(vulkanContext.allocator(), &imageInfo, &allocInfo, &mAccumImage, &mAccumAlloc, nullptr);
+
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+    {
+        // The image is required at this resolution; going over budget risks paging but usually still succeeds.
+        logger::warn("Accumulation image %ux%u exceeds the device memory budget, allocating over budget.", extent.width, extent.height);
+        allocInfo.flags = 0;
+        result = vmaCreateImage(vulkanContext.allocator(), &imageInfo, &allocInfo, &mAccumImage, &mAccumAlloc, nullptr);
+    }
 
-    VK_CHECK(vmaCreateImage(vulkanContext.allocator(), &imageInfo, &allocInfo, &mAccumImage, &mAccumAlloc, nullptr));
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+    {
+        throw std::runtime_error("Out of memory for the " + std::to_string(extent.width) + "x" + std::to_string(extent.height) +
+            " accumulation image, reduce the window size");
+    }
 
-    VkImageViewCreateInfo viewInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-    viewInfo.image = mAccumImage;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = imageInfo.format;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.layerCount = 1;
+    VK_CHECK(result);
+    vulkanContext.trackAllocation(mAccumAlloc, MemoryCategory::Accumulation, "Accumulation");
 
-    VK_CHECK(vkCreateImageView(vulkanContext.device(), &viewInfo, nullptr, &mAccumView));
+    mAccumView = createColorView(vulkanContext.device(), mAccumImage, imageInfo.format);
 }
 
-void RayTracer::uploadScene(VulkanContext& vulkanContext)
+void RayTracer::updateSharedDescriptors(VulkanContext& vulkanContext)
 {
-    VkDeviceSize sphereSize = sizeof(GPUSphere) * mSpheres.size();
+    VkDescriptorImageInfo accumInfo{};
+    accumInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    accumInfo.imageView = mAccumView;
 
-    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-    bufferInfo.size = sphereSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkDescriptorBufferInfo sphereInfo{};
+    sphereInfo.buffer = mSphereBuffer;
+    sphereInfo.range = VK_WHOLE_SIZE;
 
-    VmaAllocationCreateInfo allocInfo{};
-    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    for (VkDescriptorSet set : mDescriptorSets)
+    {
+        std::array<VkWriteDescriptorSet, 2> writes{};
+
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = set;
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[0].descriptorCount = 1;
+        writes[0].pImageInfo = &accumInfo;
 
-    VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &mSphereBuffer, &mSphereAlloc, nullptr));
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = set;
+        writes[1].dstBinding = 2;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].descriptorCount = 1;
+        writes[1].pBufferInfo = &sphereInfo;
 
-    void* mappedMemory = nullptr;
-    VK_CHECK(vmaMapMemory(vulkanContext.allocator(), mSphereAlloc, &mappedMemory));
-    std::memcpy(mappedMemory, mSpheres.data(), static_cast<size_t>(sphereSize));
-    vmaUnmapMemory(vulkanContext.allocator(), mSphereAlloc);
+        vkUpdateDescriptorSets(vulkanContext.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
+        if (mCostView)
+        {
+            VkDescriptorImageInfo costInfo{};
+            costInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            costInfo.imageView = mCostView;
+
+            VkWriteDescriptorSet costWrite{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            costWrite.dstSet = set;
+            costWrite.dstBinding = 4;
+            costWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            costWrite.descriptorCount = 1;
+            costWrite.pImageInfo = &costInfo;
+            vkUpdateDescriptorSets(vulkanContext.device(), 1, &costWrite, 0, nullptr);
+        }
+    }
 }
 
-void RayTracer::updateParams(VulkanContext& vulkanContext, const VkExtent2D& extent, uint32_t frameIndex, uint32_t swapImageIndex)
+bool RayTracer::defragmentStep(VulkanContext& vulkanContext)
 {
-    GPUParams params = makeCameraParams(extent);
-    params.frameSampleDepthCount = { frameIndex, mSamplesPerPixel, mMaxDepth, static_cast<uint32_t>(mSpheres.size()) };
+    VmaAllocator allocator = vulkanContext.allocator();
 
-    std::memcpy(mParamsMapped[swapImageIndex], &params, sizeof(GPUParams));
-    vmaFlushAllocation(vulkanContext.allocator(), mParamsAllocs[swapImageIndex], 0, sizeof(GPUParams));
-}
+    if (!mDefragContext)
+    {
+        VmaDefragmentationInfo info{};
+        info.pool = vulkanContext.pool(static_cast<MemoryPool>(mDefragPool));
+        info.maxBytesPerPass = defragBytesPerPass;
+        info.maxAllocationsPerPass = defragAllocationsPerPass;
 
-void RayTracer::render(VulkanContext& vulkanContext, Swapchain& swapchain, VkCommandBuffer commandBuffer, uint32_t swapImageIndex, uint32_t frameIndex)
-{
-    VkExtent2D extent = swapchain.bundle().extent;
-    updateParams(vulkanContext, extent, frameIndex, swapImageIndex);
+        if (!info.pool)
+        {
+            mDefragPool = (mDefragPool + 1) % static_cast<uint32_t>(MemoryPool::Count);
 
-    const bool clearAccum = mResetAccum || frameIndex == 0;
+            return mDefragPool != 0;
+        }
 
-    if (clearAccum)
+        VK_CHECK(vmaBeginDefragmentation(allocator, &info, &mDefragContext));
+    }
+
+    VmaDefragmentationPassMoveInfo pass{};
+    VkResult result = vmaBeginDefragmentationPass(allocator, mDefragContext, &pass);
+
+    if (result == VK_INCOMPLETE)
     {
-        VkImageMemoryBarrier accumToClear{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-        accumToClear.oldLayout = mAccumInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
-        accumToClear.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        accumToClear.srcAccessMask = mAccumInitialized
-            ? (VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT)
-            : 0;
-        accumToClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        accumToClear.image = mAccumImage;
-        accumToClear.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        accumToClear.subresourceRange.levelCount = 1;
-        accumToClear.subresourceRange.layerCount = 1;
+        // Moved resources are referenced by every frame in flight.
+        vulkanContext.waitIdle();
+        applyDefragmentationMoves(vulkanContext, pass);
+        result = vmaEndDefragmentationPass(allocator, mDefragContext, &pass);
+    }
 
-        VkPipelineStageFlags accumClearSrcStage = mAccumInitialized
-            ? (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
-            : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            accumClearSrcStage,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &accumToClear);
+    if (result == VK_INCOMPLETE)
+    {
+        return true;
+    }
 
-        VkClearColorValue zero{};
-        VkImageSubresourceRange range{};
-        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        range.levelCount = 1;
-        range.layerCount = 1;
-        vkCmdClearColorImage(commandBuffer, mAccumImage, VK_IMAGE_LAYOUT_GENERAL, &zero, 1, &range);
-        mAccumInitialized = true;
-        mResetAccum = false;
+    VK_CHECK(result);
+
+    VmaDefragmentationStats stats{};
+    vmaEndDefragmentation(allocator, mDefragContext, &stats);
+    mDefragContext = VK_NULL_HANDLE;
+    mDefragBytesMoved += stats.bytesMoved;
+
+    if (stats.allocationsMoved > 0 || stats.deviceMemoryBlocksFreed > 0)
+    {
+        logger::info("Defragmented %s pool: moved %u allocations (%.2f MiB), freed %u blocks (%.2f MiB).",
+            memoryPoolName(static_cast<MemoryPool>(mDefragPool)), stats.allocationsMoved, static_cast<double>(stats.bytesMoved) / (1024.0 * 1024.0),
+            stats.deviceMemoryBlocksFreed, static_cast<double>(stats.bytesFreed) / (1024.0 * 1024.0));
     }
 
-    VkImageMemoryBarrier swapBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-    swapBarrier.oldLayout = mSwapchainImageInitialized[swapImageIndex] ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
-    swapBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-    swapBarrier.srcAccessMask = 0;
-    swapBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    swapBarrier.image = swapchain.bundle().images[swapImageIndex];
-    swapBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    swapBarrier.subresourceRange.levelCount = 1;
-    swapBarrier.subresourceRange.layerCount = 1;
+    mDefragPool = (mDefragPool + 1) % static_cast<uint32_t>(MemoryPool::Count);
 
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        0,
-        0,
-        nullptr,
-        0,
-        nullptr,
-        1,
-        &swapBarrier);
+    return mDefragPool != 0;
+}
 
-    mSwapchainImageInitialized[swapImageIndex] = true;
+void RayTracer::cancelDefragmentation(VulkanContext& vulkanContext)
+{
+    if (mDefragContext)
+    {
+        vmaEndDefragmentation(vulkanContext.allocator(), mDefragContext, nullptr);
+        mDefragContext = VK_NULL_HANDLE;
+    }
 
-    VkImageMemoryBarrier accumToCompute{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-    accumToCompute.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-    accumToCompute.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-    accumToCompute.srcAccessMask = clearAccum
-        ? VK_ACCESS_TRANSFER_WRITE_BIT
-        : (VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
-    accumToCompute.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
-    accumToCompute.image = mAccumImage;
-    accumToCompute.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    accumToCompute.subresourceRange.levelCount = 1;
-    accumToCompute.subresourceRange.layerCount = 1;
+    mDefragPool = 0;
+}
 
-    VkPipelineStageFlags accumComputeSrcStage = clearAccum
-        ? VK_PIPELINE_STAGE_TRANSFER_BIT
-        : (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-    vkCmdPipelineBarrier(
+void RayTracer::applyDefragmentationMoves(VulkanContext& vulkanContext, VmaDefragmentationPassMoveInfo& pass)
+{
+    VkDevice device = vulkanContext.device();
+    VmaAllocator allocator = vulkanContext.allocator();
+    VkImage newAccumImage = VK_NULL_HANDLE;
+    VkBuffer newSphereBuffer = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < pass.moveCount; ++i)
+    {
+        VmaDefragmentationMove& move = pass.pMoves[i];
+
+        if (move.srcAllocation == mAccumAlloc && mAccumImage)
+        {
+            VkImageCreateInfo imageInfo = accumulationImageInfo({ mWidth, mHeight });
+            VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &newAccumImage));
+            VK_CHECK(vmaBindImageMemory(allocator, move.dstTmpAllocation, newAccumImage));
+        }
+        else if (move.srcAllocation == mSphereAlloc && mSphereBuffer)
+        {
+            VkBufferCreateInfo bufferInfo = sphereBufferInfo(sizeof(GPUSphere) * mSpheres.size());
+            VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &newSphereBuffer));
+            VK_CHECK(vmaBindBufferMemory(allocator, move.dstTmpAllocation, newSphereBuffer));
+        }
+        else
+        {
+            // Not owned here; leave it in place.
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        }
+    }
+
+    if (!newAccumImage && !newSphereBuffer)
+    {
+        return;
+    }
+
+    vulkanContext.submitImmediate([&](VkCommandBuffer commandBuffer)
+    {
+        if (newAccumImage)
+        {
+            // Uninitialized accumulation has nothing worth copying; it is cleared before first use.
+            VkImageMemoryBarrier barriers[2]{};
+
+            barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[0].image = newAccumImage;
+            barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barriers[1].image = mAccumImage;
+            barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            if (mAccumInitialized)
+            {
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0, 0, nullptr, 0, nullptr, 2, barriers);
+
+                VkImageCopy region{};
+                region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                region.extent = { mWidth, mHeight, 1 };
+                vkCmdCopyImage(commandBuffer, mAccumImage, VK_IMAGE_LAYOUT_GENERAL, newAccumImage, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+            }
+        }
+
+        if (newSphereBuffer)
+        {
+            VkBufferCopy region{};
+            region.size = sizeof(GPUSphere) * mSpheres.size();
+            vkCmdCopyBuffer(commandBuffer, mSphereBuffer, newSphereBuffer, 1, &region);
+        }
+    });
+
+    // The allocations keep their handles; VMA points them at the new memory when the pass ends.
+    if (newAccumImage)
+    {
+        vkDestroyImageView(device, mAccumView, nullptr);
+        vkDestroyImage(device, mAccumImage, nullptr);
+        mAccumImage = newAccumImage;
+        mAccumView = createColorView(device, mAccumImage, VK_FORMAT_R32G32B32A32_SFLOAT);
+    }
+
+    if (newSphereBuffer)
+    {
+        vkDestroyBuffer(device, mSphereBuffer, nullptr);
+        mSphereBuffer = newSphereBuffer;
+    }
+
+    updateSharedDescriptors(vulkanContext);
+}
+
+void RayTracer::setViewMode(VulkanContext& vulkanContext, ViewMode mode)
+{
+    if (mode == mViewMode)
+    {
+        return;
+    }
+
+    if (mode != ViewMode::Color && !mCostImage)
+    {
+        vkDeviceWaitIdle(vulkanContext.device());
+        createCostPipelines(vulkanContext);
+        createCostResources(vulkanContext);
+    }
+
+    mViewMode = mode;
+    mCostStats = {};
+}
+
+void RayTracer::createCostPipelines(VulkanContext& vulkanContext)
+{
+    if (mCostTracePipeline)
+    {
+        return;
+    }
+
+    VkDevice device = vulkanContext.device();
+
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0] = { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &mCostSetLayout));
+
+    VkPushConstantRange pushRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t) };
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &mCostSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &mCostPipelineLayout));
+
+    auto createPipeline = [device](const char* variant, VkPipelineLayout layout)
+    {
+        VkShaderModule module = compileCompute(device, variant);
+
+        VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        pipelineInfo.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = layout;
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        vkDestroyShaderModule(device, module, nullptr);
+
+        return pipeline;
+    };
+
+    mCostTracePipeline = createPipeline("raytrace_cost", mPipelineLayout);
+    mCostReducePipeline = createPipeline("cost_reduce", mCostPipelineLayout);
+    mCostDisplayPipeline = createPipeline("cost_display", mCostPipelineLayout);
+}
+
+void RayTracer::createCostResources(VulkanContext& vulkanContext)
+{
+    VkDevice device = vulkanContext.device();
+    const uint32_t imageCount = static_cast<uint32_t>(mDescriptorSets.size());
+
+    VkImageCreateInfo imageInfo = accumulationImageInfo({ mWidth, mHeight });
+    imageInfo.format = VK_FORMAT_R32G32_UINT;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    VmaAllocationCreateInfo imageAllocInfo{};
+    imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    imageAllocInfo.pool = vulkanContext.pool(MemoryPool::RenderTargets);
+    VK_CHECK(vmaCreateImage(vulkanContext.allocator(), &imageInfo, &imageAllocInfo, &mCostImage, &mCostAlloc, nullptr));
+    vulkanContext.trackAllocation(mCostAlloc, MemoryCategory::Debug, "Cost heatmap");
+    mCostView = createColorView(device, mCostImage, imageInfo.format);
+
+    // Four uint pairs (min, max, sum low, sum high), one slot per swapchain image.
+    mCostStatsStride = storageSlotStride(vulkanContext.physical(), 8 * sizeof(uint32_t));
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = mCostStatsStride * imageCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo bufferAllocInfo{};
+    bufferAllocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    bufferAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo mappedInfo{};
+    VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &bufferAllocInfo, &mCostStatsBuffer, &mCostStatsAlloc, &mappedInfo));
+    vulkanContext.trackAllocation(mCostStatsAlloc, MemoryCategory::Debug, "Cost statistics");
+    mCostStatsMapped = mappedInfo.pMappedData;
+    mCostStatsPending.assign(imageCount, false);
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, imageCount * 2 };
+    poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, imageCount };
+
+    VkDescriptorPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.maxSets = imageCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &mCostDescriptorPool));
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, mCostSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = mCostDescriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+    mCostDescriptorSets.resize(imageCount);
+    VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, mCostDescriptorSets.data()));
+
+    for (uint32_t i = 0; i < imageCount; ++i)
+    {
+        VkDescriptorImageInfo costInfo{ VK_NULL_HANDLE, mCostView, VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorBufferInfo statsInfo{ mCostStatsBuffer, mCostStatsStride * i, 8 * sizeof(uint32_t) };
+        VkDescriptorImageInfo outputInfo{ VK_NULL_HANDLE, mOutputViews[i], VK_IMAGE_LAYOUT_GENERAL };
+
+        std::array<VkWriteDescriptorSet, 3> writes{};
+
+        for (uint32_t binding = 0; binding < writes.size(); ++binding)
+        {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = mCostDescriptorSets[i];
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+        }
+
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[0].pImageInfo = &costInfo;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].pBufferInfo = &statsInfo;
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[2].pImageInfo = &outputInfo;
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    updateSharedDescriptors(vulkanContext);
+}
+
+void RayTracer::destroyCostResources(VulkanContext& vulkanContext)
+{
+    if (mCostDescriptorPool)
+    {
+        vkDestroyDescriptorPool(vulkanContext.device(), mCostDescriptorPool, nullptr);
+    }
+    if (mCostView)
+    {
+        vkDestroyImageView(vulkanContext.device(), mCostView, nullptr);
+    }
+    if (mCostImage && mCostAlloc)
+    {
+        vulkanContext.untrackAllocation(mCostAlloc, MemoryCategory::Debug);
+        vmaDestroyImage(vulkanContext.allocator(), mCostImage, mCostAlloc);
+    }
+    if (mCostStatsBuffer && mCostStatsAlloc)
+    {
+        vulkanContext.untrackAllocation(mCostStatsAlloc, MemoryCategory::Debug);
+        vmaDestroyBuffer(vulkanContext.allocator(), mCostStatsBuffer, mCostStatsAlloc);
+    }
+
+    mCostDescriptorPool = VK_NULL_HANDLE;
+    mCostDescriptorSets.clear();
+    mCostView = VK_NULL_HANDLE;
+    mCostImage = VK_NULL_HANDLE;
+    mCostAlloc = VK_NULL_HANDLE;
+    mCostStatsBuffer = VK_NULL_HANDLE;
+    mCostStatsAlloc = VK_NULL_HANDLE;
+    mCostStatsMapped = nullptr;
+    mCostStatsPending.clear();
+}
+
+void RayTracer::destroyCostPipelines(VulkanContext& vulkanContext)
+{
+    VkDevice device = vulkanContext.device();
+
+    for (VkPipeline* pipeline : { &mCostTracePipeline, &mCostReducePipeline, &mCostDisplayPipeline })
+    {
+        if (*pipeline)
+        {
+            vkDestroyPipeline(device, *pipeline, nullptr);
+            *pipeline = VK_NULL_HANDLE;
+        }
+    }
+
+    if (mCostPipelineLayout)
+    {
+        vkDestroyPipelineLayout(device, mCostPipelineLayout, nullptr);
+    }
+    if (mCostSetLayout)
+    {
+        vkDestroyDescriptorSetLayout(device, mCostSetLayout, nullptr);
+    }
+
+    mCostPipelineLayout = VK_NULL_HANDLE;
+    mCostSetLayout = VK_NULL_HANDLE;
+}
+
+void RayTracer::readCostStats(VulkanContext& vulkanContext, uint32_t swapImageIndex)
+{
+    // The caller has waited for this image's previous submission.
+    if (!mCostStatsPending[swapImageIndex])
+    {
+        return;
+    }
+
+    const VkDeviceSize offset = mCostStatsStride * swapImageIndex;
+    vmaInvalidateAllocation(vulkanContext.allocator(), mCostStatsAlloc, offset, 8 * sizeof(uint32_t));
+
+    uint32_t words[8]{};
+    std::memcpy(words, static_cast<const uint8_t*>(mCostStatsMapped) + offset, sizeof(words));
+
+    const uint32_t metric = mViewMode == ViewMode::CostBounces ? 0 : 1;
+    const uint64_t sum = (static_cast<uint64_t>(words[6 + metric]) << 32) | words[4 + metric];
+    const uint64_t pixels = static_cast<uint64_t>(mWidth) * mHeight;
+
+    mCostStats.minValue = words[metric];
+    mCostStats.maxValue = words[2 + metric];
+    mCostStats.mean = pixels ? static_cast<double>(sum) / static_cast<double>(pixels) : 0.0;
+}
+
+void RayTracer::recordCostPasses(VkCommandBuffer commandBuffer, const VkExtent2D& extent, uint32_t swapImageIndex)
+{
+    const VkDeviceSize offset = mCostStatsStride * swapImageIndex;
+    const uint32_t metric = mViewMode == ViewMode::CostBounces ? 0 : 1;
+
+    // Reset: min words to ~0, max and sums to 0.
+    vkCmdFillBuffer(commandBuffer, mCostStatsBuffer, offset, 2 * sizeof(uint32_t), 0xFFFFFFFFu);
+    vkCmdFillBuffer(commandBuffer, mCostStatsBuffer, offset + 2 * sizeof(uint32_t), 6 * sizeof(uint32_t), 0);
+
+    VkMemoryBarrier toReduce{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    toReduce.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    toReduce.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &toReduce, 0, nullptr, 0, nullptr);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCostPipelineLayout, 0, 1, &mCostDescriptorSets[swapImageIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, mCostPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(metric), &metric);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCostReducePipeline);
+    vkCmdDispatch(commandBuffer, (extent.width + 15) / 16, (extent.height + 15) / 16, 1);
+
+    VkMemoryBarrier toDisplay{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    toDisplay.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toDisplay.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &toDisplay, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCostDisplayPipeline);
+    vkCmdDispatch(commandBuffer, (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+
+    VkMemoryBarrier toHost{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    toHost.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &toHost, 0, nullptr, 0, nullptr);
+
+    mCostStatsPending[swapImageIndex] = true;
+}
+
+void RayTracer::createTimestampQueries(VulkanContext& vulkanContext, uint32_t imageCount)
+{
+    destroyTimestampQueries(vulkanContext);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkanContext.physical(), &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(vulkanContext.physical(), &familyCount, families.data());
+
+    const uint32_t validBits = families[vulkanContext.graphicsFamilyIndex()].timestampValidBits;
+
+    if (validBits == 0)
+    {
+        logger::warn("Timestamp queries unsupported, GPU pass time unavailable.");
+
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(vulkanContext.physical(), &properties);
+    mTimestampPeriodNs = properties.limits.timestampPeriod;
+    mTimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+    VkQueryPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = imageCount * 2;
+    VK_CHECK(vkCreateQueryPool(vulkanContext.device(), &poolInfo, nullptr, &mTimestampPool));
+    mTimestampPending.assign(imageCount, false);
+    mSlotPixelSamples.assign(imageCount, 0);
+}
+
+void RayTracer::createRayCounters(VulkanContext& vulkanContext, uint32_t imageCount)
+{
+    mCounterStride = storageSlotStride(vulkanContext.physical(), rayCounterBytes);
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = mCounterStride * imageCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo mappedInfo{};
+    VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &mCounterBuffer, &mCounterAlloc, &mappedInfo));
+    vulkanContext.trackAllocation(mCounterAlloc, MemoryCategory::Readback, "Ray counters");
+    mCounterMapped = mappedInfo.pMappedData;
+    mCounterPending.assign(imageCount, false);
+    mLastRayCounts = {};
+}
+
+void RayTracer::destroyRayCounters(VulkanContext& vulkanContext)
+{
+    if (mCounterBuffer && mCounterAlloc)
+    {
+        vulkanContext.untrackAllocation(mCounterAlloc, MemoryCategory::Readback);
+        vmaDestroyBuffer(vulkanContext.allocator(), mCounterBuffer, mCounterAlloc);
+    }
+
+    mCounterBuffer = VK_NULL_HANDLE;
+    mCounterAlloc = VK_NULL_HANDLE;
+    mCounterMapped = nullptr;
+    mCounterPending.clear();
+}
+
+void RayTracer::destroyTimestampQueries(VulkanContext& vulkanContext)
+{
+    if (mTimestampPool)
+    {
+        vkDestroyQueryPool(vulkanContext.device(), mTimestampPool, nullptr);
+    }
+
+    mTimestampPool = VK_NULL_HANDLE;
+    mTimestampPending.clear();
+    mSlotPixelSamples.clear();
+}
+
+void RayTracer::uploadScene(VulkanContext& vulkanContext)
+{
+    VkDeviceSize sphereSize = sizeof(GPUSphere) * mSpheres.size();
+
+    VkBufferCreateInfo bufferInfo = sphereBufferInfo(sphereSize);
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+    allocInfo.pool = vulkanContext.pool(MemoryPool::Scene);
+
+    VkResult result = vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &mSphereBuffer, &mSphereAlloc, nullptr);
+
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+    {
+        // Degrade to system memory read over the bus rather than failing the scene load.
+        logger::warn("Scene buffer (%.1f MiB) exceeds the device memory budget, falling back to host memory.",
+            static_cast<double>(sphereSize) / (1024.0 * 1024.0));
+        allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+        allocInfo.flags = 0;
+        allocInfo.pool = VK_NULL_HANDLE;
+        result = vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &mSphereBuffer, &mSphereAlloc, nullptr);
+    }
+
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+    {
+        throw std::runtime_error("Out of memory for the scene buffer (" + std::to_string(mSpheres.size()) + " spheres)");
+    }
+
+    VK_CHECK(result);
+    vulkanContext.trackAllocation(mSphereAlloc, MemoryCategory::Scene, "Scene spheres");
+
+    void* mappedMemory = nullptr;
+    VK_CHECK(vmaMapMemory(vulkanContext.allocator(), mSphereAlloc, &mappedMemory));
+    std::memcpy(mappedMemory, mSpheres.data(), static_cast<size_t>(sphereSize));
+    vmaUnmapMemory(vulkanContext.allocator(), mSphereAlloc);
+
+}
+
+void RayTracer::setScene(VulkanContext& vulkanContext, const std::vector<GPUSphere>& spheres)
+{
+    if (spheres.empty())
+    {
+        throw std::runtime_error("A scene needs at least one sphere");
+    }
+
+    // In-flight frames read the sphere buffer.
+    vkDeviceWaitIdle(vulkanContext.device());
+    mResetAccum = true;
+    ++mSceneVersion;
+
+    if (mSphereBuffer && spheres.size() == mSpheres.size())
+    {
+        mSpheres = spheres;
+
+        void* mappedMemory = nullptr;
+        VK_CHECK(vmaMapMemory(vulkanContext.allocator(), mSphereAlloc, &mappedMemory));
+        std::memcpy(mappedMemory, mSpheres.data(), sizeof(GPUSphere) * mSpheres.size());
+        vmaUnmapMemory(vulkanContext.allocator(), mSphereAlloc);
+        vmaFlushAllocation(vulkanContext.allocator(), mSphereAlloc, 0, VK_WHOLE_SIZE);
+
+        return;
+    }
+
+    // Defragmentation may hold a move of the old buffer.
+    cancelDefragmentation(vulkanContext);
+
+    if (mSphereBuffer && mSphereAlloc)
+    {
+        vulkanContext.untrackAllocation(mSphereAlloc, MemoryCategory::Scene);
+        vmaDestroyBuffer(vulkanContext.allocator(), mSphereBuffer, mSphereAlloc);
+    }
+
+    mSphereBuffer = VK_NULL_HANDLE;
+    mSphereAlloc = VK_NULL_HANDLE;
+    mSpheres = spheres;
+    uploadScene(vulkanContext);
+    updateSharedDescriptors(vulkanContext);
+}
+
+void RayTracer::updateParams(VulkanContext& vulkanContext, const VkExtent2D& extent, const DispatchPlan& plan, uint32_t swapImageIndex)
+{
+    GPUParams params = makeCameraParams(extent);
+    params.frameSampleDepthCount = { plan.frameIndex, plan.samples, mMaxDepth, static_cast<uint32_t>(mSpheres.size()) };
+
+    const uint64_t firstSample = plan.firstSample;
+    const bool windowed = mViewFullExtent.width > 0 && mViewFullExtent.height > 0;
+    params.sampleKey = { static_cast<uint32_t>(firstSample), static_cast<uint32_t>(firstSample >> 32),
+        windowed ? static_cast<uint32_t>(mViewOffset.x) : 0u, windowed ? static_cast<uint32_t>(mViewOffset.y) : 0u };
+
+    std::memcpy(mParamsMapped[swapImageIndex], &params, sizeof(GPUParams));
+    vmaFlushAllocation(vulkanContext.allocator(), mParamsAllocs[swapImageIndex], 0, sizeof(GPUParams));
+}
+
+RayTracer::DispatchPlan RayTracer::planDispatch(const VkExtent2D& extent, uint32_t frameIndex, bool clearAccum, bool costView)
+{
+    if (clearAccum)
+    {
+        mTileCursor = 0;
+        mCompletedSamples = 0;
+    }
+
+    // Every frame index owns mSamplesPerPixel consecutive sample indices, also when a bounded pass draws fewer,
+    // so a sample's random numbers depend only on its pixel and its index however the render is split up. Callers
+    // that vary the samples per frame key them by a running index instead (setSampleBase).
+    auto passFirstSample = [this](uint32_t passFrame)
+    {
+        return mRunningSampleKey ? mSampleBase : static_cast<uint64_t>(passFrame) * mSamplesPerPixel;
+    };
+
+    DispatchPlan plan;
+    plan.tile = extent;
+    plan.samples = mSamplesPerPixel;
+    plan.frameIndex = frameIndex;
+
+    // A pass left unfinished by switching the budget off resumes when it is switched back on; its frame index
+    // stays unique because frame indices only grow.
+    if (mDispatchBudget <= 0.0 || costView)
+    {
+        plan.firstSample = passFirstSample(frameIndex);
+        mSampleBase = plan.firstSample + plan.samples;
+        mCompletedSamples += plan.samples;
+
+        return plan;
+    }
+
+    // Pixel samples that fit the budget; 0 while the cost is unknown, which probes with one small tile at one sample.
+    const double pixelSamples = mSecondsPerPixelSample > 0.0 ? mDispatchBudget / mSecondsPerPixelSample : 0.0;
+
+    if (mTileCursor == 0)
+    {
+        uint32_t side = maxDispatchTile;
+
+        while (side > minDispatchTile && (pixelSamples <= 0.0 || static_cast<double>(side) * side > pixelSamples))
+        {
+            side /= 2;
+        }
+
+        // The whole image when one sample of it fits, otherwise the largest power-of-two tile that does.
+        mTileExtent = !mTilesAllowed || pixelSamples >= static_cast<double>(extent.width) * extent.height
+            ? extent
+            : VkExtent2D{ std::min(side, extent.width), std::min(side, extent.height) };
+        mPassFrame = frameIndex;
+        mPassSamples = mSamplesPerPixel;
+        mPassFirstSample = passFirstSample(frameIndex);
+    }
+
+    const uint32_t tilesX = (extent.width + mTileExtent.width - 1) / mTileExtent.width;
+    const uint32_t tilesY = (extent.height + mTileExtent.height - 1) / mTileExtent.height;
+    const uint32_t remaining = tilesX * tilesY - mTileCursor;
+    const double tilePixels = static_cast<double>(mTileExtent.width) * mTileExtent.height;
+
+    plan.tile = mTileExtent;
+    plan.tilesX = tilesX;
+    plan.firstTile = mTileCursor;
+    plan.frameIndex = mPassFrame;
+    plan.firstSample = mRunningSampleKey ? mPassFirstSample : static_cast<uint64_t>(mPassFrame) * mSamplesPerPixel;
+    plan.samples = static_cast<uint32_t>(std::clamp(pixelSamples / tilePixels, 1.0, static_cast<double>(mSamplesPerPixel)));
+    plan.tileCount = static_cast<uint32_t>(std::clamp(pixelSamples / (tilePixels * plan.samples), 1.0, static_cast<double>(remaining)));
+
+    // Tiles share this render's parameters, so a pass never wraps within one render. The next pass starts after
+    // the most samples any tile of this one got.
+    mPassSamples = std::min(mPassSamples, plan.samples);
+    mSampleBase = std::max(mSampleBase, plan.firstSample + plan.samples);
+    mTileCursor += plan.tileCount;
+
+    if (mTileCursor == tilesX * tilesY)
+    {
+        mTileCursor = 0;
+        mCompletedSamples += mPassSamples;
+    }
+
+    return plan;
+}
+
+void RayTracer::render(VulkanContext& vulkanContext, const RenderTarget& target, VkCommandBuffer commandBuffer, uint32_t swapImageIndex, uint32_t frameIndex)
+{
+    VkExtent2D extent = target.extent;
+    const bool clearAccum = mResetAccum || frameIndex == 0;
+    const bool costView = mViewMode != ViewMode::Color && mCostImage;
+    const uint32_t firstQuery = swapImageIndex * 2;
+    const DispatchPlan plan = planDispatch(extent, frameIndex, clearAccum, costView);
+    updateParams(vulkanContext, extent, plan, swapImageIndex);
+
+    if (costView)
+    {
+        readCostStats(vulkanContext, swapImageIndex);
+    }
+
+    if (mTimestampPool)
+    {
+        // The caller has waited for this image's previous submission, so its timestamps are final.
+        if (mTimestampPending[swapImageIndex])
+        {
+            uint64_t ticks[2]{};
+
+            if (vkGetQueryPoolResults(vulkanContext.device(), mTimestampPool, firstQuery, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+            {
+                mLastGpuSeconds = static_cast<double>((ticks[1] - ticks[0]) & mTimestampMask) * mTimestampPeriodNs * 1e-9;
+
+                if (mSlotPixelSamples[swapImageIndex] > 0 && mLastGpuSeconds > 0.0)
+                {
+                    const double cost = mLastGpuSeconds / static_cast<double>(mSlotPixelSamples[swapImageIndex]);
+                    mSecondsPerPixelSample = mSecondsPerPixelSample > 0.0
+                        ? mSecondsPerPixelSample + (cost - mSecondsPerPixelSample) * dispatchCostSmoothing
+                        : cost;
+                }
+            }
+        }
+
+        vkCmdResetQueryPool(commandBuffer, mTimestampPool, firstQuery, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mTimestampPool, firstQuery);
+        mTimestampPending[swapImageIndex] = true;
+    }
+
+    const VkDeviceSize counterOffset = mCounterStride * swapImageIndex;
+
+    if (mCounterPending[swapImageIndex])
+    {
+        vmaInvalidateAllocation(vulkanContext.allocator(), mCounterAlloc, counterOffset, rayCounterBytes);
+
+        uint32_t words[8]{};
+        std::memcpy(words, static_cast<const uint8_t*>(mCounterMapped) + counterOffset, sizeof(words));
+
+        auto wide = [&words](uint32_t index)
+        {
+            return (static_cast<uint64_t>(words[4 + index]) << 32) | words[index];
+        };
+
+        mLastRayCounts.primary = wide(0);
+        mLastRayCounts.bounce = wide(1);
+        mLastRayCounts.shadow = wide(2);
+        mLastRayCounts.intersections = wide(3);
+    }
+
+    vkCmdFillBuffer(commandBuffer, mCounterBuffer, counterOffset, rayCounterBytes, 0);
+
+    VkMemoryBarrier counterReset{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    counterReset.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    counterReset.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &counterReset, 0, nullptr, 0, nullptr);
+
+    if (clearAccum)
+    {
+        VkImageMemoryBarrier accumToClear{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        accumToClear.oldLayout = mAccumInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        accumToClear.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        accumToClear.srcAccessMask = mAccumInitialized
+            ? (VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT)
+            : 0;
+        accumToClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        accumToClear.image = mAccumImage;
+        accumToClear.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        accumToClear.subresourceRange.levelCount = 1;
+        accumToClear.subresourceRange.layerCount = 1;
+
+        VkPipelineStageFlags accumClearSrcStage = mAccumInitialized
+            ? (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+            : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            accumClearSrcStage,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            1,
+            &accumToClear);
+
+        VkClearColorValue zero{};
+        VkImageSubresourceRange range{};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.levelCount = 1;
+        range.layerCount = 1;
+        vkCmdClearColorImage(commandBuffer, mAccumImage, VK_IMAGE_LAYOUT_GENERAL, &zero, 1, &range);
+        mAccumInitialized = true;
+        mResetAccum = false;
+    }
+
+    const VkImageLayout returnedLayout = target.presentable ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_GENERAL;
+    const VkImageSubresourceRange colorRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    if (mDisplayImage)
+    {
+        if (!mDisplayInitialized)
+        {
+            // Black rather than undefined where a bounded pass has not traced yet.
+            VkImageMemoryBarrier displayToClear{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            displayToClear.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            displayToClear.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            displayToClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            displayToClear.image = mDisplayImage;
+            displayToClear.subresourceRange = colorRange;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &displayToClear);
+
+            const VkClearColorValue black{};
+            vkCmdClearColorImage(commandBuffer, mDisplayImage, VK_IMAGE_LAYOUT_GENERAL, &black, 1, &colorRange);
+            mDisplayInitialized = true;
+        }
+
+        // After the clear, or after the previous render's copy out of the image.
+        VkImageMemoryBarrier displayToCompute{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        displayToCompute.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        displayToCompute.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        displayToCompute.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        displayToCompute.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        displayToCompute.image = mDisplayImage;
+        displayToCompute.subresourceRange = colorRange;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &displayToCompute);
+    }
+    else
+    {
+        VkImageMemoryBarrier swapBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        swapBarrier.oldLayout = mOutputImageInitialized[swapImageIndex] ? returnedLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        swapBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        swapBarrier.srcAccessMask = 0;
+        swapBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        swapBarrier.image = target.images[swapImageIndex];
+        swapBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        swapBarrier.subresourceRange.levelCount = 1;
+        swapBarrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            1,
+            &swapBarrier);
+
+        mOutputImageInitialized[swapImageIndex] = true;
+    }
+
+    VkImageMemoryBarrier accumToCompute{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    accumToCompute.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    accumToCompute.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    accumToCompute.srcAccessMask = clearAccum
+        ? VK_ACCESS_TRANSFER_WRITE_BIT
+        : (VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
+    accumToCompute.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+    accumToCompute.image = mAccumImage;
+    accumToCompute.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    accumToCompute.subresourceRange.levelCount = 1;
+    accumToCompute.subresourceRange.layerCount = 1;
+
+    VkPipelineStageFlags accumComputeSrcStage = clearAccum
+        ? VK_PIPELINE_STAGE_TRANSFER_BIT
+        : (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    vkCmdPipelineBarrier(
         commandBuffer,
         accumComputeSrcStage,
         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -653,27 +1583,128 @@ void RayTracer::render(VulkanContext& vulkanContext, Swapchain& swapchain, VkCom
         1,
         &accumToCompute);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    if (costView)
+    {
+        // Cleared every frame: pixels the kernel leaves unwritten read as zero cost, not as last frame's counts
+        // or undefined memory. The previous frame's display pass is the last reader.
+        const VkImageSubresourceRange costRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        VkImageMemoryBarrier costToClear{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        costToClear.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        costToClear.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        costToClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        costToClear.image = mCostImage;
+        costToClear.subresourceRange = costRange;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &costToClear);
+
+        const VkClearColorValue zeroCost{};
+        vkCmdClearColorImage(commandBuffer, mCostImage, VK_IMAGE_LAYOUT_GENERAL, &zeroCost, 1, &costRange);
+
+        VkImageMemoryBarrier costToCompute{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        costToCompute.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        costToCompute.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        costToCompute.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        costToCompute.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        costToCompute.image = mCostImage;
+        costToCompute.subresourceRange = costRange;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &costToCompute);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, costView ? mCostTracePipeline : mPipeline);
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mDescriptorSets[swapImageIndex], 0, nullptr);
 
-    uint32_t groupX = (extent.width + 7) / 8;
-    uint32_t groupY = (extent.height + 7) / 8;
-    vkCmdDispatch(commandBuffer, groupX, groupY, 1);
+    uint64_t pixelSamples = 0;
+
+    for (uint32_t tile = plan.firstTile; tile < plan.firstTile + plan.tileCount; ++tile)
+    {
+        // Tiles are multiples of the 8x8 workgroup, so the base workgroup lands on the tile's corner.
+        const uint32_t x = (tile % plan.tilesX) * plan.tile.width;
+        const uint32_t y = (tile / plan.tilesX) * plan.tile.height;
+        const uint32_t width = std::min(plan.tile.width, extent.width - x);
+        const uint32_t height = std::min(plan.tile.height, extent.height - y);
+        vkCmdDispatchBase(commandBuffer, x / 8, y / 8, 0, (width + 7) / 8, (height + 7) / 8, 1);
+        pixelSamples += static_cast<uint64_t>(width) * height * plan.samples;
+    }
+
+    mLastPixelSamples = pixelSamples;
+
+    if (!mSlotPixelSamples.empty())
+    {
+        mSlotPixelSamples[swapImageIndex] = pixelSamples;
+    }
+
+    if (mTimestampPool)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, mTimestampPool, firstQuery + 1);
+    }
+
+    VkMemoryBarrier countersToHost{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    countersToHost.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    countersToHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &countersToHost, 0, nullptr, 0, nullptr);
+    mCounterPending[swapImageIndex] = true;
+
+    if (costView)
+    {
+        recordCostPasses(commandBuffer, extent, swapImageIndex);
+    }
+
+    // Offscreen outputs stay in GENERAL; readers synchronise against the compute stage themselves.
+    if (!target.presentable)
+    {
+        return;
+    }
+
+    VkPipelineStageFlags presentSrcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    if (mDisplayImage)
+    {
+        // Every pixel goes to the swapchain image, including those this render did not trace.
+        VkImageMemoryBarrier copyBarriers[2]{};
+
+        copyBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        copyBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        copyBarriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        copyBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        copyBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        copyBarriers[0].image = mDisplayImage;
+        copyBarriers[0].subresourceRange = colorRange;
+
+        copyBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        copyBarriers[1].oldLayout = mOutputImageInitialized[swapImageIndex] ? returnedLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        copyBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        copyBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        copyBarriers[1].image = target.images[swapImageIndex];
+        copyBarriers[1].subresourceRange = colorRange;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, copyBarriers);
+        mOutputImageInitialized[swapImageIndex] = true;
+
+        VkImageCopy region{};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.extent = { extent.width, extent.height, 1 };
+        vkCmdCopyImage(commandBuffer, mDisplayImage, VK_IMAGE_LAYOUT_GENERAL, target.images[swapImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        presentSrcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
 
     // Barrier to make image ready for color attachment (ImGui render pass will load).
     VkImageMemoryBarrier presentBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-    presentBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    presentBarrier.oldLayout = mDisplayImage ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
     presentBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    presentBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    presentBarrier.srcAccessMask = mDisplayImage ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
     presentBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-    presentBarrier.image = swapchain.bundle().images[swapImageIndex];
+    presentBarrier.image = target.images[swapImageIndex];
     presentBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     presentBarrier.subresourceRange.levelCount = 1;
     presentBarrier.subresourceRange.layerCount = 1;
 
     vkCmdPipelineBarrier(
         commandBuffer,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        presentSrcStage,
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         0,
         0,
@@ -682,4 +1713,156 @@ void RayTracer::render(VulkanContext& vulkanContext, Swapchain& swapchain, VkCom
         nullptr,
         1,
         &presentBarrier);
-}
\ No newline at end of file
+}
+
+void RayTracer::readAccumulation(VulkanContext& vulkanContext, std::vector<glm::vec4>& out)
+{
+    out.assign(static_cast<size_t>(mWidth) * mHeight, glm::vec4(0.0f));
+
+    if (!mAccumInitialized)
+    {
+        return;
+    }
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = out.size() * sizeof(glm::vec4);
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VkBuffer staging = VK_NULL_HANDLE;
+    VmaAllocation stagingAlloc = VK_NULL_HANDLE;
+    VmaAllocationInfo stagingInfo{};
+    VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &staging, &stagingAlloc, &stagingInfo));
+    vulkanContext.trackAllocation(stagingAlloc, MemoryCategory::Readback, "Accumulation readback");
+
+    vulkanContext.submitImmediate([&](VkCommandBuffer commandBuffer)
+    {
+        recordAccumulationCopy(commandBuffer, staging, 0);
+    });
+
+    vmaInvalidateAllocation(vulkanContext.allocator(), stagingAlloc, 0, VK_WHOLE_SIZE);
+    std::memcpy(out.data(), stagingInfo.pMappedData, out.size() * sizeof(glm::vec4));
+
+    vulkanContext.untrackAllocation(stagingAlloc, MemoryCategory::Readback);
+    vmaDestroyBuffer(vulkanContext.allocator(), staging, stagingAlloc);
+}
+
+void RayTracer::writeAccumulation(VulkanContext& vulkanContext, const std::vector<glm::vec4>& sums)
+{
+    if (sums.size() != static_cast<size_t>(mWidth) * mHeight)
+    {
+        throw std::runtime_error("Accumulation data does not match " + std::to_string(mWidth) + "x" + std::to_string(mHeight));
+    }
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = accumulationBytes();
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VkBuffer staging = VK_NULL_HANDLE;
+    VmaAllocation stagingAlloc = VK_NULL_HANDLE;
+    VmaAllocationInfo stagingInfo{};
+    VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &staging, &stagingAlloc, &stagingInfo));
+    vulkanContext.trackAllocation(stagingAlloc, MemoryCategory::Accumulation, "Accumulation upload");
+    std::memcpy(stagingInfo.pMappedData, sums.data(), bufferInfo.size);
+    vmaFlushAllocation(vulkanContext.allocator(), stagingAlloc, 0, VK_WHOLE_SIZE);
+
+    vulkanContext.submitImmediate([&](VkCommandBuffer commandBuffer)
+    {
+        VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        toTransfer.oldLayout = mAccumInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        toTransfer.srcAccessMask = mAccumInitialized ? (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : 0;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toTransfer.image = mAccumImage;
+        toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { mWidth, mHeight, 1 };
+        vkCmdCopyBufferToImage(commandBuffer, staging, mAccumImage, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    });
+
+    vulkanContext.untrackAllocation(stagingAlloc, MemoryCategory::Accumulation);
+    vmaDestroyBuffer(vulkanContext.allocator(), staging, stagingAlloc);
+
+    // The next frame's accumulation barrier covers the transfer write.
+    mAccumInitialized = true;
+    mResetAccum = false;
+}
+
+void RayTracer::recordAccumulationCopy(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) const
+{
+    VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.image = mAccumImage;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = offset;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { mWidth, mHeight, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, mAccumImage, VK_IMAGE_LAYOUT_GENERAL, buffer, 1, &region);
+
+    // The next frame's accumulation barriers include the transfer stage, which covers this read.
+    VkBufferMemoryBarrier toHost{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = buffer;
+    toHost.offset = offset;
+    toHost.size = accumulationBytes();
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+}
+
+void RayTracer::recordAccumulationRestore(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t completedSamples)
+{
+    VkBufferMemoryBarrier fromWriters{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    fromWriters.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT;
+    fromWriters.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    fromWriters.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    fromWriters.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    fromWriters.buffer = buffer;
+    fromWriters.offset = offset;
+    fromWriters.size = accumulationBytes();
+
+    // The transfer stage also orders this write after a copy of the previous contents recorded just before.
+    VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toTransfer.oldLayout = mAccumInitialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.srcAccessMask = mAccumInitialized ? (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : 0;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransfer.image = mAccumImage;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &fromWriters, 1, &toTransfer);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = offset;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { mWidth, mHeight, 1 };
+    vkCmdCopyBufferToImage(commandBuffer, buffer, mAccumImage, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+    // The next render's accumulation barrier covers the transfer write. A bounded pass in progress belonged to
+    // the replaced sums, so the next render starts a new one.
+    mAccumInitialized = true;
+    mResetAccum = false;
+    mCompletedSamples = completedSamples;
+    mTileCursor = 0;
+}
@@ -6,7 +6,7 @@
 #include "vma/vk_mem_alloc.h"
 
 class VulkanContext;
-class Swapchain;
+struct RenderTarget;
 
 // GPU sphere layout.
 struct GPUSphere
@@ -16,6 +16,25 @@ struct GPUSphere
     glm::vec4 misc; // x = material (0 = lambert, 1 = metal, 2 = dielectric), y = fuzz, z = refIdx, w = flags (bit0 = checker).
 };
 
+enum class SphereMaterial : uint32_t
+{
+    Lambert,
+    Metal,
+    Dielectric
+};
+
+// Packs one sphere into the GPU layout.
+inline GPUSphere packSphere(const glm::vec3& center, float radius, const glm::vec3& albedo, SphereMaterial material,
+    float fuzz = 0.0f, float refIdx = 1.0f, bool checker = false)
+{
+    GPUSphere sphere{};
+    sphere.centerRadius = glm::vec4(center, radius);
+    sphere.albedo = glm::vec4(albedo, 0.0f);
+    sphere.misc = { static_cast<float>(material), fuzz, refIdx, checker ? 1.0f : 0.0f };
+
+    return sphere;
+}
+
 // Uniform parameters.
 struct GPUParams
 {
@@ -29,6 +48,37 @@ struct GPUParams
     glm::uvec4 frameSampleDepthCount; // frameIndex, samplesPerFrame, maxDepth, sphereCount.
     glm::vec4 resolution; // x = width, y = height.
     glm::vec4 invResolution; // x = 1 / width, y = 1 / height.
+    glm::uvec4 sampleKey; // xy = global index of the frame's first sample (low, high), zw = view window offset.
+};
+
+// What the output image shows.
+enum class ViewMode
+{
+    Color,
+    CostBounces, // Heatmap of path segments per pixel.
+    CostIntersections // Heatmap of intersection tests per pixel.
+};
+
+// Reduced statistics of the displayed cost metric.
+struct CostStats
+{
+    uint32_t minValue = 0;
+    uint32_t maxValue = 0;
+    double mean = 0.0;
+};
+
+// Rays traced by one frame's ray tracing pass, from the kernel's counters.
+struct RayCounts
+{
+    uint64_t primary = 0;
+    uint64_t bounce = 0;
+    uint64_t shadow = 0;
+    uint64_t intersections = 0; // Primitive tests, not rays.
+
+    uint64_t rays() const
+    {
+        return primary + bounce + shadow;
+    }
 };
 
 class RayTracer
@@ -37,27 +87,201 @@ public:
     RayTracer() = default;
     ~RayTracer() = default;
 
-    void create(VulkanContext& vulkanContext, Swapchain& swapchain);
-    void resize(VulkanContext& vulkanContext, Swapchain& swapchain);
+    void create(VulkanContext& vulkanContext, const RenderTarget& target);
+    void resize(VulkanContext& vulkanContext, const RenderTarget& target);
     void destroy(VulkanContext& vulkanContext);
     void setCamera(const glm::vec3& pos, const glm::vec3& dir, float focusDist = -1.0f);
     void setSamplesPerPixel(uint32_t spp);
+
+    // Samples per pixel of the following dispatches without restarting accumulation. The sums carry their sample
+    // counts, so how samples are split across dispatches does not change the estimate.
+    void setDispatchSamples(uint32_t spp);
+
+    // Keys samples by a running index from now on instead of frameIndex * samplesPerPixel: each pass starts at
+    // firstSample, or where the previous pass's samples ended, so dispatches of different sizes never reuse a
+    // sample's random numbers. Takes effect at the next pass; a bounded pass in progress keeps its index.
+    void setSampleBase(uint64_t firstSample);
+
+    // Index after the last sample dispatched while keyed by setSampleBase.
+    uint64_t nextSample() const
+    {
+        return mSampleBase;
+    }
+
+    // Bounded dispatch. With a budget above 0, each render records about that much ray tracing GPU time at most,
+    // sized from timestamps of earlier renders. A frame's samples are split into slices over several renders and,
+    // when one sample of the whole image does not fit, into screen tiles; pixels a render does not trace keep the
+    // output's previous contents. Presentable targets are traced through a persistent display image that is copied
+    // out whole every render; without transfer support they get whole-image slices only. Color view only; 0 restores
+    // one full dispatch per render. Needs timestamps.
+    void setDispatchBudget(double seconds);
+
+    double dispatchBudget() const
+    {
+        return mDispatchBudget;
+    }
+
+    // Samples every pixel has received since the accumulation was last cleared, counting recorded renders.
+    uint32_t completedSamples() const
+    {
+        return mCompletedSamples;
+    }
+
+    // Pixel samples recorded by the latest render.
+    uint64_t lastPixelSamples() const
+    {
+        return mLastPixelSamples;
+    }
+
     void setAperture(float aperture);
     void setFocusDistance(float focusDist);
     void setFov(float vfov);
     void setMaxDepth(uint32_t depth);
 
+    // Renders the rectangle at offset of a virtual image of fullExtent into the target, so an output larger than
+    // any single allocation can be traced tile by tile. The rectangle is the target's extent and may extend past
+    // the virtual image's edge. A zero fullExtent renders the whole view again.
+    void setViewWindow(const VkExtent2D& fullExtent, const VkOffset2D& offset);
+
+    // Cost views use the raytrace_cost kernel variant; their resources are created on first use, which waits for the device.
+    void setViewMode(VulkanContext& vulkanContext, ViewMode mode);
+
+    ViewMode viewMode() const
+    {
+        return mViewMode;
+    }
+
+    // Statistics of the displayed cost metric from the most recently completed frame.
+    CostStats costStats() const
+    {
+        return mCostStats;
+    }
+
+    uint32_t samplesPerPixel() const
+    {
+        return mSamplesPerPixel;
+    }
+
+    // Runs one incremental defragmentation pass over the render-target and scene pools. Waits for the device to
+    // go idle, so call it on idle frames only. Returns true while more passes are needed.
+    bool defragmentStep(VulkanContext& vulkanContext);
+
+    uint64_t defragmentedBytes() const
+    {
+        return mDefragBytesMoved;
+    }
+
+    // Duration of the most recently completed ray tracing pass, or 0 if timestamps are unsupported.
+    double lastGpuSeconds() const
+    {
+        return mLastGpuSeconds;
+    }
+
+    // Counters of the same pass as lastGpuSeconds; divide the two for rays per second.
+    RayCounts lastRayCounts() const
+    {
+        return mLastRayCounts;
+    }
+
+    // Rebuilds the CPU-side sphere list; create does this before uploading. Public for the CPU microbenchmarks.
+    void buildScene();
+
+    const std::vector<GPUSphere>& spheres() const
+    {
+        return mSpheres;
+    }
+
+    // Replaces the scene and restarts accumulation. Waits for the device; a scene of the same size is copied into
+    // the existing buffer, anything else reallocates it.
+    void setScene(VulkanContext& vulkanContext, const std::vector<GPUSphere>& spheres);
+
+    // Changes whenever setScene replaces the spheres; cheaper to compare every frame than sceneHash.
+    uint64_t sceneVersion() const
+    {
+        return mSceneVersion;
+    }
+
+    // Camera for a target of the given extent, cropped to the view window when one is set.
+    GPUParams makeCameraParams(const VkExtent2D& extent) const;
+
+    // Identify what an accumulation converges to, so saved samples are only combined with compatible ones.
+    // The settings hash covers the camera (including the view window) and the path depth, not samples per frame.
+    uint64_t sceneHash() const;
+    uint64_t settingsHash(const VkExtent2D& extent) const;
+
     // Records commands into an already begun command buffer.
-    void render(VulkanContext& vulkanContext, Swapchain& swapchain, VkCommandBuffer commandBuffer, uint32_t swapImageIndex, uint32_t frameIndex);
+    void render(VulkanContext& vulkanContext, const RenderTarget& target, VkCommandBuffer commandBuffer, uint32_t swapImageIndex, uint32_t frameIndex);
+
+    // Copies the accumulation image (running RGBA sums, row-major) to the host. Submits and waits, so call it
+    // between frames.
+    void readAccumulation(VulkanContext& vulkanContext, std::vector<glm::vec4>& out);
+
+    // Replaces the accumulation with running sums from a checkpoint, sized like the accumulation image. The next
+    // frame adds to them unless its index is 0 or a setting changes, so apply settings before calling this.
+    void writeAccumulation(VulkanContext& vulkanContext, const std::vector<glm::vec4>& sums);
+
+    // Records a copy of the accumulation image into a host-visible buffer after this frame's dispatch, made
+    // visible to host reads once the submission completes.
+    void recordAccumulationCopy(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) const;
+
+    // Records a copy of running sums from buffer, such as ones saved by recordAccumulationCopy, over the
+    // accumulation image. The next render adds to them instead of clearing, so record it after this frame's
+    // settings changes; completedSamples is what the sums hold.
+    void recordAccumulationRestore(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t completedSamples);
+
+    // Whether the accumulation image holds samples, possibly for settings changed since; false after create and resize.
+    bool hasAccumulation() const
+    {
+        return mAccumInitialized;
+    }
+
+    VkExtent2D accumulationExtent() const
+    {
+        return { mWidth, mHeight };
+    }
+
+    VkDeviceSize accumulationBytes() const
+    {
+        return static_cast<VkDeviceSize>(mWidth) * mHeight * sizeof(glm::vec4);
+    }
 
 private:
-    void buildScene();
     void createPipeline(VulkanContext& vulkanContext);
-    void createDescriptors(VulkanContext& vulkanContext, Swapchain& swapchain);
+    void createDescriptors(VulkanContext& vulkanContext, const RenderTarget& target);
     void createAccumulationImage(VulkanContext& vulkanContext, const VkExtent2D& extent);
+    void destroyAccumulationImage(VulkanContext& vulkanContext);
+    void createDisplayImage(VulkanContext& vulkanContext, const RenderTarget& target);
+    void destroyDisplayImage(VulkanContext& vulkanContext);
+    void cancelDefragmentation(VulkanContext& vulkanContext);
+    void applyDefragmentationMoves(VulkanContext& vulkanContext, VmaDefragmentationPassMoveInfo& pass);
+    void updateSharedDescriptors(VulkanContext& vulkanContext);
+    void createCostPipelines(VulkanContext& vulkanContext);
+    void createCostResources(VulkanContext& vulkanContext);
+    void destroyCostResources(VulkanContext& vulkanContext);
+    void destroyCostPipelines(VulkanContext& vulkanContext);
+    void readCostStats(VulkanContext& vulkanContext, uint32_t swapImageIndex);
+    void recordCostPasses(VkCommandBuffer commandBuffer, const VkExtent2D& extent, uint32_t swapImageIndex);
+    void destroyParamsBuffers(VulkanContext& vulkanContext);
+    void createTimestampQueries(VulkanContext& vulkanContext, uint32_t imageCount);
+    void destroyTimestampQueries(VulkanContext& vulkanContext);
+    void createRayCounters(VulkanContext& vulkanContext, uint32_t imageCount);
+    void destroyRayCounters(VulkanContext& vulkanContext);
     void uploadScene(VulkanContext& vulkanContext);
-    void updateParams(VulkanContext& vulkanContext, const VkExtent2D& extent, uint32_t frameIndex, uint32_t swapImageIndex);
-    GPUParams makeCameraParams(const VkExtent2D& extent) const;
+
+    // Tiles of one render, row-major over the image; a single tile covering the image when not bounded.
+    struct DispatchPlan
+    {
+        VkExtent2D tile{ 0, 0 };
+        uint32_t tilesX = 1;
+        uint32_t firstTile = 0;
+        uint32_t tileCount = 1;
+        uint32_t samples = 1;
+        uint32_t frameIndex = 0;
+        uint64_t firstSample = 0; // Global index of the first sample, the key of its random numbers.
+    };
+
+    DispatchPlan planDispatch(const VkExtent2D& extent, uint32_t frameIndex, bool clearAccum, bool costView);
+    void updateParams(VulkanContext& vulkanContext, const VkExtent2D& extent, const DispatchPlan& plan, uint32_t swapImageIndex);
 
     VkDescriptorSetLayout mSetLayout = VK_NULL_HANDLE;
     VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
@@ -69,6 +293,14 @@ private:
     VkImageView mAccumView = VK_NULL_HANDLE;
     VmaAllocation mAccumAlloc = VK_NULL_HANDLE;
 
+    // Output of presentable targets, copied whole to the swapchain image each render. A swapchain image keeps an
+    // older frame and its overlay, so tiles a bounded render skips must come from here instead.
+    VkImage mDisplayImage = VK_NULL_HANDLE;
+    VkImageView mDisplayView = VK_NULL_HANDLE;
+    VmaAllocation mDisplayAlloc = VK_NULL_HANDLE;
+    bool mDisplayInitialized = false;
+    bool mTilesAllowed = true; // Whether a render may trace part of the image and leave the rest to earlier ones.
+
     VkBuffer mSphereBuffer = VK_NULL_HANDLE;
     VmaAllocation mSphereAlloc = VK_NULL_HANDLE;
 
@@ -76,19 +308,75 @@ private:
     std::vector<VmaAllocation> mParamsAllocs;
     std::vector<void*> mParamsMapped;
 
+    // Two timestamps per swapchain image, read back the next time that image is rendered.
+    VkQueryPool mTimestampPool = VK_NULL_HANDLE;
+    std::vector<bool> mTimestampPending;
+    double mTimestampPeriodNs = 0.0;
+    uint64_t mTimestampMask = 0;
+    double mLastGpuSeconds = 0.0;
+
+    // Bounded dispatch. A pass traces every tile once under one frame index, over as many renders as it takes.
+    double mDispatchBudget = 0.0;
+    double mSecondsPerPixelSample = 0.0; // Smoothed.
+    std::vector<uint64_t> mSlotPixelSamples; // Pixel samples of each image's last render, to price its timestamps.
+    VkExtent2D mTileExtent{ 0, 0 };
+    uint32_t mTileCursor = 0; // Next tile of the pass, 0 between passes.
+    uint32_t mPassFrame = 0;
+    uint32_t mPassSamples = 0; // Fewest samples any tile of the pass got so far.
+    uint64_t mPassFirstSample = 0;
+    bool mRunningSampleKey = false; // Set by setSampleBase.
+    uint64_t mSampleBase = 0; // First sample of the next pass when mRunningSampleKey.
+    uint32_t mCompletedSamples = 0;
+    uint64_t mLastPixelSamples = 0;
+
+    // One counter slot per swapchain image, reset before the dispatch and read back alongside the timestamps.
+    VkBuffer mCounterBuffer = VK_NULL_HANDLE;
+    VmaAllocation mCounterAlloc = VK_NULL_HANDLE;
+    void* mCounterMapped = nullptr;
+    VkDeviceSize mCounterStride = 0;
+    std::vector<bool> mCounterPending;
+    RayCounts mLastRayCounts;
+
+    // Cost heatmap view.
+    ViewMode mViewMode = ViewMode::Color;
+    VkPipeline mCostTracePipeline = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mCostSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout mCostPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mCostReducePipeline = VK_NULL_HANDLE;
+    VkPipeline mCostDisplayPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool mCostDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> mCostDescriptorSets;
+    VkImage mCostImage = VK_NULL_HANDLE;
+    VkImageView mCostView = VK_NULL_HANDLE;
+    VmaAllocation mCostAlloc = VK_NULL_HANDLE;
+    VkBuffer mCostStatsBuffer = VK_NULL_HANDLE; // One stride per swapchain image, host-readable.
+    VmaAllocation mCostStatsAlloc = VK_NULL_HANDLE;
+    void* mCostStatsMapped = nullptr;
+    VkDeviceSize mCostStatsStride = 0;
+    std::vector<bool> mCostStatsPending;
+    std::vector<VkImageView> mOutputViews;
+    CostStats mCostStats;
+
+    VmaDefragmentationContext mDefragContext = VK_NULL_HANDLE;
+    uint32_t mDefragPool = 0;
+    uint64_t mDefragBytesMoved = 0;
+
     uint32_t mWidth = 0;
     uint32_t mHeight = 0;
     bool mResetAccum = true;
     bool mAccumInitialized = false;
-    std::vector<bool> mSwapchainImageInitialized;
+    std::vector<bool> mOutputImageInitialized;
 
     std::vector<GPUSphere> mSpheres;
+    uint64_t mSceneVersion = 0;
 
     glm::vec3 mCamPos{ 13.0f, 2.0f, 3.0f };
     glm::vec3 mCamDir{ -1.0f, 0.0f, 0.0f };
     float mAperture = 0.05f;
     float mVerticalFov = 20.0f;
     float mFocusDistance = 10.0f;
+    VkExtent2D mViewFullExtent{ 0, 0 };
+    VkOffset2D mViewOffset{ 0, 0 };
     uint32_t mSamplesPerPixel = 4;
     uint32_t mMaxDepth = 12;
 };
\ No newline at end of file
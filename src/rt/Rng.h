@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// CPU twin of shaders/rng.glsl: Philox4x32-10 keyed on the full-image pixel, with the counter made of the
+// global sample index and the dimension. Any sample of any pixel can be regenerated on its own, bit-identical
+// to the kernel's, so renders split across frames, tiles or processes draw the same numbers as one render.
+inline glm::uvec4 philox4x32(glm::uvec4 counter, glm::uvec2 key)
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        const uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter.x;
+        const uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter.z;
+        counter = { static_cast<uint32_t>(product1 >> 32) ^ counter.y ^ key.x, static_cast<uint32_t>(product1),
+            static_cast<uint32_t>(product0 >> 32) ^ counter.w ^ key.y, static_cast<uint32_t>(product0) };
+        key += glm::uvec2(0x9E3779B9u, 0xBB67AE85u);
+    }
+
+    return counter;
+}
+
+class SampleRng
+{
+public:
+    SampleRng(glm::uvec2 pixel, uint64_t sampleIndex) : mKey(pixel), mSampleIndex(sampleIndex)
+    {
+        refill();
+    }
+
+    // Jumps to a dimension; draws need not be sequential.
+    void seek(uint32_t dimension)
+    {
+        mDimension = dimension;
+    }
+
+    // Uniform in [0, 1) with 24 bits.
+    float next()
+    {
+        if ((mDimension >> 2) != mBlockIndex)
+        {
+            refill();
+        }
+
+        const uint32_t bits = mBlock[mDimension & 3u];
+        ++mDimension;
+
+        return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    glm::vec2 next2()
+    {
+        const float x = next();
+
+        return { x, next() };
+    }
+
+private:
+    void refill()
+    {
+        mBlockIndex = mDimension >> 2;
+        mBlock = philox4x32({ static_cast<uint32_t>(mSampleIndex), static_cast<uint32_t>(mSampleIndex >> 32), mBlockIndex, 0u }, mKey);
+    }
+
+    glm::uvec2 mKey;
+    uint64_t mSampleIndex = 0;
+    uint32_t mDimension = 0;
+    uint32_t mBlockIndex = 0;
+    glm::uvec4 mBlock{};
+};
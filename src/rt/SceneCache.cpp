@@ -0,0 +1,137 @@
+#include "SceneCache.h"
+
+#include "../util/Hash.h"
+#include "../util/Json.h"
+
+#include <stdexcept>
+
+namespace
+{
+    glm::vec3 readVec3(const JsonValue& value, const char* name)
+    {
+        const std::vector<JsonValue>& items = value.items();
+
+        if (items.size() != 3)
+        {
+            throw std::runtime_error(std::string("Scene: ") + name + " needs three numbers");
+        }
+
+        return { static_cast<float>(items[0].asNumber()), static_cast<float>(items[1].asNumber()), static_cast<float>(items[2].asNumber()) };
+    }
+
+    SphereMaterial readMaterial(const std::string& name)
+    {
+        if (name == "lambert")
+        {
+            return SphereMaterial::Lambert;
+        }
+        if (name == "metal")
+        {
+            return SphereMaterial::Metal;
+        }
+        if (name == "dielectric")
+        {
+            return SphereMaterial::Dielectric;
+        }
+
+        throw std::runtime_error("Scene: unknown material " + name);
+    }
+}
+
+std::vector<GPUSphere> parseScene(const JsonValue& scene)
+{
+    std::vector<GPUSphere> spheres;
+
+    for (const JsonValue& sphere : scene["spheres"].items())
+    {
+        const glm::vec3 center = readVec3(sphere["center"], "center");
+        const float radius = static_cast<float>(sphere["radius"].asNumber());
+        const glm::vec3 albedo = sphere.has("albedo") ? readVec3(sphere["albedo"], "albedo") : glm::vec3(0.8f);
+
+        spheres.push_back(packSphere(center, radius, albedo, readMaterial(sphere.stringOr("material", "lambert")),
+            static_cast<float>(sphere.numberOr("fuzz", 0.0)), static_cast<float>(sphere.numberOr("ior", 1.0)), sphere.boolOr("checker", false)));
+    }
+
+    if (spheres.empty())
+    {
+        throw std::runtime_error("Scene: no spheres");
+    }
+
+    return spheres;
+}
+
+SceneCache::Scene SceneCache::get(const std::string& description, uint64_t& key)
+{
+    key = hashBytes(description.data(), description.size());
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (Scene scene = findLocked(key))
+        {
+            ++mHits;
+
+            return scene;
+        }
+
+        ++mMisses;
+    }
+
+    // Parse outside the lock; a concurrent miss on the same scene just parses it twice.
+    Scene scene = std::make_shared<const std::vector<GPUSphere>>(parseScene(JsonValue::parse(description)));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    insertLocked(key, scene);
+
+    return scene;
+}
+
+size_t SceneCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mHits;
+}
+
+size_t SceneCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mMisses;
+}
+
+SceneCache::Scene SceneCache::findLocked(uint64_t key)
+{
+    auto found = mIndex.find(key);
+
+    if (found == mIndex.end())
+    {
+        return nullptr;
+    }
+
+    mEntries.splice(mEntries.begin(), mEntries, found->second);
+
+    return found->second->scene;
+}
+
+void SceneCache::insertLocked(uint64_t key, Scene scene)
+{
+    auto found = mIndex.find(key);
+
+    if (found != mIndex.end())
+    {
+        found->second->scene = std::move(scene);
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+
+        return;
+    }
+
+    mEntries.push_front({ key, std::move(scene) });
+    mIndex[key] = mEntries.begin();
+
+    while (mEntries.size() > mCapacity)
+    {
+        mIndex.erase(mEntries.back().key);
+        mEntries.pop_back();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RayTracer.h"
+
+class JsonValue;
+
+// Scene description:
+//
+//     { "spheres": [ { "center": [x, y, z], "radius": r, "albedo": [r, g, b],
+//                      "material": "lambert" | "metal" | "dielectric", "fuzz": f, "ior": n, "checker": bool }, ... ] }
+//
+// Only center and radius are required. Throws std::runtime_error on malformed input.
+std::vector<GPUSphere> parseScene(const JsonValue& scene);
+
+// Recently used scenes, packed for upload and keyed by a hash of their description text, so repeated jobs skip
+// parsing and identical scenes are recognized whatever their source. Thread-safe.
+class SceneCache
+{
+public:
+    using Scene = std::shared_ptr<const std::vector<GPUSphere>>;
+
+    explicit SceneCache(size_t capacity = 16) : mCapacity(capacity) {}
+
+    // Returns the scene for a description, parsing it on a miss; key receives its content hash.
+    Scene get(const std::string& description, uint64_t& key);
+
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    Scene findLocked(uint64_t key);
+    void insertLocked(uint64_t key, Scene scene);
+
+    struct Entry
+    {
+        uint64_t key = 0;
+        Scene scene;
+    };
+
+    size_t mCapacity = 0;
+    std::list<Entry> mEntries; // Most recently used first.
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> mIndex;
+    mutable std::mutex mMutex;
+    size_t mHits = 0;
+    size_t mMisses = 0;
+};
@@ -0,0 +1,252 @@
+#include "ShaderLibrary.h"
+
+#include "../util/Logger.h"
+#include "../util/Env.h"
+
+#ifndef VRAYT_SHADERC
+#define VRAYT_SHADERC 0
+#endif
+
+#if VRAYT_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+#include <fstream>
+#include <stdexcept>
+#include <iterator>
+#include <memory>
+
+namespace
+{
+    // Generated by shaders/embed_shaders.cmd (glslc -mfmt=num), keep in sync with that script and with the
+    // regression suite's CMake build.
+    constexpr uint32_t kRaytraceComp[] =
+    {
+#include "raytrace.comp.inc"
+    };
+
+    constexpr uint32_t kRaytraceCostComp[] =
+    {
+#include "raytrace_cost.comp.inc"
+    };
+
+    constexpr uint32_t kCostReduceComp[] =
+    {
+#include "cost_reduce.comp.inc"
+    };
+
+    constexpr uint32_t kCostDisplayComp[] =
+    {
+#include "cost_display.comp.inc"
+    };
+
+    constexpr uint32_t kRngKatComp[] =
+    {
+#include "rng_kat.comp.inc"
+    };
+
+    bool fileExists(const std::string& path)
+    {
+        std::ifstream inputStream(path, std::ios::binary);
+
+        return static_cast<bool>(inputStream);
+    }
+
+#if VRAYT_SHADERC
+    // Reads an entire text file into a std::string.
+    std::string readFileText(const std::string& path)
+    {
+        std::ifstream inputStream(path, std::ios::binary);
+
+        if (!inputStream)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        return std::string((std::istreambuf_iterator<char>(inputStream)), std::istreambuf_iterator<char>());
+    }
+
+    // Resolves #include "file" relative to the including file, matching glslc.
+    class FileIncluder : public shaderc::CompileOptions::IncluderInterface
+    {
+    public:
+        shaderc_include_result* GetInclude(const char* requested, shaderc_include_type, const char* requesting, size_t) override
+        {
+            auto* include = new Include();
+            std::string base = requesting;
+            size_t slash = base.find_last_of("/\\");
+            include->name = (slash == std::string::npos ? std::string() : base.substr(0, slash + 1)) + requested;
+
+            if (fileExists(include->name))
+            {
+                include->content = readFileText(include->name);
+            }
+            else
+            {
+                // An empty name reports the content as the error message.
+                include->content = "Cannot open include " + include->name;
+                include->name.clear();
+            }
+
+            include->result.source_name = include->name.c_str();
+            include->result.source_name_length = include->name.size();
+            include->result.content = include->content.c_str();
+            include->result.content_length = include->content.size();
+            include->result.user_data = include;
+
+            return &include->result;
+        }
+
+        void ReleaseInclude(shaderc_include_result* result) override
+        {
+            delete static_cast<Include*>(result->user_data);
+        }
+
+    private:
+        struct Include
+        {
+            std::string name;
+            std::string content;
+            shaderc_include_result result{};
+        };
+    };
+
+    std::vector<uint32_t> compileGlsl(const shaders::Variant& variant, const std::string& path)
+    {
+        auto source = readFileText(path);
+
+        shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+        options.SetIncluder(std::make_unique<FileIncluder>());
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+        std::string defines = variant.defines;
+        size_t start = 0;
+
+        while (start < defines.size())
+        {
+            size_t end = defines.find(' ', start);
+            end = end == std::string::npos ? defines.size() : end;
+            std::string define = defines.substr(start, end - start);
+            size_t equals = define.find('=');
+
+            if (!define.empty())
+            {
+                if (equals == std::string::npos)
+                {
+                    options.AddMacroDefinition(define);
+                }
+                else
+                {
+                    options.AddMacroDefinition(define.substr(0, equals), define.substr(equals + 1));
+                }
+            }
+
+            start = end + 1;
+        }
+
+        auto result = compiler.CompileGlslToSpv(source, shaderc_compute_shader, path.c_str(), options);
+
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+        {
+            throw std::runtime_error(result.GetErrorMessage());
+        }
+
+        return std::vector<uint32_t>(result.cbegin(), result.cend());
+    }
+#endif
+}
+
+namespace shaders
+{
+    const std::vector<Variant>& variants()
+    {
+        static const std::vector<Variant> table =
+        {
+            { "raytrace", "raytrace.comp.glsl", "", kRaytraceComp, std::size(kRaytraceComp) },
+            { "raytrace_cost", "raytrace.comp.glsl", "VRAYT_COST_HEATMAP=1", kRaytraceCostComp, std::size(kRaytraceCostComp) },
+            { "cost_reduce", "cost_reduce.comp.glsl", "", kCostReduceComp, std::size(kCostReduceComp) },
+            { "cost_display", "cost_display.comp.glsl", "", kCostDisplayComp, std::size(kCostDisplayComp) },
+            { "rng_kat", "rng_kat.comp.glsl", "", kRngKatComp, std::size(kRngKatComp) },
+        };
+
+        return table;
+    }
+
+    std::vector<uint32_t> loadSpirv(const std::string& name)
+    {
+        const Variant* variant = nullptr;
+
+        for (const auto& candidate : variants())
+        {
+            if (name == candidate.name)
+            {
+                variant = &candidate;
+                break;
+            }
+        }
+
+        if (!variant)
+        {
+            throw std::runtime_error("Unknown shader variant: " + name);
+        }
+
+        // Development override: prebuilt SPIR-V, or GLSL when runtime compilation is compiled in.
+        std::string overrideDir = readEnv("VRAYT_SHADER_DIR");
+
+        if (!overrideDir.empty())
+        {
+            std::string spvPath = overrideDir + "/" + variant->name + ".spv";
+
+            if (fileExists(spvPath))
+            {
+                logger::info("Shader '%s' loaded from %s", variant->name, spvPath.c_str());
+
+                return readSpirvFile(spvPath);
+            }
+
+#if VRAYT_SHADERC
+            std::string glslPath = overrideDir + "/" + variant->source;
+
+            if (fileExists(glslPath))
+            {
+                logger::info("Shader '%s' compiled from %s", variant->name, glslPath.c_str());
+
+                return compileGlsl(*variant, glslPath);
+            }
+#endif
+
+            logger::warn("VRAYT_SHADER_DIR has no override for '%s', using embedded SPIR-V.", variant->name);
+        }
+
+        return std::vector<uint32_t>(variant->code, variant->code + variant->wordCount);
+    }
+
+    std::vector<uint32_t> readSpirvFile(const std::string& path)
+    {
+        std::ifstream inputStream(path, std::ios::binary | std::ios::ate);
+
+        if (!inputStream)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        const std::streamsize size = inputStream.tellg();
+        if (size <= 0 || (size % 4) != 0)
+        {
+            throw std::runtime_error("Invalid SPIR-V file size: " + path);
+        }
+
+        std::vector<uint32_t> data(static_cast<size_t>(size) / 4);
+        inputStream.seekg(0);
+        inputStream.read(reinterpret_cast<char*>(data.data()), size);
+
+        if (!inputStream)
+        {
+            throw std::runtime_error("Failed to read file: " + path);
+        }
+
+        return data;
+    }
+}
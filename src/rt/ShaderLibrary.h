@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace shaders
+{
+    // Compute kernel variant compiled by shaders/embed_shaders.cmd.
+    struct Variant
+    {
+        const char* name; // Variant name, also the file stem of a development override.
+        const char* source; // GLSL source under shaders/.
+        const char* defines; // Space separated NAME=VALUE defines, empty for the base kernel.
+        const uint32_t* code; // Embedded SPIR-V words.
+        size_t wordCount;
+    };
+
+    // All embedded variants, in build order.
+    const std::vector<Variant>& variants();
+
+    // Returns SPIR-V for a variant. A module found in VRAYT_SHADER_DIR overrides the embedded one.
+    std::vector<uint32_t> loadSpirv(const std::string& name);
+
+    // Reads a SPIR-V binary from disk.
+    std::vector<uint32_t> readSpirvFile(const std::string& path);
+}
@@ -0,0 +1,241 @@
+#include "Checkpoint.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace
+{
+    const char checkpointMagic[8] = { 'V', 'R', 'A', 'Y', 'T', 'C', 'K', 'P' };
+    const uint32_t checkpointVersion = 3; // 2 added samplesPerFrame, 3 the merged frame ranges after the sums.
+
+    struct CheckpointHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t sources;
+        uint64_t sceneHash;
+        uint64_t settingsHash;
+        uint64_t firstFrame;
+        uint64_t nextFrame;
+        uint64_t samplesPerPixel;
+        uint64_t samplesPerFrame; // Version 2.
+    };
+
+    const size_t headerBytesV1 = offsetof(CheckpointHeader, samplesPerFrame);
+
+    static_assert(sizeof(CheckpointHeader) == 72, "Checkpoint header layout is part of the file format");
+    static_assert(sizeof(FrameRange) == 16, "Frame ranges are stored as written");
+}
+
+void writeCheckpoint(const std::string& path, const Checkpoint& checkpoint)
+{
+    const size_t pixelBytes = checkpoint.sums.size() * sizeof(glm::vec4);
+    const uint64_t rangeCount = checkpoint.mergedRanges.size();
+    const size_t rangeBytes = sizeof(rangeCount) + checkpoint.mergedRanges.size() * sizeof(FrameRange);
+
+    if (checkpoint.sums.size() != static_cast<size_t>(checkpoint.width) * checkpoint.height)
+    {
+        throw std::runtime_error("Checkpoint sums do not match " + std::to_string(checkpoint.width) + "x" + std::to_string(checkpoint.height));
+    }
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = checkpointVersion;
+    header.width = checkpoint.width;
+    header.height = checkpoint.height;
+    header.sources = checkpoint.sources;
+    header.sceneHash = checkpoint.sceneHash;
+    header.settingsHash = checkpoint.settingsHash;
+    header.firstFrame = checkpoint.firstFrame;
+    header.nextFrame = checkpoint.nextFrame;
+    header.samplesPerPixel = checkpoint.samplesPerPixel;
+    header.samplesPerFrame = checkpoint.samplesPerFrame;
+
+    const std::string temporaryPath = path + ".tmp";
+
+    {
+        MappedFile file;
+        file.create(temporaryPath, sizeof(header) + pixelBytes + rangeBytes);
+        uint8_t* cursor = file.data();
+        std::memcpy(cursor, &header, sizeof(header));
+        cursor += sizeof(header);
+        std::memcpy(cursor, checkpoint.sums.data(), pixelBytes);
+        cursor += pixelBytes;
+        std::memcpy(cursor, &rangeCount, sizeof(rangeCount));
+        cursor += sizeof(rangeCount);
+        std::memcpy(cursor, checkpoint.mergedRanges.data(), checkpoint.mergedRanges.size() * sizeof(FrameRange));
+        file.close();
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+}
+
+Checkpoint readCheckpoint(const std::string& path)
+{
+    MappedFile file;
+    file.openRead(path);
+
+    CheckpointHeader header{};
+
+    if (file.size() < headerBytesV1)
+    {
+        throw std::runtime_error(path + " is not a checkpoint");
+    }
+
+    std::memcpy(&header, file.data(), headerBytesV1);
+
+    if (std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0)
+    {
+        throw std::runtime_error(path + " is not a checkpoint");
+    }
+    if (header.version < 1 || header.version > checkpointVersion)
+    {
+        throw std::runtime_error(path + " has unsupported checkpoint version " + std::to_string(header.version));
+    }
+
+    const size_t headerBytes = header.version == 1 ? headerBytesV1 : sizeof(header);
+
+    if (header.version == 1)
+    {
+        // A single run rendered every frame of its range at the same samples per frame; a merged one may not have.
+        const uint64_t frames = header.nextFrame - header.firstFrame;
+        const bool derivable = header.sources == 1 && header.nextFrame > header.firstFrame && header.samplesPerPixel % frames == 0;
+        header.samplesPerFrame = derivable ? header.samplesPerPixel / frames : 0;
+    }
+    else if (file.size() < sizeof(header))
+    {
+        throw std::runtime_error(path + " is truncated");
+    }
+    else
+    {
+        std::memcpy(&header, file.data(), sizeof(header));
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.width = header.width;
+    checkpoint.height = header.height;
+    checkpoint.sources = header.sources;
+    checkpoint.sceneHash = header.sceneHash;
+    checkpoint.settingsHash = header.settingsHash;
+    checkpoint.firstFrame = header.firstFrame;
+    checkpoint.nextFrame = header.nextFrame;
+    checkpoint.samplesPerPixel = header.samplesPerPixel;
+    checkpoint.samplesPerFrame = header.samplesPerFrame;
+
+    const size_t pixels = static_cast<size_t>(header.width) * header.height;
+    const size_t rangesOffset = headerBytes + pixels * sizeof(glm::vec4);
+    uint64_t rangeCount = 0;
+
+    if (header.version >= 3)
+    {
+        if (file.size() < rangesOffset + sizeof(rangeCount))
+        {
+            throw std::runtime_error(path + " is truncated");
+        }
+
+        std::memcpy(&rangeCount, file.data() + rangesOffset, sizeof(rangeCount));
+    }
+
+    const size_t expectedBytes = header.version >= 3 ? rangesOffset + sizeof(rangeCount) + rangeCount * sizeof(FrameRange) : rangesOffset;
+
+    if (rangeCount > file.size() || file.size() != expectedBytes)
+    {
+        throw std::runtime_error(path + " is truncated");
+    }
+
+    checkpoint.sums.resize(pixels);
+    std::memcpy(checkpoint.sums.data(), file.data() + headerBytes, pixels * sizeof(glm::vec4));
+    checkpoint.mergedRanges.resize(static_cast<size_t>(rangeCount));
+    std::memcpy(checkpoint.mergedRanges.data(), file.data() + rangesOffset + sizeof(rangeCount), checkpoint.mergedRanges.size() * sizeof(FrameRange));
+
+    return checkpoint;
+}
+
+std::vector<FrameRange> frameRanges(const Checkpoint& checkpoint)
+{
+    if (!checkpoint.mergedRanges.empty())
+    {
+        return checkpoint.mergedRanges;
+    }
+    if (checkpoint.nextFrame > checkpoint.firstFrame)
+    {
+        return { { checkpoint.firstFrame, checkpoint.nextFrame } };
+    }
+
+    return {};
+}
+
+bool mergeCheckpoint(Checkpoint& into, const Checkpoint& other)
+{
+    if (into.width != other.width || into.height != other.height)
+    {
+        throw std::runtime_error("Checkpoints differ in size: " + std::to_string(into.width) + "x" + std::to_string(into.height) + " and " +
+            std::to_string(other.width) + "x" + std::to_string(other.height));
+    }
+    if (into.sceneHash != other.sceneHash || into.settingsHash != other.settingsHash)
+    {
+        throw std::runtime_error("Checkpoints were rendered from different scenes or settings");
+    }
+    if (into.samplesPerFrame == 0 || into.samplesPerFrame != other.samplesPerFrame)
+    {
+        throw std::runtime_error("Checkpoints differ in samples per frame (" + std::to_string(into.samplesPerFrame) + " and " +
+            std::to_string(other.samplesPerFrame) + ", 0 if unknown), so their frame indices do not name the same samples");
+    }
+
+    // Every range against every range, not the outer spans: pieces of one render arrive in any order, and a
+    // piece between two merged ones overlaps neither.
+    std::vector<FrameRange> ranges = frameRanges(into);
+    const std::vector<FrameRange> otherRanges = frameRanges(other);
+    bool disjoint = true;
+
+    for (const FrameRange& a : ranges)
+    {
+        for (const FrameRange& b : otherRanges)
+        {
+            disjoint = disjoint && (b.next <= a.first || a.next <= b.first);
+        }
+    }
+
+    ranges.insert(ranges.end(), otherRanges.begin(), otherRanges.end());
+    std::sort(ranges.begin(), ranges.end(), [](const FrameRange& a, const FrameRange& b)
+    {
+        return a.first < b.first;
+    });
+
+    into.mergedRanges.clear();
+
+    for (const FrameRange& range : ranges)
+    {
+        if (!into.mergedRanges.empty() && range.first <= into.mergedRanges.back().next)
+        {
+            into.mergedRanges.back().next = std::max(into.mergedRanges.back().next, range.next);
+        }
+        else
+        {
+            into.mergedRanges.push_back(range);
+        }
+    }
+
+    // The sums carry their sample counts, so adding them weights each run by its samples.
+    for (size_t i = 0; i < into.sums.size(); ++i)
+    {
+        into.sums[i] += other.sums[i];
+    }
+
+    if (!into.mergedRanges.empty())
+    {
+        into.firstFrame = into.mergedRanges.front().first;
+        into.nextFrame = into.mergedRanges.back().next;
+    }
+
+    into.samplesPerPixel += other.samplesPerPixel;
+    into.sources += other.sources;
+
+    return disjoint;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Frame indices [first, next).
+struct FrameRange
+{
+    uint64_t first = 0;
+    uint64_t next = 0;
+};
+
+// Saved accumulation: per-pixel running sums (alpha holds the sample count) plus what they were rendered from.
+// Sums of runs with the same scene and settings add up to a run with all their samples, which is what resume
+// and merge rely on.
+struct Checkpoint
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t sceneHash = 0;
+    uint64_t settingsHash = 0;
+    uint64_t firstFrame = 0; // Frame indices [firstFrame, nextFrame) went into the sums.
+    uint64_t nextFrame = 0;
+    uint64_t samplesPerPixel = 0;
+    uint64_t samplesPerFrame = 0; // Frame f used sample indices [f, f + 1) * samplesPerFrame; 0 if unknown.
+    uint32_t sources = 1; // Runs merged into this one.
+    std::vector<FrameRange> mergedRanges; // Sorted and disjoint once merged; empty for a single run's range.
+    std::vector<glm::vec4> sums;
+};
+
+// The frame ranges that went into the sums, sorted and disjoint; empty when none did.
+std::vector<FrameRange> frameRanges(const Checkpoint& checkpoint);
+
+// Written through a mapped temporary file that replaces path once complete, so an interrupted write leaves the
+// previous checkpoint intact. Throws on I/O errors. Version 1 files, which predate samplesPerFrame, get it from
+// their frame range when they hold a single run.
+void writeCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+Checkpoint readCheckpoint(const std::string& path);
+
+// Adds other's samples to into. Throws when the size, scene, settings or samples per frame differ: frame indices
+// only name the same samples at the same samples per frame. Returns false when any frame range of other overlaps
+// one merged into into so far: both then used the same random streams and the merge gains less than its sample
+// count. into keeps every range, so pieces may arrive in any order.
+bool mergeCheckpoint(Checkpoint& into, const Checkpoint& other);
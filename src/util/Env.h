@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <cstdlib>
+
+// Returns the value of an environment variable, or an empty string when it is not set.
+inline std::string readEnv(const char* name)
+{
+#if defined(_WIN32)
+    char* value = nullptr;
+    size_t length = 0;
+
+    if (_dupenv_s(&value, &length, name) != 0 || !value)
+    {
+        return {};
+    }
+
+    std::string result(value);
+    std::free(value);
+
+    return result;
+#else
+    const char* value = std::getenv(name);
+
+    return value ? std::string(value) : std::string();
+#endif
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a. Chain calls by passing the previous result as the seed.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 1469598103934665603ull)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t seed = 1469598103934665603ull)
+{
+    return hashBytes(&value, sizeof(T), seed);
+}
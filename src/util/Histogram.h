@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Log-linear (HDR-style) histogram of non-negative integers. Every power-of-two range is split into
+// 2^(subBucketBits - 1) linear buckets, so any recorded value is reproduced within a relative error of
+// 2^-(subBucketBits - 1) (under 1.6% with the default 7 bits) while the full 64-bit range costs ~30 KiB.
+// Record values in the finest unit you need (e.g. microseconds).
+class Histogram
+{
+public:
+    explicit Histogram(uint32_t subBucketBits = 7)
+        : mSubBucketBits(subBucketBits),
+          mSubBucketCount(1ull << subBucketBits),
+          mHalfCount(1ull << (subBucketBits - 1))
+    {
+        mCounts.assign(static_cast<size_t>(mSubBucketCount + (64 - subBucketBits) * mHalfCount), 0);
+    }
+
+    void record(uint64_t value, uint64_t count = 1)
+    {
+        mCounts[indexOf(value)] += count;
+        mTotal += count;
+        mSum += static_cast<double>(value) * static_cast<double>(count);
+        mMin = std::min(mMin, value);
+        mMax = std::max(mMax, value);
+    }
+
+    void reset()
+    {
+        std::fill(mCounts.begin(), mCounts.end(), 0);
+        mTotal = 0;
+        mSum = 0.0;
+        mMin = std::numeric_limits<uint64_t>::max();
+        mMax = 0;
+    }
+
+    // Smallest recorded value such that at least `percentile` percent of the samples are at or below it.
+    uint64_t valueAtPercentile(double percentile) const
+    {
+        if (mTotal == 0)
+        {
+            return 0;
+        }
+
+        const double clamped = std::clamp(percentile, 0.0, 100.0);
+        const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(mTotal) + 0.5));
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < mCounts.size(); ++i)
+        {
+            seen += mCounts[i];
+
+            if (seen >= target)
+            {
+                return std::clamp(highestEquivalent(i), mMin, mMax);
+            }
+        }
+
+        return mMax;
+    }
+
+    uint64_t count() const
+    {
+        return mTotal;
+    }
+
+    double sum() const
+    {
+        return mSum;
+    }
+
+    double mean() const
+    {
+        return mTotal ? mSum / static_cast<double>(mTotal) : 0.0;
+    }
+
+    uint64_t min() const
+    {
+        return mTotal ? mMin : 0;
+    }
+
+    uint64_t max() const
+    {
+        return mMax;
+    }
+
+private:
+    size_t indexOf(uint64_t value) const
+    {
+        if (value < mSubBucketCount)
+        {
+            return static_cast<size_t>(value);
+        }
+
+        uint32_t highBit = 63;
+
+        while (!(value >> highBit))
+        {
+            --highBit;
+        }
+
+        const uint32_t shift = highBit - mSubBucketBits + 1;
+        const uint64_t subBucket = (value >> shift) - mHalfCount;
+
+        return static_cast<size_t>(mSubBucketCount + (shift - 1) * mHalfCount + subBucket);
+    }
+
+    uint64_t highestEquivalent(size_t index) const
+    {
+        if (index < mSubBucketCount)
+        {
+            return index;
+        }
+
+        const uint64_t offset = index - mSubBucketCount;
+        const uint32_t shift = static_cast<uint32_t>(offset / mHalfCount) + 1;
+        const uint64_t lowest = (mHalfCount + offset % mHalfCount) << shift;
+
+        return lowest + ((1ull << shift) - 1);
+    }
+
+    uint32_t mSubBucketBits;
+    uint64_t mSubBucketCount;
+    uint64_t mHalfCount;
+    std::vector<uint64_t> mCounts;
+    uint64_t mTotal = 0;
+    double mSum = 0.0;
+    uint64_t mMin = std::numeric_limits<uint64_t>::max();
+    uint64_t mMax = 0;
+};
@@ -0,0 +1,94 @@
+#include "Image.h"
+
+#include <fstream>
+#include <stdexcept>
+
+Image resolveAccumulation(const std::vector<glm::vec4>& accumulation, uint32_t width, uint32_t height)
+{
+    if (accumulation.size() != static_cast<size_t>(width) * height)
+    {
+        throw std::runtime_error("Accumulation size does not match " + std::to_string(width) + "x" + std::to_string(height));
+    }
+
+    return resolveAccumulation(accumulation.data(), width, height);
+}
+
+Image resolveAccumulation(const glm::vec4* accumulation, uint32_t width, uint32_t height)
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height);
+
+    for (size_t i = 0; i < image.pixels.size(); ++i)
+    {
+        const glm::vec4& sum = accumulation[i];
+        image.pixels[i] = sum.w > 0.0f ? glm::vec3(sum) / sum.w : glm::vec3(0.0f);
+    }
+
+    return image;
+}
+
+void writePfm(const std::string& path, const Image& image)
+{
+    std::ofstream outputStream(path, std::ios::binary | std::ios::trunc);
+
+    if (!outputStream)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+
+    // A negative scale marks little-endian data; PFM rows run bottom to top.
+    outputStream << "PF\n" << image.width << " " << image.height << "\n-1.0\n";
+
+    for (uint32_t row = image.height; row-- > 0;)
+    {
+        outputStream.write(reinterpret_cast<const char*>(&image.pixels[static_cast<size_t>(row) * image.width]),
+            static_cast<std::streamsize>(image.width * sizeof(glm::vec3)));
+    }
+
+    if (!outputStream)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+Image readPfm(const std::string& path)
+{
+    std::ifstream inputStream(path, std::ios::binary);
+
+    if (!inputStream)
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    std::string magic;
+    Image image;
+    float scale = 0.0f;
+    inputStream >> magic >> image.width >> image.height >> scale;
+    inputStream.get();
+
+    if (!inputStream || magic != "PF" || image.width == 0 || image.height == 0)
+    {
+        throw std::runtime_error(path + " is not an RGB PFM image");
+    }
+    if (scale > 0.0f)
+    {
+        throw std::runtime_error(path + " is big-endian, only little-endian PFM is supported");
+    }
+
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+
+    for (uint32_t row = image.height; row-- > 0;)
+    {
+        inputStream.read(reinterpret_cast<char*>(&image.pixels[static_cast<size_t>(row) * image.width]),
+            static_cast<std::streamsize>(image.width * sizeof(glm::vec3)));
+    }
+
+    if (!inputStream)
+    {
+        throw std::runtime_error(path + " is truncated");
+    }
+
+    return image;
+}
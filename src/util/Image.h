@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Linear RGB float image, row-major with the top row first.
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<glm::vec3> pixels;
+};
+
+// Divides accumulated radiance sums by their sample count (alpha); pixels without samples stay black.
+Image resolveAccumulation(const std::vector<glm::vec4>& accumulation, uint32_t width, uint32_t height);
+Image resolveAccumulation(const glm::vec4* accumulation, uint32_t width, uint32_t height);
+
+// Portable float map (PF, little endian). Throws on I/O or format errors.
+void writePfm(const std::string& path, const Image& image);
+Image readPfm(const std::string& path);
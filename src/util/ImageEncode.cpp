@@ -0,0 +1,329 @@
+#include "ImageEncode.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+    // Every format here is little-endian except the PNG framing, as are all supported hosts.
+    template <typename T>
+    void append(std::vector<uint8_t>& bytes, const T& value)
+    {
+        const size_t offset = bytes.size();
+        bytes.resize(offset + sizeof(T));
+        std::memcpy(bytes.data() + offset, &value, sizeof(T));
+    }
+
+    void appendString(std::vector<uint8_t>& bytes, const char* text)
+    {
+        bytes.insert(bytes.end(), text, text + std::strlen(text) + 1);
+    }
+
+    void appendBigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+    {
+        bytes.push_back(static_cast<uint8_t>(value >> 24));
+        bytes.push_back(static_cast<uint8_t>(value >> 16));
+        bytes.push_back(static_cast<uint8_t>(value >> 8));
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    void appendExrAttribute(std::vector<uint8_t>& bytes, const char* name, const char* type, const std::vector<uint8_t>& value)
+    {
+        appendString(bytes, name);
+        appendString(bytes, type);
+        append(bytes, static_cast<int32_t>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+
+    template <typename T>
+    std::vector<uint8_t> packed(std::initializer_list<T> values)
+    {
+        std::vector<uint8_t> bytes;
+
+        for (const T& value : values)
+        {
+            append(bytes, value);
+        }
+
+        return bytes;
+    }
+
+    const std::array<uint32_t, 256>& crcTable()
+    {
+        static const std::array<uint32_t, 256> table = []()
+        {
+            std::array<uint32_t, 256> result{};
+
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+
+                result[n] = c;
+            }
+
+            return result;
+        }();
+
+        return table;
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size)
+    {
+        const auto& table = crcTable();
+        uint32_t crc = 0xffffffffu;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+
+        return crc ^ 0xffffffffu;
+    }
+
+    uint32_t adler32(const uint8_t* data, size_t size)
+    {
+        // 5552 is the largest run that cannot overflow the 32-bit sums before the modulo.
+        uint32_t a = 1;
+        uint32_t b = 0;
+
+        while (size > 0)
+        {
+            const size_t run = std::min<size_t>(size, 5552);
+
+            for (size_t i = 0; i < run; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+
+            a %= 65521u;
+            b %= 65521u;
+            data += run;
+            size -= run;
+        }
+
+        return (b << 16) | a;
+    }
+
+    void appendPngChunk(std::vector<uint8_t>& bytes, const char* type, const std::vector<uint8_t>& data)
+    {
+        appendBigEndian(bytes, static_cast<uint32_t>(data.size()));
+        const size_t crcBegin = bytes.size();
+        bytes.insert(bytes.end(), type, type + 4);
+        bytes.insert(bytes.end(), data.begin(), data.end());
+        appendBigEndian(bytes, crc32(bytes.data() + crcBegin, bytes.size() - crcBegin));
+    }
+
+    uint8_t toSrgb8(float linear)
+    {
+        const float c = std::clamp(linear, 0.0f, 1.0f);
+        const float encoded = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+
+        return static_cast<uint8_t>(encoded * 255.0f + 0.5f);
+    }
+}
+
+const char* imageFormatExtension(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::Pfm: return "pfm";
+    case ImageFormat::ExrHalf: return "exr";
+    case ImageFormat::ExrFloat: return "exr";
+    case ImageFormat::Png: return "png";
+    }
+
+    return "bin";
+}
+
+std::string pfmHeader(uint32_t width, uint32_t height)
+{
+    // A negative scale marks little-endian data.
+    return "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+}
+
+std::vector<uint8_t> exrHeader(uint32_t width, uint32_t height, bool halfFloat)
+{
+    // Single-part scanline file, one line per block, no compression. Channels must be listed alphabetically.
+    const int32_t pixelType = halfFloat ? 1 : 2;
+    const int32_t maxX = static_cast<int32_t>(width) - 1;
+    const int32_t maxY = static_cast<int32_t>(height) - 1;
+
+    std::vector<uint8_t> channels;
+
+    for (const char* name : { "B", "G", "R" })
+    {
+        appendString(channels, name);
+        append(channels, pixelType);
+        append(channels, uint32_t(0)); // pLinear and reserved.
+        append(channels, int32_t(1));
+        append(channels, int32_t(1));
+    }
+
+    channels.push_back(0);
+
+    std::vector<uint8_t> bytes;
+    append(bytes, uint32_t(20000630));
+    append(bytes, uint32_t(2));
+    appendExrAttribute(bytes, "channels", "chlist", channels);
+    appendExrAttribute(bytes, "compression", "compression", { 0 });
+    appendExrAttribute(bytes, "dataWindow", "box2i", packed<int32_t>({ 0, 0, maxX, maxY }));
+    appendExrAttribute(bytes, "displayWindow", "box2i", packed<int32_t>({ 0, 0, maxX, maxY }));
+    appendExrAttribute(bytes, "lineOrder", "lineOrder", { 0 });
+    appendExrAttribute(bytes, "pixelAspectRatio", "float", packed<float>({ 1.0f }));
+    appendExrAttribute(bytes, "screenWindowCenter", "v2f", packed<float>({ 0.0f, 0.0f }));
+    appendExrAttribute(bytes, "screenWindowWidth", "float", packed<float>({ 1.0f }));
+    bytes.push_back(0);
+
+    return bytes;
+}
+
+std::vector<uint8_t> encodePfm(const Image& image)
+{
+    const std::string header = pfmHeader(image.width, image.height);
+    const size_t rowBytes = static_cast<size_t>(image.width) * sizeof(glm::vec3);
+    std::vector<uint8_t> bytes(header.begin(), header.end());
+    bytes.reserve(header.size() + rowBytes * image.height);
+
+    // Rows run bottom to top.
+    for (uint32_t row = image.height; row-- > 0;)
+    {
+        const uint8_t* source = reinterpret_cast<const uint8_t*>(&image.pixels[static_cast<size_t>(row) * image.width]);
+        bytes.insert(bytes.end(), source, source + rowBytes);
+    }
+
+    return bytes;
+}
+
+std::vector<uint8_t> encodeExr(const Image& image, bool halfFloat)
+{
+    const size_t sampleBytes = halfFloat ? sizeof(uint16_t) : sizeof(float);
+    std::vector<uint8_t> bytes = exrHeader(image.width, image.height, halfFloat);
+
+    const size_t lineDataBytes = static_cast<size_t>(image.width) * 3 * sampleBytes;
+    const size_t blockBytes = 2 * sizeof(int32_t) + lineDataBytes;
+    uint64_t blockOffset = bytes.size() + static_cast<size_t>(image.height) * sizeof(uint64_t);
+    bytes.reserve(blockOffset + blockBytes * image.height);
+
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        append(bytes, blockOffset);
+        blockOffset += blockBytes;
+    }
+
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        const glm::vec3* row = &image.pixels[static_cast<size_t>(y) * image.width];
+        append(bytes, static_cast<int32_t>(y));
+        append(bytes, static_cast<int32_t>(lineDataBytes));
+
+        for (int channel = 2; channel >= 0; --channel)
+        {
+            for (uint32_t x = 0; x < image.width; ++x)
+            {
+                if (halfFloat)
+                {
+                    append(bytes, glm::packHalf1x16(row[x][channel]));
+                }
+                else
+                {
+                    append(bytes, row[x][channel]);
+                }
+            }
+        }
+    }
+
+    return bytes;
+}
+
+std::vector<uint8_t> encodePng(const Image& image)
+{
+    // Filter type 0 on every line, wrapped in stored deflate blocks.
+    const size_t lineBytes = 1 + static_cast<size_t>(image.width) * 3;
+    std::vector<uint8_t> raw(lineBytes * image.height);
+
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        uint8_t* line = &raw[y * lineBytes];
+        line[0] = 0;
+
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            const glm::vec3& pixel = image.pixels[static_cast<size_t>(y) * image.width + x];
+            line[1 + x * 3 + 0] = toSrgb8(pixel.r);
+            line[1 + x * 3 + 1] = toSrgb8(pixel.g);
+            line[1 + x * 3 + 2] = toSrgb8(pixel.b);
+        }
+    }
+
+    const size_t maxStored = 65535;
+    std::vector<uint8_t> zlib;
+    zlib.reserve(raw.size() + (raw.size() / maxStored + 1) * 5 + 6);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+
+    size_t offset = 0;
+
+    do
+    {
+        const size_t length = std::min(maxStored, raw.size() - offset);
+        const bool last = offset + length == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        append(zlib, static_cast<uint16_t>(length));
+        append(zlib, static_cast<uint16_t>(~length));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+
+    appendBigEndian(zlib, adler32(raw.data(), raw.size()));
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, image.width);
+    appendBigEndian(header, image.height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, adaptive filtering, no interlace.
+
+    std::vector<uint8_t> bytes = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    bytes.reserve(zlib.size() + 64);
+    appendPngChunk(bytes, "IHDR", header);
+    appendPngChunk(bytes, "sRGB", { 0 });
+    appendPngChunk(bytes, "IDAT", zlib);
+    appendPngChunk(bytes, "IEND", {});
+
+    return bytes;
+}
+
+std::vector<uint8_t> encodeImage(const Image& image, ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::Pfm: return encodePfm(image);
+    case ImageFormat::ExrHalf: return encodeExr(image, true);
+    case ImageFormat::ExrFloat: return encodeExr(image, false);
+    case ImageFormat::Png: return encodePng(image);
+    }
+
+    throw std::runtime_error("Unknown image format");
+}
+
+void writeFileMapped(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    MappedFile file;
+    file.create(path, bytes.size());
+
+    if (!bytes.empty())
+    {
+        std::memcpy(file.data(), bytes.data(), bytes.size());
+    }
+
+    file.close();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+
+enum class ImageFormat : uint32_t
+{
+    Pfm,
+    ExrHalf,
+    ExrFloat,
+    Png // 8-bit sRGB, clamped.
+};
+
+const char* imageFormatExtension(ImageFormat format);
+
+// In-memory encoders, so the file write is a single copy into a mapped view. All are uncompressed: encoding runs
+// off the render thread and the bottleneck for large frames is the disk, not the byte count.
+std::vector<uint8_t> encodePfm(const Image& image);
+std::vector<uint8_t> encodeExr(const Image& image, bool halfFloat);
+std::vector<uint8_t> encodePng(const Image& image);
+
+std::vector<uint8_t> encodeImage(const Image& image, ImageFormat format);
+
+// Headers of the uncompressed layouts above, for writers that fill in the pixels piecewise. The EXR header is
+// followed by the line offset table.
+std::string pfmHeader(uint32_t width, uint32_t height);
+std::vector<uint8_t> exrHeader(uint32_t width, uint32_t height, bool halfFloat);
+
+// Writes through a memory-mapped view of the destination. Throws on I/O errors.
+void writeFileMapped(const std::string& path, const std::vector<uint8_t>& bytes);
@@ -0,0 +1,106 @@
+#include "ImageError.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+    // Keeps near-black reference pixels from dominating relMSE.
+    const double relMseEpsilon = 0.01;
+
+    // FLIP colour constants: HyAB compression exponent and the error redistribution knee.
+    const double flipExponent = 0.7;
+    const double flipKneeFraction = 0.4;
+    const double flipKneeError = 0.95;
+
+    double labCurve(double t)
+    {
+        const double delta = 6.0 / 29.0;
+
+        return t > delta * delta * delta ? std::cbrt(t) : t / (3.0 * delta * delta) + 4.0 / 29.0;
+    }
+
+    // Linear sRGB (D65) to CIELAB.
+    glm::dvec3 linearToLab(const glm::dvec3& rgb)
+    {
+        const double x = (0.4124564 * rgb.r + 0.3575761 * rgb.g + 0.1804375 * rgb.b) / 0.95047;
+        const double y = 0.2126729 * rgb.r + 0.7151522 * rgb.g + 0.0721750 * rgb.b;
+        const double z = (0.0193339 * rgb.r + 0.1191920 * rgb.g + 0.9503041 * rgb.b) / 1.08883;
+
+        const double fx = labCurve(x);
+        const double fy = labCurve(y);
+        const double fz = labCurve(z);
+
+        return { 116.0 * fy - 16.0, 500.0 * (fx - fy), 200.0 * (fy - fz) };
+    }
+
+    // Reinhard per channel; the same operator for both images is all a relative metric needs.
+    glm::dvec3 toneMap(const glm::vec3& radiance)
+    {
+        glm::dvec3 value = glm::max(glm::dvec3(radiance), glm::dvec3(0.0));
+
+        return value / (1.0 + value);
+    }
+
+    double hyab(const glm::dvec3& a, const glm::dvec3& b)
+    {
+        const double da = a.y - b.y;
+        const double db = a.z - b.z;
+
+        return std::abs(a.x - b.x) + std::sqrt(da * da + db * db);
+    }
+
+    double flipColorError(const glm::dvec3& testLab, const glm::dvec3& referenceLab, double maxError)
+    {
+        const double error = std::pow(hyab(testLab, referenceLab), flipExponent);
+        const double knee = flipKneeFraction * maxError;
+
+        if (error < knee)
+        {
+            return error * flipKneeError / knee;
+        }
+
+        return std::min(1.0, flipKneeError + (error - knee) / (maxError - knee) * (1.0 - flipKneeError));
+    }
+}
+
+ImageError compareImages(const Image& test, const Image& reference)
+{
+    if (test.width != reference.width || test.height != reference.height || test.pixels.size() != reference.pixels.size())
+    {
+        throw std::runtime_error("Image is " + std::to_string(test.width) + "x" + std::to_string(test.height) +
+            ", reference is " + std::to_string(reference.width) + "x" + std::to_string(reference.height));
+    }
+
+    // Largest colour difference FLIP normalises by: pure green against pure blue.
+    const double maxError = std::pow(hyab(linearToLab({ 0.0, 1.0, 0.0 }), linearToLab({ 0.0, 0.0, 1.0 })), flipExponent);
+
+    double squared = 0.0;
+    double relative = 0.0;
+    double flip = 0.0;
+
+    for (size_t i = 0; i < test.pixels.size(); ++i)
+    {
+        const glm::dvec3 value(test.pixels[i]);
+        const glm::dvec3 expected(reference.pixels[i]);
+        const glm::dvec3 difference = value - expected;
+        const glm::dvec3 differenceSquared = difference * difference;
+
+        squared += differenceSquared.r + differenceSquared.g + differenceSquared.b;
+        relative += glm::dot(differenceSquared / (expected * expected + relMseEpsilon), glm::dvec3(1.0));
+        flip += flipColorError(linearToLab(toneMap(test.pixels[i])), linearToLab(toneMap(reference.pixels[i])), maxError);
+    }
+
+    ImageError error;
+
+    if (!test.pixels.empty())
+    {
+        const double channels = static_cast<double>(test.pixels.size()) * 3.0;
+        error.rmse = std::sqrt(squared / channels);
+        error.relMse = relative / channels;
+        error.flip = flip / static_cast<double>(test.pixels.size());
+    }
+
+    return error;
+}
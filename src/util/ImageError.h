@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Image.h"
+
+// Error of a rendered image against a reference, averaged over pixels.
+struct ImageError
+{
+    double rmse = 0.0; // Root mean squared error over the RGB channels.
+    double relMse = 0.0; // Squared error relative to the squared reference value, robust to bright pixels.
+    double flip = 0.0; // FLIP-style perceptual colour difference in [0, 1].
+};
+
+// The FLIP-style term follows the colour pipeline of NVIDIA's FLIP (exposure and tone mapping, CIELAB, HyAB
+// distance compressed towards small differences) without its spatial filtering and feature detection, so it
+// tracks noise per pixel rather than visibility at a viewing distance. Throws if the sizes differ.
+ImageError compareImages(const Image& test, const Image& reference);
@@ -0,0 +1,612 @@
+#include "Json.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+    const size_t maxDepth = 64;
+
+    class Parser
+    {
+    public:
+        explicit Parser(const std::string& text) : mText(text) {}
+
+        JsonValue parseDocument()
+        {
+            JsonValue value = parseValue(0);
+            skipWhitespace();
+
+            if (mPos != mText.size())
+            {
+                fail("trailing characters");
+            }
+
+            return value;
+        }
+
+    private:
+        [[noreturn]] void fail(const char* what) const
+        {
+            throw std::runtime_error(std::string("Invalid JSON at byte ") + std::to_string(mPos) + ": " + what);
+        }
+
+        void skipWhitespace()
+        {
+            while (mPos < mText.size() && (mText[mPos] == ' ' || mText[mPos] == '\t' || mText[mPos] == '\n' || mText[mPos] == '\r'))
+            {
+                ++mPos;
+            }
+        }
+
+        bool consume(const char* literal)
+        {
+            const size_t length = std::char_traits<char>::length(literal);
+
+            if (mText.compare(mPos, length, literal) != 0)
+            {
+                return false;
+            }
+
+            mPos += length;
+
+            return true;
+        }
+
+        JsonValue parseValue(size_t depth)
+        {
+            if (depth > maxDepth)
+            {
+                fail("nesting too deep");
+            }
+
+            skipWhitespace();
+
+            if (mPos >= mText.size())
+            {
+                fail("unexpected end");
+            }
+
+            const char c = mText[mPos];
+
+            if (c == '{')
+            {
+                return parseObject(depth);
+            }
+            if (c == '[')
+            {
+                return parseArray(depth);
+            }
+            if (c == '"')
+            {
+                return JsonValue(parseString());
+            }
+            if (consume("true"))
+            {
+                return JsonValue(true);
+            }
+            if (consume("false"))
+            {
+                return JsonValue(false);
+            }
+            if (consume("null"))
+            {
+                return JsonValue();
+            }
+
+            return parseNumber();
+        }
+
+        JsonValue parseObject(size_t depth)
+        {
+            JsonValue object = JsonValue::object();
+            ++mPos;
+            skipWhitespace();
+
+            if (mPos < mText.size() && mText[mPos] == '}')
+            {
+                ++mPos;
+
+                return object;
+            }
+
+            while (true)
+            {
+                skipWhitespace();
+
+                if (mPos >= mText.size() || mText[mPos] != '"')
+                {
+                    fail("expected a member name");
+                }
+
+                std::string key = parseString();
+                skipWhitespace();
+
+                if (mPos >= mText.size() || mText[mPos] != ':')
+                {
+                    fail("expected ':'");
+                }
+
+                ++mPos;
+                object.set(key, parseValue(depth + 1));
+                skipWhitespace();
+
+                if (mPos < mText.size() && mText[mPos] == ',')
+                {
+                    ++mPos;
+                    continue;
+                }
+                if (mPos < mText.size() && mText[mPos] == '}')
+                {
+                    ++mPos;
+
+                    return object;
+                }
+
+                fail("expected ',' or '}'");
+            }
+        }
+
+        JsonValue parseArray(size_t depth)
+        {
+            JsonValue array = JsonValue::array();
+            ++mPos;
+            skipWhitespace();
+
+            if (mPos < mText.size() && mText[mPos] == ']')
+            {
+                ++mPos;
+
+                return array;
+            }
+
+            while (true)
+            {
+                array.push(parseValue(depth + 1));
+                skipWhitespace();
+
+                if (mPos < mText.size() && mText[mPos] == ',')
+                {
+                    ++mPos;
+                    continue;
+                }
+                if (mPos < mText.size() && mText[mPos] == ']')
+                {
+                    ++mPos;
+
+                    return array;
+                }
+
+                fail("expected ',' or ']'");
+            }
+        }
+
+        uint32_t parseHex4()
+        {
+            if (mPos + 4 > mText.size())
+            {
+                fail("truncated escape");
+            }
+
+            uint32_t value = 0;
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const char c = mText[mPos++];
+                value <<= 4;
+
+                if (c >= '0' && c <= '9')
+                {
+                    value |= static_cast<uint32_t>(c - '0');
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    value |= static_cast<uint32_t>(c - 'a' + 10);
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    value |= static_cast<uint32_t>(c - 'A' + 10);
+                }
+                else
+                {
+                    fail("invalid escape");
+                }
+            }
+
+            return value;
+        }
+
+        void appendUtf8(std::string& out, uint32_t codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                out += static_cast<char>(codePoint);
+            }
+            else if (codePoint < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (codePoint >> 6));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (codePoint >> 12));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (codePoint >> 18));
+                out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        std::string parseString()
+        {
+            std::string out;
+            ++mPos;
+
+            while (true)
+            {
+                if (mPos >= mText.size())
+                {
+                    fail("unterminated string");
+                }
+
+                const char c = mText[mPos++];
+
+                if (c == '"')
+                {
+                    return out;
+                }
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    fail("control character in string");
+                }
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (mPos >= mText.size())
+                {
+                    fail("unterminated string");
+                }
+
+                const char escape = mText[mPos++];
+
+                switch (escape)
+                {
+                case '"':
+                case '\\':
+                case '/':
+                    out += escape;
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                {
+                    uint32_t codePoint = parseHex4();
+
+                    // Surrogate pair.
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF && consume("\\u"))
+                    {
+                        const uint32_t low = parseHex4();
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    appendUtf8(out, codePoint);
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+                }
+            }
+        }
+
+        JsonValue parseNumber()
+        {
+            const char* begin = mText.c_str() + mPos;
+            char* end = nullptr;
+            const double value = std::strtod(begin, &end);
+
+            if (end == begin)
+            {
+                fail("unexpected character");
+            }
+
+            mPos += static_cast<size_t>(end - begin);
+
+            return JsonValue(value);
+        }
+
+        const std::string& mText;
+        size_t mPos = 0;
+    };
+
+    const JsonValue nullValue;
+
+    const char* typeName(JsonValue::Type type)
+    {
+        switch (type)
+        {
+        case JsonValue::Type::Null:
+            return "null";
+        case JsonValue::Type::Bool:
+            return "bool";
+        case JsonValue::Type::Number:
+            return "number";
+        case JsonValue::Type::String:
+            return "string";
+        case JsonValue::Type::Array:
+            return "array";
+        default:
+            return "object";
+        }
+    }
+
+    void expectType(const JsonValue& value, JsonValue::Type type)
+    {
+        if (value.type() != type)
+        {
+            throw std::runtime_error(std::string("Expected a JSON ") + typeName(type) + ", got " + typeName(value.type()));
+        }
+    }
+
+    void dumpString(std::string& out, const std::string& text)
+    {
+        out += '"';
+
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+                    out += escape;
+                }
+                else
+                {
+                    out += c;
+                }
+            }
+        }
+
+        out += '"';
+    }
+}
+
+JsonValue JsonValue::array()
+{
+    JsonValue value;
+    value.mType = Type::Array;
+
+    return value;
+}
+
+JsonValue JsonValue::object()
+{
+    JsonValue value;
+    value.mType = Type::Object;
+
+    return value;
+}
+
+JsonValue JsonValue::parse(const std::string& text)
+{
+    return Parser(text).parseDocument();
+}
+
+std::string JsonValue::dump() const
+{
+    std::string out;
+    dump(out);
+
+    return out;
+}
+
+void JsonValue::dump(std::string& out) const
+{
+    switch (mType)
+    {
+    case Type::Null:
+        out += "null";
+        break;
+    case Type::Bool:
+        out += mBool ? "true" : "false";
+        break;
+    case Type::Number:
+    {
+        if (!std::isfinite(mNumber))
+        {
+            out += "null";
+            break;
+        }
+
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.17g", mNumber);
+        out += number;
+        break;
+    }
+    case Type::String:
+        dumpString(out, mString);
+        break;
+    case Type::Array:
+        out += '[';
+
+        for (size_t i = 0; i < mItems.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out += ',';
+            }
+
+            mItems[i].dump(out);
+        }
+
+        out += ']';
+        break;
+    case Type::Object:
+        out += '{';
+
+        for (size_t i = 0; i < mMembers.size(); ++i)
+        {
+            if (i > 0)
+            {
+                out += ',';
+            }
+
+            dumpString(out, mMembers[i].first);
+            out += ':';
+            mMembers[i].second.dump(out);
+        }
+
+        out += '}';
+        break;
+    }
+}
+
+bool JsonValue::asBool() const
+{
+    expectType(*this, Type::Bool);
+
+    return mBool;
+}
+
+double JsonValue::asNumber() const
+{
+    expectType(*this, Type::Number);
+
+    return mNumber;
+}
+
+const std::string& JsonValue::asString() const
+{
+    expectType(*this, Type::String);
+
+    return mString;
+}
+
+const std::vector<JsonValue>& JsonValue::items() const
+{
+    expectType(*this, Type::Array);
+
+    return mItems;
+}
+
+const std::vector<std::pair<std::string, JsonValue>>& JsonValue::members() const
+{
+    expectType(*this, Type::Object);
+
+    return mMembers;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+    for (const auto& member : mMembers)
+    {
+        if (member.first == key)
+        {
+            return member.second;
+        }
+    }
+
+    return nullValue;
+}
+
+bool JsonValue::has(const std::string& key) const
+{
+    return !(*this)[key].isNull();
+}
+
+double JsonValue::numberOr(const std::string& key, double fallback) const
+{
+    const JsonValue& value = (*this)[key];
+
+    return value.isNull() ? fallback : value.asNumber();
+}
+
+std::string JsonValue::stringOr(const std::string& key, const std::string& fallback) const
+{
+    const JsonValue& value = (*this)[key];
+
+    return value.isNull() ? fallback : value.asString();
+}
+
+bool JsonValue::boolOr(const std::string& key, bool fallback) const
+{
+    const JsonValue& value = (*this)[key];
+
+    return value.isNull() ? fallback : value.asBool();
+}
+
+JsonValue& JsonValue::set(const std::string& key, JsonValue value)
+{
+    if (mType == Type::Null)
+    {
+        mType = Type::Object;
+    }
+
+    expectType(*this, Type::Object);
+
+    for (auto& member : mMembers)
+    {
+        if (member.first == key)
+        {
+            member.second = std::move(value);
+
+            return *this;
+        }
+    }
+
+    mMembers.emplace_back(key, std::move(value));
+
+    return *this;
+}
+
+JsonValue& JsonValue::push(JsonValue value)
+{
+    if (mType == Type::Null)
+    {
+        mType = Type::Array;
+    }
+
+    expectType(*this, Type::Array);
+    mItems.push_back(std::move(value));
+
+    return *this;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small JSON document model for local control protocols. Objects keep their insertion order; numbers are doubles.
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    JsonValue() = default;
+    JsonValue(bool value) : mType(Type::Bool), mBool(value) {}
+    JsonValue(double value) : mType(Type::Number), mNumber(value) {}
+    JsonValue(int value) : mType(Type::Number), mNumber(value) {}
+    JsonValue(uint32_t value) : mType(Type::Number), mNumber(value) {}
+    JsonValue(uint64_t value) : mType(Type::Number), mNumber(static_cast<double>(value)) {}
+    JsonValue(const char* value) : mType(Type::String), mString(value) {}
+    JsonValue(std::string value) : mType(Type::String), mString(std::move(value)) {}
+
+    static JsonValue array();
+    static JsonValue object();
+
+    // Throws std::runtime_error with the byte offset of the first error.
+    static JsonValue parse(const std::string& text);
+
+    // Compact, on one line, so documents can be framed by newlines.
+    std::string dump() const;
+
+    Type type() const
+    {
+        return mType;
+    }
+
+    bool isNull() const
+    {
+        return mType == Type::Null;
+    }
+
+    // Typed access throws std::runtime_error on a type mismatch.
+    bool asBool() const;
+    double asNumber() const;
+    const std::string& asString() const;
+    const std::vector<JsonValue>& items() const;
+    const std::vector<std::pair<std::string, JsonValue>>& members() const;
+
+    // Member lookup; a missing key (or a non-object) yields a null value.
+    const JsonValue& operator[](const std::string& key) const;
+    bool has(const std::string& key) const;
+
+    double numberOr(const std::string& key, double fallback) const;
+    std::string stringOr(const std::string& key, const std::string& fallback) const;
+    bool boolOr(const std::string& key, bool fallback) const;
+
+    // Replaces an existing member of the same name.
+    JsonValue& set(const std::string& key, JsonValue value);
+    JsonValue& push(JsonValue value);
+
+private:
+    void dump(std::string& out) const;
+
+    Type mType = Type::Null;
+    bool mBool = false;
+    double mNumber = 0.0;
+    std::string mString;
+    std::vector<JsonValue> mItems;
+    std::vector<std::pair<std::string, JsonValue>> mMembers;
+};
@@ -1,39 +1,665 @@
 #include "Logger.h"
+#include "Profiler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace
 {
-    void logFormatted(const char* tag, const char* fmt, va_list args)
+    using logger::Level;
+    using logger::SinkFormat;
+    using logger::detail::ArgType;
+    using logger::detail::Encoder;
+    using logger::detail::payloadCapacity;
+
+    const size_t ringCapacity = 4096; // Power of two.
+    const size_t rateBuckets = 256;
+    const int64_t rateWindowNs = 1000000000;
+    const int64_t suppressionSweepNs = 100000000; // How often the writer reports windows that ended.
+    const char* const suppressedFormat = "Suppressed %u repeats of a rate-limited message.";
+    const char* levelTags[] = { "[I] ", "[W] ", "[E] " };
+
+    int64_t nowNs()
     {
-        std::fputs(tag, stdout);
-        std::vfprintf(stdout, fmt, args);
-        std::fputc('\n', stdout);
-        std::fflush(stdout);
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence{ 0 };
+        int64_t timestamp = 0;
+        const char* fmt = nullptr;
+        Level level = Level::Info;
+        uint16_t payloadSize = 0;
+        uint16_t argCount = 0;
+        uint8_t payload[payloadCapacity];
+    };
+
+    struct RateBucket
+    {
+        std::atomic<uint64_t> key{ 0 };
+        std::atomic<int64_t> windowStart{ 0 };
+        std::atomic<uint32_t> count{ 0 };
+        std::atomic<uint32_t> suppressed{ 0 };
+    };
+
+    struct Sink
+    {
+        uint32_t levelMask = logger::allLevels;
+        SinkFormat format = SinkFormat::Text;
+        bool console = false;
+        std::ofstream stream;
+    };
+
+    // Reads packed arguments back in order.
+    class ArgReader
+    {
+    public:
+        ArgReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+        bool next(ArgType& type, int64_t& integer, double& number, std::string& text)
+        {
+            if (mOffset >= mSize)
+            {
+                return false;
+            }
+
+            type = static_cast<ArgType>(mData[mOffset++]);
+
+            if (type == ArgType::String)
+            {
+                uint16_t length = 0;
+                std::memcpy(&length, mData + mOffset, sizeof(length));
+                text.assign(reinterpret_cast<const char*>(mData + mOffset + sizeof(length)), length);
+                mOffset += sizeof(length) + length;
+            }
+            else if (type == ArgType::Double)
+            {
+                std::memcpy(&number, mData + mOffset, sizeof(number));
+                integer = static_cast<int64_t>(number);
+                mOffset += sizeof(number);
+            }
+            else
+            {
+                std::memcpy(&integer, mData + mOffset, sizeof(integer));
+                number = static_cast<double>(integer);
+                mOffset += sizeof(integer);
+            }
+
+            return true;
+        }
+
+    private:
+        const uint8_t* mData;
+        size_t mSize;
+        size_t mOffset = 0;
+    };
+
+    // printf-style formatting over captured arguments: each conversion is rendered on its own with the
+    // argument's captured type, so a mismatched length modifier can't read garbage.
+    void formatRecord(std::string& out, const char* fmt, const uint8_t* payload, size_t payloadSize)
+    {
+        ArgReader reader(payload, payloadSize);
+        ArgType type{};
+        int64_t integer = 0;
+        double number = 0.0;
+        std::string text;
+        char buffer[512];
+
+        for (const char* cursor = fmt; *cursor; ++cursor)
+        {
+            if (*cursor != '%')
+            {
+                out.push_back(*cursor);
+                continue;
+            }
+
+            if (cursor[1] == '%')
+            {
+                out.push_back('%');
+                ++cursor;
+                continue;
+            }
+
+            // Collect flags, width and precision; drop length modifiers.
+            std::string spec = "%";
+            const char* scan = cursor + 1;
+
+            while (*scan && std::strchr("-+ #0123456789.*", *scan))
+            {
+                if (*scan == '*')
+                {
+                    // Star widths consume an argument, which is inlined into the spec.
+                    if (reader.next(type, integer, number, text))
+                    {
+                        spec += std::to_string(integer);
+                    }
+                }
+                else
+                {
+                    spec.push_back(*scan);
+                }
+
+                ++scan;
+            }
+
+            while (*scan && std::strchr("hljztL", *scan))
+            {
+                ++scan;
+            }
+
+            const char conversion = *scan;
+
+            if (!conversion)
+            {
+                break;
+            }
+
+            cursor = scan;
+
+            if (!reader.next(type, integer, number, text))
+            {
+                out += "<missing>";
+                continue;
+            }
+
+            int written = 0;
+
+            switch (conversion)
+            {
+            case 'd':
+            case 'i':
+                spec += "lld";
+                written = std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<long long>(integer));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                spec += "ll";
+                spec.push_back(conversion);
+                written = std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<unsigned long long>(integer));
+                break;
+            case 'c':
+                spec.push_back('c');
+                written = std::snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<int>(integer));
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec.push_back(conversion);
+                written = std::snprintf(buffer, sizeof(buffer), spec.c_str(), number);
+                break;
+            case 'p':
+                written = std::snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(integer));
+                break;
+            case 's':
+                if (type == ArgType::String)
+                {
+                    if (spec.size() == 1)
+                    {
+                        out += text;
+                        continue;
+                    }
+
+                    spec.push_back('s');
+                    written = std::snprintf(buffer, sizeof(buffer), spec.c_str(), text.c_str());
+                }
+                else
+                {
+                    written = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(integer));
+                }
+                break;
+            default:
+                out.push_back('%');
+                out.push_back(conversion);
+                continue;
+            }
+
+            if (written > 0)
+            {
+                out.append(buffer, std::min(static_cast<size_t>(written), sizeof(buffer) - 1));
+            }
+        }
+    }
+
+    class AsyncLogger
+    {
+    public:
+        AsyncLogger()
+        {
+            mSlots = std::make_unique<Slot[]>(ringCapacity);
+
+            for (size_t i = 0; i < ringCapacity; ++i)
+            {
+                mSlots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            auto console = std::make_unique<Sink>();
+            console->console = true;
+            mSinks.push_back(std::move(console));
+            mStartNs = nowNs();
+            mWorker = std::thread([this]() { run(); });
+        }
+
+        ~AsyncLogger()
+        {
+            mRunning.store(false, std::memory_order_release);
+
+            if (mWorker.joinable())
+            {
+                mWorker.join();
+            }
+        }
+
+        bool enabled(Level level) const
+        {
+            return static_cast<int>(level) >= mMinLevel.load(std::memory_order_relaxed);
+        }
+
+        void submit(Level level, const char* fmt, const Encoder& encoder)
+        {
+            const int64_t timestamp = nowNs();
+            const uint32_t limit = mRateLimit.load(std::memory_order_relaxed);
+
+            if (limit > 0 && !admit(fmt, encoder, timestamp, limit))
+            {
+                return;
+            }
+
+            enqueue(level, fmt, encoder, timestamp);
+        }
+
+        void enqueue(Level level, const char* fmt, const Encoder& encoder, int64_t timestamp)
+        {
+            size_t position = mEnqueuePos.load(std::memory_order_relaxed);
+            Slot* slot = nullptr;
+
+            // Bounded MPSC ring (Vyukov): a slot is free when its sequence equals the claim position.
+            for (;;)
+            {
+                slot = &mSlots[position & (ringCapacity - 1)];
+                const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+                if (difference == 0)
+                {
+                    if (mEnqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    // Ring full: drop instead of blocking the caller.
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+
+                    return;
+                }
+                else
+                {
+                    position = mEnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            slot->timestamp = timestamp;
+            slot->fmt = fmt;
+            slot->level = level;
+            slot->payloadSize = encoder.size;
+            slot->argCount = encoder.count;
+            std::memcpy(slot->payload, encoder.data, encoder.size);
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+
+        void flush()
+        {
+            const size_t target = mEnqueuePos.load(std::memory_order_acquire);
+
+            while (mWrittenPos.load(std::memory_order_acquire) < target && mWorker.joinable())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        bool addFileSink(const std::string& path, SinkFormat format, uint32_t levelMask)
+        {
+            auto sink = std::make_unique<Sink>();
+            sink->format = format;
+            sink->levelMask = levelMask;
+            sink->stream.open(path, std::ios::binary | std::ios::trunc);
+
+            if (!sink->stream)
+            {
+                return false;
+            }
+
+            if (format == SinkFormat::Binary)
+            {
+                // Record layout: u32 size, i64 timestamp ns, u8 level, u16 fmt length, fmt, u16 arg count, packed args.
+                sink->stream.write("VRTLOG1", 8);
+            }
+
+            std::lock_guard<std::mutex> lock(mSinkMutex);
+            mSinks.push_back(std::move(sink));
+
+            return true;
+        }
+
+        void setConsoleLevels(uint32_t levelMask)
+        {
+            std::lock_guard<std::mutex> lock(mSinkMutex);
+            mSinks.front()->levelMask = levelMask;
+        }
+
+        void setConsoleStream(std::FILE* stream)
+        {
+            std::lock_guard<std::mutex> lock(mSinkMutex);
+            std::fflush(mConsole);
+            mConsole = stream;
+        }
+
+        std::FILE* mConsole = stdout; // Guarded by mSinkMutex.
+        std::atomic<int> mMinLevel{ static_cast<int>(Level::Info) };
+        std::atomic<uint32_t> mRateLimit{ 50 };
+        std::atomic<uint64_t> mDropped{ 0 };
+
+    private:
+        bool admit(const char* fmt, const Encoder& encoder, int64_t timestamp, uint32_t limit)
+        {
+            // FNV-1a over the call site and captured arguments identifies a repeated message.
+            uint64_t key = 1469598103934665603ull ^ reinterpret_cast<uintptr_t>(fmt);
+
+            for (uint16_t i = 0; i < encoder.size; ++i)
+            {
+                key = (key ^ encoder.data[i]) * 1099511628211ull;
+            }
+
+            RateBucket& bucket = mBuckets[key & (rateBuckets - 1)];
+
+            if (bucket.key.load(std::memory_order_relaxed) != key ||
+                timestamp - bucket.windowStart.load(std::memory_order_relaxed) > rateWindowNs)
+            {
+                const uint32_t suppressed = bucket.suppressed.exchange(0, std::memory_order_relaxed);
+                bucket.key.store(key, std::memory_order_relaxed);
+                bucket.windowStart.store(timestamp, std::memory_order_relaxed);
+                bucket.count.store(0, std::memory_order_relaxed);
+
+                if (suppressed > 0)
+                {
+                    Encoder note;
+                    logger::detail::encode(note, suppressed);
+                    enqueue(Level::Warn, suppressedFormat, note, timestamp);
+                }
+            }
+
+            if (bucket.count.fetch_add(1, std::memory_order_relaxed) >= limit)
+            {
+                bucket.suppressed.fetch_add(1, std::memory_order_relaxed);
+
+                return false;
+            }
+
+            return true;
+        }
+
+        // A burst that stops is never followed by the call that would report its suppressed repeats, so the
+        // writer reports windows that have ended, and every pending count when final. Returns the notes queued.
+        size_t reportSuppressed(int64_t timestamp, bool final)
+        {
+            size_t reported = 0;
+
+            for (RateBucket& bucket : mBuckets)
+            {
+                if (bucket.suppressed.load(std::memory_order_relaxed) == 0 ||
+                    (!final && timestamp - bucket.windowStart.load(std::memory_order_relaxed) <= rateWindowNs))
+                {
+                    continue;
+                }
+
+                // Exchanged, so a producer starting a new window in the meantime cannot report the same repeats.
+                const uint32_t suppressed = bucket.suppressed.exchange(0, std::memory_order_relaxed);
+
+                if (suppressed > 0)
+                {
+                    Encoder note;
+                    logger::detail::encode(note, suppressed);
+                    enqueue(Level::Warn, suppressedFormat, note, timestamp);
+                    ++reported;
+                }
+            }
+
+            return reported;
+        }
+
+        void run()
+        {
+            std::string line;
+            std::string binary;
+            uint32_t idleSpins = 0;
+            uint64_t reportedDrops = 0;
+            int64_t lastSweep = nowNs();
+            profiler::setThreadName("logger");
+
+            for (;;)
+            {
+                const bool running = mRunning.load(std::memory_order_acquire);
+                const uint64_t drainBegin = profiler::now();
+                size_t drained = 0;
+
+                {
+                    std::lock_guard<std::mutex> lock(mSinkMutex);
+
+                    for (;;)
+                    {
+                        Slot& slot = mSlots[mDequeuePos & (ringCapacity - 1)];
+
+                        if (slot.sequence.load(std::memory_order_acquire) != mDequeuePos + 1)
+                        {
+                            break;
+                        }
+
+                        write(slot, line, binary);
+                        slot.sequence.store(mDequeuePos + ringCapacity, std::memory_order_release);
+                        ++mDequeuePos;
+                        ++drained;
+                    }
+
+                    const uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+
+                    if (dropped != reportedDrops)
+                    {
+                        line = "[W] Logger ring full, dropped " + std::to_string(dropped - reportedDrops) + " records.\n";
+                        std::fwrite(line.data(), 1, line.size(), mConsole);
+                        reportedDrops = dropped;
+                    }
+
+                    if (drained > 0)
+                    {
+                        std::fflush(mConsole);
+
+                        for (auto& sink : mSinks)
+                        {
+                            if (!sink->console)
+                            {
+                                sink->stream.flush();
+                            }
+                        }
+                    }
+                }
+
+                const int64_t sweepTime = nowNs();
+                size_t swept = 0;
+
+                if (!running || sweepTime - lastSweep >= suppressionSweepNs)
+                {
+                    swept = reportSuppressed(sweepTime, !running);
+                    lastSweep = sweepTime;
+                }
+
+                if (drained > 0)
+                {
+                    // Idle polls are not recorded so they do not flood the profiler ring.
+                    profiler::record("LogDrain", drainBegin, profiler::now());
+                    mWrittenPos.store(mDequeuePos, std::memory_order_release);
+                    idleSpins = 0;
+                    continue;
+                }
+
+                // Notes just queued are written by the next pass.
+                if (swept > 0)
+                {
+                    continue;
+                }
+
+                if (!running)
+                {
+                    break;
+                }
+
+                // Back off from spinning to short sleeps; producers never wait on the writer.
+                if (++idleSpins < 64)
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }
+
+        void write(const Slot& slot, std::string& line, std::string& binary)
+        {
+            const uint32_t bit = logger::levelBit(slot.level);
+            bool formatted = false;
+
+            for (auto& sink : mSinks)
+            {
+                if (!(sink->levelMask & bit))
+                {
+                    continue;
+                }
+
+                if (sink->format == SinkFormat::Binary)
+                {
+                    const uint16_t fmtLength = static_cast<uint16_t>(std::strlen(slot.fmt));
+                    const uint8_t level = static_cast<uint8_t>(slot.level);
+                    const uint32_t size = static_cast<uint32_t>(sizeof(int64_t) + 1 + 2 + fmtLength + 2 + slot.payloadSize);
+
+                    binary.clear();
+                    binary.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                    binary.append(reinterpret_cast<const char*>(&slot.timestamp), sizeof(slot.timestamp));
+                    binary.append(reinterpret_cast<const char*>(&level), 1);
+                    binary.append(reinterpret_cast<const char*>(&fmtLength), sizeof(fmtLength));
+                    binary.append(slot.fmt, fmtLength);
+                    binary.append(reinterpret_cast<const char*>(&slot.argCount), sizeof(slot.argCount));
+                    binary.append(reinterpret_cast<const char*>(slot.payload), slot.payloadSize);
+                    sink->stream.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+                    continue;
+                }
+
+                if (!formatted)
+                {
+                    line = levelTags[static_cast<int>(slot.level)];
+                    formatRecord(line, slot.fmt, slot.payload, slot.payloadSize);
+                    line.push_back('\n');
+                    formatted = true;
+                }
+
+                if (sink->console)
+                {
+                    std::fwrite(line.data(), 1, line.size(), mConsole);
+                }
+                else
+                {
+                    char stamp[32];
+                    int length = std::snprintf(stamp, sizeof(stamp), "[%10.3f] ", static_cast<double>(slot.timestamp - mStartNs) * 1e-9);
+                    sink->stream.write(stamp, length);
+                    sink->stream.write(line.data(), static_cast<std::streamsize>(line.size()));
+                }
+            }
+        }
+
+        std::unique_ptr<Slot[]> mSlots;
+        alignas(64) std::atomic<size_t> mEnqueuePos{ 0 };
+        alignas(64) size_t mDequeuePos = 0;
+        std::atomic<size_t> mWrittenPos{ 0 };
+        std::array<RateBucket, rateBuckets> mBuckets;
+
+        std::mutex mSinkMutex;
+        std::vector<std::unique_ptr<Sink>> mSinks;
+        int64_t mStartNs = 0;
+
+        std::atomic<bool> mRunning{ true };
+        std::thread mWorker;
+    };
+
+    AsyncLogger& instance()
+    {
+        static AsyncLogger asyncLogger;
+
+        return asyncLogger;
     }
 }
 
 namespace logger
 {
-    void info(const char* fmt, ...)
+    void setLevel(Level minimum)
+    {
+        instance().mMinLevel.store(static_cast<int>(minimum), std::memory_order_relaxed);
+    }
+
+    void setConsoleLevels(uint32_t levelMask)
     {
-        va_list args;
-        va_start(args, fmt);
-        logFormatted("[I] ", fmt, args);
-        va_end(args);
+        instance().setConsoleLevels(levelMask);
     }
 
-    void warn(const char* fmt, ...)
+    void setConsoleStream(std::FILE* stream)
     {
-        va_list args;
-        va_start(args, fmt);
-        logFormatted("[W] ", fmt, args);
-        va_end(args);
+        instance().setConsoleStream(stream);
     }
 
-    void error(const char* fmt, ...)
+    bool addFileSink(const std::string& path, SinkFormat format, uint32_t levelMask)
     {
-        va_list args;
-        va_start(args, fmt);
-        logFormatted("[E] ", fmt, args);
-        va_end(args);
+        return instance().addFileSink(path, format, levelMask);
     }
-}
\ No newline at end of file
+
+    void setRateLimit(uint32_t messagesPerSecond)
+    {
+        instance().mRateLimit.store(messagesPerSecond, std::memory_order_relaxed);
+    }
+
+    void flush()
+    {
+        instance().flush();
+    }
+
+    uint64_t droppedCount()
+    {
+        return instance().mDropped.load(std::memory_order_relaxed);
+    }
+
+    namespace detail
+    {
+        bool enabled(Level level)
+        {
+            return instance().enabled(level);
+        }
+
+        void submit(Level level, const char* fmt, const Encoder& encoder)
+        {
+            instance().submit(level, fmt, encoder);
+        }
+    }
+}
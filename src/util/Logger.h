@@ -2,8 +2,14 @@
 
 #include <string>
 #include <cstdio>
-#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
 
+// Asynchronous logger. Call sites keep printf-style format strings; arguments are captured by value into a
+// lock-free ring and formatted and written by a background thread, so logging never blocks on I/O.
+// Format strings must outlive the process (string literals); only the pointer is captured.
 namespace logger
 {
     enum class Level
@@ -13,7 +19,160 @@ namespace logger
         Error
     };
 
-    void info(const char* fmt, ...);
-    void warn(const char* fmt, ...);
-    void error(const char* fmt, ...);
-}
\ No newline at end of file
+    enum class SinkFormat
+    {
+        Text,
+        Binary // Raw records (format string + packed arguments), formatted offline.
+    };
+
+    constexpr uint32_t levelBit(Level level)
+    {
+        return 1u << static_cast<uint32_t>(level);
+    }
+
+    constexpr uint32_t allLevels = levelBit(Level::Info) | levelBit(Level::Warn) | levelBit(Level::Error);
+
+    // Records below this level are discarded at the call site.
+    void setLevel(Level minimum);
+    void setConsoleLevels(uint32_t levelMask);
+
+    // Console records go to stdout unless redirected, for example to stderr while stdout carries data.
+    void setConsoleStream(std::FILE* stream);
+    bool addFileSink(const std::string& path, SinkFormat format, uint32_t levelMask = allLevels);
+
+    // Identical messages beyond this count per second are suppressed (0 disables). The number suppressed is logged
+    // once their second is over, also when the message does not come back.
+    void setRateLimit(uint32_t messagesPerSecond);
+
+    // Blocks until every record logged so far has been written.
+    void flush();
+
+    uint64_t droppedCount();
+
+    namespace detail
+    {
+        constexpr size_t payloadCapacity = 960;
+
+        enum class ArgType : uint8_t
+        {
+            Int,
+            UInt,
+            Double,
+            String,
+            Pointer
+        };
+
+        struct Encoder
+        {
+            uint8_t data[payloadCapacity];
+            uint16_t size = 0;
+            uint16_t count = 0;
+
+            void putScalar(ArgType type, const void* value, size_t bytes)
+            {
+                if (size + 1 + bytes > payloadCapacity)
+                {
+                    return;
+                }
+
+                data[size++] = static_cast<uint8_t>(type);
+                std::memcpy(data + size, value, bytes);
+                size = static_cast<uint16_t>(size + bytes);
+                ++count;
+            }
+
+            void putString(const char* value, size_t length)
+            {
+                if (static_cast<size_t>(size) + 3 > payloadCapacity)
+                {
+                    return;
+                }
+
+                length = std::min(length, payloadCapacity - size - 3);
+                uint16_t stored = static_cast<uint16_t>(length);
+                data[size++] = static_cast<uint8_t>(ArgType::String);
+                std::memcpy(data + size, &stored, sizeof(stored));
+                std::memcpy(data + size + sizeof(stored), value, length);
+                size = static_cast<uint16_t>(size + sizeof(stored) + length);
+                ++count;
+            }
+        };
+
+        template<typename T>
+        void encode(Encoder& encoder, T value)
+        {
+            if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+            {
+                const char* text = value ? value : "(null)";
+                encoder.putString(text, std::strlen(text));
+            }
+            else if constexpr (std::is_same_v<T, std::string>)
+            {
+                encoder.putString(value.data(), value.size());
+            }
+            else if constexpr (std::is_floating_point_v<T>)
+            {
+                double number = static_cast<double>(value);
+                encoder.putScalar(ArgType::Double, &number, sizeof(number));
+            }
+            else if constexpr (std::is_enum_v<T>)
+            {
+                int64_t number = static_cast<int64_t>(value);
+                encoder.putScalar(ArgType::Int, &number, sizeof(number));
+            }
+            else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+            {
+                int64_t number = value;
+                encoder.putScalar(ArgType::Int, &number, sizeof(number));
+            }
+            else if constexpr (std::is_integral_v<T>)
+            {
+                uint64_t number = value;
+                encoder.putScalar(ArgType::UInt, &number, sizeof(number));
+            }
+            else if constexpr (std::is_pointer_v<T>)
+            {
+                uint64_t address = reinterpret_cast<uintptr_t>(value);
+                encoder.putScalar(ArgType::Pointer, &address, sizeof(address));
+            }
+            else
+            {
+                static_assert(std::is_pointer_v<T>, "Unsupported logger argument type.");
+            }
+        }
+
+        bool enabled(Level level);
+        void submit(Level level, const char* fmt, const Encoder& encoder);
+
+        template<typename... Args>
+        void log(Level level, const char* fmt, Args... args)
+        {
+            if (!enabled(level))
+            {
+                return;
+            }
+
+            Encoder encoder;
+            (encode(encoder, args), ...);
+            submit(level, fmt, encoder);
+        }
+    }
+
+    template<typename... Args>
+    void info(const char* fmt, Args... args)
+    {
+        detail::log(Level::Info, fmt, args...);
+    }
+
+    template<typename... Args>
+    void warn(const char* fmt, Args... args)
+    {
+        detail::log(Level::Warn, fmt, args...);
+    }
+
+    template<typename... Args>
+    void error(const char* fmt, Args... args)
+    {
+        detail::log(Level::Error, fmt, args...);
+    }
+}
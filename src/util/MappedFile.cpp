@@ -0,0 +1,165 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::create(const std::string& path, size_t size)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+
+    mFile = file;
+#else
+    mFile = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (mFile < 0)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+
+    if (size > 0 && ftruncate(mFile, static_cast<off_t>(size)) != 0)
+    {
+        close();
+
+        throw std::runtime_error("Failed to resize " + path);
+    }
+#endif
+
+    mSize = size;
+    map(path, true);
+}
+
+void MappedFile::openRead(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size{};
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    mFile = file;
+
+    if (!GetFileSizeEx(file, &size))
+    {
+        close();
+
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    mSize = static_cast<size_t>(size.QuadPart);
+#else
+    mFile = open(path.c_str(), O_RDONLY);
+    struct stat info{};
+
+    if (mFile < 0 || fstat(mFile, &info) != 0)
+    {
+        close();
+
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    mSize = static_cast<size_t>(info.st_size);
+#endif
+
+    map(path, false);
+}
+
+void MappedFile::map(const std::string& path, bool writable)
+{
+    // Empty files cannot be mapped; they are valid with a null view.
+    if (mSize == 0)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    const uint64_t size = mSize;
+    mMapping = CreateFileMappingA(static_cast<HANDLE>(mFile), nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    mView = mMapping ? MapViewOfFile(static_cast<HANDLE>(mMapping), writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, mSize) : nullptr;
+
+    if (!mView)
+    {
+        close();
+
+        throw std::runtime_error("Failed to map " + path);
+    }
+#else
+    void* view = mmap(nullptr, mSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, mFile, 0);
+
+    if (view == MAP_FAILED)
+    {
+        close();
+
+        throw std::runtime_error("Failed to map " + path);
+    }
+
+    mView = view;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (mView)
+    {
+        UnmapViewOfFile(mView);
+    }
+    if (mMapping)
+    {
+        CloseHandle(static_cast<HANDLE>(mMapping));
+    }
+    if (mFile)
+    {
+        CloseHandle(static_cast<HANDLE>(mFile));
+    }
+
+    mMapping = nullptr;
+    mFile = nullptr;
+#else
+    if (mView)
+    {
+        munmap(mView, mSize);
+    }
+    if (mFile >= 0)
+    {
+        ::close(mFile);
+    }
+
+    mFile = -1;
+#endif
+
+    mView = nullptr;
+    mSize = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Memory-mapped view of a whole file, read-only or read-write. Throws on I/O errors.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Creates or truncates the file to size bytes and maps it writable.
+    void create(const std::string& path, size_t size);
+
+    void openRead(const std::string& path);
+
+    // Unmaps; writes reach the file no later than this.
+    void close();
+
+    uint8_t* data()
+    {
+        return static_cast<uint8_t*>(mView);
+    }
+
+    const uint8_t* data() const
+    {
+        return static_cast<const uint8_t*>(mView);
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+private:
+    void map(const std::string& path, bool writable);
+
+    void* mView = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#else
+    int mFile = -1;
+#endif
+};
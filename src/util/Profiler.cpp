@@ -0,0 +1,276 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define VRAYT_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define VRAYT_HAS_TSC 1
+#else
+#define VRAYT_HAS_TSC 0
+#endif
+
+namespace
+{
+    const size_t zonesPerThread = 16384; // Power of two.
+
+    struct ZoneRecord
+    {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> begin{ 0 };
+        std::atomic<uint64_t> end{ 0 };
+    };
+
+    // Single-writer ring owned by one thread; readers copy it and discard entries the writer may have overwritten.
+    struct ThreadBuffer
+    {
+        std::unique_ptr<ZoneRecord[]> zones = std::make_unique<ZoneRecord[]>(zonesPerThread);
+        std::atomic<uint64_t> head{ 0 };
+        uint32_t threadId = 0;
+        std::string name;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers; // Never freed, threads may outlive a dump.
+        std::vector<ThreadBuffer*> freeBuffers; // Of exited threads; dumps still show their zones until reused.
+        uint32_t nextThreadId = 1;
+        std::atomic<bool> enabled{ true };
+        uint64_t startTicks = 0;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    uint64_t readTicks()
+    {
+#if VRAYT_HAS_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    Registry& registry()
+    {
+        static Registry* instance = []()
+        {
+            auto* created = new Registry();
+            created->startTicks = readTicks();
+            created->startTime = std::chrono::steady_clock::now();
+
+            return created;
+        }();
+
+        return *instance;
+    }
+
+    // Trivially destructible, so still readable while the thread's other thread_locals are destroyed.
+    thread_local ThreadBuffer* tlsBuffer = nullptr;
+    thread_local bool tlsExited = false;
+
+    // Hands the thread's buffer back when the thread exits. Servers start a thread per connection, and a buffer
+    // each for the life of the process would grow without bound.
+    struct BufferOwner
+    {
+        ~BufferOwner()
+        {
+            if (tlsBuffer)
+            {
+                Registry& reg = registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                reg.freeBuffers.push_back(tlsBuffer);
+            }
+
+            tlsBuffer = nullptr;
+            tlsExited = true;
+        }
+    };
+
+    // Null once the thread is exiting; zones recorded then are dropped.
+    ThreadBuffer* threadBuffer()
+    {
+        if (!tlsBuffer && !tlsExited)
+        {
+            thread_local BufferOwner owner;
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+
+            if (!reg.freeBuffers.empty())
+            {
+                // Under the mutex, so no dump is reading it; the old zones are dropped.
+                tlsBuffer = reg.freeBuffers.back();
+                reg.freeBuffers.pop_back();
+                tlsBuffer->head.store(0, std::memory_order_relaxed);
+                tlsBuffer->name.clear();
+            }
+            else
+            {
+                reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+                tlsBuffer = reg.buffers.back().get();
+            }
+
+            tlsBuffer->threadId = reg.nextThreadId++;
+        }
+
+        return tlsBuffer;
+    }
+
+    // Ticks per second, measured against steady_clock over the process lifetime so far.
+    double tickFrequency()
+    {
+#if VRAYT_HAS_TSC
+        Registry& reg = registry();
+        const uint64_t ticks = readTicks() - reg.startTicks;
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - reg.startTime).count();
+
+        return seconds > 0.0 && ticks > 0 ? static_cast<double>(ticks) / seconds : 1e9;
+#else
+        return 1e9;
+#endif
+    }
+
+    void writeJsonString(std::ofstream& out, const std::string& text)
+    {
+        out << '"';
+
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out << '\\';
+            }
+
+            out << c;
+        }
+
+        out << '"';
+    }
+}
+
+namespace profiler
+{
+    uint64_t now()
+    {
+        return readTicks();
+    }
+
+    void record(const char* name, uint64_t begin, uint64_t end)
+    {
+        if (!registry().enabled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        ThreadBuffer* buffer = threadBuffer();
+
+        if (!buffer)
+        {
+            return;
+        }
+
+        const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        ZoneRecord& zone = buffer->zones[head & (zonesPerThread - 1)];
+        zone.name.store(name, std::memory_order_relaxed);
+        zone.begin.store(begin, std::memory_order_relaxed);
+        zone.end.store(end, std::memory_order_relaxed);
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    void setThreadName(const char* name)
+    {
+        ThreadBuffer* buffer = threadBuffer();
+
+        if (!buffer)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        buffer->name = name;
+    }
+
+    void setEnabled(bool enable)
+    {
+        registry().enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    bool enabled()
+    {
+        return registry().enabled.load(std::memory_order_relaxed);
+    }
+
+    double ticksToSeconds(uint64_t ticks)
+    {
+        return static_cast<double>(ticks) / tickFrequency();
+    }
+
+    bool writeChromeTrace(const std::string& path)
+    {
+        std::ofstream out(path, std::ios::trunc);
+
+        if (!out)
+        {
+            return false;
+        }
+
+        Registry& reg = registry();
+        const double microsPerTick = 1e6 / tickFrequency();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        bool first = true;
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        for (const auto& buffer : reg.buffers)
+        {
+            std::string name = buffer->name.empty() ? "thread " + std::to_string(buffer->threadId) : buffer->name;
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+            writeJsonString(out, name);
+            out << "}}";
+            first = false;
+
+            const uint64_t head = buffer->head.load(std::memory_order_acquire);
+            const uint64_t start = head > zonesPerThread ? head - zonesPerThread : 0;
+            std::vector<std::pair<const char*, std::pair<uint64_t, uint64_t>>> zones;
+            zones.reserve(static_cast<size_t>(head - start));
+
+            for (uint64_t i = start; i < head; ++i)
+            {
+                const ZoneRecord& zone = buffer->zones[i & (zonesPerThread - 1)];
+                zones.push_back({ zone.name.load(std::memory_order_relaxed), { zone.begin.load(std::memory_order_relaxed), zone.end.load(std::memory_order_relaxed) } });
+            }
+
+            // Drop the entries the owning thread may have overwritten while they were copied.
+            const uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+            const uint64_t firstValid = headAfter > zonesPerThread ? headAfter - zonesPerThread : 0;
+            const size_t skip = firstValid > start ? static_cast<size_t>(std::min(firstValid - start, head - start)) : 0;
+
+            for (size_t i = skip; i < zones.size(); ++i)
+            {
+                const auto& [zoneName, span] = zones[i];
+
+                if (!zoneName)
+                {
+                    continue;
+                }
+
+                const double ts = static_cast<double>(span.first - reg.startTicks) * microsPerTick;
+                const double dur = static_cast<double>(span.second - span.first) * microsPerTick;
+                out << ",\n{\"name\":";
+                writeJsonString(out, zoneName);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << std::fixed << ts << ",\"dur\":" << dur << "}";
+            }
+        }
+
+        out << "\n]}\n";
+
+        return static_cast<bool>(out);
+    }
+}
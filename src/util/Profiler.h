@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Low-overhead CPU zone profiler. Zones are timestamped with the TSC (steady_clock where unavailable) and
+// recorded into a per-thread lock-free ring, so it can stay enabled in production builds. The most recent
+// zones of every thread can be dumped as Chrome trace JSON (chrome://tracing, Perfetto) on demand.
+namespace profiler
+{
+    uint64_t now();
+
+    void record(const char* name, uint64_t begin, uint64_t end);
+    void setThreadName(const char* name);
+    void setEnabled(bool enabled);
+    bool enabled();
+
+    // Converts a tick delta to seconds.
+    double ticksToSeconds(uint64_t ticks);
+
+    // Writes every buffered zone to a Chrome trace JSON file.
+    bool writeChromeTrace(const std::string& path);
+
+    // Records the enclosing scope as a zone. The name must be a string literal.
+    class Zone
+    {
+    public:
+        explicit Zone(const char* name) : mName(name), mBegin(now()) {}
+        ~Zone()
+        {
+            record(mName, mBegin, now());
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char* mName;
+        uint64_t mBegin;
+    };
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
@@ -0,0 +1,151 @@
+#include "TiledImageWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+    size_t sampleBytes(ImageFormat format)
+    {
+        return format == ImageFormat::ExrHalf ? sizeof(uint16_t) : sizeof(float);
+    }
+
+    // EXR line block: int32 y, int32 byte count, then the B, G and R planes of the line.
+    uint64_t exrBlockBytes(uint32_t width, ImageFormat format)
+    {
+        return 2 * sizeof(int32_t) + static_cast<uint64_t>(width) * 3 * sampleBytes(format);
+    }
+}
+
+void TiledImageWriter::open(const std::string& path, uint32_t width, uint32_t height, ImageFormat format)
+{
+    if (format == ImageFormat::Png)
+    {
+        throw std::runtime_error("Tiled output must be PFM or EXR, PNG cannot be written out of order");
+    }
+
+    mFile.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!mFile)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+
+    mPath = path;
+    mFormat = format;
+    mWidth = width;
+    mHeight = height;
+    uint64_t fileBytes = 0;
+
+    if (format == ImageFormat::Pfm)
+    {
+        const std::string header = pfmHeader(width, height);
+        mFile.write(header.data(), static_cast<std::streamsize>(header.size()));
+        mDataOffset = header.size();
+        fileBytes = mDataOffset + static_cast<uint64_t>(width) * height * sizeof(glm::vec3);
+    }
+    else
+    {
+        const std::vector<uint8_t> header = exrHeader(width, height, format == ImageFormat::ExrHalf);
+        const uint64_t blockBytes = exrBlockBytes(width, format);
+        mDataOffset = header.size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+        fileBytes = mDataOffset + blockBytes * height;
+
+        std::vector<uint64_t> offsets(height);
+
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            offsets[y] = mDataOffset + blockBytes * y;
+        }
+
+        mFile.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        mFile.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+
+        // Block headers up front; tiles only fill in the planes.
+        const int32_t lineBytes = static_cast<int32_t>(blockBytes - 2 * sizeof(int32_t));
+
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const int32_t blockHeader[2] = { static_cast<int32_t>(y), lineBytes };
+            mFile.seekp(static_cast<std::streamoff>(offsets[y]));
+            mFile.write(reinterpret_cast<const char*>(blockHeader), sizeof(blockHeader));
+        }
+    }
+
+    // Extend to the final size, so tiles can land anywhere.
+    mFile.seekp(static_cast<std::streamoff>(fileBytes - 1));
+    mFile.put(0);
+
+    if (!mFile)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+void TiledImageWriter::writeTile(uint32_t x, uint32_t y, const Image& tile)
+{
+    if (x >= mWidth || y >= mHeight)
+    {
+        return;
+    }
+
+    const uint32_t columns = std::min(tile.width, mWidth - x);
+    const uint32_t rows = std::min(tile.height, mHeight - y);
+
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        const glm::vec3* source = &tile.pixels[static_cast<size_t>(row) * tile.width];
+        const uint32_t imageRow = y + row;
+
+        if (mFormat == ImageFormat::Pfm)
+        {
+            // PFM rows run bottom to top.
+            const uint64_t offset = mDataOffset + (static_cast<uint64_t>(mHeight - 1 - imageRow) * mWidth + x) * sizeof(glm::vec3);
+            mFile.seekp(static_cast<std::streamoff>(offset));
+            mFile.write(reinterpret_cast<const char*>(source), static_cast<std::streamsize>(columns * sizeof(glm::vec3)));
+
+            continue;
+        }
+
+        const size_t bytes = sampleBytes(mFormat);
+        const uint64_t planeBytes = static_cast<uint64_t>(mWidth) * bytes;
+        const uint64_t block = mDataOffset + exrBlockBytes(mWidth, mFormat) * imageRow + 2 * sizeof(int32_t);
+        mRow.resize(columns * bytes);
+
+        for (int channel = 2; channel >= 0; --channel)
+        {
+            for (uint32_t column = 0; column < columns; ++column)
+            {
+                if (mFormat == ImageFormat::ExrHalf)
+                {
+                    const uint16_t half = glm::packHalf1x16(source[column][channel]);
+                    std::memcpy(&mRow[column * bytes], &half, bytes);
+                }
+                else
+                {
+                    std::memcpy(&mRow[column * bytes], &source[column][channel], bytes);
+                }
+            }
+
+            mFile.seekp(static_cast<std::streamoff>(block + planeBytes * (2 - channel) + x * bytes));
+            mFile.write(reinterpret_cast<const char*>(mRow.data()), static_cast<std::streamsize>(mRow.size()));
+        }
+    }
+
+    if (!mFile)
+    {
+        throw std::runtime_error("Failed to write " + mPath);
+    }
+}
+
+void TiledImageWriter::close()
+{
+    mFile.close();
+
+    if (mFile.fail())
+    {
+        throw std::runtime_error("Failed to write " + mPath);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ImageEncode.h"
+
+// Writes an uncompressed PFM or EXR whose pixels arrive one tile at a time, in any order. The file is laid out
+// when it is opened and each tile row is written in place, so memory stays at one tile whatever the image size.
+class TiledImageWriter
+{
+public:
+    TiledImageWriter() = default;
+    ~TiledImageWriter() = default;
+
+    // Pfm, ExrHalf or ExrFloat. Throws on I/O errors.
+    void open(const std::string& path, uint32_t width, uint32_t height, ImageFormat format);
+
+    // Writes the tile with its top-left pixel at (x, y); the parts outside the image are dropped.
+    void writeTile(uint32_t x, uint32_t y, const Image& tile);
+
+    void close();
+
+private:
+    std::fstream mFile;
+    std::string mPath;
+    ImageFormat mFormat = ImageFormat::Pfm;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    uint64_t mDataOffset = 0; // First pixel row (PFM) or first line block (EXR).
+    std::vector<uint8_t> mRow;
+};
@@ -0,0 +1,98 @@
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(uint32_t threadCount, const char* name)
+{
+    stop();
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+    }
+
+    mName = name;
+    mStopping = false;
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        mThreads.emplace_back([this]() { run(); });
+    }
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+
+    mWake.notify_all();
+
+    for (auto& thread : mThreads)
+    {
+        thread.join();
+    }
+
+    mThreads.clear();
+}
+
+void WorkerPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+
+    mWake.notify_one();
+}
+
+void WorkerPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() { return mJobs.empty() && mRunning == 0; });
+}
+
+size_t WorkerPool::pending() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mJobs.size() + mRunning;
+}
+
+void WorkerPool::run()
+{
+    profiler::setThreadName(mName.c_str());
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+        mWake.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+
+        if (mJobs.empty())
+        {
+            return;
+        }
+
+        std::function<void()> job = std::move(mJobs.front());
+        mJobs.pop_front();
+        ++mRunning;
+        lock.unlock();
+
+        job();
+
+        lock.lock();
+        --mRunning;
+
+        if (mJobs.empty() && mRunning == 0)
+        {
+            mIdle.notify_all();
+        }
+    }
+}
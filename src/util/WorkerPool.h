@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed set of background threads running queued jobs in submission order. Jobs must not throw.
+class WorkerPool
+{
+public:
+    WorkerPool() = default;
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // 0 threads picks one per hardware thread, minus one for the render thread.
+    void start(uint32_t threadCount, const char* name);
+
+    // Runs every queued job, then joins the threads.
+    void stop();
+
+    void submit(std::function<void()> job);
+
+    // Blocks until the queue is empty and no job is running.
+    void waitIdle();
+
+    // Queued plus running jobs.
+    size_t pending() const;
+
+    uint32_t threadCount() const
+    {
+        return static_cast<uint32_t>(mThreads.size());
+    }
+
+private:
+    void run();
+
+    std::vector<std::thread> mThreads;
+    std::deque<std::function<void()>> mJobs;
+    mutable std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mIdle;
+    size_t mRunning = 0;
+    bool mStopping = false;
+    std::string mName;
+};
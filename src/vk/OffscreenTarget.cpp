@@ -0,0 +1,248 @@
+#include "OffscreenTarget.h"
+#include "VulkanContext.h"
+#include "../util/Check.h"
+
+#include <stdexcept>
+
+namespace
+{
+    void checkExportSupport(VkPhysicalDevice physical, const VkImageCreateInfo& imageInfo)
+    {
+        VkPhysicalDeviceExternalImageFormatInfo externalInfo{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO };
+        externalInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+        VkPhysicalDeviceImageFormatInfo2 formatInfo{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2, &externalInfo };
+        formatInfo.format = imageInfo.format;
+        formatInfo.type = imageInfo.imageType;
+        formatInfo.tiling = imageInfo.tiling;
+        formatInfo.usage = imageInfo.usage;
+
+        VkExternalImageFormatProperties externalProperties{ VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES };
+        VkImageFormatProperties2 properties{ VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2, &externalProperties };
+
+        if (vkGetPhysicalDeviceImageFormatProperties2(physical, &formatInfo, &properties) != VK_SUCCESS ||
+            !(externalProperties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT))
+        {
+            throw std::runtime_error("The device cannot export RGBA8 storage images as opaque fds");
+        }
+
+        VkSemaphoreTypeCreateInfo timelineInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+
+        VkPhysicalDeviceExternalSemaphoreInfo semaphoreInfo{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO, &timelineInfo };
+        semaphoreInfo.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+        VkExternalSemaphoreProperties semaphoreProperties{ VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES };
+        vkGetPhysicalDeviceExternalSemaphoreProperties(physical, &semaphoreInfo, &semaphoreProperties);
+
+        if (!(semaphoreProperties.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT))
+        {
+            throw std::runtime_error("The device cannot export timeline semaphores as opaque fds");
+        }
+    }
+}
+
+void OffscreenTarget::create(VulkanContext& vulkanContext, const VkExtent2D& extent, uint32_t imageCount, bool exportable)
+{
+    destroy(vulkanContext);
+
+    mTarget.extent = extent;
+    mTarget.presentable = false;
+    mTarget.format = format;
+
+    VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { extent.width, extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.pool = vulkanContext.pool(MemoryPool::RenderTargets);
+
+    VkExternalMemoryImageCreateInfo externalInfo{ VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO };
+
+    if (exportable)
+    {
+        if (!vulkanContext.externalFdEnabled())
+        {
+            throw std::runtime_error("Exportable render targets need VK_KHR_external_memory_fd and VK_KHR_external_semaphore_fd");
+        }
+
+        externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        imageInfo.pNext = &externalInfo;
+        imageInfo.usage = exportedUsage;
+        checkExportSupport(vulkanContext.physical(), imageInfo);
+
+        // Exported memory comes from its own pool, one dedicated allocation per image, so an importer maps exactly
+        // one image at offset 0.
+        mExportInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+        VmaPoolCreateInfo poolInfo{};
+        poolInfo.pMemoryAllocateNext = &mExportInfo;
+        VK_CHECK(vmaFindMemoryTypeIndexForImageInfo(vulkanContext.allocator(), &imageInfo, &allocInfo, &poolInfo.memoryTypeIndex));
+        VK_CHECK(vmaCreatePool(vulkanContext.allocator(), &poolInfo, &mExportPool));
+        vmaSetPoolName(vulkanContext.allocator(), mExportPool, "Exported targets");
+
+        allocInfo.pool = mExportPool;
+        allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+        VkExportSemaphoreCreateInfo exportSemaphoreInfo{ VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO };
+        exportSemaphoreInfo.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+        VkSemaphoreTypeCreateInfo timelineInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, &exportSemaphoreInfo };
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+
+        VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &timelineInfo };
+        VK_CHECK(vkCreateSemaphore(vulkanContext.device(), &semaphoreInfo, nullptr, &mReadySemaphore));
+        mReleased.assign(imageCount, false);
+    }
+
+    for (uint32_t i = 0; i < imageCount; ++i)
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        VK_CHECK(vmaCreateImage(vulkanContext.allocator(), &imageInfo, &allocInfo, &image, &allocation, nullptr));
+        vulkanContext.trackAllocation(allocation, MemoryCategory::Swapchain, exportable ? "Exported target" : "Offscreen target");
+
+        VkImageViewCreateInfo viewInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = imageInfo.format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        VkImageView view = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateImageView(vulkanContext.device(), &viewInfo, nullptr, &view));
+
+        mTarget.images.push_back(image);
+        mTarget.imageViews.push_back(view);
+        mAllocations.push_back(allocation);
+    }
+}
+
+void OffscreenTarget::destroy(VulkanContext& vulkanContext)
+{
+    for (size_t i = 0; i < mTarget.images.size(); ++i)
+    {
+        vkDestroyImageView(vulkanContext.device(), mTarget.imageViews[i], nullptr);
+        vulkanContext.untrackAllocation(mAllocations[i], MemoryCategory::Swapchain);
+        vmaDestroyImage(vulkanContext.allocator(), mTarget.images[i], mAllocations[i]);
+    }
+
+    if (mReadySemaphore)
+    {
+        vkDestroySemaphore(vulkanContext.device(), mReadySemaphore, nullptr);
+        mReadySemaphore = VK_NULL_HANDLE;
+    }
+
+    if (mExportPool)
+    {
+        vmaDestroyPool(vulkanContext.allocator(), mExportPool);
+        mExportPool = VK_NULL_HANDLE;
+    }
+
+    mTarget = RenderTarget{};
+    mAllocations.clear();
+    mReleased.clear();
+}
+
+ExportedImage OffscreenTarget::exportImage(VulkanContext& vulkanContext, uint32_t imageIndex) const
+{
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(vulkanContext.allocator(), mAllocations[imageIndex], &info);
+
+    ExportedImage exported;
+    exported.fd = vulkanContext.exportMemoryFd(info.deviceMemory);
+    exported.size = info.size;
+    exported.memoryTypeIndex = info.memoryType;
+
+    return exported;
+}
+
+int OffscreenTarget::exportReadySemaphore(VulkanContext& vulkanContext) const
+{
+    return vulkanContext.exportSemaphoreFd(mReadySemaphore);
+}
+
+void OffscreenTarget::recordAcquireFromExternal(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t queueFamilyIndex)
+{
+    // Never handed over yet: there is nothing to take back.
+    if (!mReleased[imageIndex])
+    {
+        return;
+    }
+
+    VkImageMemoryBarrier acquire{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    acquire.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    acquire.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    acquire.srcAccessMask = 0;
+    acquire.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    acquire.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    acquire.dstQueueFamilyIndex = queueFamilyIndex;
+    acquire.image = mTarget.images[imageIndex];
+    acquire.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &acquire);
+
+    mReleased[imageIndex] = false;
+}
+
+void OffscreenTarget::recordReleaseToExternal(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t queueFamilyIndex)
+{
+    VkImageMemoryBarrier release{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    release.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    release.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    release.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    release.dstAccessMask = 0;
+    release.srcQueueFamilyIndex = queueFamilyIndex;
+    release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    release.image = mTarget.images[imageIndex];
+    release.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &release);
+
+    mReleased[imageIndex] = true;
+}
+
+void OffscreenTarget::recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkBuffer buffer, VkDeviceSize offset) const
+{
+    VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.image = mTarget.images[imageIndex];
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &toTransfer);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = offset;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { mTarget.extent.width, mTarget.extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, mTarget.images[imageIndex], VK_IMAGE_LAYOUT_GENERAL, buffer, 1, &region);
+
+    // The next frame's dispatch waits on the transfer stage before writing the image again.
+    VkImageMemoryBarrier toCompute = toTransfer;
+    toCompute.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toCompute.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkBufferMemoryBarrier toHost{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = buffer;
+    toHost.offset = offset;
+    toHost.size = imageBytes();
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+        nullptr, 1, &toHost, 1, &toCompute);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "RenderTarget.h"
+#include "vma/vk_mem_alloc.h"
+
+class VulkanContext;
+
+// An image's memory as another process imports it: a dedicated allocation of size bytes in memoryTypeIndex.
+struct ExportedImage
+{
+    int fd = -1; // Owned by the caller.
+    VkDeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+};
+
+// RGBA8 storage images standing in for the swapchain when rendering without a window.
+//
+// Exportable targets put each image in its own exportable allocation (VK_KHR_external_memory_fd) and add an
+// exportable timeline semaphore, so another local process can read finished frames in place: the producer signals
+// the semaphore after each frame and the consumer waits for that value on its own queue. Ownership of an image
+// moves to VK_QUEUE_FAMILY_EXTERNAL after every frame and back before the next, as the importer expects.
+class OffscreenTarget
+{
+public:
+    OffscreenTarget() = default;
+    ~OffscreenTarget() = default;
+
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    // Exportable targets need VulkanContext::externalFdEnabled and throw when the device cannot export the images.
+    void create(VulkanContext& vulkanContext, const VkExtent2D& extent, uint32_t imageCount = 1, bool exportable = false);
+    void destroy(VulkanContext& vulkanContext);
+
+    const RenderTarget& target() const
+    {
+        return mTarget;
+    }
+
+    // Records a copy of an image's RGBA8 pixels (row-major, tightly packed) into buffer, made visible to the host.
+    // Record it after the frame's dispatch.
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkBuffer buffer, VkDeviceSize offset) const;
+
+    VkDeviceSize imageBytes() const
+    {
+        return static_cast<VkDeviceSize>(mTarget.extent.width) * mTarget.extent.height * 4;
+    }
+
+    bool exportable() const
+    {
+        return mReadySemaphore != VK_NULL_HANDLE;
+    }
+
+    // Importers create their images with the same format, usage and extent.
+    static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr VkImageUsageFlags exportedUsage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    ExportedImage exportImage(VulkanContext& vulkanContext, uint32_t imageIndex) const;
+    int exportReadySemaphore(VulkanContext& vulkanContext) const;
+
+    // Timeline semaphore of an exportable target; signal it in the submission that finishes a frame.
+    VkSemaphore readySemaphore() const
+    {
+        return mReadySemaphore;
+    }
+
+    // Around the tracer's work on an exportable image: takes it back from the importer before, and hands it over after.
+    // The image stays in GENERAL.
+    void recordAcquireFromExternal(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t queueFamilyIndex);
+    void recordReleaseToExternal(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t queueFamilyIndex);
+
+private:
+    RenderTarget mTarget;
+    std::vector<VmaAllocation> mAllocations;
+
+    // Exportable targets.
+    VmaPool mExportPool = VK_NULL_HANDLE;
+    VkExportMemoryAllocateInfo mExportInfo{ VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO }; // Referenced by mExportPool.
+    VkSemaphore mReadySemaphore = VK_NULL_HANDLE;
+    std::vector<bool> mReleased; // Ownership is with VK_QUEUE_FAMILY_EXTERNAL.
+};
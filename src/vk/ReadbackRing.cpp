@@ -0,0 +1,134 @@
+#include "ReadbackRing.h"
+#include "VulkanContext.h"
+#include "../util/Check.h"
+
+void ReadbackRing::create(VulkanContext& vulkanContext, uint32_t slotCount, VkDeviceSize slotBytes)
+{
+    destroy(vulkanContext);
+
+    mSlots = std::make_unique<Slot[]>(slotCount);
+    mSlotCount = slotCount;
+    mSlotBytes = slotBytes;
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = slotBytes;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+
+    for (uint32_t i = 0; i < slotCount; ++i)
+    {
+        Slot& slot = mSlots[i];
+        VmaAllocationInfo info{};
+        VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &slot.buffer, &slot.allocation, &info));
+        vulkanContext.trackAllocation(slot.allocation, MemoryCategory::Readback, "Readback ring");
+        slot.mapped = info.pMappedData;
+        VK_CHECK(vkCreateFence(vulkanContext.device(), &fenceInfo, nullptr, &slot.fence));
+    }
+}
+
+void ReadbackRing::destroy(VulkanContext& vulkanContext)
+{
+    for (uint32_t i = 0; i < mSlotCount; ++i)
+    {
+        Slot& slot = mSlots[i];
+
+        if (slot.state.load() == SlotState::InFlight)
+        {
+            VK_CHECK(vkWaitForFences(vulkanContext.device(), 1, &slot.fence, VK_TRUE, UINT64_MAX));
+        }
+
+        vkDestroyFence(vulkanContext.device(), slot.fence, nullptr);
+        vulkanContext.untrackAllocation(slot.allocation, MemoryCategory::Readback);
+        vmaDestroyBuffer(vulkanContext.allocator(), slot.buffer, slot.allocation);
+    }
+
+    mSlots.reset();
+    mSlotCount = 0;
+    mNextSlot = 0;
+    mSlotBytes = 0;
+}
+
+int32_t ReadbackRing::acquire()
+{
+    for (uint32_t i = 0; i < mSlotCount; ++i)
+    {
+        const uint32_t index = (mNextSlot + i) % mSlotCount;
+        SlotState expected = SlotState::Free;
+
+        if (mSlots[index].state.compare_exchange_strong(expected, SlotState::Recorded))
+        {
+            mNextSlot = (index + 1) % mSlotCount;
+
+            return static_cast<int32_t>(index);
+        }
+    }
+
+    return -1;
+}
+
+void ReadbackRing::submit(VulkanContext& vulkanContext, uint32_t slot)
+{
+    // An empty submission signals its fence once all earlier work on the queue has completed.
+    VK_CHECK(vkResetFences(vulkanContext.device(), 1, &mSlots[slot].fence));
+    VK_CHECK(vkQueueSubmit(vulkanContext.graphicsQueue(), 0, nullptr, mSlots[slot].fence));
+    mSlots[slot].state.store(SlotState::InFlight);
+}
+
+void ReadbackRing::cancel(uint32_t slot)
+{
+    mSlots[slot].state.store(SlotState::Free);
+}
+
+void ReadbackRing::poll(VulkanContext& vulkanContext, std::vector<uint32_t>& ready)
+{
+    for (uint32_t i = 0; i < mSlotCount; ++i)
+    {
+        Slot& slot = mSlots[i];
+
+        if (slot.state.load() != SlotState::InFlight || vkGetFenceStatus(vulkanContext.device(), slot.fence) != VK_SUCCESS)
+        {
+            continue;
+        }
+
+        vmaInvalidateAllocation(vulkanContext.allocator(), slot.allocation, 0, VK_WHOLE_SIZE);
+        slot.state.store(SlotState::Ready);
+        ready.push_back(i);
+    }
+}
+
+void ReadbackRing::release(uint32_t slot)
+{
+    mSlots[slot].state.store(SlotState::Free);
+}
+
+bool ReadbackRing::idle() const
+{
+    for (uint32_t i = 0; i < mSlotCount; ++i)
+    {
+        if (mSlots[i].state.load() != SlotState::Free)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ReadbackRing::hasFreeSlot() const
+{
+    for (uint32_t i = 0; i < mSlotCount; ++i)
+    {
+        if (mSlots[i].state.load() == SlotState::Free)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "vma/vk_mem_alloc.h"
+
+class VulkanContext;
+
+// Ring of persistently mapped host-visible buffers for GPU-to-CPU copies that never stall the render loop.
+//
+// A slot cycles Free -> Recorded (acquire, copy recorded into the frame) -> InFlight (submit, fence queued) ->
+// Ready (poll saw the fence) -> Free (release, from any thread once the consumer is done with the bytes).
+// When every slot is busy, acquire fails and the caller drops the readback instead of waiting.
+class ReadbackRing
+{
+public:
+    ReadbackRing() = default;
+    ~ReadbackRing() = default;
+
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    void create(VulkanContext& vulkanContext, uint32_t slotCount, VkDeviceSize slotBytes);
+
+    // Waits for outstanding copies; consumers must have released their slots.
+    void destroy(VulkanContext& vulkanContext);
+
+    // Returns a free slot, or -1 when all of them are still in flight or being consumed.
+    int32_t acquire();
+
+    // Call after the submission holding the slot's copy; queues a fence that signals once that work completes.
+    void submit(VulkanContext& vulkanContext, uint32_t slot);
+
+    // Returns a recorded slot to the ring when its command buffer was never submitted.
+    void cancel(uint32_t slot);
+
+    // Non-blocking. Appends the slots whose copy has landed; their bytes are readable until release.
+    void poll(VulkanContext& vulkanContext, std::vector<uint32_t>& ready);
+
+    // Thread safe.
+    void release(uint32_t slot);
+
+    // True when no slot is recorded, in flight or held by a consumer.
+    bool idle() const;
+
+    // True when acquire would succeed.
+    bool hasFreeSlot() const;
+
+    VkBuffer buffer(uint32_t slot) const
+    {
+        return mSlots[slot].buffer;
+    }
+
+    const void* data(uint32_t slot) const
+    {
+        return mSlots[slot].mapped;
+    }
+
+    VkDeviceSize slotBytes() const
+    {
+        return mSlotBytes;
+    }
+
+    uint32_t slotCount() const
+    {
+        return mSlotCount;
+    }
+
+private:
+    enum class SlotState : uint32_t
+    {
+        Free,
+        Recorded,
+        InFlight,
+        Ready
+    };
+
+    struct Slot
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkFence fence = VK_NULL_HANDLE;
+        std::atomic<SlotState> state{ SlotState::Free };
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    uint32_t mSlotCount = 0;
+    uint32_t mNextSlot = 0;
+    VkDeviceSize mSlotBytes = 0;
+};
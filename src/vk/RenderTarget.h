@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// Images the ray tracer writes its display output to: the swapchain images, or offscreen images in headless runs.
+struct RenderTarget
+{
+    VkExtent2D extent{};
+    std::vector<VkImage> images;
+    std::vector<VkImageView> imageViews;
+
+    // Presentable targets are handed over in COLOR_ATTACHMENT_OPTIMAL for the overlay pass and come back in
+    // PRESENT_SRC_KHR; offscreen targets stay in GENERAL.
+    bool presentable = true;
+
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    bool transferDst = false; // Whether the images were created with VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+};
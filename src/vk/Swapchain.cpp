@@ -129,6 +129,7 @@ void Swapchain::destroy(VulkanContext& vulkanContext)
 
     mSwapchainBundle.swapchain = VK_NULL_HANDLE;
     mSwapchainBundle.images.clear();
+    vulkanContext.setCategoryBytes(MemoryCategory::Swapchain, 0);
 }
 
 void Swapchain::createSwapchain(VulkanContext& vulkanContext, Window& window, VkSwapchainKHR oldSwap)
@@ -152,7 +153,9 @@ void Swapchain::createSwapchain(VulkanContext& vulkanContext, Window& window, Vk
     createInfo.imageColorSpace = format.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    // Transfer usage, where supported, lets presented frames be uploaded or read back by copies.
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT |
+        (support.caps.supportedUsageFlags & (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT));
 
     uint32_t queueIndices[] = { vulkanContext.graphicsFamilyIndex(), vulkanContext.presentFamilyIndex() };
 
@@ -175,12 +178,16 @@ void Swapchain::createSwapchain(VulkanContext& vulkanContext, Window& window, Vk
 
     VK_CHECK(vkCreateSwapchainKHR(vulkanContext.device(), &createInfo, nullptr, &mSwapchainBundle.swapchain));
     mSwapchainBundle.imageFormat = format.format;
+    mSwapchainBundle.imageUsage = createInfo.imageUsage;
     mSwapchainBundle.extent = extent;
 
     uint32_t count = 0;
     vkGetSwapchainImagesKHR(vulkanContext.device(), mSwapchainBundle.swapchain, &count, nullptr);
     mSwapchainBundle.images.resize(count);
     vkGetSwapchainImagesKHR(vulkanContext.device(), mSwapchainBundle.swapchain, &count, mSwapchainBundle.images.data());
+
+    // Swapchain images are owned by the driver; account for them as 4 bytes per pixel.
+    vulkanContext.setCategoryBytes(MemoryCategory::Swapchain, static_cast<VkDeviceSize>(extent.width) * extent.height * 4 * count);
 }
 
 void Swapchain::createImageViews(VulkanContext& vulkanContext)
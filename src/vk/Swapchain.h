@@ -3,6 +3,8 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 
+#include "RenderTarget.h"
+
 class VulkanContext;
 class Window;
 
@@ -10,6 +12,7 @@ struct SwapchainBundle
 {
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     VkFormat imageFormat = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags imageUsage = 0;
     VkExtent2D extent{};
     std::vector<VkImage> images;
     std::vector<VkImageView> imageViews;
@@ -35,6 +38,13 @@ public:
         return mSwapchainBundle;
     }
 
+    // The swapchain images as ray tracer output.
+    RenderTarget renderTarget() const
+    {
+        return { mSwapchainBundle.extent, mSwapchainBundle.images, mSwapchainBundle.imageViews, true, mSwapchainBundle.imageFormat,
+            (mSwapchainBundle.imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0 };
+    }
+
 private:
     SwapchainBundle mSwapchainBundle{};
 
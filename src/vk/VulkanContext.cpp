@@ -7,6 +7,7 @@
 
 #include "VulkanContext.h"
 #include "../util/Check.h"
+#include "../util/Env.h"
 #include "../util/Logger.h"
 #include "../platform/Window.h"
 
@@ -17,6 +18,8 @@
 #include <cassert>
 #include <stdexcept>
 #include <array>
+#include <algorithm>
+#include <fstream>
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -26,18 +29,19 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 {
     (void)types;
     (void)userData;
-    const char* tag = "[VK] ";
-
+    // Validation can fire thousands of times per frame; the logger rate-limits identical messages.
     if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
     {
-        tag = "[VK-ERROR] ";
+        logger::error("[VK] %s", callbackData->pMessage);
     }
     else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
     {
-        tag = "[VK-WARN ] ";
+        logger::warn("[VK] %s", callbackData->pMessage);
+    }
+    else
+    {
+        logger::info("[VK] %s", callbackData->pMessage);
     }
-
-    logger::warn("%s%s", tag, callbackData->pMessage);
 
     return VK_FALSE;
 }
@@ -65,9 +69,10 @@ VulkanContext::~VulkanContext()
     destroy();
 }
 
-void VulkanContext::createInstance(bool enableValidation)
+void VulkanContext::createInstance(bool enableValidation, bool headless)
 {
     mEnableValidation = enableValidation;
+    mHeadless = headless;
 
     VkApplicationInfo appInfo{ VK_STRUCTURE_TYPE_APPLICATION_INFO };
     appInfo.pApplicationName = "Vulkan Ray Tracer";
@@ -192,6 +197,11 @@ static bool hasDeviceExtension(VkPhysicalDevice device, const char* name)
 
 bool VulkanContext::checkDeviceExtensions(VkPhysicalDevice device) const
 {
+    if (mHeadless)
+    {
+        return true;
+    }
+
     static const char* required[] =
     {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -232,6 +242,24 @@ QueueFamilyIndices VulkanContext::findQueueFamilies(VkPhysicalDevice device) con
             indices.graphicsFamily = i;
         }
 
+        if (!mSurface)
+        {
+            // Headless: the kernel only needs compute, which graphics queues also provide.
+            if (!indices.graphicsFamily && (family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            {
+                indices.graphicsFamily = i;
+            }
+
+            indices.presentFamily = indices.graphicsFamily;
+
+            if (indices.isComplete() && (family.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                break;
+            }
+
+            continue;
+        }
+
         VkBool32 presentSupport = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
 
@@ -266,17 +294,31 @@ void VulkanContext::pickPhysicalDevice()
     QueueFamilyIndices bestIndices{};
     VkDeviceSize bestDeviceLocalMemory = 0;
 
+    // Substring of the device name, e.g. "llvmpipe" to force lavapipe next to a hardware GPU.
+    const std::string requestedDevice = readEnv("VRAYT_DEVICE");
+
     for (auto device : devices)
     {
         if (!checkDeviceExtensions(device))
         {
             continue;
         }
-        if (!supportsRayTracing(device))
+        if (!mHeadless && !supportsRayTracing(device))
         {
             continue;
         }
 
+        if (!requestedDevice.empty())
+        {
+            VkPhysicalDeviceProperties properties{};
+            vkGetPhysicalDeviceProperties(device, &properties);
+
+            if (std::strstr(properties.deviceName, requestedDevice.c_str()) == nullptr)
+            {
+                continue;
+            }
+        }
+
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         if (!indices.isComplete())
@@ -285,7 +327,7 @@ void VulkanContext::pickPhysicalDevice()
         }
 
         VkDeviceSize deviceLocalMemory = getDeviceLocalMemorySize(device);
-        if (deviceLocalMemory > bestDeviceLocalMemory)
+        if (bestDevice == VK_NULL_HANDLE || deviceLocalMemory > bestDeviceLocalMemory)
         {
             bestDevice = device;
             bestIndices = indices;
@@ -295,7 +337,9 @@ void VulkanContext::pickPhysicalDevice()
 
     if (bestDevice == VK_NULL_HANDLE)
     {
-        throw std::runtime_error("No suitable device found (ray tracing + swapchain).");
+        throw std::runtime_error(mHeadless
+            ? "No suitable device found (compute queue)."
+            : "No suitable device found (ray tracing + swapchain).");
     }
 
     if (!bestIndices.graphicsFamily || !bestIndices.presentFamily)
@@ -326,11 +370,11 @@ void VulkanContext::createDevice()
     supportedAcceleration.pNext = &supportedRayQuery;
     vkGetPhysicalDeviceFeatures2(mPhysical, &supportedFeatures);
 
-    if (!supportedVulkan12.bufferDeviceAddress ||
+    if (!mHeadless && (!supportedVulkan12.bufferDeviceAddress ||
         !supportedVulkan12.runtimeDescriptorArray ||
         !supportedVulkan12.descriptorBindingPartiallyBound ||
         !supportedRayTracing.rayTracingPipeline ||
-        !supportedAcceleration.accelerationStructure)
+        !supportedAcceleration.accelerationStructure))
     {
         throw std::runtime_error("Required Vulkan features for ray tracing are not supported.");
     }
@@ -345,10 +389,10 @@ void VulkanContext::createDevice()
     rayTracingFeatures.rayTracingPipeline = VK_TRUE;
 
     VkPhysicalDeviceVulkan12Features vulkan12Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
-    vulkan12Features.bufferDeviceAddress = VK_TRUE;
+    vulkan12Features.bufferDeviceAddress = supportedVulkan12.bufferDeviceAddress;
     vulkan12Features.descriptorIndexing = supportedVulkan12.descriptorIndexing ? VK_TRUE : VK_FALSE;
-    vulkan12Features.runtimeDescriptorArray = VK_TRUE;
-    vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan12Features.runtimeDescriptorArray = supportedVulkan12.runtimeDescriptorArray;
+    vulkan12Features.descriptorBindingPartiallyBound = supportedVulkan12.descriptorBindingPartiallyBound;
     vulkan12Features.timelineSemaphore = supportedVulkan12.timelineSemaphore ? VK_TRUE : VK_FALSE;
     vulkan12Features.vulkanMemoryModel = supportedVulkan12.vulkanMemoryModel ? VK_TRUE : VK_FALSE;
     vulkan12Features.vulkanMemoryModelDeviceScope = supportedVulkan12.vulkanMemoryModelDeviceScope ? VK_TRUE : VK_FALSE;
@@ -359,11 +403,15 @@ void VulkanContext::createDevice()
     deviceFeatures.features.vertexPipelineStoresAndAtomics = supportedFeatures.features.vertexPipelineStoresAndAtomics;
     deviceFeatures.features.shaderInt64 = supportedFeatures.features.shaderInt64;
 
-    // Chain: core features -> Vulkan 1.2 -> RT pipeline -> acceleration -> ray query.
+    // Chain: core features -> Vulkan 1.2 -> RT pipeline -> acceleration -> ray query. Headless stops after 1.2.
     deviceFeatures.pNext = &vulkan12Features;
-    vulkan12Features.pNext = &rayTracingFeatures;
-    rayTracingFeatures.pNext = &accelerationFeatures;
-    accelerationFeatures.pNext = &rayQueryFeatures;
+
+    if (!mHeadless)
+    {
+        vulkan12Features.pNext = &rayTracingFeatures;
+        rayTracingFeatures.pNext = &accelerationFeatures;
+        accelerationFeatures.pNext = &rayQueryFeatures;
+    }
 
     float queuePriority = 1.0f;
     std::vector<VkDeviceQueueCreateInfo> queueInfos;
@@ -379,17 +427,40 @@ void VulkanContext::createDevice()
         queueInfos.push_back(queueCreateInfo);
     }
 
-    std::vector<const char*> extensions =
+    std::vector<const char*> extensions;
+
+    if (!mHeadless)
     {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
-        VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
-        VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
-    };
+        extensions =
+        {
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+            VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+            VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+            VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
+        };
 
-    if (rayQueryFeatures.rayQuery && hasDeviceExtension(mPhysical, VK_KHR_RAY_QUERY_EXTENSION_NAME))
+        if (rayQueryFeatures.rayQuery && hasDeviceExtension(mPhysical, VK_KHR_RAY_QUERY_EXTENSION_NAME))
+        {
+            extensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+        }
+    }
+
+    // Real per-heap budgets instead of VMA's 80%-of-heap estimate.
+    mMemoryBudgetEnabled = hasDeviceExtension(mPhysical, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    if (mMemoryBudgetEnabled)
     {
-        extensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // Zero-copy frame sharing with other local processes (exportable offscreen targets).
+    mExternalFdEnabled = hasDeviceExtension(mPhysical, VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) &&
+        hasDeviceExtension(mPhysical, VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
+
+    if (mExternalFdEnabled)
+    {
+        extensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
     }
 
     std::vector<const char*> layers;
@@ -412,6 +483,15 @@ void VulkanContext::createDevice()
     VK_CHECK(vkCreateDevice(mPhysical, &deviceInfo, nullptr, &mDevice));
     vkGetDeviceQueue(mDevice, mGraphicsFamilyIndex, 0, &mGraphicsQueue);
     vkGetDeviceQueue(mDevice, mPresentFamilyIndex, 0, &mPresentQueue);
+
+    if (mExternalFdEnabled)
+    {
+        mGetMemoryFd = reinterpret_cast<PFN_vkGetMemoryFdKHR>(vkGetDeviceProcAddr(mDevice, "vkGetMemoryFdKHR"));
+        mGetSemaphoreFd = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(vkGetDeviceProcAddr(mDevice, "vkGetSemaphoreFdKHR"));
+        mImportSemaphoreFd = reinterpret_cast<PFN_vkImportSemaphoreFdKHR>(vkGetDeviceProcAddr(mDevice, "vkImportSemaphoreFdKHR"));
+        mExternalFdEnabled = mGetMemoryFd && mGetSemaphoreFd && mImportSemaphoreFd;
+    }
+
     logger::info("Logical device created.");
 }
 
@@ -427,11 +507,63 @@ void VulkanContext::createAllocator()
     allocInfo.physicalDevice = mPhysical;
     allocInfo.device = mDevice;
     allocInfo.pVulkanFunctions = &functions;
+
+    if (mMemoryBudgetEnabled)
+    {
+        allocInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
     VK_CHECK(vmaCreateAllocator(&allocInfo, &mAllocator));
+    createPools();
 
     logger::info("VMA allocator created.");
 }
 
+void VulkanContext::createPools()
+{
+    // Representative resources pick each pool's memory type.
+    VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { 16, 16, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VmaAllocationCreateInfo imageAllocInfo{};
+    imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = 1024;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    VmaAllocationCreateInfo bufferAllocInfo{};
+    bufferAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+    uint32_t memoryTypes[static_cast<size_t>(MemoryPool::Count)]{};
+    VkResult found[static_cast<size_t>(MemoryPool::Count)]{};
+    found[static_cast<size_t>(MemoryPool::RenderTargets)] = vmaFindMemoryTypeIndexForImageInfo(mAllocator, &imageInfo, &imageAllocInfo, &memoryTypes[static_cast<size_t>(MemoryPool::RenderTargets)]);
+    found[static_cast<size_t>(MemoryPool::Scene)] = vmaFindMemoryTypeIndexForBufferInfo(mAllocator, &bufferInfo, &bufferAllocInfo, &memoryTypes[static_cast<size_t>(MemoryPool::Scene)]);
+
+    for (size_t i = 0; i < mPools.size(); ++i)
+    {
+        if (found[i] != VK_SUCCESS)
+        {
+            // Allocations fall back to the default pools.
+            logger::warn("No memory type for the %s pool, using default pools.", memoryPoolName(static_cast<MemoryPool>(i)));
+            continue;
+        }
+
+        VmaPoolCreateInfo poolInfo{};
+        poolInfo.memoryTypeIndex = memoryTypes[i];
+        poolInfo.flags = i == static_cast<size_t>(MemoryPool::RenderTargets) ? VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT : 0;
+        VK_CHECK(vmaCreatePool(mAllocator, &poolInfo, &mPools[i]));
+        vmaSetPoolName(mAllocator, mPools[i], memoryPoolName(static_cast<MemoryPool>(i)));
+    }
+}
+
 void VulkanContext::createCommandPoolsAndBuffers(uint32_t framesInFlight)
 {
     mFrames.resize(framesInFlight);
@@ -452,6 +584,11 @@ void VulkanContext::createCommandPoolsAndBuffers(uint32_t framesInFlight)
         VK_CHECK(vkAllocateCommandBuffers(mDevice, &allocInfo, &frameSync.cmdBuf));
     }
 
+    VkCommandPoolCreateInfo immediatePoolInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    immediatePoolInfo.queueFamilyIndex = mGraphicsFamilyIndex;
+    immediatePoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VK_CHECK(vkCreateCommandPool(mDevice, &immediatePoolInfo, nullptr, &mImmediatePool));
+
     logger::info("Per-frame command pools & buffers created.");
 }
 
@@ -477,6 +614,255 @@ void VulkanContext::waitIdle() const
     VK_CHECK(vkDeviceWaitIdle(mDevice));
 }
 
+const char* memoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Accumulation:
+        return "Accumulation";
+    case MemoryCategory::Scene:
+        return "Scene";
+    case MemoryCategory::Uniform:
+        return "Uniform";
+    case MemoryCategory::Swapchain:
+        return "Swapchain";
+    case MemoryCategory::Debug:
+        return "Debug views";
+    case MemoryCategory::Readback:
+        return "Readback";
+    default:
+        return "Unknown";
+    }
+}
+
+const char* memoryPoolName(MemoryPool pool)
+{
+    switch (pool)
+    {
+    case MemoryPool::RenderTargets:
+        return "Render targets";
+    case MemoryPool::Scene:
+        return "Scene";
+    default:
+        return "Unknown";
+    }
+}
+
+PoolStats VulkanContext::poolStats(MemoryPool kind) const
+{
+    PoolStats result;
+    VmaPool vmaPool = pool(kind);
+
+    if (!vmaPool)
+    {
+        return result;
+    }
+
+    VmaDetailedStatistics stats{};
+    vmaCalculatePoolStatistics(mAllocator, vmaPool, &stats);
+    result.blockCount = stats.statistics.blockCount;
+    result.blockBytes = stats.statistics.blockBytes;
+    result.allocationCount = stats.statistics.allocationCount;
+    result.allocationBytes = stats.statistics.allocationBytes;
+    result.freeRangeCount = stats.unusedRangeCount;
+    result.largestFreeRange = stats.unusedRangeCount ? stats.unusedRangeSizeMax : 0;
+
+    const VkDeviceSize freeBytes = result.blockBytes - result.allocationBytes;
+    result.fragmentation = freeBytes ? 1.0 - static_cast<double>(result.largestFreeRange) / static_cast<double>(freeBytes) : 0.0;
+
+    return result;
+}
+
+void VulkanContext::submitImmediate(const std::function<void(VkCommandBuffer)>& record) const
+{
+    VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    allocInfo.commandPool = mImmediatePool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VK_CHECK(vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    record(commandBuffer);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateFence(mDevice, &fenceInfo, nullptr, &fence));
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    VK_CHECK(vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, fence));
+    VK_CHECK(vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+
+    vkDestroyFence(mDevice, fence, nullptr);
+    vkFreeCommandBuffers(mDevice, mImmediatePool, 1, &commandBuffer);
+}
+
+int VulkanContext::exportMemoryFd(VkDeviceMemory memory) const
+{
+    if (!mExternalFdEnabled)
+    {
+        throw std::runtime_error("VK_KHR_external_memory_fd is not supported on this device");
+    }
+
+    VkMemoryGetFdInfoKHR info{ VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR };
+    info.memory = memory;
+    info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    int fd = -1;
+    VK_CHECK(mGetMemoryFd(mDevice, &info, &fd));
+
+    return fd;
+}
+
+int VulkanContext::exportSemaphoreFd(VkSemaphore semaphore) const
+{
+    if (!mExternalFdEnabled)
+    {
+        throw std::runtime_error("VK_KHR_external_semaphore_fd is not supported on this device");
+    }
+
+    VkSemaphoreGetFdInfoKHR info{ VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR };
+    info.semaphore = semaphore;
+    info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    int fd = -1;
+    VK_CHECK(mGetSemaphoreFd(mDevice, &info, &fd));
+
+    return fd;
+}
+
+void VulkanContext::importSemaphoreFd(VkSemaphore semaphore, int fd) const
+{
+    if (!mExternalFdEnabled)
+    {
+        throw std::runtime_error("VK_KHR_external_semaphore_fd is not supported on this device");
+    }
+
+    VkImportSemaphoreFdInfoKHR info{ VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR };
+    info.semaphore = semaphore;
+    info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+    info.fd = fd;
+    VK_CHECK(mImportSemaphoreFd(mDevice, &info));
+}
+
+std::string VulkanContext::deviceUuid() const
+{
+    VkPhysicalDeviceIDProperties ids{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+    VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &ids };
+    vkGetPhysicalDeviceProperties2(mPhysical, &properties);
+
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+
+    for (const uint8_t* uuid : { ids.deviceUUID, ids.driverUUID })
+    {
+        for (uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+        {
+            text += digits[uuid[i] >> 4];
+            text += digits[uuid[i] & 15];
+        }
+    }
+
+    return text;
+}
+
+std::vector<HeapBudget> VulkanContext::heapBudgets() const
+{
+    std::vector<HeapBudget> heaps;
+
+    if (!mAllocator)
+    {
+        return heaps;
+    }
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+    vmaGetMemoryProperties(mAllocator, &memoryProperties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+    vmaGetHeapBudgets(mAllocator, budgets);
+
+    for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; ++heap)
+    {
+        HeapBudget entry;
+        entry.heapIndex = heap;
+        entry.deviceLocal = (memoryProperties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        entry.size = memoryProperties->memoryHeaps[heap].size;
+        entry.usage = budgets[heap].usage;
+        entry.budget = budgets[heap].budget;
+        entry.blockBytes = budgets[heap].statistics.blockBytes;
+        entry.allocationBytes = budgets[heap].statistics.allocationBytes;
+        heaps.push_back(entry);
+    }
+
+    return heaps;
+}
+
+void VulkanContext::trackAllocation(VmaAllocation allocation, MemoryCategory category, const char* name)
+{
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(mAllocator, allocation, &info);
+    vmaSetAllocationName(mAllocator, allocation, name);
+    mCategoryBytes[static_cast<size_t>(category)] += info.size;
+}
+
+void VulkanContext::untrackAllocation(VmaAllocation allocation, MemoryCategory category)
+{
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(mAllocator, allocation, &info);
+    VkDeviceSize& total = mCategoryBytes[static_cast<size_t>(category)];
+    total -= std::min(total, info.size);
+}
+
+void VulkanContext::setCategoryBytes(MemoryCategory category, VkDeviceSize bytes)
+{
+    mCategoryBytes[static_cast<size_t>(category)] = bytes;
+}
+
+bool VulkanContext::writeAllocatorStatsJson(const std::string& path) const
+{
+    if (!mAllocator)
+    {
+        return false;
+    }
+
+    char* stats = nullptr;
+    vmaBuildStatsString(mAllocator, &stats, VK_TRUE);
+    std::ofstream out(path, std::ios::trunc);
+    out << stats;
+    vmaFreeStatsString(mAllocator, stats);
+
+    return static_cast<bool>(out);
+}
+
+void VulkanContext::queryMemoryUsage(uint64_t& usage, uint64_t& budget) const
+{
+    usage = 0;
+    budget = 0;
+
+    if (!mAllocator)
+    {
+        return;
+    }
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+    vmaGetMemoryProperties(mAllocator, &memoryProperties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+    vmaGetHeapBudgets(mAllocator, budgets);
+
+    for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; ++heap)
+    {
+        usage += budgets[heap].usage;
+        budget += budgets[heap].budget;
+    }
+}
+
 void VulkanContext::destroy()
 {
     if (mDevice)
@@ -502,6 +888,21 @@ void VulkanContext::destroy()
 
     mFrames.clear();
 
+    if (mImmediatePool)
+    {
+        vkDestroyCommandPool(mDevice, mImmediatePool, nullptr);
+        mImmediatePool = VK_NULL_HANDLE;
+    }
+
+    for (auto& pool : mPools)
+    {
+        if (pool)
+        {
+            vmaDestroyPool(mAllocator, pool);
+            pool = VK_NULL_HANDLE;
+        }
+    }
+
     if (mAllocator)
     {
         vmaDestroyAllocator(mAllocator);
@@ -537,6 +938,11 @@ void VulkanContext::destroy()
 
 void VulkanContext::getRequiredInstanceExtensions(std::vector<const char*>& out) const
 {
+    if (mHeadless)
+    {
+        return;
+    }
+
     uint32_t glfwCount = 0;
     const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwCount);
 
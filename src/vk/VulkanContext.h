@@ -4,6 +4,8 @@
 #include <vector>
 #include <optional>
 #include <string>
+#include <array>
+#include <functional>
 
 class Window;
 
@@ -20,6 +22,52 @@ struct QueueFamilyIndices
     }
 };
 
+// Resource categories for device memory accounting.
+enum class MemoryCategory : uint32_t
+{
+    Accumulation,
+    Scene,
+    Uniform,
+    Swapchain,
+    Debug, // Debug views such as the cost heatmap.
+    Readback, // Host-visible buffers the GPU writes for the CPU to read.
+    Count
+};
+
+const char* memoryCategoryName(MemoryCategory category);
+
+// Dedicated VMA pools, so resize churn and scene reloads do not fragment the general heaps.
+enum class MemoryPool : uint32_t
+{
+    RenderTargets, // Resolution-dependent images (accumulation and future AOV/denoise targets).
+    Scene, // Scene buffers.
+    Count
+};
+
+const char* memoryPoolName(MemoryPool pool);
+
+struct PoolStats
+{
+    uint32_t blockCount = 0;
+    VkDeviceSize blockBytes = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize allocationBytes = 0;
+    uint32_t freeRangeCount = 0;
+    VkDeviceSize largestFreeRange = 0;
+    double fragmentation = 0.0; // 1 - largest free range / free bytes.
+};
+
+struct HeapBudget
+{
+    uint32_t heapIndex = 0;
+    bool deviceLocal = false;
+    VkDeviceSize size = 0;
+    VkDeviceSize usage = 0; // Process-wide usage; exact with VK_EXT_memory_budget, otherwise estimated.
+    VkDeviceSize budget = 0;
+    VkDeviceSize blockBytes = 0; // Device memory blocks owned by VMA.
+    VkDeviceSize allocationBytes = 0; // Bytes in live VMA allocations.
+};
+
 struct FrameSync
 {
     VkSemaphore imageAvailable = VK_NULL_HANDLE;
@@ -34,8 +82,9 @@ public:
     VulkanContext() = default;
     ~VulkanContext();
 
-    // Lifecycle.
-    void createInstance(bool enableValidation);
+    // Lifecycle. Headless contexts have no surface and do not require the swapchain or ray tracing pipeline
+    // extensions, so any compute-capable device (including lavapipe) qualifies; skip createSurface for them.
+    void createInstance(bool enableValidation, bool headless = false);
     void setupDebugMessenger(bool enableValidation);
     void createSurface(Window& window);
     void pickPhysicalDevice();
@@ -70,6 +119,11 @@ public:
         return mSurface;
     }
 
+    bool headless() const
+    {
+        return mHeadless;
+    }
+
     VkQueue graphicsQueue() const
     {
         return mGraphicsQueue;
@@ -103,6 +157,60 @@ public:
     // Resize.
     void waitIdle() const;
 
+    // Current VMA usage and budget summed over all memory heaps, in bytes.
+    void queryMemoryUsage(uint64_t& usage, uint64_t& budget) const;
+
+    // Memory budget.
+    std::vector<HeapBudget> heapBudgets() const;
+
+    bool memoryBudgetEnabled() const
+    {
+        return mMemoryBudgetEnabled;
+    }
+
+    // External memory and semaphores as POSIX file descriptors, for sharing images with other local processes.
+    bool externalFdEnabled() const
+    {
+        return mExternalFdEnabled;
+    }
+
+    // Opaque file descriptors the caller owns. Throw when external fds are not enabled.
+    int exportMemoryFd(VkDeviceMemory memory) const;
+    int exportSemaphoreFd(VkSemaphore semaphore) const;
+
+    // Takes ownership of fd on success.
+    void importSemaphoreFd(VkSemaphore semaphore, int fd) const;
+
+    // Device and driver UUIDs in hex; memory and semaphores only move between processes where these match.
+    std::string deviceUuid() const;
+
+    // Names the allocation for VMA statistics and adds its size to the category total.
+    void trackAllocation(VmaAllocation allocation, MemoryCategory category, const char* name);
+
+    // Call before freeing a tracked allocation.
+    void untrackAllocation(VmaAllocation allocation, MemoryCategory category);
+
+    // For memory not allocated through VMA (e.g. swapchain images, estimated).
+    void setCategoryBytes(MemoryCategory category, VkDeviceSize bytes);
+
+    VkDeviceSize categoryBytes(MemoryCategory category) const
+    {
+        return mCategoryBytes[static_cast<size_t>(category)];
+    }
+
+    VmaPool pool(MemoryPool kind) const
+    {
+        return mPools[static_cast<size_t>(kind)];
+    }
+
+    PoolStats poolStats(MemoryPool kind) const;
+
+    // Records and submits a one-off command buffer on the graphics queue and waits for it.
+    void submitImmediate(const std::function<void(VkCommandBuffer)>& record) const;
+
+    // Writes vmaBuildStatsString (detailed map) to a JSON file.
+    bool writeAllocatorStatsJson(const std::string& path) const;
+
 private:
     // Debug utils.
     VkDebugUtilsMessengerEXT mDebugMessenger = VK_NULL_HANDLE;
@@ -119,16 +227,30 @@ private:
 
     // VMA.
     VmaAllocator mAllocator = VK_NULL_HANDLE;
+    bool mMemoryBudgetEnabled = false;
+
+    // External fds.
+    bool mExternalFdEnabled = false;
+    PFN_vkGetMemoryFdKHR mGetMemoryFd = nullptr;
+    PFN_vkGetSemaphoreFdKHR mGetSemaphoreFd = nullptr;
+    PFN_vkImportSemaphoreFdKHR mImportSemaphoreFd = nullptr;
+    std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> mCategoryBytes{};
+    std::array<VmaPool, static_cast<size_t>(MemoryPool::Count)> mPools{};
+
+    // One-off submissions.
+    VkCommandPool mImmediatePool = VK_NULL_HANDLE;
 
     // Per-frame.
     std::vector<FrameSync> mFrames;
 
     // Validation.
     bool mEnableValidation = false;
+    bool mHeadless = false;
 
     // Internal helpers.
     bool checkDeviceExtensions(VkPhysicalDevice device) const;
     void getRequiredInstanceExtensions(std::vector<const char*>& out) const;
+    void createPools();
 
     // Loading extension functions.
     static VkResult CreateDebugUtilsMessengerEXT(VkInstance inst,
@@ -0,0 +1,413 @@
+// Batch renderer for camera animations such as turntables and fly-throughs.
+//
+// Usage: animate --keyframes <file> [--out <dir>] [--fps F] [--spp N] [--spp-per-frame N] [--depth N]
+//                [--width W] [--height H] [--format pfm|exr|exr-float|png]... [--first N] [--last N]
+//                [--workers N] [--csv <file>] [--validation]
+//
+// The keyframe file has one keyframe per line, blank lines and '#' comments are skipped:
+//
+//     time  pos.x pos.y pos.z  target.x target.y target.z  [fov [aperture [focus]]]
+//
+// Times are in seconds and increasing. Positions and targets follow a Catmull-Rom spline through the keys; fov
+// (degrees, default 20), aperture (default 0) and focus (default: distance to the target) are interpolated
+// linearly. Every frame at --fps between the first and last key is accumulated to --spp samples per pixel and
+// written to <out>/frame_<NNNNN>.<ext>.
+//
+// The renderer, scene and pipelines stay resident for the whole run. The last dispatch of frame N also copies
+// its accumulation to a staging buffer; resolving, encoding and writing then run on worker threads while the
+// GPU traces frame N+1. Rendering only waits ("stall") when the encoders fall more than three frames behind.
+
+#include "../../src/core/FrameExporter.h"
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Keyframe
+    {
+        double time = 0.0;
+        glm::vec3 position{ 0.0f };
+        glm::vec3 target{ 0.0f };
+        float verticalFov = 20.0f;
+        float aperture = 0.0f;
+        float focusDistance = -1.0f; // Negative: distance to the target.
+    };
+
+    struct Options
+    {
+        std::string keyframesPath;
+        std::string outDir = "frames";
+        double fps = 24.0;
+        uint32_t spp = 256;
+        uint32_t sppPerFrame = 8;
+        uint32_t maxDepth = 12;
+        uint32_t width = 1280;
+        uint32_t height = 720;
+        std::vector<ImageFormat> formats;
+        uint32_t first = 0;
+        uint32_t last = UINT32_MAX;
+        uint32_t workers = 0;
+        std::string csvPath;
+        bool validation = false;
+    };
+
+    ImageFormat parseFormat(const std::string& name)
+    {
+        if (name == "pfm")
+        {
+            return ImageFormat::Pfm;
+        }
+        if (name == "exr")
+        {
+            return ImageFormat::ExrHalf;
+        }
+        if (name == "exr-float")
+        {
+            return ImageFormat::ExrFloat;
+        }
+        if (name == "png")
+        {
+            return ImageFormat::Png;
+        }
+
+        throw std::runtime_error("Unknown format " + name);
+    }
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--keyframes")
+            {
+                options.keyframesPath = next();
+            }
+            else if (arg == "--out")
+            {
+                options.outDir = next();
+            }
+            else if (arg == "--fps")
+            {
+                options.fps = std::stod(next());
+            }
+            else if (arg == "--spp")
+            {
+                options.spp = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp-per-frame")
+            {
+                options.sppPerFrame = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                options.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--width")
+            {
+                options.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                options.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--format")
+            {
+                options.formats.push_back(parseFormat(next()));
+            }
+            else if (arg == "--first")
+            {
+                options.first = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--last")
+            {
+                options.last = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--workers")
+            {
+                options.workers = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--csv")
+            {
+                options.csvPath = next();
+            }
+            else if (arg == "--validation")
+            {
+                options.validation = true;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.keyframesPath.empty())
+        {
+            throw std::runtime_error("--keyframes is required");
+        }
+        if (options.width == 0 || options.height == 0 || options.spp == 0 || options.sppPerFrame == 0 || options.fps <= 0.0)
+        {
+            throw std::runtime_error("--width, --height, --spp, --spp-per-frame and --fps must be positive");
+        }
+        if (options.formats.empty())
+        {
+            options.formats.push_back(ImageFormat::ExrHalf);
+        }
+
+        return options;
+    }
+
+    std::vector<Keyframe> readKeyframes(const std::string& path)
+    {
+        std::ifstream inputStream(path);
+
+        if (!inputStream)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        std::vector<Keyframe> keyframes;
+        std::string line;
+        uint32_t lineNumber = 0;
+
+        while (std::getline(inputStream, line))
+        {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+            {
+                continue;
+            }
+
+            std::istringstream fields(line);
+            Keyframe key;
+
+            if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z))
+            {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected time, position and target");
+            }
+
+            fields >> key.verticalFov >> key.aperture >> key.focusDistance;
+
+            if (!keyframes.empty() && key.time <= keyframes.back().time)
+            {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": times must increase");
+            }
+
+            keyframes.push_back(key);
+        }
+
+        if (keyframes.empty())
+        {
+            throw std::runtime_error(path + " has no keyframes");
+        }
+
+        return keyframes;
+    }
+
+    glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+    {
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+
+        return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    // Camera at a time within the keys; the end keys are repeated as spline tangents.
+    Keyframe sampleCamera(const std::vector<Keyframe>& keys, double time)
+    {
+        if (keys.size() == 1 || time <= keys.front().time)
+        {
+            return keys.front();
+        }
+        if (time >= keys.back().time)
+        {
+            return keys.back();
+        }
+
+        size_t i = 0;
+
+        while (keys[i + 1].time < time)
+        {
+            ++i;
+        }
+
+        const Keyframe& a = keys[i];
+        const Keyframe& b = keys[i + 1];
+        const Keyframe& before = keys[i > 0 ? i - 1 : i];
+        const Keyframe& after = keys[std::min(i + 2, keys.size() - 1)];
+        const float t = static_cast<float>((time - a.time) / (b.time - a.time));
+
+        Keyframe key;
+        key.time = time;
+        key.position = catmullRom(before.position, a.position, b.position, after.position, t);
+        key.target = catmullRom(before.target, a.target, b.target, after.target, t);
+        key.verticalFov = a.verticalFov + (b.verticalFov - a.verticalFov) * t;
+        key.aperture = a.aperture + (b.aperture - a.aperture) * t;
+
+        if (a.focusDistance >= 0.0f && b.focusDistance >= 0.0f)
+        {
+            key.focusDistance = a.focusDistance + (b.focusDistance - a.focusDistance) * t;
+        }
+
+        return key;
+    }
+
+    std::string frameName(uint32_t frame)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%05u", frame);
+
+        return name;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        const std::vector<Keyframe> keyframes = readKeyframes(options.keyframesPath);
+
+        const double duration = keyframes.back().time - keyframes.front().time;
+        const uint32_t frameCount = static_cast<uint32_t>(std::floor(duration * options.fps + 1e-6)) + 1;
+        const uint32_t lastFrame = std::min(options.last, frameCount - 1);
+        const uint32_t dispatches = (options.spp + options.sppPerFrame - 1) / options.sppPerFrame;
+
+        if (options.first > lastFrame)
+        {
+            throw std::runtime_error("--first is past the last frame (" + std::to_string(frameCount - 1) + ")");
+        }
+
+        std::filesystem::create_directories(options.outDir);
+        std::ofstream csv;
+
+        if (!options.csvPath.empty())
+        {
+            csv.open(options.csvPath, std::ios::trunc);
+
+            if (!csv)
+            {
+                throw std::runtime_error("Failed to write " + options.csvPath);
+            }
+
+            csv << "frame,spp,trace_seconds,stall_seconds\n";
+        }
+
+        HeadlessRenderer renderer;
+        renderer.create({ options.width, options.height }, options.validation);
+        RayTracer& tracer = renderer.tracer();
+        tracer.setSamplesPerPixel(options.sppPerFrame);
+        tracer.setMaxDepth(options.maxDepth);
+
+        FrameExporter exporter;
+        exporter.create(3, options.workers);
+        exporter.setFormats(options.formats);
+
+        std::printf("Rendering frames %u-%u of %u at %ux%u, %u spp (%u dispatches of %u)\n", options.first, lastFrame, frameCount,
+            options.width, options.height, dispatches * options.sppPerFrame, dispatches, options.sppPerFrame);
+
+        Timer totalTimer;
+        double traceTotal = 0.0;
+        double stallTotal = 0.0;
+
+        for (uint32_t frame = options.first; frame <= lastFrame; ++frame)
+        {
+            const Keyframe camera = sampleCamera(keyframes, keyframes.front().time + frame / options.fps);
+            const glm::vec3 toTarget = camera.target - camera.position;
+            tracer.setCamera(camera.position, glm::normalize(toTarget), camera.focusDistance >= 0.0f ? camera.focusDistance : glm::length(toTarget));
+            tracer.setFov(camera.verticalFov);
+            tracer.setAperture(camera.aperture);
+
+            Timer frameTimer;
+            double stallSeconds = 0.0;
+
+            for (uint32_t dispatch = 0; dispatch < dispatches; ++dispatch)
+            {
+                exporter.poll(renderer.context());
+
+                if (dispatch + 1 < dispatches)
+                {
+                    renderer.renderFrame(dispatch);
+
+                    continue;
+                }
+
+                // The readback rides on the last dispatch; a staging buffer must be free before recording it.
+                Timer stallTimer;
+
+                while (!exporter.canCapture(tracer))
+                {
+                    exporter.poll(renderer.context());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                stallSeconds = stallTimer.elapsedSeconds();
+                const std::string basePath = (std::filesystem::path(options.outDir) / frameName(frame)).string();
+
+                renderer.renderFrame(dispatch, [&](VkCommandBuffer commandBuffer)
+                {
+                    exporter.capture(renderer.context(), tracer, commandBuffer, basePath);
+                });
+
+                exporter.submitted(renderer.context());
+            }
+
+            const double traceSeconds = frameTimer.elapsedSeconds() - stallSeconds;
+            traceTotal += traceSeconds;
+            stallTotal += stallSeconds;
+            std::printf("frame %5u  trace %8.3f s  stall %7.3f s  encoding %u\n", frame, traceSeconds, stallSeconds, exporter.capturesPending());
+
+            if (csv)
+            {
+                csv << frame << "," << dispatches * options.sppPerFrame << "," << traceSeconds << "," << stallSeconds << "\n";
+            }
+        }
+
+        exporter.destroy(renderer.context());
+        const double totalSeconds = totalTimer.elapsedSeconds();
+        const uint32_t rendered = lastFrame - options.first + 1;
+
+        std::printf("%u frames in %.1f s (trace %.1f s, stall %.1f s, final encode %.1f s): %.1f frames/hour\n", rendered, totalSeconds,
+            traceTotal, stallTotal, std::max(0.0, totalSeconds - traceTotal - stallTotal), rendered * 3600.0 / std::max(totalSeconds, 1e-9));
+
+        const bool failed = exporter.filesFailed() > 0;
+        renderer.destroy();
+        logger::flush();
+
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "animate: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
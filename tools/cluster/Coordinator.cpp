@@ -0,0 +1,565 @@
+#include "Coordinator.h"
+
+#include "../../src/rt/SceneCache.h"
+#include "../../src/util/Hash.h"
+#include "../../src/util/Image.h"
+#include "../../src/util/Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    const int pollIntervalMs = 200;
+    const double progressIntervalSeconds = 2.0;
+    const double rateSmoothing = 0.3;
+
+    std::string spawnCommand(const std::string& executable, uint16_t port)
+    {
+        std::string command = "\"" + executable + "\" --worker --connect 127.0.0.1:" + std::to_string(port);
+#ifdef _WIN32
+        // cmd /c strips the outer quotes of a command that starts with one.
+        command = "\"" + command + "\"";
+#endif
+
+        return command;
+    }
+}
+
+void Coordinator::run(const CoordinatorSettings& settings)
+{
+    mSettings = settings;
+    ClusterJob& job = mSettings.job;
+
+    if (job.scene.isNull())
+    {
+        RayTracer builtIn;
+        builtIn.buildScene();
+        job.sceneHash = builtIn.sceneHash();
+    }
+    else
+    {
+        const std::vector<GPUSphere> spheres = parseScene(job.scene);
+        job.sceneHash = hashBytes(spheres.data(), spheres.size() * sizeof(GPUSphere));
+    }
+
+    createUnits();
+
+    net::Socket listener = net::Socket::listenTcp(mSettings.listenHost, mSettings.port);
+    const uint16_t port = listener.localPort();
+    std::printf("Coordinator on %s:%u: %ux%u, %zu tiles, %zu units\n", mSettings.listenHost.c_str(), static_cast<unsigned>(port), job.width,
+        job.height, mTiles.size(), mUnits.size());
+    std::fflush(stdout);
+
+    mRunning.store(true, std::memory_order_release);
+    mRunTimer.reset();
+
+    std::vector<std::thread> spawned;
+
+    for (uint32_t i = 0; i < mSettings.spawnWorkers; ++i)
+    {
+        spawned.emplace_back([command = spawnCommand(mSettings.workerCommand, port)]()
+        {
+            if (std::system(command.c_str()) != 0)
+            {
+                logger::warn("Local worker exited with an error");
+            }
+        });
+    }
+
+    Timer progressTimer;
+
+    while (!allDone())
+    {
+        if (listener.waitReadable(pollIntervalMs))
+        {
+            acceptWorker(listener.accept());
+        }
+
+        if (progressTimer.elapsedSeconds() >= progressIntervalSeconds)
+        {
+            printProgress();
+            progressTimer.reset();
+        }
+    }
+
+    mRunning.store(false, std::memory_order_release);
+    mWake.notify_all();
+
+    for (std::thread& thread : mWorkerThreads)
+    {
+        thread.join();
+    }
+
+    // Idle local workers are stopped by their connection threads above.
+    for (std::thread& thread : spawned)
+    {
+        thread.join();
+    }
+
+    listener.close();
+    writeOutputs();
+    printReport();
+}
+
+void Coordinator::createUnits()
+{
+    const ClusterJob& job = mSettings.job;
+    const uint32_t tile = mSettings.tile;
+    const uint32_t totalFrames = (mSettings.spp + job.sppPerFrame - 1) / job.sppPerFrame;
+    RayTracer hashTracer; // Camera math only, no device.
+    std::vector<WorkUnit> tiles;
+
+    for (uint32_t y = 0; y < job.height; y += tile)
+    {
+        for (uint32_t x = 0; x < job.width; x += tile)
+        {
+            WorkUnit work;
+            work.x = x;
+            work.y = y;
+            work.width = std::min(tile, job.width - x);
+            work.height = std::min(tile, job.height - y);
+
+            configureTracer(hashTracer, job, work);
+            work.settingsHash = hashTracer.settingsHash({ work.width, work.height });
+
+            Checkpoint checkpoint;
+            checkpoint.width = work.width;
+            checkpoint.height = work.height;
+            checkpoint.sceneHash = job.sceneHash;
+            checkpoint.settingsHash = work.settingsHash;
+            checkpoint.samplesPerFrame = job.sppPerFrame;
+            checkpoint.sources = 0;
+            checkpoint.sums.assign(static_cast<size_t>(work.width) * work.height, glm::vec4(0.0f));
+
+            tiles.push_back(work);
+            mTiles.push_back(std::move(checkpoint));
+        }
+    }
+
+    // Frame ranges outermost, so the whole image reaches a low sample count before any tile gets more.
+    for (uint32_t firstFrame = 0; firstFrame < totalFrames; firstFrame += mSettings.framesPerUnit)
+    {
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            Unit unit;
+            unit.work = tiles[i];
+            unit.work.id = mUnits.size();
+            unit.work.firstFrame = firstFrame;
+            unit.work.frames = std::min(mSettings.framesPerUnit, totalFrames - firstFrame);
+            unit.tile = i;
+            unit.pixelSamples = static_cast<double>(unit.work.width) * unit.work.height * unit.work.frames * job.sppPerFrame;
+
+            mPending.push_back(mUnits.size());
+            mUnits.push_back(unit);
+        }
+    }
+}
+
+void Coordinator::acceptWorker(net::Socket socket)
+{
+    if (!socket.valid())
+    {
+        return;
+    }
+
+    auto shared = std::make_shared<net::Socket>(std::move(socket));
+    mWorkerThreads.emplace_back([this, shared]() { serveWorker(shared); });
+}
+
+void Coordinator::serveWorker(std::shared_ptr<net::Socket> socket)
+{
+    const int heartbeatMs = static_cast<int>(mSettings.heartbeatSeconds * 1000.0);
+    net::LineReader reader;
+    JsonValue message;
+    std::vector<uint8_t> payload;
+    size_t worker = 0;
+
+    try
+    {
+        if (net::receiveMessage(*socket, reader, message, payload, heartbeatMs) != net::LineReader::Result::Line ||
+            message.stringOr("op", "") != "hello")
+        {
+            return;
+        }
+    }
+    catch (const std::exception& error)
+    {
+        logger::warn("Rejected a worker: %s", error.what());
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        WorkerStats stats;
+        stats.name = message.stringOr("name", "worker");
+        mWorkers.push_back(stats);
+        worker = mWorkers.size() - 1;
+    }
+
+    const std::string name = message.stringOr("name", "worker");
+    logger::info("%s connected", name);
+    bool alive = net::sendMessage(*socket, toJson(mSettings.job));
+
+    while (alive && mRunning.load(std::memory_order_acquire))
+    {
+        const size_t unit = takeUnit(worker);
+
+        if (unit == noUnit)
+        {
+            if (allDone())
+            {
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait_for(lock, std::chrono::milliseconds(pollIntervalMs));
+
+            continue;
+        }
+
+        if (!net::sendMessage(*socket, toJson(mUnits[unit].work)))
+        {
+            releaseUnit(unit, worker, true);
+
+            break;
+        }
+
+        Timer silence;
+        bool cancelSent = false;
+
+        while (true)
+        {
+            net::LineReader::Result result = net::LineReader::Result::Closed;
+
+            try
+            {
+                result = net::receiveMessage(*socket, reader, message, payload, pollIntervalMs);
+            }
+            catch (const std::exception& error)
+            {
+                logger::error("%s sent a malformed message: %s", name, error.what());
+            }
+
+            if (result == net::LineReader::Result::Timeout)
+            {
+                if (silence.elapsedSeconds() > mSettings.heartbeatSeconds)
+                {
+                    logger::warn("%s silent for %.0f s, handing unit %zu out again", name, mSettings.heartbeatSeconds, unit);
+                    releaseUnit(unit, worker, true);
+                    alive = false;
+
+                    break;
+                }
+
+                bool done = false;
+
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    done = mUnits[unit].done;
+                }
+
+                if (done && !cancelSent)
+                {
+                    JsonValue cancel = JsonValue::object();
+                    cancel.set("op", "cancel");
+                    cancel.set("unit", static_cast<uint64_t>(unit));
+                    cancelSent = net::sendMessage(*socket, cancel);
+                }
+
+                continue;
+            }
+            if (result == net::LineReader::Result::Closed)
+            {
+                logger::warn("%s disconnected during unit %zu", name, unit);
+                releaseUnit(unit, worker, true);
+                alive = false;
+
+                break;
+            }
+
+            silence.reset();
+            const std::string op = message.stringOr("op", "");
+
+            if (op == "result" && message.numberOr("unit", 0.0) == static_cast<double>(unit))
+            {
+                if (!completeUnit(unit, worker, message, payload))
+                {
+                    logger::error("%s returned %zu bytes for unit %zu", name, payload.size(), unit);
+                    alive = false;
+                }
+
+                break;
+            }
+            if (op == "cancelled")
+            {
+                releaseUnit(unit, worker, false);
+
+                break;
+            }
+            if (op == "error")
+            {
+                // A worker that disagrees about the scene or settings would fail every unit; drop it.
+                logger::error("%s failed unit %zu: %s", name, unit, message.stringOr("error", "unknown error"));
+                releaseUnit(unit, worker, false);
+                alive = false;
+
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWorkers[worker].connected = false;
+    }
+
+    if (alive)
+    {
+        JsonValue stop = JsonValue::object();
+        stop.set("op", "stop");
+        net::sendMessage(*socket, stop);
+    }
+
+    logger::info("%s released", name);
+}
+
+size_t Coordinator::takeUnit(size_t worker)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t chosen = noUnit;
+
+    if (!mPending.empty())
+    {
+        chosen = mPending.front();
+        mPending.pop_front();
+    }
+    else
+    {
+        // Nothing queued: duplicate the unit most overdue against its expected time, if any is.
+        double worst = 1.0;
+
+        for (size_t i = 0; i < mUnits.size(); ++i)
+        {
+            const Unit& unit = mUnits[i];
+
+            if (unit.done || unit.holders != 1 || unit.owner == worker)
+            {
+                continue;
+            }
+
+            const double overdue = unit.assigned.elapsedSeconds() / std::max(mSettings.minUnitSeconds, mSettings.slowFactor * unit.expectedSeconds);
+
+            if (overdue > worst)
+            {
+                worst = overdue;
+                chosen = i;
+            }
+        }
+
+        if (chosen == noUnit)
+        {
+            return noUnit;
+        }
+
+        ++mWorkers[mUnits[chosen].owner].slow;
+        logger::warn("Unit %zu is slow on %s, also giving it to %s", chosen, mWorkers[mUnits[chosen].owner].name, mWorkers[worker].name);
+    }
+
+    // Expected time from this worker's throughput, or the fleet's before its first result.
+    double rate = mWorkers[worker].rate;
+
+    if (rate <= 0.0)
+    {
+        double total = 0.0;
+        uint32_t measured = 0;
+
+        for (const WorkerStats& stats : mWorkers)
+        {
+            if (stats.connected && stats.rate > 0.0)
+            {
+                total += stats.rate;
+                ++measured;
+            }
+        }
+
+        rate = measured > 0 ? total / measured : 0.0;
+    }
+
+    Unit& unit = mUnits[chosen];
+    ++unit.holders;
+    unit.owner = worker;
+    unit.assigned.reset();
+    unit.expectedSeconds = rate > 0.0 ? unit.pixelSamples / rate : std::numeric_limits<double>::infinity();
+
+    return chosen;
+}
+
+void Coordinator::releaseUnit(size_t unitIndex, size_t worker, bool died)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Unit& unit = mUnits[unitIndex];
+        --unit.holders;
+
+        if (unit.done)
+        {
+            return;
+        }
+        if (died)
+        {
+            ++mWorkers[worker].lost;
+        }
+        if (unit.holders == 0)
+        {
+            mPending.push_front(unitIndex);
+        }
+    }
+
+    mWake.notify_all();
+}
+
+bool Coordinator::completeUnit(size_t unitIndex, size_t worker, const JsonValue& message, const std::vector<uint8_t>& payload)
+{
+    const WorkUnit& work = mUnits[unitIndex].work;
+
+    Checkpoint piece;
+    piece.width = work.width;
+    piece.height = work.height;
+    piece.sceneHash = mSettings.job.sceneHash;
+    piece.settingsHash = work.settingsHash;
+    piece.firstFrame = work.firstFrame;
+    piece.nextFrame = work.firstFrame + work.frames;
+    piece.samplesPerPixel = static_cast<uint64_t>(work.frames) * mSettings.job.sppPerFrame;
+    piece.samplesPerFrame = mSettings.job.sppPerFrame;
+
+    if (payload.size() != static_cast<size_t>(work.width) * work.height * sizeof(glm::vec4))
+    {
+        releaseUnit(unitIndex, worker, false);
+
+        return false;
+    }
+
+    piece.sums.resize(static_cast<size_t>(work.width) * work.height);
+    std::memcpy(piece.sums.data(), payload.data(), payload.size());
+    const double seconds = message.numberOr("seconds", 0.0);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Unit& unit = mUnits[unitIndex];
+        WorkerStats& stats = mWorkers[worker];
+        --unit.holders;
+
+        if (unit.done)
+        {
+            ++stats.discarded;
+
+            return true;
+        }
+
+        // Units of a tile never share frames; the tile keeps every merged range, so out-of-order arrival is fine.
+        if (!mergeCheckpoint(mTiles[unit.tile], piece))
+        {
+            logger::warn("Unit %zu overlaps frames already merged into its tile", unitIndex);
+        }
+        unit.done = true;
+        ++mDone;
+
+        ++stats.units;
+        stats.pixelSamples += unit.pixelSamples;
+        stats.busySeconds += seconds;
+
+        if (seconds > 0.0)
+        {
+            const double rate = unit.pixelSamples / seconds;
+            stats.rate = stats.rate > 0.0 ? stats.rate + (rate - stats.rate) * rateSmoothing : rate;
+        }
+    }
+
+    mWake.notify_all();
+
+    return true;
+}
+
+bool Coordinator::allDone()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mDone == mUnits.size();
+}
+
+void Coordinator::printProgress()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t connected = 0;
+    double rate = 0.0;
+
+    for (const WorkerStats& stats : mWorkers)
+    {
+        if (stats.connected)
+        {
+            ++connected;
+            rate += stats.rate;
+        }
+    }
+
+    std::printf("%zu/%zu units, %u workers, %.1f Msamples/s, %.0f s\n", mDone, mUnits.size(), connected, rate * 1e-6, mRunTimer.elapsedSeconds());
+    std::fflush(stdout);
+}
+
+void Coordinator::writeOutputs()
+{
+    const ClusterJob& job = mSettings.job;
+    Checkpoint image;
+    image.width = job.width;
+    image.height = job.height;
+    image.sceneHash = job.sceneHash;
+    image.nextFrame = (mSettings.spp + job.sppPerFrame - 1) / job.sppPerFrame;
+    image.samplesPerPixel = image.nextFrame * job.sppPerFrame;
+    image.samplesPerFrame = job.sppPerFrame;
+    image.sums.resize(static_cast<size_t>(job.width) * job.height);
+
+    for (size_t i = 0; i < mTiles.size(); ++i)
+    {
+        const Checkpoint& tile = mTiles[i];
+        const WorkUnit& work = mUnits[i].work; // The first frame range lists every tile once, in tile order.
+
+        for (uint32_t row = 0; row < tile.height; ++row)
+        {
+            std::memcpy(&image.sums[static_cast<size_t>(work.y + row) * job.width + work.x], &tile.sums[static_cast<size_t>(row) * tile.width],
+                tile.width * sizeof(glm::vec4));
+        }
+    }
+
+    if (!mSettings.checkpointPath.empty())
+    {
+        // The whole view without a window, as the render tool hashes it, so the result merges with its checkpoints.
+        RayTracer hashTracer;
+        configureTracer(hashTracer, job, WorkUnit{});
+        hashTracer.setViewWindow({ 0, 0 }, { 0, 0 });
+        image.settingsHash = hashTracer.settingsHash({ job.width, job.height });
+
+        writeCheckpoint(mSettings.checkpointPath, image);
+        std::printf("Wrote %s\n", mSettings.checkpointPath.c_str());
+    }
+
+    writeFileMapped(mSettings.outPath, encodeImage(resolveAccumulation(image.sums, job.width, job.height), mSettings.format));
+    std::printf("Wrote %s in %.1f s\n", mSettings.outPath.c_str(), mRunTimer.elapsedSeconds());
+}
+
+void Coordinator::printReport()
+{
+    std::printf("%-24s %6s %12s %9s %5s %5s %9s\n", "worker", "units", "Msamples/s", "busy s", "lost", "slow", "discarded");
+
+    for (const WorkerStats& stats : mWorkers)
+    {
+        const double rate = stats.busySeconds > 0.0 ? stats.pixelSamples / stats.busySeconds : 0.0;
+        std::printf("%-24s %6llu %12.1f %9.1f %5u %5u %9u\n", stats.name.c_str(), static_cast<unsigned long long>(stats.units), rate * 1e-6,
+            stats.busySeconds, stats.lost, stats.slow, stats.discarded);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Protocol.h"
+#include "../../src/util/Checkpoint.h"
+#include "../../src/util/ImageEncode.h"
+#include "../../src/util/Timer.h"
+
+struct CoordinatorSettings
+{
+    ClusterJob job;
+    std::string listenHost = "0.0.0.0";
+    uint16_t port = 7878;
+    uint32_t tile = 512;
+    uint32_t spp = 256;
+    uint32_t framesPerUnit = 4;
+    double heartbeatSeconds = 10.0; // A worker silent for longer is dropped and its unit handed out again.
+    double slowFactor = 3.0; // A unit running this many times its expected time is also given to an idle worker.
+    double minUnitSeconds = 2.0; // Floor of the expected time, so short units are not duplicated on noise.
+    std::string outPath;
+    ImageFormat format = ImageFormat::ExrHalf;
+    std::string checkpointPath;
+    uint32_t spawnWorkers = 0; // Local worker processes to launch, for loopback runs.
+    std::string workerCommand; // This executable, for spawnWorkers.
+};
+
+// Splits an image into units of tiles and frame ranges, hands them to workers connecting over TCP and adds up
+// the accumulation sums they return. A worker that disconnects or stops sending heartbeats loses its unit to
+// the queue; a unit far slower than its worker's measured throughput is duplicated on an idle worker, the first
+// result wins and the other copy is cancelled. Each unit's sums enter its tile exactly once.
+class Coordinator
+{
+public:
+    Coordinator() = default;
+    ~Coordinator() = default;
+
+    Coordinator(const Coordinator&) = delete;
+    Coordinator& operator=(const Coordinator&) = delete;
+
+    // Returns once every unit is merged and the outputs are written. Throws on setup and I/O errors.
+    void run(const CoordinatorSettings& settings);
+
+private:
+    static constexpr size_t noUnit = std::numeric_limits<size_t>::max();
+
+    struct Unit
+    {
+        WorkUnit work;
+        size_t tile = 0;
+        double pixelSamples = 0.0;
+        bool done = false;
+        uint32_t holders = 0;
+        size_t owner = 0; // Worker of the latest assignment.
+        Timer assigned;
+        double expectedSeconds = std::numeric_limits<double>::infinity();
+    };
+
+    struct WorkerStats
+    {
+        std::string name;
+        bool connected = true;
+        uint64_t units = 0;
+        double pixelSamples = 0.0;
+        double busySeconds = 0.0;
+        double rate = 0.0; // Pixel samples per second, smoothed; 0 until the first result.
+        uint32_t lost = 0; // Units handed out again because the worker died.
+        uint32_t slow = 0; // Units duplicated because the worker was slow.
+        uint32_t discarded = 0; // Results that arrived after another worker's.
+    };
+
+    void createUnits();
+    void acceptWorker(net::Socket socket);
+    void serveWorker(std::shared_ptr<net::Socket> socket);
+    size_t takeUnit(size_t worker);
+    void releaseUnit(size_t unit, size_t worker, bool died);
+
+    // Returns false when the payload does not match the unit, which then goes back to the queue.
+    bool completeUnit(size_t unit, size_t worker, const JsonValue& message, const std::vector<uint8_t>& payload);
+    bool allDone();
+    void printProgress();
+    void writeOutputs();
+    void printReport();
+
+    CoordinatorSettings mSettings;
+    std::vector<Unit> mUnits;
+    std::vector<Checkpoint> mTiles;
+    std::vector<WorkerStats> mWorkers;
+    std::deque<size_t> mPending;
+    size_t mDone = 0;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::atomic<bool> mRunning{ false };
+    std::vector<std::thread> mWorkerThreads;
+    Timer mRunTimer;
+};
@@ -0,0 +1,131 @@
+#include "Protocol.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+    JsonValue vec3Json(const glm::vec3& value)
+    {
+        JsonValue items = JsonValue::array();
+        items.push(static_cast<double>(value.x));
+        items.push(static_cast<double>(value.y));
+        items.push(static_cast<double>(value.z));
+
+        return items;
+    }
+
+    glm::vec3 readVec3(const JsonValue& value, const char* name)
+    {
+        const std::vector<JsonValue>& items = value.items();
+
+        if (items.size() != 3)
+        {
+            throw std::runtime_error(std::string(name) + " needs three numbers");
+        }
+
+        return { static_cast<float>(items[0].asNumber()), static_cast<float>(items[1].asNumber()), static_cast<float>(items[2].asNumber()) };
+    }
+
+    // 64-bit hashes do not fit a double, so they travel as hex strings.
+    JsonValue hashJson(uint64_t hash)
+    {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+
+        return JsonValue(text);
+    }
+
+    uint64_t readHash(const JsonValue& value)
+    {
+        return std::stoull(value.asString(), nullptr, 16);
+    }
+
+    uint32_t readUint(const JsonValue& message, const char* name)
+    {
+        const double value = message[name].asNumber();
+
+        if (!(value >= 0.0 && value <= 4294967295.0))
+        {
+            throw std::runtime_error(std::string(name) + " is out of range");
+        }
+
+        return static_cast<uint32_t>(value);
+    }
+}
+
+JsonValue toJson(const ClusterJob& job)
+{
+    JsonValue message = JsonValue::object();
+    message.set("op", "job");
+    message.set("width", job.width);
+    message.set("height", job.height);
+    message.set("position", vec3Json(job.position));
+    message.set("target", vec3Json(job.target));
+    message.set("fov", static_cast<double>(job.fov));
+    message.set("aperture", static_cast<double>(job.aperture));
+    message.set("depth", job.maxDepth);
+    message.set("sppPerFrame", job.sppPerFrame);
+    message.set("scene", job.scene);
+    message.set("sceneHash", hashJson(job.sceneHash));
+
+    return message;
+}
+
+ClusterJob clusterJobFromJson(const JsonValue& message)
+{
+    ClusterJob job;
+    job.width = readUint(message, "width");
+    job.height = readUint(message, "height");
+    job.position = readVec3(message["position"], "position");
+    job.target = readVec3(message["target"], "target");
+    job.fov = static_cast<float>(message["fov"].asNumber());
+    job.aperture = static_cast<float>(message["aperture"].asNumber());
+    job.maxDepth = readUint(message, "depth");
+    job.sppPerFrame = readUint(message, "sppPerFrame");
+    job.scene = message["scene"];
+    job.sceneHash = readHash(message["sceneHash"]);
+
+    return job;
+}
+
+JsonValue toJson(const WorkUnit& unit)
+{
+    JsonValue message = JsonValue::object();
+    message.set("op", "unit");
+    message.set("unit", unit.id);
+    message.set("x", unit.x);
+    message.set("y", unit.y);
+    message.set("width", unit.width);
+    message.set("height", unit.height);
+    message.set("firstFrame", unit.firstFrame);
+    message.set("frames", unit.frames);
+    message.set("settingsHash", hashJson(unit.settingsHash));
+
+    return message;
+}
+
+WorkUnit workUnitFromJson(const JsonValue& message)
+{
+    WorkUnit unit;
+    unit.id = static_cast<uint64_t>(message["unit"].asNumber());
+    unit.x = readUint(message, "x");
+    unit.y = readUint(message, "y");
+    unit.width = readUint(message, "width");
+    unit.height = readUint(message, "height");
+    unit.firstFrame = readUint(message, "firstFrame");
+    unit.frames = readUint(message, "frames");
+    unit.settingsHash = readHash(message["settingsHash"]);
+
+    return unit;
+}
+
+void configureTracer(RayTracer& tracer, const ClusterJob& job, const WorkUnit& unit)
+{
+    tracer.setCamera(job.position, job.target - job.position, glm::length(job.target - job.position));
+    tracer.setFov(job.fov);
+    tracer.setAperture(job.aperture);
+    tracer.setMaxDepth(job.maxDepth);
+    tracer.setSamplesPerPixel(job.sppPerFrame);
+    tracer.setViewWindow({ job.width, job.height }, { static_cast<int32_t>(unit.x), static_cast<int32_t>(unit.y) });
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../../src/net/Message.h"
+#include "../../src/rt/RayTracer.h"
+#include "../../src/util/Json.h"
+
+// Coordinator/worker messages (net::sendMessage) are one JSON object per line; results carry their accumulation
+// sums as the payload.
+//
+//     worker -> coordinator   {"op": "hello", "name": s}
+//     coordinator -> worker   {"op": "job", <ClusterJob>}, then one {"op": "unit", <WorkUnit>} at a time
+//     worker -> coordinator   {"op": "progress", "unit": id, "frames": n} between frames, at most twice a second
+//     worker -> coordinator   {"op": "heartbeat"} every second from its own thread, also during long frames
+//     worker -> coordinator   {"op": "result", "unit": id, "frames": n, "seconds": s, "bytes": b} + RGBA32F sums
+//     worker -> coordinator   {"op": "error", "unit": id, "error": s}
+//     coordinator -> worker   {"op": "cancel", "unit": id}, answered with {"op": "cancelled", "unit": id}
+//     coordinator -> worker   {"op": "stop"}
+
+// What every unit of a render shares: the image, camera, path settings and scene.
+struct ClusterJob
+{
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    glm::vec3 position{ 13.0f, 2.0f, 3.0f };
+    glm::vec3 target{ 0.0f, 1.0f, 0.0f };
+    float fov = 20.0f;
+    float aperture = 0.05f;
+    uint32_t maxDepth = 12;
+    uint32_t sppPerFrame = 8;
+    JsonValue scene; // Scene description (see src/rt/SceneCache.h), null for the built-in scene.
+    uint64_t sceneHash = 0;
+};
+
+// A tile of the image and a range of its frames. Frame indices seed the random streams, so units of one tile
+// with disjoint frame ranges add up to one longer run.
+struct WorkUnit
+{
+    uint64_t id = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t firstFrame = 0;
+    uint32_t frames = 0;
+    uint64_t settingsHash = 0; // RayTracer::settingsHash of the tile's view window, so a worker cannot drift.
+};
+
+JsonValue toJson(const ClusterJob& job);
+ClusterJob clusterJobFromJson(const JsonValue& message);
+
+JsonValue toJson(const WorkUnit& unit);
+WorkUnit workUnitFromJson(const JsonValue& message);
+
+// Applies the job's camera and settings and the unit's view window, restarting accumulation.
+void configureTracer(RayTracer& tracer, const ClusterJob& job, const WorkUnit& unit);
@@ -0,0 +1,267 @@
+#include "Worker.h"
+
+#include "../../src/rt/SceneCache.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int pollIntervalMs = 200;
+    const double progressIntervalSeconds = 0.5;
+    const int heartbeatIntervalMs = 1000; // Well below the coordinator's --heartbeat, which must be at least 2 s.
+}
+
+ClusterWorker::~ClusterWorker()
+{
+    stopHeartbeat();
+}
+
+void ClusterWorker::run(const WorkerSettings& settings)
+{
+    mRenderer.create({ 256, 256 }, settings.validation);
+
+    Timer connectTimer;
+
+    while (true)
+    {
+        mSocket = net::Socket::connectTcp(settings.host, settings.port);
+
+        if (mSocket.valid())
+        {
+            break;
+        }
+        if (connectTimer.elapsedSeconds() > settings.connectSeconds)
+        {
+            throw std::runtime_error("Failed to connect to " + settings.host + ":" + std::to_string(settings.port));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(pollIntervalMs));
+    }
+
+    JsonValue hello = JsonValue::object();
+    hello.set("op", "hello");
+    hello.set("name", settings.name.empty() ? "worker " + std::to_string(getpid()) : settings.name);
+    send(hello);
+    logger::info("Connected to %s:%u", settings.host, static_cast<unsigned>(settings.port));
+    startHeartbeat();
+
+    JsonValue message;
+    std::vector<uint8_t> payload;
+
+    while (!mStopRequested)
+    {
+        const net::LineReader::Result result = net::receiveMessage(mSocket, mReader, message, payload, -1);
+
+        if (result != net::LineReader::Result::Line)
+        {
+            break;
+        }
+
+        const std::string op = message.stringOr("op", "");
+
+        if (op == "job")
+        {
+            applyJob(clusterJobFromJson(message));
+        }
+        else if (op == "unit" && mHasJob)
+        {
+            renderUnit(workUnitFromJson(message));
+        }
+        else if (op == "stop")
+        {
+            mStopRequested = true;
+        }
+    }
+
+    stopHeartbeat();
+    mSocket.close();
+    mRenderer.destroy();
+}
+
+void ClusterWorker::applyJob(const ClusterJob& job)
+{
+    RayTracer& tracer = mRenderer.tracer();
+
+    if (tracer.sceneHash() != job.sceneHash)
+    {
+        if (job.scene.isNull())
+        {
+            RayTracer builtIn;
+            builtIn.buildScene();
+            tracer.setScene(mRenderer.context(), builtIn.spheres());
+        }
+        else
+        {
+            tracer.setScene(mRenderer.context(), parseScene(job.scene));
+        }
+    }
+
+    // Same description but a different packing or build would trace a different image; refuse it.
+    if (tracer.sceneHash() != job.sceneHash)
+    {
+        throw std::runtime_error("Scene hash differs from the coordinator's");
+    }
+
+    mJob = job;
+    mHasJob = true;
+}
+
+bool ClusterWorker::renderUnit(const WorkUnit& unit)
+{
+    RayTracer& tracer = mRenderer.tracer();
+    const VkExtent2D extent{ unit.width, unit.height };
+
+    if (extent.width != mRenderer.extent().width || extent.height != mRenderer.extent().height)
+    {
+        mRenderer.resize(extent);
+    }
+
+    configureTracer(tracer, mJob, unit);
+
+    if (tracer.settingsHash(extent) != unit.settingsHash)
+    {
+        JsonValue error = JsonValue::object();
+        error.set("op", "error");
+        error.set("unit", unit.id);
+        error.set("error", "settings hash differs from the coordinator's");
+        send(error);
+
+        return false;
+    }
+
+    Timer unitTimer;
+    Timer progressTimer;
+
+    for (uint32_t frame = 0; frame < unit.frames; ++frame)
+    {
+        mRenderer.renderFrame(unit.firstFrame + frame);
+
+        if (!pollControl(unit.id))
+        {
+            return false;
+        }
+
+        // Reported between frames; the heartbeat thread covers frames that take longer.
+        if (progressTimer.elapsedSeconds() >= progressIntervalSeconds)
+        {
+            JsonValue progress = JsonValue::object();
+            progress.set("op", "progress");
+            progress.set("unit", unit.id);
+            progress.set("frames", frame + 1);
+            send(progress);
+            progressTimer.reset();
+        }
+    }
+
+    std::vector<glm::vec4> sums;
+    tracer.readAccumulation(mRenderer.context(), sums);
+
+    JsonValue result = JsonValue::object();
+    result.set("op", "result");
+    result.set("unit", unit.id);
+    result.set("frames", unit.frames);
+    result.set("seconds", unitTimer.elapsedSeconds());
+    result.set("bytes", static_cast<uint64_t>(sums.size() * sizeof(glm::vec4)));
+
+    return send(result, sums.data(), sums.size() * sizeof(glm::vec4));
+}
+
+bool ClusterWorker::pollControl(uint64_t unitId)
+{
+    JsonValue message;
+    std::vector<uint8_t> payload;
+
+    while (true)
+    {
+        const net::LineReader::Result result = net::receiveMessage(mSocket, mReader, message, payload, 0);
+
+        if (result == net::LineReader::Result::Timeout)
+        {
+            return true;
+        }
+        if (result == net::LineReader::Result::Closed)
+        {
+            mStopRequested = true;
+
+            return false;
+        }
+
+        const std::string op = message.stringOr("op", "");
+
+        if (op == "stop")
+        {
+            mStopRequested = true;
+
+            return false;
+        }
+
+        // Another worker finished this unit first.
+        if (op == "cancel" && static_cast<uint64_t>(message.numberOr("unit", 0.0)) == unitId)
+        {
+            JsonValue cancelled = JsonValue::object();
+            cancelled.set("op", "cancelled");
+            cancelled.set("unit", unitId);
+            send(cancelled);
+
+            return false;
+        }
+    }
+}
+
+bool ClusterWorker::send(const JsonValue& message, const void* payload, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mSendMutex);
+
+    return net::sendMessage(mSocket, message, payload, bytes);
+}
+
+void ClusterWorker::startHeartbeat()
+{
+    mHeartbeatStop = false;
+    mHeartbeatThread = std::thread([this]()
+    {
+        JsonValue heartbeat = JsonValue::object();
+        heartbeat.set("op", "heartbeat");
+        std::unique_lock<std::mutex> lock(mHeartbeatMutex);
+
+        while (!mHeartbeatWake.wait_for(lock, std::chrono::milliseconds(heartbeatIntervalMs), [this]() { return mHeartbeatStop; }))
+        {
+            lock.unlock();
+            const bool sent = send(heartbeat);
+            lock.lock();
+
+            // The render loop notices the closed socket on its next receive.
+            if (!sent)
+            {
+                break;
+            }
+        }
+    });
+}
+
+void ClusterWorker::stopHeartbeat()
+{
+    if (!mHeartbeatThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mHeartbeatMutex);
+        mHeartbeatStop = true;
+    }
+
+    mHeartbeatWake.notify_all();
+    mHeartbeatThread.join();
+}
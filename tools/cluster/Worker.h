@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Protocol.h"
+#include "../../src/rt/HeadlessRenderer.h"
+
+struct WorkerSettings
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 7878;
+    std::string name; // Shown in the coordinator's report; defaults to the process id.
+    double connectSeconds = 30.0; // Keeps retrying, so workers may start before the coordinator.
+    bool validation = false;
+};
+
+// Renders the units a coordinator hands out on a headless tracer and streams back their accumulation sums.
+class ClusterWorker
+{
+public:
+    ClusterWorker() = default;
+    ~ClusterWorker();
+
+    // Returns once the coordinator stops the worker or goes away. Throws on device or protocol errors.
+    void run(const WorkerSettings& settings);
+
+private:
+    void applyJob(const ClusterJob& job);
+
+    // Returns false when the unit was cancelled or the worker was stopped.
+    bool renderUnit(const WorkUnit& unit);
+
+    // Handles messages that arrive while a unit renders.
+    bool pollControl(uint64_t unitId);
+
+    // Messages from the render loop and the heartbeat thread must not interleave on the socket.
+    bool send(const JsonValue& message, const void* payload = nullptr, size_t bytes = 0);
+
+    // Heartbeats come from their own thread, so a frame longer than the coordinator's timeout (a large tile, a
+    // slow device, the first pipeline compile) does not look like a dead worker. A stuck render is left to the
+    // coordinator's duplicate of late units.
+    void startHeartbeat();
+    void stopHeartbeat();
+
+    HeadlessRenderer mRenderer;
+    net::Socket mSocket;
+    net::LineReader mReader;
+    ClusterJob mJob;
+    bool mHasJob = false;
+    bool mStopRequested = false;
+
+    std::mutex mSendMutex;
+    std::thread mHeartbeatThread;
+    std::mutex mHeartbeatMutex;
+    std::condition_variable mHeartbeatWake;
+    bool mHeartbeatStop = false;
+};
@@ -0,0 +1,283 @@
+// Distributed rendering of one image across worker processes on several machines.
+//
+// Usage: cluster [--width W] [--height H] [--spp N] [--spp-per-frame N] [--depth N] [--aperture A] [--fov DEGREES]
+//                [--position X,Y,Z] [--target X,Y,Z] [--scene <scene.json>] [--tile N] [--frames-per-unit N]
+//                [--listen HOST] [--port N] [--heartbeat SECONDS] [--out <file.pfm|file.exr|file.png>] [--float]
+//                [--checkpoint <file>] [--spawn N]
+//        cluster --worker [--connect HOST:PORT] [--name NAME] [--validation]
+//
+// The coordinator splits the image into --tile sized tiles and each tile's frames into ranges of
+// --frames-per-unit, and serves these units over TCP (default port 7878, all interfaces) to workers, which trace
+// them on a headless RayTracer and stream back the accumulation sums. Sums carry their sample counts, so adding
+// a tile's units weights each by its samples. Workers that disconnect or miss heartbeats lose their unit to the
+// next free worker; units running far beyond their worker's measured throughput are duplicated and the slower
+// copy cancelled. A per-worker throughput report closes the run. --checkpoint also writes the sums in the render
+// tool's format, mergeable with its runs of the same view.
+//
+// --spawn N starts N local workers on loopback, so the whole protocol can be exercised on one machine; further
+// workers can join from anywhere at any time. Port 0 picks a free port.
+
+#include "Coordinator.h"
+#include "Worker.h"
+
+#include "../../src/util/Logger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    struct Options
+    {
+        bool worker = false;
+        CoordinatorSettings coordinator;
+        WorkerSettings workerSettings;
+        std::string scenePath;
+        bool fullFloat = false;
+    };
+
+    glm::vec3 parseVec3(const std::string& text)
+    {
+        glm::vec3 value{};
+
+        if (std::sscanf(text.c_str(), "%f,%f,%f", &value.x, &value.y, &value.z) != 3)
+        {
+            throw std::runtime_error("Expected X,Y,Z instead of " + text);
+        }
+
+        return value;
+    }
+
+    void parseEndpoint(const std::string& text, WorkerSettings& settings)
+    {
+        const size_t colon = text.rfind(':');
+
+        if (colon == std::string::npos || colon == 0)
+        {
+            throw std::runtime_error("Expected HOST:PORT instead of " + text);
+        }
+
+        settings.host = text.substr(0, colon);
+        settings.port = static_cast<uint16_t>(std::stoul(text.substr(colon + 1)));
+    }
+
+    ImageFormat outputFormat(const std::string& path, bool fullFloat)
+    {
+        const std::string extension = std::filesystem::path(path).extension().string();
+
+        if (extension == ".pfm")
+        {
+            return ImageFormat::Pfm;
+        }
+        if (extension == ".exr")
+        {
+            return fullFloat ? ImageFormat::ExrFloat : ImageFormat::ExrHalf;
+        }
+        if (extension == ".png")
+        {
+            return ImageFormat::Png;
+        }
+
+        throw std::runtime_error("--out must end in .pfm, .exr or .png");
+    }
+
+    std::string readTextFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        std::ostringstream text;
+        text << file.rdbuf();
+
+        return text.str();
+    }
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        CoordinatorSettings& coordinator = options.coordinator;
+        ClusterJob& job = coordinator.job;
+        coordinator.outPath = "cluster.exr";
+        coordinator.workerCommand = argv[0];
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--worker")
+            {
+                options.worker = true;
+            }
+            else if (arg == "--connect")
+            {
+                parseEndpoint(next(), options.workerSettings);
+            }
+            else if (arg == "--name")
+            {
+                options.workerSettings.name = next();
+            }
+            else if (arg == "--validation")
+            {
+                options.workerSettings.validation = true;
+            }
+            else if (arg == "--width")
+            {
+                job.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                job.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp")
+            {
+                coordinator.spp = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp-per-frame")
+            {
+                job.sppPerFrame = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                job.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--aperture")
+            {
+                job.aperture = std::stof(next());
+            }
+            else if (arg == "--fov")
+            {
+                job.fov = std::stof(next());
+            }
+            else if (arg == "--position")
+            {
+                job.position = parseVec3(next());
+            }
+            else if (arg == "--target")
+            {
+                job.target = parseVec3(next());
+            }
+            else if (arg == "--scene")
+            {
+                options.scenePath = next();
+            }
+            else if (arg == "--tile")
+            {
+                coordinator.tile = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--frames-per-unit")
+            {
+                coordinator.framesPerUnit = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--listen")
+            {
+                coordinator.listenHost = next();
+            }
+            else if (arg == "--port")
+            {
+                coordinator.port = static_cast<uint16_t>(std::stoul(next()));
+            }
+            else if (arg == "--heartbeat")
+            {
+                coordinator.heartbeatSeconds = std::stod(next());
+            }
+            else if (arg == "--out")
+            {
+                coordinator.outPath = next();
+            }
+            else if (arg == "--float")
+            {
+                options.fullFloat = true;
+            }
+            else if (arg == "--checkpoint")
+            {
+                coordinator.checkpointPath = next();
+            }
+            else if (arg == "--spawn")
+            {
+                coordinator.spawnWorkers = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.worker)
+        {
+            return options;
+        }
+
+        if (job.width == 0 || job.height == 0 || coordinator.spp == 0 || job.sppPerFrame == 0 || coordinator.tile == 0 ||
+            coordinator.framesPerUnit == 0)
+        {
+            throw std::runtime_error("--width, --height, --spp, --spp-per-frame, --tile and --frames-per-unit must be positive");
+        }
+        if (job.position == job.target)
+        {
+            throw std::runtime_error("--position and --target must differ");
+        }
+        if (!(coordinator.heartbeatSeconds >= 2.0))
+        {
+            throw std::runtime_error("--heartbeat must be at least 2 seconds; workers beat once a second");
+        }
+
+        // Tiles start on the tracer's 8x8 workgroups.
+        coordinator.tile = (coordinator.tile + 7) / 8 * 8;
+        coordinator.format = outputFormat(coordinator.outPath, options.fullFloat);
+
+        return options;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        if (options.worker)
+        {
+            ClusterWorker worker;
+            worker.run(options.workerSettings);
+        }
+        else
+        {
+            if (!options.scenePath.empty())
+            {
+                options.coordinator.job.scene = JsonValue::parse(readTextFile(options.scenePath));
+            }
+
+            Coordinator coordinator;
+            coordinator.run(options.coordinator);
+        }
+
+        logger::flush();
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "cluster: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,261 @@
+// Convergence benchmark: image error against wall time for one renderer configuration.
+//
+// Usage: convergence [--reference <file.pfm>] [--reference-spp N] [--render-reference] [--width W] [--height H]
+//                    [--spp N] [--depth N] [--aperture A] [--interval S] [--duration S] [--label NAME]
+//                    [--out <file.csv>] [--validation]
+//
+// Runs headless on any compute-capable device; set VRAYT_DEVICE=llvmpipe to use lavapipe. The reference is
+// loaded from --reference when the file exists, otherwise it is rendered to --reference-spp samples per pixel
+// with independent random streams and written there. The configuration under test is then rendered from an
+// empty accumulation buffer. Every --interval seconds of render time the accumulation is read back and
+// compared, and one row (label, seconds, frames, spp, rmse, relmse, flip) is appended to the CSV. Readback and
+// comparison are excluded from the clock. Runs with different --label values can share one CSV, and kernel
+// variants can be compared through VRAYT_SHADER_DIR.
+
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/ImageError.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // Reference frames seed their random streams from here so they do not correlate with the run under test.
+    const uint32_t referenceFrameOffset = 1u << 24;
+    const uint32_t referenceSamplesPerFrame = 16;
+
+    struct Options
+    {
+        std::string referencePath = "convergence_reference.pfm";
+        uint32_t referenceSpp = 16384;
+        bool renderReference = false;
+        uint32_t width = 640;
+        uint32_t height = 360;
+        uint32_t samplesPerPixel = 1;
+        uint32_t maxDepth = 12;
+        float aperture = 0.05f;
+        double interval = 0.5;
+        double duration = 30.0;
+        std::string label = "default";
+        std::string outPath = "convergence.csv";
+        bool validation = false;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--reference")
+            {
+                options.referencePath = next();
+            }
+            else if (arg == "--reference-spp")
+            {
+                options.referenceSpp = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--render-reference")
+            {
+                options.renderReference = true;
+            }
+            else if (arg == "--width")
+            {
+                options.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                options.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp")
+            {
+                options.samplesPerPixel = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                options.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--aperture")
+            {
+                options.aperture = std::stof(next());
+            }
+            else if (arg == "--interval")
+            {
+                options.interval = std::stod(next());
+            }
+            else if (arg == "--duration")
+            {
+                options.duration = std::stod(next());
+            }
+            else if (arg == "--label")
+            {
+                options.label = next();
+            }
+            else if (arg == "--out")
+            {
+                options.outPath = next();
+            }
+            else if (arg == "--validation")
+            {
+                options.validation = true;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.width == 0 || options.height == 0 || options.interval <= 0.0)
+        {
+            throw std::runtime_error("--width, --height and --interval must be positive");
+        }
+
+        return options;
+    }
+
+    Image renderReference(HeadlessRenderer& renderer, const Options& options)
+    {
+        RayTracer& tracer = renderer.tracer();
+        tracer.setSamplesPerPixel(referenceSamplesPerFrame);
+        tracer.setMaxDepth(options.maxDepth);
+        tracer.setAperture(options.aperture);
+
+        const uint32_t frames = (options.referenceSpp + referenceSamplesPerFrame - 1) / referenceSamplesPerFrame;
+        Timer timer;
+
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            renderer.renderFrame(referenceFrameOffset + frame);
+
+            if ((frame + 1) % 64 == 0 || frame + 1 == frames)
+            {
+                std::printf("reference: %u / %u spp (%.1f s)\n", (frame + 1) * referenceSamplesPerFrame, frames * referenceSamplesPerFrame, timer.elapsedSeconds());
+            }
+        }
+
+        return renderer.readImage();
+    }
+
+    std::ofstream openCsv(const std::string& path)
+    {
+        const bool exists = std::filesystem::exists(path) && std::filesystem::file_size(path) > 0;
+        std::ofstream outputStream(path, std::ios::app);
+
+        if (!outputStream)
+        {
+            throw std::runtime_error("Failed to write " + path);
+        }
+        if (!exists)
+        {
+            outputStream << "label,seconds,frames,spp,rmse,relmse,flip\n";
+        }
+
+        return outputStream;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        HeadlessRenderer renderer;
+        renderer.create({ options.width, options.height }, options.validation);
+        RayTracer& tracer = renderer.tracer();
+
+        Image reference;
+
+        if (!options.renderReference && std::filesystem::exists(options.referencePath))
+        {
+            reference = readPfm(options.referencePath);
+            logger::info("Loaded reference %s", options.referencePath);
+        }
+        else
+        {
+            reference = renderReference(renderer, options);
+            writePfm(options.referencePath, reference);
+            logger::info("Reference written to %s", options.referencePath);
+        }
+
+        if (reference.width != options.width || reference.height != options.height)
+        {
+            throw std::runtime_error("Reference is " + std::to_string(reference.width) + "x" + std::to_string(reference.height) +
+                ", pass matching --width and --height or --render-reference");
+        }
+
+        tracer.setSamplesPerPixel(options.samplesPerPixel);
+        tracer.setMaxDepth(options.maxDepth);
+        tracer.setAperture(options.aperture);
+
+        std::ofstream csv = openCsv(options.outPath);
+        std::printf("%-10s %8s %8s %12s %12s %8s\n", "seconds", "frames", "spp", "rmse", "relmse", "flip");
+
+        double renderSeconds = 0.0;
+        double nextSample = options.interval;
+        uint32_t frames = 0;
+        Timer timer;
+
+        while (renderSeconds < options.duration)
+        {
+            renderer.renderFrame(frames++);
+
+            if (renderSeconds + timer.elapsedSeconds() < nextSample)
+            {
+                continue;
+            }
+
+            renderSeconds += timer.elapsedSeconds();
+
+            while (nextSample <= renderSeconds)
+            {
+                nextSample += options.interval;
+            }
+
+            ImageError error = compareImages(renderer.readImage(), reference);
+            const uint64_t spp = static_cast<uint64_t>(frames) * options.samplesPerPixel;
+
+            std::printf("%-10.3f %8u %8llu %12.6g %12.6g %8.5f\n", renderSeconds, frames, static_cast<unsigned long long>(spp), error.rmse, error.relMse, error.flip);
+            csv << options.label << ',' << renderSeconds << ',' << frames << ',' << spp << ','
+                << error.rmse << ',' << error.relMse << ',' << error.flip << '\n';
+
+            timer.reset();
+        }
+
+        csv.flush();
+
+        if (!csv)
+        {
+            throw std::runtime_error("Failed to write " + options.outPath);
+        }
+
+        renderer.destroy();
+        logger::flush();
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "convergence: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,145 @@
+// Combines checkpoints of independent runs of one image into a single checkpoint with all their samples.
+//
+// Usage: merge --out <file> [--image <file.pfm|file.exr|file.png>] [--float] <checkpoint> <checkpoint>...
+//
+// The checkpoints must share their size, scene and settings hashes. Their accumulation sums are added; since each
+// pixel's sum carries its own sample count, the merged image weights every run by the samples it contributed.
+// Runs whose frame ranges overlap traced the same random streams and are merged with a warning. The result can be
+// resumed by the render tool or merged again; --image also writes the resolved image.
+
+#include "../../src/util/Checkpoint.h"
+#include "../../src/util/ImageEncode.h"
+#include "../../src/util/Logger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        std::string outPath;
+        std::string imagePath;
+        bool fullFloat = false;
+        std::vector<std::string> inputs;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--out")
+            {
+                options.outPath = next();
+            }
+            else if (arg == "--image")
+            {
+                options.imagePath = next();
+            }
+            else if (arg == "--float")
+            {
+                options.fullFloat = true;
+            }
+            else if (arg.rfind("--", 0) == 0)
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+            else
+            {
+                options.inputs.push_back(arg);
+            }
+        }
+
+        if (options.outPath.empty() || options.inputs.size() < 2)
+        {
+            throw std::runtime_error("Usage: merge --out <file> [--image <file>] [--float] <checkpoint> <checkpoint>...");
+        }
+
+        return options;
+    }
+
+    ImageFormat imageFormat(const Options& options)
+    {
+        const std::string extension = std::filesystem::path(options.imagePath).extension().string();
+
+        if (extension == ".pfm")
+        {
+            return ImageFormat::Pfm;
+        }
+        if (extension == ".exr")
+        {
+            return options.fullFloat ? ImageFormat::ExrFloat : ImageFormat::ExrHalf;
+        }
+        if (extension == ".png")
+        {
+            return ImageFormat::Png;
+        }
+
+        throw std::runtime_error("--image must end in .pfm, .exr or .png");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        const ImageFormat format = options.imagePath.empty() ? ImageFormat::Pfm : imageFormat(options);
+
+        Checkpoint merged = readCheckpoint(options.inputs[0]);
+        std::printf("%s: %ux%u, frames %llu-%llu, %llu spp\n", options.inputs[0].c_str(), merged.width, merged.height,
+            static_cast<unsigned long long>(merged.firstFrame), static_cast<unsigned long long>(merged.nextFrame),
+            static_cast<unsigned long long>(merged.samplesPerPixel));
+
+        for (size_t i = 1; i < options.inputs.size(); ++i)
+        {
+            const Checkpoint checkpoint = readCheckpoint(options.inputs[i]);
+            std::printf("%s: %ux%u, frames %llu-%llu, %llu spp\n", options.inputs[i].c_str(), checkpoint.width, checkpoint.height,
+                static_cast<unsigned long long>(checkpoint.firstFrame), static_cast<unsigned long long>(checkpoint.nextFrame),
+                static_cast<unsigned long long>(checkpoint.samplesPerPixel));
+
+            if (!mergeCheckpoint(merged, checkpoint))
+            {
+                logger::warn("%s overlaps the frames of earlier checkpoints; use distinct --frame-offset ranges for independent runs",
+                    options.inputs[i]);
+            }
+        }
+
+        writeCheckpoint(options.outPath, merged);
+        std::printf("Wrote %s: %u runs, %llu spp\n", options.outPath.c_str(), merged.sources, static_cast<unsigned long long>(merged.samplesPerPixel));
+
+        if (!options.imagePath.empty())
+        {
+            writeFileMapped(options.imagePath, encodeImage(resolveAccumulation(merged.sums, merged.width, merged.height), format));
+            std::printf("Wrote %s\n", options.imagePath.c_str());
+        }
+
+        logger::flush();
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "merge: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,197 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double timeSeconds(const bench::Body& body, uint64_t iterations)
+    {
+        const Clock::time_point begin = Clock::now();
+        body(iterations);
+        bench::clobberMemory();
+
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+
+    void writeJsonString(std::ofstream& out, const std::string& text)
+    {
+        out << '"';
+
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out << '\\';
+            }
+
+            out << c;
+        }
+
+        out << '"';
+    }
+}
+
+namespace bench
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    __declspec(noinline) void escape(const volatile void* pointer)
+    {
+        // A volatile read of the first byte makes the call itself observable.
+        (void)*static_cast<const volatile char*>(pointer);
+    }
+#endif
+
+    bool pinCurrentThread(int cpu)
+    {
+        if (cpu < 0)
+        {
+            return true;
+        }
+
+#ifdef _WIN32
+        const bool pinned = SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+        return pinned;
+#else
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+    }
+
+    Result run(const Benchmark& benchmark, const Settings& settings)
+    {
+        // Warm caches and lazily initialized state, then grow the iteration count until one repetition is long
+        // enough for the clock resolution not to matter.
+        const Body body = benchmark.prepare();
+        uint64_t iterations = 1;
+        double seconds = timeSeconds(body, iterations);
+
+        while (seconds < settings.minRepetitionSeconds && iterations < (1ull << 40))
+        {
+            const double scale = seconds > 0.0 ? settings.minRepetitionSeconds / seconds * 1.2 : 10.0;
+            iterations = std::max(iterations + 1, static_cast<uint64_t>(static_cast<double>(iterations) * std::min(scale, 10.0)));
+            seconds = timeSeconds(body, iterations);
+        }
+
+        std::vector<double> samples;
+        samples.reserve(settings.repetitions);
+
+        for (uint32_t i = 0; i < settings.repetitions; ++i)
+        {
+            samples.push_back(timeSeconds(body, iterations) * 1e9 / static_cast<double>(iterations));
+        }
+
+        Result result;
+        result.name = benchmark.name;
+        result.iterations = iterations;
+        result.repetitions = settings.repetitions;
+
+        if (samples.empty())
+        {
+            return result;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        const size_t middle = samples.size() / 2;
+        result.medianNs = samples.size() % 2 ? samples[middle] : 0.5 * (samples[middle - 1] + samples[middle]);
+        result.minNs = samples.front();
+
+        double sum = 0.0;
+
+        for (double sample : samples)
+        {
+            sum += sample;
+        }
+
+        result.meanNs = sum / static_cast<double>(samples.size());
+        double variance = 0.0;
+
+        for (double sample : samples)
+        {
+            variance += (sample - result.meanNs) * (sample - result.meanNs);
+        }
+
+        result.stddevNs = samples.size() > 1 ? std::sqrt(variance / static_cast<double>(samples.size() - 1)) : 0.0;
+        result.bytesPerSecond = benchmark.bytesPerOp && result.medianNs > 0.0
+            ? static_cast<double>(benchmark.bytesPerOp) * 1e9 / result.medianNs
+            : 0.0;
+
+        return result;
+    }
+
+    void printHeader()
+    {
+        std::printf("%-36s %14s %14s %10s %12s %12s\n", "benchmark", "median ns/op", "min ns/op", "stddev %", "MiB/s", "iterations");
+    }
+
+    void printResult(const Result& result)
+    {
+        const double relative = result.meanNs > 0.0 ? result.stddevNs * 100.0 / result.meanNs : 0.0;
+
+        if (result.bytesPerSecond > 0.0)
+        {
+            std::printf("%-36s %14.1f %14.1f %10.2f %12.1f %12llu\n", result.name.c_str(), result.medianNs, result.minNs, relative,
+                result.bytesPerSecond / (1024.0 * 1024.0), static_cast<unsigned long long>(result.iterations));
+        }
+        else
+        {
+            std::printf("%-36s %14.1f %14.1f %10.2f %12s %12llu\n", result.name.c_str(), result.medianNs, result.minNs, relative,
+                "-", static_cast<unsigned long long>(result.iterations));
+        }
+    }
+
+    bool writeJson(const std::string& path, const std::string& label, const Settings& settings, const std::vector<Result>& results)
+    {
+        std::ofstream out(path, std::ios::trunc);
+
+        if (!out)
+        {
+            return false;
+        }
+
+        out << "{\n  \"label\": ";
+        writeJsonString(out, label);
+        out << ",\n  \"repetitions\": " << settings.repetitions << ",\n  \"cpu\": " << settings.cpu << ",\n  \"benchmarks\": [\n";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& result = results[i];
+            out << "    { \"name\": ";
+            writeJsonString(out, result.name);
+            out << ", \"iterations\": " << result.iterations
+                << ", \"median_ns\": " << result.medianNs
+                << ", \"mean_ns\": " << result.meanNs
+                << ", \"min_ns\": " << result.minNs
+                << ", \"stddev_ns\": " << result.stddevNs
+                << ", \"bytes_per_second\": " << result.bytesPerSecond << " }"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+
+        out << "  ]\n}\n";
+
+        return static_cast<bool>(out);
+    }
+}
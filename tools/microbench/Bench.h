@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Minimal microbenchmark harness. A benchmark prepares its inputs once, untimed, and returns a body that runs
+// `iterations` operations; the harness calibrates the count to a target time per repetition, repeats the
+// measurement and reports robust statistics.
+namespace bench
+{
+    using Body = std::function<void(uint64_t iterations)>;
+
+    struct Benchmark
+    {
+        std::string name;
+        uint64_t bytesPerOp = 0; // Bytes processed per operation, 0 when throughput is meaningless.
+        std::function<Body()> prepare;
+    };
+
+    struct Result
+    {
+        std::string name;
+        uint64_t iterations = 0; // Per repetition.
+        uint32_t repetitions = 0;
+        double medianNs = 0.0; // Per operation.
+        double meanNs = 0.0;
+        double minNs = 0.0;
+        double stddevNs = 0.0;
+        double bytesPerSecond = 0.0; // From the median, 0 without bytesPerOp.
+    };
+
+    struct Settings
+    {
+        double minRepetitionSeconds = 0.05;
+        uint32_t repetitions = 15;
+        int cpu = 0; // Core to pin the thread to, -1 leaves scheduling alone.
+    };
+
+    // Pins the calling thread to one core and raises its priority, so frequency and migration noise stay low.
+    // Returns false when the platform refuses.
+    bool pinCurrentThread(int cpu);
+
+    Result run(const Benchmark& benchmark, const Settings& settings);
+
+    void printHeader();
+    void printResult(const Result& result);
+    bool writeJson(const std::string& path, const std::string& label, const Settings& settings, const std::vector<Result>& results);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    // Defined out of line and never inlined, so the compiler must assume it reads through the pointer.
+    void escape(const volatile void* pointer);
+#endif
+
+    // Keeps the compiler from discarding a computed value: it must be materialised in a register or in memory, and
+    // no load or store is moved across the call.
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        escape(&value);
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : : "r,m"(value) : "memory");
+#endif
+    }
+
+    // Forces pending stores to be treated as observable.
+    inline void clobberMemory()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : : : "memory");
+#endif
+    }
+}
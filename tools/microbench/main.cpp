@@ -0,0 +1,313 @@
+// Microbenchmarks for CPU-side hot paths that grow with the scene or the image.
+//
+// Usage: microbench [--filter SUBSTRING] [--repetitions N] [--min-time SECONDS] [--cpu N] [--json <file>] [--label NAME]
+//
+// Each benchmark is calibrated to --min-time per repetition and repeated --repetitions times on a thread pinned
+// to --cpu (-1 disables pinning). The table reports median/min ns per operation, the relative standard deviation
+// and, where an operation has a size, MiB/s. --json writes the same results for diffing between commits.
+//
+// No GPU is needed: the benchmarks call the CPU halves of the renderer directly. There is no BVH yet; add its
+// build here once it exists.
+
+#include "Bench.h"
+
+#include "../../src/rt/RayTracer.h"
+#include "../../src/util/Image.h"
+#include "../../src/util/ImageError.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        std::string filter;
+        bench::Settings settings;
+        std::string jsonPath;
+        std::string label = "microbench";
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--filter")
+            {
+                options.filter = next();
+            }
+            else if (arg == "--repetitions")
+            {
+                options.settings.repetitions = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--min-time")
+            {
+                options.settings.minRepetitionSeconds = std::stod(next());
+            }
+            else if (arg == "--cpu")
+            {
+                options.settings.cpu = std::stoi(next());
+            }
+            else if (arg == "--json")
+            {
+                options.jsonPath = next();
+            }
+            else if (arg == "--label")
+            {
+                options.label = next();
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        return options;
+    }
+
+    // Deterministic pseudo-random scene content, so runs are comparable.
+    struct Lcg
+    {
+        uint32_t state = 0x9e3779b9u;
+
+        float next()
+        {
+            state = state * 1664525u + 1013904223u;
+
+            return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    std::vector<glm::vec4> makeAccumulation(uint32_t width, uint32_t height, float samples)
+    {
+        std::vector<glm::vec4> accumulation(static_cast<size_t>(width) * height);
+        Lcg random;
+
+        for (auto& pixel : accumulation)
+        {
+            pixel = { random.next() * samples, random.next() * samples, random.next() * samples, samples };
+        }
+
+        return accumulation;
+    }
+
+    Image makeImage(uint32_t width, uint32_t height, uint32_t seed)
+    {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(static_cast<size_t>(width) * height);
+        Lcg random{ seed };
+
+        for (auto& pixel : image.pixels)
+        {
+            pixel = { random.next() * 2.0f, random.next(), random.next() * 0.5f };
+        }
+
+        return image;
+    }
+
+    void addCameraBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+    {
+        benchmarks.push_back({ "camera_params/1920x1080", sizeof(GPUParams), []() -> bench::Body
+        {
+            auto tracer = std::make_shared<RayTracer>();
+            tracer->setCamera({ 13.0f, 2.0f, 3.0f }, { -1.0f, 0.0f, 0.0f }, 10.0f);
+
+            return [tracer](uint64_t iterations)
+            {
+                for (uint64_t i = 0; i < iterations; ++i)
+                {
+                    GPUParams params = tracer->makeCameraParams({ 1920, 1080 });
+                    bench::doNotOptimize(params);
+                }
+            };
+        } });
+    }
+
+    void addSceneBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+    {
+        benchmarks.push_back({ "build_scene", 5 * sizeof(GPUSphere), []() -> bench::Body
+        {
+            auto tracer = std::make_shared<RayTracer>();
+
+            return [tracer](uint64_t iterations)
+            {
+                for (uint64_t i = 0; i < iterations; ++i)
+                {
+                    tracer->buildScene();
+                    bench::doNotOptimize(tracer->spheres().data());
+                }
+            };
+        } });
+
+        for (uint32_t count : { 1024u, 65536u, 1048576u })
+        {
+            // Packing a generated sphere field, as a procedural or loaded scene would.
+            benchmarks.push_back({ "sphere_pack/" + std::to_string(count), count * sizeof(GPUSphere), [count]() -> bench::Body
+            {
+                auto spheres = std::make_shared<std::vector<GPUSphere>>();
+                spheres->reserve(count);
+
+                return [count, spheres](uint64_t iterations)
+                {
+                    for (uint64_t i = 0; i < iterations; ++i)
+                    {
+                        Lcg random;
+                        spheres->clear();
+
+                        for (uint32_t s = 0; s < count; ++s)
+                        {
+                            const glm::vec3 center{ random.next() * 100.0f - 50.0f, 0.2f, random.next() * 100.0f - 50.0f };
+                            const SphereMaterial material = static_cast<SphereMaterial>(s % 3);
+                            spheres->push_back(packSphere(center, 0.2f, { random.next(), random.next(), random.next() }, material, random.next() * 0.5f, 1.5f));
+                        }
+
+                        bench::doNotOptimize(spheres->data());
+                    }
+                };
+            } });
+
+            // Host side of the scene upload: the copy into mapped memory.
+            benchmarks.push_back({ "sphere_upload_copy/" + std::to_string(count), count * sizeof(GPUSphere), [count]() -> bench::Body
+            {
+                auto spheres = std::make_shared<std::vector<GPUSphere>>(count, packSphere({ 0.0f, 1.0f, 0.0f }, 1.0f, { 0.5f, 0.5f, 0.5f }, SphereMaterial::Lambert));
+                auto mapped = std::make_shared<std::vector<GPUSphere>>(count);
+
+                return [spheres, mapped](uint64_t iterations)
+                {
+                    for (uint64_t i = 0; i < iterations; ++i)
+                    {
+                        std::memcpy(mapped->data(), spheres->data(), spheres->size() * sizeof(GPUSphere));
+                        bench::doNotOptimize(mapped->data());
+                        bench::clobberMemory();
+                    }
+                };
+            } });
+        }
+    }
+
+    void addImageBenchmarks(std::vector<bench::Benchmark>& benchmarks)
+    {
+        struct Size
+        {
+            uint32_t width;
+            uint32_t height;
+        };
+
+        for (Size size : { Size{ 640, 360 }, Size{ 1920, 1080 }, Size{ 3840, 2160 } })
+        {
+            const std::string suffix = "/" + std::to_string(size.width) + "x" + std::to_string(size.height);
+            const uint64_t pixels = static_cast<uint64_t>(size.width) * size.height;
+
+            benchmarks.push_back({ "resolve_accumulation" + suffix, pixels * sizeof(glm::vec4), [size]() -> bench::Body
+            {
+                auto accumulation = std::make_shared<std::vector<glm::vec4>>(makeAccumulation(size.width, size.height, 64.0f));
+
+                return [size, accumulation](uint64_t iterations)
+                {
+                    for (uint64_t i = 0; i < iterations; ++i)
+                    {
+                        Image image = resolveAccumulation(*accumulation, size.width, size.height);
+                        bench::doNotOptimize(image.pixels.data());
+                    }
+                };
+            } });
+
+            benchmarks.push_back({ "compare_images" + suffix, 2 * pixels * sizeof(glm::vec3), [size]() -> bench::Body
+            {
+                auto test = std::make_shared<Image>(makeImage(size.width, size.height, 1));
+                auto reference = std::make_shared<Image>(makeImage(size.width, size.height, 2));
+
+                return [test, reference](uint64_t iterations)
+                {
+                    for (uint64_t i = 0; i < iterations; ++i)
+                    {
+                        ImageError error = compareImages(*test, *reference);
+                        bench::doNotOptimize(error);
+                    }
+                };
+            } });
+
+            benchmarks.push_back({ "write_pfm" + suffix, pixels * sizeof(glm::vec3), [size]() -> bench::Body
+            {
+                auto image = std::make_shared<Image>(makeImage(size.width, size.height, 3));
+                const std::string path = (std::filesystem::temp_directory_path() / "vrayt_microbench.pfm").string();
+
+                return [image, path](uint64_t iterations)
+                {
+                    for (uint64_t i = 0; i < iterations; ++i)
+                    {
+                        writePfm(path, *image);
+                    }
+                };
+            } });
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        if (!bench::pinCurrentThread(options.settings.cpu))
+        {
+            std::fprintf(stderr, "microbench: could not pin to CPU %d, results may be noisy\n", options.settings.cpu);
+        }
+
+        std::vector<bench::Benchmark> benchmarks;
+        addCameraBenchmarks(benchmarks);
+        addSceneBenchmarks(benchmarks);
+        addImageBenchmarks(benchmarks);
+
+        std::vector<bench::Result> results;
+        bench::printHeader();
+
+        for (const auto& benchmark : benchmarks)
+        {
+            if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+            {
+                continue;
+            }
+
+            results.push_back(bench::run(benchmark, options.settings));
+            bench::printResult(results.back());
+        }
+
+        std::filesystem::remove(std::filesystem::temp_directory_path() / "vrayt_microbench.pfm");
+
+        if (!options.jsonPath.empty() && !bench::writeJson(options.jsonPath, options.label, options.settings, results))
+        {
+            throw std::runtime_error("Failed to write " + options.jsonPath);
+        }
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        std::fprintf(stderr, "microbench: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
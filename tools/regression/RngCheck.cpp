@@ -0,0 +1,228 @@
+#include "RngCheck.h"
+
+#include "../../src/rt/Rng.h"
+#include "../../src/rt/ShaderLibrary.h"
+#include "../../src/util/Check.h"
+#include "../../src/vk/VulkanContext.h"
+
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Matches KatCase in shaders/rng_kat.comp.glsl.
+    struct KatCase
+    {
+        glm::uvec4 counter;
+        glm::uvec4 key; // xy = Philox key and pixel, zw = sample index (low, high).
+    };
+
+    struct KnownAnswer
+    {
+        KatCase input;
+        glm::uvec4 expected; // Philox4x32-10 of counter and key.xy, from Random123's kat_vectors.
+    };
+
+    const KnownAnswer knownAnswers[] =
+    {
+        { { { 0u, 0u, 0u, 0u }, { 0u, 0u, 0u, 0u } }, { 0x6627E8D5u, 0xE169C58Du, 0xBC57AC4Cu, 0x9B00DBD8u } },
+        { { { 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu }, { 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu } },
+            { 0x408F276Du, 0x41C83B0Eu, 0xA20BC7C6u, 0x6D5451FDu } },
+        { { { 0x243F6A88u, 0x85A308D3u, 0x13198A2Eu, 0x03707344u }, { 0xA4093822u, 0x299F31D0u, 0x082EFA98u, 0xEC4E6C89u } },
+            { 0xD16CFE09u, 0x94FDCCEBu, 0x5001E420u, 0x24126EA1u } },
+    };
+
+    // Pixels and sample indices as the kernel uses them, including a sample index past 32 bits.
+    const KatCase samples[] =
+    {
+        { { 0u, 0u, 0u, 0u }, { 17u, 941u, 0u, 0u } },
+        { { 0u, 0u, 0u, 0u }, { 1919u, 1079u, 4095u, 0u } },
+        { { 0u, 0u, 0u, 0u }, { 3u, 7u, 0xFFFFFFFEu, 1u } },
+    };
+
+    // What rng_kat writes for one case: the Philox block, then eight draws as float bits.
+    std::array<glm::uvec4, 3> expectedResults(const KatCase& katCase)
+    {
+        std::array<glm::uvec4, 3> results{};
+        results[0] = philox4x32(katCase.counter, glm::uvec2(katCase.key.x, katCase.key.y));
+
+        SampleRng rng({ katCase.key.x, katCase.key.y }, (static_cast<uint64_t>(katCase.key.w) << 32) | katCase.key.z);
+
+        for (size_t block = 1; block < results.size(); ++block)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                results[block][lane] = std::bit_cast<uint32_t>(rng.next());
+            }
+        }
+
+        return results;
+    }
+
+    VkBuffer createHostBuffer(VulkanContext& vulkanContext, VkDeviceSize size, VmaMemoryUsage usage, VmaAllocation& allocation, void*& mapped)
+    {
+        VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = usage;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocationInfo info{};
+        VK_CHECK(vmaCreateBuffer(vulkanContext.allocator(), &bufferInfo, &allocInfo, &buffer, &allocation, &info));
+        mapped = info.pMappedData;
+
+        return buffer;
+    }
+
+    // Runs rng_kat over the cases and returns its results, three per case.
+    std::vector<glm::uvec4> runKernel(VulkanContext& vulkanContext, const std::vector<KatCase>& cases)
+    {
+        VkDevice device = vulkanContext.device();
+        const VkDeviceSize casesBytes = sizeof(KatCase) * cases.size();
+        const VkDeviceSize resultsBytes = sizeof(glm::uvec4) * 3 * cases.size();
+
+        VmaAllocation casesAlloc = VK_NULL_HANDLE;
+        VmaAllocation resultsAlloc = VK_NULL_HANDLE;
+        void* casesMapped = nullptr;
+        void* resultsMapped = nullptr;
+        VkBuffer casesBuffer = createHostBuffer(vulkanContext, casesBytes, VMA_MEMORY_USAGE_CPU_TO_GPU, casesAlloc, casesMapped);
+        VkBuffer resultsBuffer = createHostBuffer(vulkanContext, resultsBytes, VMA_MEMORY_USAGE_GPU_TO_CPU, resultsAlloc, resultsMapped);
+        std::memcpy(casesMapped, cases.data(), casesBytes);
+        vmaFlushAllocation(vulkanContext.allocator(), casesAlloc, 0, VK_WHOLE_SIZE);
+
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+        bindings[0] = { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+        bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout));
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+        const std::vector<uint32_t> spirv = shaders::loadSpirv("rng_kat");
+        VkShaderModuleCreateInfo moduleInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        moduleInfo.codeSize = spirv.size() * sizeof(uint32_t);
+        moduleInfo.pCode = spirv.data();
+        VkShaderModule module = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateShaderModule(device, &moduleInfo, nullptr, &module));
+
+        VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        pipelineInfo.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        vkDestroyShaderModule(device, module, nullptr);
+
+        VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 };
+        VkDescriptorPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+
+        VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &set));
+
+        VkDescriptorBufferInfo bufferInfos[2] = { { casesBuffer, 0, VK_WHOLE_SIZE }, { resultsBuffer, 0, VK_WHOLE_SIZE } };
+        std::array<VkWriteDescriptorSet, 2> writes{};
+
+        for (uint32_t binding = 0; binding < writes.size(); ++binding)
+        {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = set;
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].descriptorCount = 1;
+            writes[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        vulkanContext.submitImmediate([&](VkCommandBuffer commandBuffer)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+            vkCmdDispatch(commandBuffer, static_cast<uint32_t>(cases.size()), 1, 1);
+
+            VkMemoryBarrier toHost{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            toHost.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &toHost, 0, nullptr, 0, nullptr);
+        });
+
+        vmaInvalidateAllocation(vulkanContext.allocator(), resultsAlloc, 0, VK_WHOLE_SIZE);
+        std::vector<glm::uvec4> results(3 * cases.size());
+        std::memcpy(results.data(), resultsMapped, resultsBytes);
+
+        vkDestroyDescriptorPool(device, pool, nullptr);
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        vmaDestroyBuffer(vulkanContext.allocator(), resultsBuffer, resultsAlloc);
+        vmaDestroyBuffer(vulkanContext.allocator(), casesBuffer, casesAlloc);
+
+        return results;
+    }
+}
+
+bool checkRng(VulkanContext& vulkanContext)
+{
+    bool passed = true;
+    std::vector<KatCase> cases;
+
+    for (const KnownAnswer& answer : knownAnswers)
+    {
+        const glm::uvec4 block = philox4x32(answer.input.counter, glm::uvec2(answer.input.key.x, answer.input.key.y));
+
+        if (block != answer.expected)
+        {
+            std::printf("rng: Rng.h Philox differs from the known answer for case %zu\n", cases.size());
+            passed = false;
+        }
+
+        cases.push_back(answer.input);
+    }
+
+    cases.insert(cases.end(), std::begin(samples), std::end(samples));
+    const std::vector<glm::uvec4> results = runKernel(vulkanContext, cases);
+
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        const std::array<glm::uvec4, 3> expected = expectedResults(cases[i]);
+
+        if (results[i * 3] != expected[0])
+        {
+            std::printf("rng: rng.glsl Philox differs from Rng.h for case %zu\n", i);
+            passed = false;
+        }
+        if (results[i * 3 + 1] != expected[1] || results[i * 3 + 2] != expected[2])
+        {
+            std::printf("rng: rng.glsl draws differ from Rng.h for case %zu\n", i);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
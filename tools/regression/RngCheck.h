@@ -0,0 +1,8 @@
+#pragma once
+
+class VulkanContext;
+
+// Checks the Philox random numbers: src/rt/Rng.h against the Random123 known-answer vectors, and
+// shaders/rng.glsl (through the rng_kat kernel) against src/rt/Rng.h bit for bit, including the float
+// conversion. Prints a line per failed case and returns whether all of them passed. Submits and waits.
+bool checkRng(VulkanContext& vulkanContext);
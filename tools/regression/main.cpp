@@ -0,0 +1,380 @@
+// Golden-image and throughput regression suite.
+//
+// Usage: regression [--golden <dir>] [--update] [--scene NAME]... [--width W] [--height H] [--frames N]
+//                   [--max-rmse X] [--max-flip X] [--max-slowdown F] [--validation]
+//
+// Renders each canonical scene headless from frame 0 (fixed random streams) and compares the result against
+// <golden>/<scene>.pfm. Throughput (samples per second, first frame excluded as warm-up) is compared against
+// <golden>/baseline.txt when that baseline was recorded on the same device. Rays per second, from the kernel's
+// ray counters, are reported and recorded alongside but not checked, since they follow samples per second. The tool exits with a non-zero
+// code when an image is off by more than the tolerances or a scene is slower than the baseline by more than
+// --max-slowdown. --update rewrites the goldens and the baseline instead of checking them.
+//
+// Before rendering, the Philox generator is checked against the Random123 known answers on the CPU
+// (src/rt/Rng.h) and bit for bit between the CPU and the GPU (shaders/rng.glsl); a mismatch fails the run.
+//
+// Needs no GPU: set VRAYT_DEVICE=llvmpipe to run on lavapipe, which is also the device the goldens should be
+// recorded on, since other devices trace slightly different paths.
+
+#include "RngCheck.h"
+
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/ImageError.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Camera and sampling presets over the built-in scene, each stressing a different part of the kernel.
+    struct Scene
+    {
+        const char* name;
+        glm::vec3 position;
+        glm::vec3 direction;
+        float focusDistance;
+        float aperture;
+        float verticalFov;
+        uint32_t samplesPerPixel;
+        uint32_t maxDepth;
+    };
+
+    const Scene scenes[] =
+    {
+        { "default", { 13.0f, 2.0f, 3.0f }, { -1.0f, 0.0f, 0.0f }, 10.0f, 0.05f, 20.0f, 4, 12 },
+        { "depth_of_field", { 13.0f, 2.0f, 3.0f }, { -1.0f, 0.0f, 0.0f }, 10.0f, 0.4f, 20.0f, 4, 12 },
+        { "direct", { 13.0f, 2.0f, 3.0f }, { -1.0f, 0.0f, 0.0f }, 10.0f, 0.0f, 20.0f, 4, 1 },
+        { "glass_closeup", { -4.0f, 1.3f, 4.5f }, { 0.0f, -0.05f, -1.0f }, 4.5f, 0.0f, 40.0f, 4, 12 },
+        { "overview", { 0.0f, 12.0f, 14.0f }, { 0.0f, -0.7f, -1.0f }, 18.0f, 0.0f, 45.0f, 4, 12 },
+    };
+
+    struct Options
+    {
+        std::string goldenDir = "tools/regression/golden";
+        bool update = false;
+        std::vector<std::string> sceneNames;
+        uint32_t width = 320;
+        uint32_t height = 180;
+        uint32_t frames = 32;
+        double maxRmse = 0.01;
+        double maxFlip = 0.005;
+        double maxSlowdown = 0.1;
+        bool validation = false;
+    };
+
+    // Throughput per scene, recorded together with the device it was measured on.
+    struct Baseline
+    {
+        std::string device;
+        std::map<std::string, double> samplesPerSecond;
+        std::map<std::string, double> raysPerSecond; // Missing from baselines written before rays were counted.
+    };
+
+    struct Throughput
+    {
+        double samplesPerSecond = 0.0;
+        double raysPerSecond = 0.0; // 0 when the kernel does not count rays.
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--golden")
+            {
+                options.goldenDir = next();
+            }
+            else if (arg == "--update")
+            {
+                options.update = true;
+            }
+            else if (arg == "--scene")
+            {
+                options.sceneNames.push_back(next());
+            }
+            else if (arg == "--width")
+            {
+                options.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                options.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--frames")
+            {
+                options.frames = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--max-rmse")
+            {
+                options.maxRmse = std::stod(next());
+            }
+            else if (arg == "--max-flip")
+            {
+                options.maxFlip = std::stod(next());
+            }
+            else if (arg == "--max-slowdown")
+            {
+                options.maxSlowdown = std::stod(next());
+            }
+            else if (arg == "--validation")
+            {
+                options.validation = true;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.width == 0 || options.height == 0 || options.frames < 2)
+        {
+            throw std::runtime_error("--width and --height must be positive and --frames at least 2");
+        }
+
+        return options;
+    }
+
+    std::vector<const Scene*> selectScenes(const Options& options)
+    {
+        std::vector<const Scene*> selected;
+
+        for (const Scene& scene : scenes)
+        {
+            bool wanted = options.sceneNames.empty();
+
+            for (const auto& name : options.sceneNames)
+            {
+                wanted = wanted || name == scene.name;
+            }
+
+            if (wanted)
+            {
+                selected.push_back(&scene);
+            }
+        }
+
+        if (selected.size() < std::max<size_t>(options.sceneNames.size(), 1))
+        {
+            throw std::runtime_error("Unknown scene in --scene");
+        }
+
+        return selected;
+    }
+
+    Baseline readBaseline(const std::filesystem::path& path)
+    {
+        Baseline baseline;
+        std::ifstream inputStream(path);
+        std::string line;
+
+        while (std::getline(inputStream, line))
+        {
+            if (line.rfind("device ", 0) == 0)
+            {
+                baseline.device = line.substr(7);
+                continue;
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            std::istringstream fields(line);
+            std::string scene;
+            double samplesPerSecond = 0.0;
+            double raysPerSecond = 0.0;
+
+            if (fields >> scene >> samplesPerSecond)
+            {
+                baseline.samplesPerSecond[scene] = samplesPerSecond;
+            }
+            if (fields >> raysPerSecond)
+            {
+                baseline.raysPerSecond[scene] = raysPerSecond;
+            }
+        }
+
+        return baseline;
+    }
+
+    void writeBaseline(const std::filesystem::path& path, const Baseline& baseline)
+    {
+        std::ofstream outputStream(path, std::ios::trunc);
+        outputStream << "# Samples and rays per second per scene, written by regression --update.\n";
+        outputStream << "device " << baseline.device << "\n";
+
+        for (const auto& [scene, samplesPerSecond] : baseline.samplesPerSecond)
+        {
+            auto rays = baseline.raysPerSecond.find(scene);
+            outputStream << scene << " " << samplesPerSecond << " " << (rays != baseline.raysPerSecond.end() ? rays->second : 0.0) << "\n";
+        }
+
+        if (!outputStream)
+        {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    }
+
+    // Renders the scene from frame 0 and measures throughput over every frame but the first. Each render reads back
+    // the previous frame's ray counters, so the timed renders yield the counts of frames 0 to frames - 2: as many
+    // frames, at the same samples each, as were timed.
+    Throughput renderScene(HeadlessRenderer& renderer, const Scene& scene, uint32_t frames)
+    {
+        RayTracer& tracer = renderer.tracer();
+        tracer.setCamera(scene.position, scene.direction, scene.focusDistance);
+        tracer.setAperture(scene.aperture);
+        tracer.setFov(scene.verticalFov);
+        tracer.setSamplesPerPixel(scene.samplesPerPixel);
+        tracer.setMaxDepth(scene.maxDepth);
+
+        renderer.renderFrame(0);
+        Timer timer;
+        uint64_t rays = 0;
+
+        for (uint32_t frame = 1; frame < frames; ++frame)
+        {
+            renderer.renderFrame(frame);
+            rays += tracer.lastRayCounts().rays();
+        }
+
+        const double seconds = timer.elapsedSeconds();
+        const double samples = static_cast<double>(frames - 1) * scene.samplesPerPixel * renderer.extent().width * renderer.extent().height;
+
+        Throughput throughput;
+
+        if (seconds > 0.0)
+        {
+            throughput.samplesPerSecond = samples / seconds;
+            throughput.raysPerSecond = static_cast<double>(rays) / seconds;
+        }
+
+        return throughput;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        std::vector<const Scene*> selected = selectScenes(options);
+        const std::filesystem::path goldenDir = options.goldenDir;
+        const std::filesystem::path baselinePath = goldenDir / "baseline.txt";
+
+        HeadlessRenderer renderer;
+        renderer.create({ options.width, options.height }, options.validation);
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(renderer.context().physical(), &properties);
+        const std::string device = properties.deviceName;
+
+        Baseline baseline = readBaseline(baselinePath);
+        const bool compareThroughput = !options.update && baseline.device == device;
+
+        if (!options.update && !baseline.device.empty() && !compareThroughput)
+        {
+            std::printf("Throughput baseline was recorded on %s, not %s; skipping throughput checks.\n", baseline.device.c_str(), device.c_str());
+        }
+
+        if (options.update)
+        {
+            std::filesystem::create_directories(goldenDir);
+            baseline.device = device;
+        }
+
+        // Split and resumed renders rely on both generators drawing the same numbers.
+        bool passed = checkRng(renderer.context());
+        std::printf("rng: %s\n", passed ? "ok" : "FAIL");
+
+        std::printf("%-16s %10s %10s %12s %12s %10s  %s\n", "scene", "rmse", "flip", "Msamples/s", "baseline", "Mrays/s", "result");
+
+        for (const Scene* scene : selected)
+        {
+            const Throughput throughput = renderScene(renderer, *scene, options.frames);
+            const double samplesPerSecond = throughput.samplesPerSecond;
+            const double raysPerSecond = throughput.raysPerSecond;
+            const Image image = renderer.readImage();
+            const std::filesystem::path goldenPath = goldenDir / (std::string(scene->name) + ".pfm");
+
+            if (options.update)
+            {
+                writePfm(goldenPath.string(), image);
+                baseline.samplesPerSecond[scene->name] = samplesPerSecond;
+                baseline.raysPerSecond[scene->name] = raysPerSecond;
+                std::printf("%-16s %10s %10s %12.3f %12s %10.3f  updated\n", scene->name, "-", "-", samplesPerSecond * 1e-6, "-", raysPerSecond * 1e-6);
+
+                continue;
+            }
+
+            if (!std::filesystem::exists(goldenPath))
+            {
+                std::printf("%-16s %10s %10s %12.3f %12s %10.3f  FAIL (no golden, run with --update)\n", scene->name, "-", "-", samplesPerSecond * 1e-6, "-",
+                    raysPerSecond * 1e-6);
+                passed = false;
+
+                continue;
+            }
+
+            const ImageError error = compareImages(image, readPfm(goldenPath.string()));
+            std::string result = "ok";
+
+            if (error.rmse > options.maxRmse || error.flip > options.maxFlip)
+            {
+                result = "FAIL (image)";
+            }
+
+            auto base = baseline.samplesPerSecond.find(scene->name);
+            const bool hasBase = compareThroughput && base != baseline.samplesPerSecond.end();
+
+            if (hasBase && samplesPerSecond < base->second * (1.0 - options.maxSlowdown))
+            {
+                result = result == "ok" ? "FAIL (throughput)" : "FAIL (image, throughput)";
+            }
+
+            passed = passed && result == "ok";
+            std::printf("%-16s %10.5f %10.5f %12.3f %12.3f %10.3f  %s\n", scene->name, error.rmse, error.flip, samplesPerSecond * 1e-6,
+                hasBase ? base->second * 1e-6 : 0.0, raysPerSecond * 1e-6, result.c_str());
+        }
+
+        if (options.update)
+        {
+            writeBaseline(baselinePath, baseline);
+            logger::info("Goldens and baseline written to %s", goldenDir.string());
+        }
+
+        renderer.destroy();
+        logger::flush();
+
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "regression: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,265 @@
+// Offline single-image renderer with checkpoints, for long renders that may be interrupted or split across machines.
+//
+// Usage: render [--width W] [--height H] [--spp N] [--spp-per-frame N] [--depth N] [--aperture A] [--fov DEGREES]
+//               [--out <file.pfm|file.exr|file.png>] [--float] [--checkpoint <file>] [--checkpoint-interval SECONDS]
+//               [--resume] [--frame-offset N] [--validation]
+//
+// With --checkpoint, the accumulation sums (with their per-pixel sample counts), the frame range rendered and
+// hashes of the scene and settings are written to the file every --checkpoint-interval seconds and at the end.
+// --resume uploads the checkpoint back into the accumulation image and continues from its next frame until --spp
+// is reached; the hashes must match the current scene and settings. Independent runs of the same image, for
+// example on several machines, should use disjoint --frame-offset ranges so their random streams differ; the
+// merge tool then combines their checkpoints.
+
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/Checkpoint.h"
+#include "../../src/util/ImageEncode.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    struct Options
+    {
+        uint32_t width = 1280;
+        uint32_t height = 720;
+        uint32_t spp = 1024;
+        uint32_t sppPerFrame = 8;
+        uint32_t maxDepth = 12;
+        float aperture = 0.05f;
+        float fov = 20.0f;
+        std::string outPath = "render.exr";
+        bool fullFloat = false;
+        std::string checkpointPath;
+        double checkpointInterval = 60.0;
+        bool resume = false;
+        uint32_t frameOffset = 0;
+        bool validation = false;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--width")
+            {
+                options.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                options.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp")
+            {
+                options.spp = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp-per-frame")
+            {
+                options.sppPerFrame = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                options.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--aperture")
+            {
+                options.aperture = std::stof(next());
+            }
+            else if (arg == "--fov")
+            {
+                options.fov = std::stof(next());
+            }
+            else if (arg == "--out")
+            {
+                options.outPath = next();
+            }
+            else if (arg == "--float")
+            {
+                options.fullFloat = true;
+            }
+            else if (arg == "--checkpoint")
+            {
+                options.checkpointPath = next();
+            }
+            else if (arg == "--checkpoint-interval")
+            {
+                options.checkpointInterval = std::stod(next());
+            }
+            else if (arg == "--resume")
+            {
+                options.resume = true;
+            }
+            else if (arg == "--frame-offset")
+            {
+                options.frameOffset = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--validation")
+            {
+                options.validation = true;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.width == 0 || options.height == 0 || options.spp == 0 || options.sppPerFrame == 0)
+        {
+            throw std::runtime_error("--width, --height, --spp and --spp-per-frame must be positive");
+        }
+        if (options.resume && options.checkpointPath.empty())
+        {
+            throw std::runtime_error("--resume needs --checkpoint");
+        }
+
+        return options;
+    }
+
+    ImageFormat outputFormat(const Options& options)
+    {
+        const std::string extension = std::filesystem::path(options.outPath).extension().string();
+
+        if (extension == ".pfm")
+        {
+            return ImageFormat::Pfm;
+        }
+        if (extension == ".exr")
+        {
+            return options.fullFloat ? ImageFormat::ExrFloat : ImageFormat::ExrHalf;
+        }
+        if (extension == ".png")
+        {
+            return ImageFormat::Png;
+        }
+
+        throw std::runtime_error("--out must end in .pfm, .exr or .png");
+    }
+
+    void saveCheckpoint(HeadlessRenderer& renderer, const std::string& path, Checkpoint& checkpoint)
+    {
+        Timer timer;
+        renderer.tracer().readAccumulation(renderer.context(), checkpoint.sums);
+        writeCheckpoint(path, checkpoint);
+
+        logger::info("Checkpoint %s: frames %llu-%llu, %llu spp (%.3f s)", path, static_cast<unsigned long long>(checkpoint.firstFrame),
+            static_cast<unsigned long long>(checkpoint.nextFrame), static_cast<unsigned long long>(checkpoint.samplesPerPixel), timer.elapsedSeconds());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        const ImageFormat format = outputFormat(options);
+
+        HeadlessRenderer renderer;
+        renderer.create({ options.width, options.height }, options.validation);
+        RayTracer& tracer = renderer.tracer();
+        tracer.setSamplesPerPixel(options.sppPerFrame);
+        tracer.setMaxDepth(options.maxDepth);
+        tracer.setAperture(options.aperture);
+        tracer.setFov(options.fov);
+
+        Checkpoint checkpoint;
+        checkpoint.width = options.width;
+        checkpoint.height = options.height;
+        checkpoint.sceneHash = tracer.sceneHash();
+        checkpoint.settingsHash = tracer.settingsHash(renderer.extent());
+        checkpoint.firstFrame = options.frameOffset;
+        checkpoint.nextFrame = options.frameOffset;
+        checkpoint.samplesPerFrame = options.sppPerFrame;
+
+        if (options.resume && std::filesystem::exists(options.checkpointPath))
+        {
+            Checkpoint saved = readCheckpoint(options.checkpointPath);
+
+            if (saved.width != checkpoint.width || saved.height != checkpoint.height)
+            {
+                throw std::runtime_error(options.checkpointPath + " is " + std::to_string(saved.width) + "x" + std::to_string(saved.height));
+            }
+            if (saved.sceneHash != checkpoint.sceneHash || saved.settingsHash != checkpoint.settingsHash)
+            {
+                throw std::runtime_error(options.checkpointPath + " was rendered from a different scene or settings");
+            }
+
+            // Frame indices key the random numbers at a fixed samples per frame; another one would repeat samples.
+            if (saved.samplesPerPixel > 0 && saved.samplesPerFrame != checkpoint.samplesPerFrame)
+            {
+                throw std::runtime_error(options.checkpointPath + " was rendered at " + std::to_string(saved.samplesPerFrame) +
+                    " samples per frame (0 if unknown); resume it with that --spp-per-frame");
+            }
+
+            // Settings are applied above, so the upload is not cleared by their reset. An empty checkpoint is
+            // simply restarted; anything else has a non-zero next frame, which does not clear either.
+            if (saved.samplesPerPixel > 0)
+            {
+                tracer.writeAccumulation(renderer.context(), saved.sums);
+                checkpoint = std::move(saved);
+            }
+
+            std::printf("Resuming %s at frame %llu, %llu spp\n", options.checkpointPath.c_str(), static_cast<unsigned long long>(checkpoint.nextFrame),
+                static_cast<unsigned long long>(checkpoint.samplesPerPixel));
+        }
+        else if (options.resume)
+        {
+            std::printf("%s does not exist, starting from frame %u\n", options.checkpointPath.c_str(), options.frameOffset);
+        }
+
+        Timer totalTimer;
+        Timer checkpointTimer;
+
+        while (checkpoint.samplesPerPixel < options.spp)
+        {
+            renderer.renderFrame(static_cast<uint32_t>(checkpoint.nextFrame));
+            ++checkpoint.nextFrame;
+            checkpoint.samplesPerPixel += options.sppPerFrame;
+
+            if (!options.checkpointPath.empty() && checkpointTimer.elapsedSeconds() >= options.checkpointInterval)
+            {
+                saveCheckpoint(renderer, options.checkpointPath, checkpoint);
+                checkpointTimer.reset();
+            }
+        }
+
+        if (!options.checkpointPath.empty())
+        {
+            saveCheckpoint(renderer, options.checkpointPath, checkpoint);
+        }
+
+        writeFileMapped(options.outPath, encodeImage(renderer.readImage(), format));
+        std::printf("Wrote %s, %llu spp in %.1f s\n", options.outPath.c_str(), static_cast<unsigned long long>(checkpoint.samplesPerPixel),
+            totalTimer.elapsedSeconds());
+
+        renderer.destroy();
+        logger::flush();
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "render: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,471 @@
+#include "RenderDaemon.h"
+
+#include "../../src/net/LineReader.h"
+#include "../../src/util/Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    const int pollIntervalMs = 200;
+    const uint32_t maxDimension = 16384;
+
+    glm::vec3 readVec3(const JsonValue& value, const char* name)
+    {
+        const std::vector<JsonValue>& items = value.items();
+
+        if (items.size() != 3)
+        {
+            throw std::runtime_error(std::string(name) + " needs three numbers");
+        }
+
+        return { static_cast<float>(items[0].asNumber()), static_cast<float>(items[1].asNumber()), static_cast<float>(items[2].asNumber()) };
+    }
+
+    uint32_t readCount(const JsonValue& request, const char* name, uint32_t fallback, uint32_t maximum)
+    {
+        const double value = request.numberOr(name, fallback);
+
+        if (!(value >= 1.0 && value <= maximum))
+        {
+            throw std::runtime_error(std::string(name) + " must be between 1 and " + std::to_string(maximum));
+        }
+
+        return static_cast<uint32_t>(value);
+    }
+
+    ImageFormat formatForPath(const std::string& path)
+    {
+        const std::string extension = std::filesystem::path(path).extension().string();
+
+        if (extension == ".pfm")
+        {
+            return ImageFormat::Pfm;
+        }
+        if (extension == ".exr")
+        {
+            return ImageFormat::ExrHalf;
+        }
+        if (extension == ".png")
+        {
+            return ImageFormat::Png;
+        }
+
+        throw std::runtime_error("output must end in .pfm, .exr or .png");
+    }
+
+    std::string readTextFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        std::ostringstream text;
+        text << file.rdbuf();
+
+        return text.str();
+    }
+
+    JsonValue reply(uint64_t jobId, const JsonValue& tag, const char* state)
+    {
+        JsonValue message = JsonValue::object();
+
+        if (jobId != 0)
+        {
+            message.set("job", jobId);
+        }
+        if (!tag.isNull())
+        {
+            message.set("tag", tag);
+        }
+
+        message.set("state", state);
+
+        return message;
+    }
+}
+
+void RenderDaemon::Client::send(const JsonValue& message)
+{
+    const std::string line = message.dump() + "\n";
+    std::lock_guard<std::mutex> lock(sendMutex);
+
+    // A client that went away loses its replies; its jobs still run.
+    socket.sendAll(line.data(), line.size());
+}
+
+RenderDaemon::~RenderDaemon()
+{
+    mEncoders.stop();
+    shutdownThreads();
+}
+
+void RenderDaemon::run(const DaemonSettings& settings)
+{
+    mScenes = std::make_unique<SceneCache>(settings.sceneCapacity);
+    mRenderer.create({ 640, 360 }, settings.validation);
+
+    // The built-in scene is resident from the start and used by jobs without a scene.
+    RayTracer& tracer = mRenderer.tracer();
+    mDefaultScene = std::make_shared<const std::vector<GPUSphere>>(tracer.spheres());
+    mDefaultSceneKey = tracer.sceneHash();
+    mResidentSceneKey = mDefaultSceneKey;
+
+    mEncoders.start(settings.encodeWorkers, "encoder");
+    mSocketPath = settings.socketPath;
+    mListener = net::Socket::listenLocal(mSocketPath);
+    mRunning.store(true, std::memory_order_release);
+    mAcceptThread = std::thread([this]() { acceptLoop(); });
+    logger::info("Render daemon listening on %s", mSocketPath);
+
+    while (true)
+    {
+        std::unique_ptr<Job> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mQueueMutex);
+            mQueueWake.wait(lock, [this]() { return !mQueue.empty() || mShutdownRequested; });
+
+            if (mQueue.empty())
+            {
+                break;
+            }
+
+            job = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+
+        try
+        {
+            renderJob(*job);
+        }
+        catch (const std::exception& error)
+        {
+            logger::error("Job %llu failed: %s", static_cast<unsigned long long>(job->id), error.what());
+            ++mFailed;
+
+            JsonValue message = reply(job->id, job->tag, "failed");
+            message.set("error", error.what());
+            job->client->send(message);
+        }
+    }
+
+    // Outstanding encodes still reply to their clients.
+    mEncoders.stop();
+    shutdownThreads();
+    mRenderer.destroy();
+
+    std::error_code ignored;
+    std::filesystem::remove(mSocketPath, ignored);
+    logger::info("Render daemon stopped: %llu jobs done, %llu failed", static_cast<unsigned long long>(mCompleted.load()),
+        static_cast<unsigned long long>(mFailed.load()));
+}
+
+void RenderDaemon::shutdownThreads()
+{
+    mRunning.store(false, std::memory_order_release);
+
+    if (mAcceptThread.joinable())
+    {
+        mAcceptThread.join();
+    }
+
+    std::vector<ClientThread> threads;
+
+    {
+        std::lock_guard<std::mutex> lock(mClientThreadsMutex);
+        threads.swap(mClientThreads);
+    }
+
+    for (ClientThread& client : threads)
+    {
+        client.thread.join();
+    }
+
+    mListener.close();
+}
+
+void RenderDaemon::acceptLoop()
+{
+    while (mRunning.load(std::memory_order_acquire))
+    {
+        joinFinishedClients();
+
+        // Poll so shutdown is noticed without having to unblock accept().
+        if (!mListener.waitReadable(pollIntervalMs))
+        {
+            continue;
+        }
+
+        net::Socket socket = mListener.accept();
+
+        if (!socket.valid())
+        {
+            continue;
+        }
+
+        auto client = std::make_shared<Client>();
+        client->socket = std::move(socket);
+
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+
+        std::lock_guard<std::mutex> lock(mClientThreadsMutex);
+        mClientThreads.push_back({ std::thread([this, client, finished]()
+        {
+            serveClient(client);
+            finished->store(true, std::memory_order_release);
+        }), finished });
+    }
+}
+
+void RenderDaemon::joinFinishedClients()
+{
+    std::lock_guard<std::mutex> lock(mClientThreadsMutex);
+
+    // A daemon lives for many connections; without this each would keep its thread, stack and profiler buffer.
+    mClientThreads.erase(std::remove_if(mClientThreads.begin(), mClientThreads.end(), [](ClientThread& client)
+    {
+        if (!client.finished->load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        client.thread.join();
+
+        return true;
+    }), mClientThreads.end());
+}
+
+void RenderDaemon::serveClient(std::shared_ptr<Client> client)
+{
+    net::LineReader reader;
+    std::string line;
+
+    while (mRunning.load(std::memory_order_acquire))
+    {
+        const net::LineReader::Result result = reader.next(client->socket, line, pollIntervalMs);
+
+        if (result == net::LineReader::Result::Timeout)
+        {
+            continue;
+        }
+        if (result == net::LineReader::Result::Closed)
+        {
+            break;
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+
+        JsonValue request;
+
+        try
+        {
+            request = JsonValue::parse(line);
+            handleRequest(client, request);
+        }
+        catch (const std::exception& error)
+        {
+            JsonValue message = reply(0, request["tag"], "rejected");
+            message.set("error", error.what());
+            client->send(message);
+        }
+    }
+}
+
+void RenderDaemon::handleRequest(const std::shared_ptr<Client>& client, const JsonValue& request)
+{
+    const std::string op = request.stringOr("op", "render");
+    const JsonValue& tag = request["tag"];
+
+    if (op == "render")
+    {
+        std::unique_ptr<Job> job = parseJob(request);
+        job->client = client;
+        job->tag = tag;
+
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+
+        if (mShutdownRequested)
+        {
+            throw std::runtime_error("The daemon is shutting down");
+        }
+
+        job->id = mNextJobId++;
+        JsonValue message = reply(job->id, tag, "queued");
+        message.set("position", static_cast<uint64_t>(mQueue.size()));
+
+        // Replying under the lock keeps "queued" ahead of the job's result.
+        client->send(message);
+        mQueue.push_back(std::move(job));
+        mQueueWake.notify_one();
+    }
+    else if (op == "status")
+    {
+        JsonValue message = statusReply();
+        message.set("tag", tag);
+        client->send(message);
+    }
+    else if (op == "shutdown")
+    {
+        size_t queued = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+            mShutdownRequested = true;
+            queued = mQueue.size();
+            mQueueWake.notify_one();
+        }
+
+        JsonValue message = reply(0, tag, "shutting-down");
+        message.set("queued", static_cast<uint64_t>(queued));
+        client->send(message);
+    }
+    else
+    {
+        throw std::runtime_error("Unknown op " + op);
+    }
+}
+
+std::unique_ptr<RenderDaemon::Job> RenderDaemon::parseJob(const JsonValue& request)
+{
+    auto job = std::make_unique<Job>();
+    const JsonValue& scene = request["scene"];
+
+    if (scene.isNull() || (scene.type() == JsonValue::Type::String && scene.asString() == "default"))
+    {
+        job->scene = mDefaultScene;
+        job->sceneKey = mDefaultSceneKey;
+    }
+    else if (scene.type() == JsonValue::Type::String)
+    {
+        job->scene = mScenes->get(readTextFile(scene.asString()), job->sceneKey);
+    }
+    else
+    {
+        // Serialized again, so formatting differences between clients do not split the cache.
+        job->scene = mScenes->get(scene.dump(), job->sceneKey);
+    }
+
+    const JsonValue& camera = request["camera"];
+
+    if (!camera.isNull())
+    {
+        if (camera.has("position"))
+        {
+            job->position = readVec3(camera["position"], "camera.position");
+        }
+        if (camera.has("target"))
+        {
+            job->target = readVec3(camera["target"], "camera.target");
+        }
+
+        job->fov = static_cast<float>(camera.numberOr("fov", job->fov));
+        job->aperture = static_cast<float>(camera.numberOr("aperture", job->aperture));
+        job->focus = static_cast<float>(camera.numberOr("focus", job->focus));
+    }
+
+    if (job->position == job->target)
+    {
+        throw std::runtime_error("camera.position and camera.target must differ");
+    }
+
+    job->width = readCount(request, "width", job->width, maxDimension);
+    job->height = readCount(request, "height", job->height, maxDimension);
+    job->spp = readCount(request, "spp", job->spp, 1u << 20);
+    job->sppPerFrame = readCount(request, "sppPerFrame", job->sppPerFrame, 1024);
+    job->maxDepth = readCount(request, "depth", job->maxDepth, 64);
+    job->outputPath = request["output"].asString();
+    job->format = formatForPath(job->outputPath);
+
+    return job;
+}
+
+void RenderDaemon::renderJob(Job& job)
+{
+    const double queueSeconds = job.queuedTimer.elapsedSeconds();
+    Timer traceTimer;
+    RayTracer& tracer = mRenderer.tracer();
+
+    mRenderer.resize({ job.width, job.height });
+
+    // Consecutive jobs on one scene keep its buffer as is.
+    if (job.sceneKey != mResidentSceneKey)
+    {
+        tracer.setScene(mRenderer.context(), *job.scene);
+        mResidentSceneKey = job.sceneKey;
+    }
+
+    const float focus = job.focus > 0.0f ? job.focus : glm::length(job.target - job.position);
+    tracer.setCamera(job.position, job.target - job.position, focus);
+    tracer.setFov(job.fov);
+    tracer.setAperture(job.aperture);
+    tracer.setSamplesPerPixel(job.sppPerFrame);
+    tracer.setMaxDepth(job.maxDepth);
+
+    const uint32_t dispatches = (job.spp + job.sppPerFrame - 1) / job.sppPerFrame;
+
+    for (uint32_t dispatch = 0; dispatch < dispatches; ++dispatch)
+    {
+        mRenderer.renderFrame(dispatch);
+    }
+
+    auto image = std::make_shared<Image>(mRenderer.readImage());
+    const double traceSeconds = traceTimer.elapsedSeconds();
+
+    // Encoding and writing overlap the next job's trace.
+    mEncoders.submit([this, image, id = job.id, tag = job.tag, client = job.client, outputPath = job.outputPath, format = job.format,
+        queueSeconds, traceSeconds, queuedTimer = job.queuedTimer]()
+    {
+        try
+        {
+            writeFileMapped(outputPath, encodeImage(*image, format));
+            ++mCompleted;
+
+            JsonValue message = reply(id, tag, "done");
+            message.set("output", outputPath);
+            message.set("queueSeconds", queueSeconds);
+            message.set("traceSeconds", traceSeconds);
+            message.set("totalSeconds", queuedTimer.elapsedSeconds());
+            client->send(message);
+        }
+        catch (const std::exception& error)
+        {
+            logger::error("Job %llu failed: %s", static_cast<unsigned long long>(id), error.what());
+            ++mFailed;
+
+            JsonValue message = reply(id, tag, "failed");
+            message.set("error", error.what());
+            client->send(message);
+        }
+    });
+}
+
+JsonValue RenderDaemon::statusReply()
+{
+    size_t queued = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        queued = mQueue.size();
+    }
+
+    JsonValue message = reply(0, JsonValue(), "ok");
+    message.set("queued", static_cast<uint64_t>(queued));
+    message.set("encoding", static_cast<uint64_t>(mEncoders.pending()));
+    message.set("completed", mCompleted.load());
+    message.set("failed", mFailed.load());
+    message.set("sceneHits", static_cast<uint64_t>(mScenes->hits()));
+    message.set("sceneMisses", static_cast<uint64_t>(mScenes->misses()));
+
+    return message;
+}
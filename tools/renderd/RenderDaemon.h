@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/net/Socket.h"
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/rt/SceneCache.h"
+#include "../../src/util/ImageEncode.h"
+#include "../../src/util/Json.h"
+#include "../../src/util/Timer.h"
+#include "../../src/util/WorkerPool.h"
+
+struct DaemonSettings
+{
+    std::string socketPath;
+    uint32_t encodeWorkers = 0; // 0 picks one per hardware thread.
+    size_t sceneCapacity = 16;
+    bool validation = false;
+};
+
+// Keeps a headless renderer, its pipelines and recently used scenes resident and serves render jobs sent as
+// line-delimited JSON over a local socket. Jobs run one at a time in arrival order; each client gets a "queued"
+// reply at once and a "done" or "failed" reply when its image is written.
+class RenderDaemon
+{
+public:
+    RenderDaemon() = default;
+    ~RenderDaemon();
+
+    RenderDaemon(const RenderDaemon&) = delete;
+    RenderDaemon& operator=(const RenderDaemon&) = delete;
+
+    // Serves until a client sends a shutdown request; queued jobs still complete. Throws on startup errors.
+    void run(const DaemonSettings& settings);
+
+private:
+    struct Client
+    {
+        net::Socket socket;
+        std::mutex sendMutex;
+
+        void send(const JsonValue& message);
+    };
+
+    // A connection's thread; finished once serveClient returns, so the accept loop can join it.
+    struct ClientThread
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+
+    struct Job
+    {
+        uint64_t id = 0;
+        JsonValue tag; // Echoed back so clients can match replies to their requests.
+        std::shared_ptr<Client> client;
+        SceneCache::Scene scene;
+        uint64_t sceneKey = 0;
+        glm::vec3 position{ 13.0f, 2.0f, 3.0f };
+        glm::vec3 target{ 0.0f, 1.0f, 0.0f };
+        float fov = 20.0f;
+        float aperture = 0.05f;
+        float focus = -1.0f; // Distance to the target.
+        uint32_t width = 640;
+        uint32_t height = 360;
+        uint32_t spp = 64;
+        uint32_t sppPerFrame = 8;
+        uint32_t maxDepth = 12;
+        std::string outputPath;
+        ImageFormat format = ImageFormat::Png;
+        Timer queuedTimer;
+    };
+
+    void acceptLoop();
+    void serveClient(std::shared_ptr<Client> client);
+    void joinFinishedClients();
+    void handleRequest(const std::shared_ptr<Client>& client, const JsonValue& request);
+    std::unique_ptr<Job> parseJob(const JsonValue& request);
+    void renderJob(Job& job);
+    JsonValue statusReply();
+    void shutdownThreads();
+
+    HeadlessRenderer mRenderer;
+    std::unique_ptr<SceneCache> mScenes;
+    SceneCache::Scene mDefaultScene;
+    uint64_t mDefaultSceneKey = 0;
+    uint64_t mResidentSceneKey = 0;
+    WorkerPool mEncoders;
+
+    net::Socket mListener;
+    std::string mSocketPath;
+    std::thread mAcceptThread;
+    std::vector<ClientThread> mClientThreads;
+    std::mutex mClientThreadsMutex;
+    std::atomic<bool> mRunning{ false };
+
+    std::deque<std::unique_ptr<Job>> mQueue;
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueWake;
+    bool mShutdownRequested = false;
+    uint64_t mNextJobId = 1;
+
+    std::atomic<uint64_t> mCompleted{ 0 };
+    std::atomic<uint64_t> mFailed{ 0 };
+};
@@ -0,0 +1,245 @@
+// Resident render daemon for many small jobs, such as thumbnails, and its command-line client.
+//
+// Usage: renderd [--socket <path>] [--workers N] [--scenes N] [--validation]
+//        renderd --submit <job.json>... [--socket <path>]
+//        renderd --status | --shutdown [--socket <path>]
+//
+// The daemon creates the Vulkan device, pipelines and the built-in scene once, then serves requests on a Unix
+// domain socket (default <temp dir>/vrayt-renderd.sock). Each request and reply is one JSON object per line:
+//
+//     {"op": "render", "tag": any, "scene": "default" | "<scene.json>" | {...}, "output": "thumb.png",
+//      "camera": {"position": [x, y, z], "target": [x, y, z], "fov": 20, "aperture": 0.05, "focus": d},
+//      "width": 640, "height": 360, "spp": 64, "sppPerFrame": 8, "depth": 12}
+//     {"op": "status"}
+//     {"op": "shutdown"}
+//
+// Everything but output is optional. Render requests are answered at once with {"job": id, "state": "queued"}
+// and later with "done" (plus queue, trace and total seconds) or "failed"; malformed requests get "rejected".
+// Scenes (see src/rt/SceneCache.h for the format) are parsed once and cached by content hash, --scenes of them
+// at a time. Shutdown finishes the queued jobs first.
+//
+// --submit sends each file as one render request, tagged with its name unless it has a tag, prints the replies
+// and exits once every job has finished; it fails if any did not succeed.
+
+#include "RenderDaemon.h"
+
+#include "../../src/net/LineReader.h"
+#include "../../src/util/Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    enum class Mode
+    {
+        Serve,
+        Submit,
+        Status,
+        Shutdown
+    };
+
+    struct Options
+    {
+        Mode mode = Mode::Serve;
+        std::string socketPath = (std::filesystem::temp_directory_path() / "vrayt-renderd.sock").string();
+        uint32_t workers = 0;
+        size_t scenes = 16;
+        bool validation = false;
+        std::vector<std::string> jobFiles;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--socket")
+            {
+                options.socketPath = next();
+            }
+            else if (arg == "--workers")
+            {
+                options.workers = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--scenes")
+            {
+                options.scenes = std::max<size_t>(1, std::stoul(next()));
+            }
+            else if (arg == "--validation")
+            {
+                options.validation = true;
+            }
+            else if (arg == "--submit")
+            {
+                options.mode = Mode::Submit;
+            }
+            else if (arg == "--status")
+            {
+                options.mode = Mode::Status;
+            }
+            else if (arg == "--shutdown")
+            {
+                options.mode = Mode::Shutdown;
+            }
+            else if (options.mode == Mode::Submit && arg.rfind("--", 0) != 0)
+            {
+                options.jobFiles.push_back(arg);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.mode == Mode::Submit && options.jobFiles.empty())
+        {
+            throw std::runtime_error("--submit needs at least one job file");
+        }
+
+        return options;
+    }
+
+    JsonValue readJobFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        std::ostringstream text;
+        text << file.rdbuf();
+
+        JsonValue job = JsonValue::parse(text.str());
+        job.set("op", "render");
+
+        if (!job.has("tag"))
+        {
+            job.set("tag", path);
+        }
+
+        return job;
+    }
+
+    // Sends the requests and prints replies until `expected` of them are final. Returns the number that failed.
+    size_t exchange(const std::string& socketPath, const std::vector<JsonValue>& requests, size_t expected)
+    {
+        net::Socket socket = net::Socket::connectLocal(socketPath);
+
+        if (!socket.valid())
+        {
+            throw std::runtime_error("No daemon listening on " + socketPath);
+        }
+
+        for (const JsonValue& request : requests)
+        {
+            const std::string line = request.dump() + "\n";
+
+            if (!socket.sendAll(line.data(), line.size()))
+            {
+                throw std::runtime_error("Lost the connection to " + socketPath);
+            }
+        }
+
+        net::LineReader reader;
+        std::string line;
+        size_t finished = 0;
+        size_t failed = 0;
+
+        while (finished < expected)
+        {
+            if (reader.next(socket, line, -1) != net::LineReader::Result::Line)
+            {
+                throw std::runtime_error("Lost the connection to " + socketPath);
+            }
+
+            std::printf("%s\n", line.c_str());
+            std::fflush(stdout);
+
+            const std::string state = JsonValue::parse(line).stringOr("state", "");
+
+            if (state == "queued")
+            {
+                continue;
+            }
+            if (state == "failed" || state == "rejected")
+            {
+                ++failed;
+            }
+
+            ++finished;
+        }
+
+        return failed;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        size_t failed = 0;
+
+        if (options.mode == Mode::Serve)
+        {
+            DaemonSettings settings;
+            settings.socketPath = options.socketPath;
+            settings.encodeWorkers = options.workers;
+            settings.sceneCapacity = options.scenes;
+            settings.validation = options.validation;
+
+            RenderDaemon daemon;
+            daemon.run(settings);
+        }
+        else if (options.mode == Mode::Submit)
+        {
+            std::vector<JsonValue> requests;
+
+            for (const std::string& path : options.jobFiles)
+            {
+                requests.push_back(readJobFile(path));
+            }
+
+            failed = exchange(options.socketPath, requests, requests.size());
+        }
+        else
+        {
+            JsonValue request = JsonValue::object();
+            request.set("op", options.mode == Mode::Status ? "status" : "shutdown");
+            failed = exchange(options.socketPath, { request }, 1);
+        }
+
+        logger::flush();
+
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "renderd: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,227 @@
+#include "ShareServer.h"
+
+#include "../../src/net/Message.h"
+#include "../../src/rt/SceneCache.h"
+#include "../../src/util/Logger.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int idleWaitMs = 20;
+    const int handshakeTimeoutMs = 10000;
+
+    void closeDescriptors(const std::vector<int>& descriptors)
+    {
+#ifndef _WIN32
+        for (int descriptor : descriptors)
+        {
+            ::close(descriptor);
+        }
+#else
+        (void)descriptors;
+#endif
+    }
+}
+
+void ShareServer::run(const ShareSettings& settings)
+{
+    mRenderer.create({ settings.width, settings.height }, settings.validation, settings.images);
+    RayTracer& tracer = mRenderer.tracer();
+    tracer.setSamplesPerPixel(settings.samplesPerFrame);
+    tracer.setMaxDepth(settings.maxDepth);
+
+    if (!settings.scene.isNull())
+    {
+        tracer.setScene(mRenderer.context(), parseScene(settings.scene));
+    }
+
+    mHeld.assign(settings.images, false);
+
+    net::Socket listener = net::Socket::listenLocal(settings.socketPath);
+    std::printf("Sharing %ux%u frames on %s\n", settings.width, settings.height, settings.socketPath.c_str());
+    std::fflush(stdout);
+
+    while (true)
+    {
+        if (!mConsumer.valid())
+        {
+            if (listener.waitReadable(idleWaitMs))
+            {
+                acceptConsumer(listener.accept());
+            }
+
+            continue;
+        }
+
+        readMessages();
+
+        // A consumer that connects to a converged accumulation still gets one frame of it.
+        const bool converged = settings.maxSamples > 0 && mFrameIndex > 0 && tracer.completedSamples() >= settings.maxSamples;
+        const int32_t image = mConsumer.valid() && (!converged || mFramePending) ? freeImage() : -1;
+
+        if (image < 0)
+        {
+            // Waiting for a release, or for the consumer to leave once converged.
+            if (mConsumer.valid())
+            {
+                mConsumer.waitReadable(idleWaitMs);
+            }
+
+            continue;
+        }
+
+        // The consumer can queue its work on the semaphore while this frame still traces.
+        mRenderer.submitFrame(mFrameIndex++, static_cast<uint32_t>(image), ++mReadyValue);
+        mHeld[image] = true;
+        mFramePending = false;
+
+        JsonValue frame = JsonValue::object();
+        frame.set("op", "frame");
+        frame.set("image", static_cast<uint32_t>(image));
+        frame.set("value", mReadyValue);
+        frame.set("samples", tracer.completedSamples());
+
+        if (!net::sendMessage(mConsumer, frame))
+        {
+            logger::info("Consumer disconnected");
+            mConsumer.close();
+        }
+
+        mRenderer.waitFrame();
+    }
+}
+
+void ShareServer::acceptConsumer(net::Socket socket)
+{
+    if (!socket.valid())
+    {
+        return;
+    }
+
+    mConsumer = std::move(socket);
+    mReader = net::LineReader();
+
+    // Whatever a previous consumer held is free; its process no longer reads it.
+    mHeld.assign(mHeld.size(), false);
+
+    VulkanContext& context = mRenderer.context();
+    OffscreenTarget& target = mRenderer.target();
+    const VkExtent2D extent = mRenderer.extent();
+
+    JsonValue hello = JsonValue::object();
+    hello.set("op", "hello");
+    hello.set("width", extent.width);
+    hello.set("height", extent.height);
+    hello.set("format", "rgba8");
+    hello.set("usage", static_cast<uint32_t>(OffscreenTarget::exportedUsage));
+    hello.set("device", context.deviceUuid());
+
+    JsonValue sizes = JsonValue::array();
+    JsonValue memoryTypes = JsonValue::array();
+    std::vector<int> descriptors;
+
+    // Fresh descriptors per consumer; the kernel hands it duplicates, so these are closed once sent.
+    for (uint32_t i = 0; i < static_cast<uint32_t>(mHeld.size()); ++i)
+    {
+        const ExportedImage exported = target.exportImage(context, i);
+        sizes.push(static_cast<uint64_t>(exported.size));
+        memoryTypes.push(exported.memoryTypeIndex);
+        descriptors.push_back(exported.fd);
+    }
+
+    descriptors.push_back(target.exportReadySemaphore(context));
+    hello.set("sizes", sizes);
+    hello.set("memoryTypes", memoryTypes);
+
+    const bool sent = net::sendMessageWithDescriptors(mConsumer, hello, descriptors);
+    closeDescriptors(descriptors);
+
+    JsonValue reply;
+    std::vector<uint8_t> payload;
+    bool ready = false;
+
+    try
+    {
+        ready = sent && net::receiveMessage(mConsumer, mReader, reply, payload, handshakeTimeoutMs) == net::LineReader::Result::Line &&
+            reply.stringOr("op", "") == "ready";
+    }
+    catch (const std::exception&)
+    {
+        ready = false;
+    }
+
+    if (!ready)
+    {
+        logger::warn("Consumer failed to import the frames: %s", reply.stringOr("message", "no reply"));
+        mConsumer.close();
+
+        return;
+    }
+
+    logger::info("Consumer connected");
+    mFramePending = true;
+}
+
+void ShareServer::readMessages()
+{
+    JsonValue message;
+    std::vector<uint8_t> payload;
+
+    while (mConsumer.valid())
+    {
+        net::LineReader::Result result = net::LineReader::Result::Closed;
+
+        try
+        {
+            result = net::receiveMessage(mConsumer, mReader, message, payload, 0);
+        }
+        catch (const std::exception& error)
+        {
+            logger::warn("Dropping consumer: %s", error.what());
+        }
+
+        if (result == net::LineReader::Result::Timeout)
+        {
+            return;
+        }
+        if (result == net::LineReader::Result::Closed)
+        {
+            logger::info("Consumer disconnected");
+            mConsumer.close();
+
+            return;
+        }
+
+        const double image = message.numberOr("image", -1.0);
+
+        if (message.stringOr("op", "") == "release" && image >= 0.0 && image < static_cast<double>(mHeld.size()))
+        {
+            mHeld[static_cast<size_t>(image)] = false;
+        }
+    }
+}
+
+int32_t ShareServer::freeImage()
+{
+    const uint32_t count = static_cast<uint32_t>(mHeld.size());
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t image = (mNextImage + i) % count;
+
+        if (!mHeld[image])
+        {
+            mNextImage = (image + 1) % count;
+
+            return static_cast<int32_t>(image);
+        }
+    }
+
+    return -1;
+}
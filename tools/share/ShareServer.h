@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../src/net/LineReader.h"
+#include "../../src/net/Socket.h"
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/Json.h"
+
+// Producer/consumer messages over a Unix domain socket, one JSON object per line:
+//
+//     producer -> consumer   {"op": "hello", "width": w, "height": h, "format": "rgba8", "usage": VkImageUsageFlags,
+//                             "device": uuid, "sizes": [...], "memoryTypes": [...]}
+//                            + one opaque memory fd per image, then the ready semaphore's fd (SCM_RIGHTS)
+//     consumer -> producer   {"op": "ready"}
+//     producer -> consumer   {"op": "frame", "image": i, "value": v, "samples": s}
+//     consumer -> producer   {"op": "release", "image": i}
+//
+// "device" is VulkanContext::deviceUuid; the consumer must run on the same GPU and driver. Image i is finished once
+// the timeline semaphore reaches v, is in GENERAL and owned by VK_QUEUE_FAMILY_EXTERNAL; the consumer acquires it
+// from there and releases it back, and the producer does not touch it again until "release".
+
+struct ShareSettings
+{
+    std::string socketPath = "/tmp/vrayt-share.sock";
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t images = 3; // The consumer holds one while the producer renders into another.
+    uint32_t samplesPerFrame = 4;
+    uint32_t maxSamples = 4096; // Tracing pauses once the accumulation has this many samples; 0 never pauses.
+    uint32_t maxDepth = 12;
+    JsonValue scene; // Scene description (see src/rt/SceneCache.h), null for the built-in scene.
+    bool validation = false;
+};
+
+// Renders straight into exportable images and hands each finished frame to one local consumer, such as a
+// compositor, without a readback: the consumer imports the images and the ready semaphore once and then only
+// trades image indices with the producer. Tracing runs while a consumer is connected and has released an image;
+// further consumers wait in the listen backlog until it leaves.
+class ShareServer
+{
+public:
+    ShareServer() = default;
+    ~ShareServer() = default;
+
+    // Runs until the process is interrupted. Throws on device errors, when the device cannot export memory, or
+    // when the socket cannot be bound.
+    void run(const ShareSettings& settings);
+
+private:
+    void acceptConsumer(net::Socket socket);
+
+    // Applies releases; drops the consumer when it went away.
+    void readMessages();
+
+    // An image the consumer does not hold, or -1.
+    int32_t freeImage();
+
+    HeadlessRenderer mRenderer;
+    net::Socket mConsumer;
+    net::LineReader mReader;
+    std::vector<bool> mHeld; // Sent to the consumer and not released yet.
+    uint32_t mNextImage = 0;
+    uint32_t mFrameIndex = 0;
+    uint64_t mReadyValue = 0;
+    bool mFramePending = false; // The consumer has not been sent the current accumulation.
+};
@@ -0,0 +1,504 @@
+#include "ShareViewer.h"
+
+#include "../../src/net/Message.h"
+#include "../../src/util/Check.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int handshakeTimeoutMs = 10000;
+    const int idleWaitMs = 5;
+
+    void closeDescriptors(std::vector<int>& descriptors)
+    {
+#ifndef _WIN32
+        for (int descriptor : descriptors)
+        {
+            if (descriptor >= 0)
+            {
+                ::close(descriptor);
+            }
+        }
+#endif
+        descriptors.clear();
+    }
+
+    // The frame scaled to fit the window, centred.
+    void fitRect(const VkExtent2D& frame, const VkExtent2D& window, VkOffset3D& min, VkOffset3D& max)
+    {
+        const double scale = std::min(static_cast<double>(window.width) / frame.width, static_cast<double>(window.height) / frame.height);
+        const int32_t width = std::max(1, static_cast<int32_t>(frame.width * scale));
+        const int32_t height = std::max(1, static_cast<int32_t>(frame.height * scale));
+        min = { (static_cast<int32_t>(window.width) - width) / 2, (static_cast<int32_t>(window.height) - height) / 2, 0 };
+        max = { min.x + width, min.y + height, 1 };
+    }
+}
+
+void ShareViewer::run(const ShareViewerSettings& settings)
+{
+    mSocket = net::Socket::connectLocal(settings.socketPath);
+
+    if (!mSocket.valid())
+    {
+        throw std::runtime_error("Failed to connect to " + settings.socketPath);
+    }
+
+    JsonValue hello;
+    std::vector<int> descriptors;
+
+    if (net::receiveMessageWithDescriptors(mSocket, hello, descriptors, handshakeTimeoutMs) != net::LineReader::Result::Line ||
+        hello.stringOr("op", "") != "hello")
+    {
+        closeDescriptors(descriptors);
+
+        throw std::runtime_error("No hello from " + settings.socketPath);
+    }
+
+    if (!mWindow.create(1280, 720, "Share " + settings.socketPath))
+    {
+        closeDescriptors(descriptors);
+
+        throw std::runtime_error("Failed to create the window");
+    }
+
+    mContext.createInstance(settings.validation);
+    mContext.setupDebugMessenger(settings.validation);
+    mContext.createSurface(mWindow);
+    mContext.pickPhysicalDevice();
+    mContext.createDevice();
+    mContext.createAllocator();
+    mContext.createCommandPoolsAndBuffers(1);
+    mContext.createSyncObjects(1);
+
+    try
+    {
+        importFrames(hello, descriptors);
+    }
+    catch (const std::exception& error)
+    {
+        closeDescriptors(descriptors);
+
+        JsonValue failed = JsonValue::object();
+        failed.set("op", "error");
+        failed.set("message", error.what());
+        net::sendMessage(mSocket, failed);
+
+        throw;
+    }
+
+    recreateSwapchain();
+
+    // Frames are display-encoded, so they are blitted into a UNORM swapchain unchanged.
+    const VkFormat format = mSwapchain.bundle().imageFormat;
+    VkFormatProperties formatProperties{};
+    vkGetPhysicalDeviceFormatProperties(mContext.physical(), format, &formatProperties);
+
+    if (!(mSwapchain.bundle().imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+        (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_B8G8R8A8_UNORM) ||
+        !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT))
+    {
+        throw std::runtime_error("The swapchain does not support blits of RGBA8 frames into its images");
+    }
+
+    JsonValue ready = JsonValue::object();
+    ready.set("op", "ready");
+    net::sendMessage(mSocket, ready);
+
+    Timer titleTimer;
+    uint64_t titleFrames = 0;
+    bool connected = true;
+
+    while (!mWindow.shouldClose())
+    {
+        mWindow.poll();
+
+        if (!readMessages())
+        {
+            connected = false;
+            break;
+        }
+
+        if (mWindow.framebufferResized())
+        {
+            mWindow.clearFramebufferResized();
+            recreateSwapchain();
+        }
+
+        if (titleTimer.elapsedSeconds() >= 1.0)
+        {
+            char title[160];
+            std::snprintf(title, sizeof(title), "Share %s  %u spp  %.1f fps", settings.socketPath.c_str(), mLatestSamples,
+                static_cast<double>(mFramesShown - titleFrames) / titleTimer.elapsedSeconds());
+            glfwSetWindowTitle(mWindow.handle(), title);
+            titleFrames = mFramesShown;
+            titleTimer.reset();
+        }
+
+        if (!mRedraw || !present())
+        {
+            mSocket.waitReadable(idleWaitMs);
+        }
+    }
+
+    mContext.waitIdle();
+    mSocket.close();
+    destroyFrames();
+
+    for (VkSemaphore semaphore : mRenderFinished)
+    {
+        vkDestroySemaphore(mContext.device(), semaphore, nullptr);
+    }
+
+    mSwapchain.destroy(mContext);
+    mContext.destroy();
+    mWindow.destroy();
+
+    if (!connected)
+    {
+        logger::info("The producer closed the share");
+    }
+}
+
+void ShareViewer::importFrames(const JsonValue& hello, std::vector<int>& descriptors)
+{
+    if (!mContext.externalFdEnabled())
+    {
+        throw std::runtime_error("This device cannot import memory from file descriptors");
+    }
+    if (hello.stringOr("device", "") != mContext.deviceUuid())
+    {
+        throw std::runtime_error("The producer renders on another device or driver; set VRAYT_DEVICE to match it");
+    }
+    if (hello.stringOr("format", "") != "rgba8")
+    {
+        throw std::runtime_error("Unsupported frame format " + hello.stringOr("format", ""));
+    }
+
+    const JsonValue& sizes = hello["sizes"];
+    const JsonValue& memoryTypes = hello["memoryTypes"];
+    const size_t imageCount = sizes.items().size();
+
+    if (imageCount == 0 || memoryTypes.items().size() != imageCount || descriptors.size() != imageCount + 1)
+    {
+        throw std::runtime_error("The producer sent " + std::to_string(descriptors.size()) + " descriptors for " +
+            std::to_string(imageCount) + " images");
+    }
+
+    mFrameExtent = { static_cast<uint32_t>(hello.numberOr("width", 0.0)), static_cast<uint32_t>(hello.numberOr("height", 0.0)) };
+
+    // Same parameters as the producer's images; external memory is bound to an image created to match it.
+    VkExternalMemoryImageCreateInfo externalInfo{ VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO };
+    externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+    VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, &externalInfo };
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { mFrameExtent.width, mFrameExtent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = static_cast<VkImageUsageFlags>(hello.numberOr("usage", 0.0));
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    for (size_t i = 0; i < imageCount; ++i)
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateImage(mContext.device(), &imageInfo, nullptr, &image));
+        mImages.push_back(image);
+
+        const uint32_t memoryType = static_cast<uint32_t>(memoryTypes.items()[i].asNumber());
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(mContext.device(), image, &requirements);
+
+        if (!(requirements.memoryTypeBits & (1u << memoryType)))
+        {
+            throw std::runtime_error("The producer's memory type cannot back the imported images");
+        }
+
+        // The producer allocated each image on its own, so the import is dedicated too.
+        VkMemoryDedicatedAllocateInfo dedicatedInfo{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+        dedicatedInfo.image = image;
+
+        VkImportMemoryFdInfoKHR importInfo{ VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR, &dedicatedInfo };
+        importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+        importInfo.fd = descriptors[i];
+
+        VkMemoryAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importInfo };
+        allocateInfo.allocationSize = static_cast<VkDeviceSize>(sizes.items()[i].asNumber());
+        allocateInfo.memoryTypeIndex = memoryType;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VK_CHECK(vkAllocateMemory(mContext.device(), &allocateInfo, nullptr, &memory));
+        descriptors[i] = -1; // Owned by the driver now.
+        mMemory.push_back(memory);
+        VK_CHECK(vkBindImageMemory(mContext.device(), image, memory, 0));
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+
+    VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &timelineInfo };
+    VK_CHECK(vkCreateSemaphore(mContext.device(), &semaphoreInfo, nullptr, &mReady));
+    mContext.importSemaphoreFd(mReady, descriptors[imageCount]);
+    descriptors.clear();
+
+    logger::info("Imported %zu shared %ux%u frames", imageCount, mFrameExtent.width, mFrameExtent.height);
+}
+
+void ShareViewer::destroyFrames()
+{
+    for (VkImage image : mImages)
+    {
+        vkDestroyImage(mContext.device(), image, nullptr);
+    }
+    for (VkDeviceMemory memory : mMemory)
+    {
+        vkFreeMemory(mContext.device(), memory, nullptr);
+    }
+
+    if (mReady != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(mContext.device(), mReady, nullptr);
+    }
+
+    mImages.clear();
+    mMemory.clear();
+    mReady = VK_NULL_HANDLE;
+}
+
+bool ShareViewer::readMessages()
+{
+    JsonValue message;
+    std::vector<uint8_t> payload;
+
+    while (true)
+    {
+        net::LineReader::Result result = net::LineReader::Result::Closed;
+
+        try
+        {
+            result = net::receiveMessage(mSocket, mReader, message, payload, 0);
+        }
+        catch (const std::exception& error)
+        {
+            logger::error("Share: %s", error.what());
+        }
+
+        if (result == net::LineReader::Result::Timeout)
+        {
+            return true;
+        }
+        if (result == net::LineReader::Result::Closed)
+        {
+            return false;
+        }
+
+        const double image = message.numberOr("image", -1.0);
+
+        if (message.stringOr("op", "") != "frame" || !(image >= 0.0 && image < static_cast<double>(mImages.size())))
+        {
+            continue;
+        }
+
+        // A frame replaced before it was ever shown goes straight back.
+        if (mLatestImage >= 0 && mLatestImage != mShownImage)
+        {
+            release(mLatestImage);
+        }
+
+        mLatestImage = static_cast<int32_t>(image);
+        mLatestValue = static_cast<uint64_t>(message.numberOr("value", 0.0));
+        mLatestSamples = static_cast<uint32_t>(message.numberOr("samples", 0.0));
+        mRedraw = true;
+    }
+}
+
+void ShareViewer::release(int32_t image)
+{
+    JsonValue message = JsonValue::object();
+    message.set("op", "release");
+    message.set("image", image);
+    net::sendMessage(mSocket, message);
+}
+
+bool ShareViewer::present()
+{
+    const FrameSync& frameSync = mContext.frames()[0];
+    VK_CHECK(vkWaitForFences(mContext.device(), 1, &frameSync.inFlight, VK_TRUE, UINT64_MAX));
+
+    // The last submission is done with the frame it showed.
+    if (mShownImage >= 0 && mShownImage != mLatestImage)
+    {
+        release(mShownImage);
+        mShownImage = -1;
+    }
+
+    uint32_t imageIndex = 0;
+    const VkResult acquireResult = mSwapchain.acquireNextImage(mContext, frameSync.imageAvailable, &imageIndex);
+
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        recreateSwapchain();
+
+        return false;
+    }
+
+    VK_CHECK(acquireResult);
+    VK_CHECK(vkResetFences(mContext.device(), 1, &frameSync.inFlight));
+    VK_CHECK(vkResetCommandBuffer(frameSync.cmdBuf, 0));
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(frameSync.cmdBuf, &beginInfo));
+
+    const VkImage target = mSwapchain.bundle().images[imageIndex];
+    const VkImage frame = mImages[mLatestImage];
+    const uint32_t family = mContext.graphicsFamilyIndex();
+
+    VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = target;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    // Ownership comes over from the producer; the image keeps the producer's contents in GENERAL.
+    VkImageMemoryBarrier acquire = toTransfer;
+    acquire.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    acquire.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    acquire.srcAccessMask = 0;
+    acquire.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    acquire.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+    acquire.dstQueueFamilyIndex = family;
+    acquire.image = frame;
+
+    const VkImageMemoryBarrier before[2] = { toTransfer, acquire };
+    vkCmdPipelineBarrier(frameSync.cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, before);
+
+    // Black bars where the window's aspect differs from the frame's.
+    const VkClearColorValue black{};
+    vkCmdClearColorImage(frameSync.cmdBuf, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &toTransfer.subresourceRange);
+
+    VkImageMemoryBarrier afterClear = toTransfer;
+    afterClear.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    afterClear.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(frameSync.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &afterClear);
+
+    // The blit also swaps channels for a BGRA swapchain.
+    VkImageBlit blit{};
+    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    blit.srcOffsets[1] = { static_cast<int32_t>(mFrameExtent.width), static_cast<int32_t>(mFrameExtent.height), 1 };
+    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    fitRect(mFrameExtent, mSwapchain.bundle().extent, blit.dstOffsets[0], blit.dstOffsets[1]);
+    vkCmdBlitImage(frameSync.cmdBuf, frame, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+        VK_FILTER_LINEAR);
+
+    VkImageMemoryBarrier toPresent = toTransfer;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toPresent.dstAccessMask = 0;
+
+    // And back to the producer, in the layout it left the image in.
+    VkImageMemoryBarrier releaseFrame = acquire;
+    releaseFrame.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    releaseFrame.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    releaseFrame.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    releaseFrame.dstAccessMask = 0;
+    releaseFrame.srcQueueFamilyIndex = family;
+    releaseFrame.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+
+    const VkImageMemoryBarrier after[2] = { toPresent, releaseFrame };
+    vkCmdPipelineBarrier(frameSync.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 2, after);
+    VK_CHECK(vkEndCommandBuffer(frameSync.cmdBuf));
+
+    // The swapchain image and the producer's frame are both waited for on the GPU.
+    const VkSemaphore waitSemaphores[2] = { frameSync.imageAvailable, mReady };
+    const VkPipelineStageFlags waitStages[2] = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+    const uint64_t waitValues[2] = { 0, mLatestValue };
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineInfo.waitSemaphoreValueCount = 2;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO, &timelineInfo };
+    submitInfo.waitSemaphoreCount = 2;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameSync.cmdBuf;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &mRenderFinished[imageIndex];
+    VK_CHECK(vkQueueSubmit(mContext.graphicsQueue(), 1, &submitInfo, frameSync.inFlight));
+
+    mShownImage = mLatestImage;
+    mRedraw = false;
+    ++mFramesShown;
+
+    const VkResult presentResult = mSwapchain.present(mContext, mRenderFinished[imageIndex], imageIndex);
+
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+    {
+        recreateSwapchain();
+    }
+    else
+    {
+        VK_CHECK(presentResult);
+    }
+
+    return true;
+}
+
+void ShareViewer::recreateSwapchain()
+{
+    int width = 0;
+    int height = 0;
+    mWindow.getFramebufferSize(width, height);
+
+    // Minimized: nothing to present until the window is back.
+    while ((width == 0 || height == 0) && !mWindow.shouldClose())
+    {
+        mWindow.waitEvents();
+        mWindow.getFramebufferSize(width, height);
+    }
+
+    mContext.waitIdle();
+
+    if (mSwapchain.bundle().swapchain == VK_NULL_HANDLE)
+    {
+        mSwapchain.create(mContext, mWindow);
+    }
+    else
+    {
+        mSwapchain.recreate(mContext, mWindow);
+    }
+
+    for (VkSemaphore semaphore : mRenderFinished)
+    {
+        vkDestroySemaphore(mContext.device(), semaphore, nullptr);
+    }
+
+    mRenderFinished.assign(mSwapchain.bundle().images.size(), VK_NULL_HANDLE);
+    VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+
+    for (VkSemaphore& semaphore : mRenderFinished)
+    {
+        VK_CHECK(vkCreateSemaphore(mContext.device(), &semaphoreInfo, nullptr, &semaphore));
+    }
+
+    // Show the current frame again on the new images.
+    mRedraw = mLatestImage >= 0;
+}
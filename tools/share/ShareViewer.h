@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../src/net/LineReader.h"
+#include "../../src/net/Socket.h"
+#include "../../src/platform/Window.h"
+#include "../../src/util/Json.h"
+#include "../../src/vk/Swapchain.h"
+#include "../../src/vk/VulkanContext.h"
+
+struct ShareViewerSettings
+{
+    std::string socketPath = "/tmp/vrayt-share.sock";
+    bool validation = false;
+};
+
+// Example consumer for a share producer, standing in for a compositor: imports the producer's images and ready
+// semaphore, then blits the latest frame into its own swapchain. No pixel passes through the CPU; the GPU waits
+// for the producer's semaphore value and reads the producer's memory directly.
+class ShareViewer
+{
+public:
+    ShareViewer() = default;
+    ~ShareViewer() = default;
+
+    // Returns when the window is closed or the producer goes away. Throws when it cannot connect, when the producer
+    // runs on another device, or on device errors.
+    void run(const ShareViewerSettings& settings);
+
+private:
+    // Creates images over the descriptors in hello and takes ownership of the descriptors.
+    void importFrames(const JsonValue& hello, std::vector<int>& descriptors);
+    void destroyFrames();
+
+    // Reads frame messages without waiting; false once the producer is gone.
+    bool readMessages();
+    void release(int32_t image);
+
+    // Blits the latest frame and presents it; false when the swapchain had to be recreated first.
+    bool present();
+    void recreateSwapchain();
+
+    Window mWindow;
+    VulkanContext mContext;
+    Swapchain mSwapchain;
+    std::vector<VkSemaphore> mRenderFinished;
+
+    net::Socket mSocket;
+    net::LineReader mReader;
+
+    std::vector<VkImage> mImages;
+    std::vector<VkDeviceMemory> mMemory;
+    VkSemaphore mReady = VK_NULL_HANDLE; // Imported timeline semaphore.
+    VkExtent2D mFrameExtent{};
+
+    int32_t mLatestImage = -1;
+    uint64_t mLatestValue = 0;
+    uint32_t mLatestSamples = 0;
+    int32_t mShownImage = -1; // Read by the last submission; released once a newer frame replaced it.
+    bool mRedraw = false;
+    uint64_t mFramesShown = 0;
+};
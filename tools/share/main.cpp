@@ -0,0 +1,178 @@
+// Rendered frames shared with another local process without a readback, for compositors and capture tools on the
+// same GPU.
+//
+// Usage: share [--socket PATH] [--width W] [--height H] [--images N] [--spp-per-frame N] [--max-spp N] [--depth N]
+//              [--scene <scene.json>] [--validation]
+//        share --view [--socket PATH] [--validation]
+//
+// The producer renders into --images exportable images (VK_KHR_external_memory_fd) and listens on the Unix socket
+// (default /tmp/vrayt-share.sock). A consumer receives the images' memory and a timeline semaphore as file
+// descriptors once, then only image indices and semaphore values per frame (tools/share/ShareServer.h); it waits
+// for the value on its own queue and reads the image in place. Tracing pauses once the accumulation reaches
+// --max-spp samples (0 never pauses).
+//
+// --view opens the example consumer, which blits each shared frame into a window. Both processes must pick the same
+// device; set VRAYT_DEVICE when the machine has several. POSIX only.
+
+#include "ShareServer.h"
+#include "ShareViewer.h"
+
+#include "../../src/util/Logger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    struct Options
+    {
+        bool view = false;
+        ShareSettings server;
+        ShareViewerSettings viewer;
+        std::string scenePath;
+    };
+
+    std::string readTextFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        std::ostringstream text;
+        text << file.rdbuf();
+
+        return text.str();
+    }
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        ShareSettings& server = options.server;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--view")
+            {
+                options.view = true;
+            }
+            else if (arg == "--socket")
+            {
+                server.socketPath = next();
+                options.viewer.socketPath = server.socketPath;
+            }
+            else if (arg == "--validation")
+            {
+                server.validation = true;
+                options.viewer.validation = true;
+            }
+            else if (arg == "--width")
+            {
+                server.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                server.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--images")
+            {
+                server.images = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp-per-frame")
+            {
+                server.samplesPerFrame = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--max-spp")
+            {
+                server.maxSamples = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                server.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--scene")
+            {
+                options.scenePath = next();
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.view)
+        {
+            return options;
+        }
+
+        if (server.width == 0 || server.height == 0 || server.samplesPerFrame == 0 || server.maxDepth == 0)
+        {
+            throw std::runtime_error("--width, --height, --spp-per-frame and --depth must be positive");
+        }
+        if (server.images < 2)
+        {
+            throw std::runtime_error("--images must be at least 2");
+        }
+
+        return options;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+#ifdef _WIN32
+        (void)argc;
+        (void)argv;
+
+        throw std::runtime_error("Sharing needs POSIX file descriptors");
+#else
+        Options options = parseOptions(argc, argv);
+
+        if (options.view)
+        {
+            ShareViewer viewer;
+            viewer.run(options.viewer);
+        }
+        else
+        {
+            if (!options.scenePath.empty())
+            {
+                options.server.scene = JsonValue::parse(readTextFile(options.scenePath));
+            }
+
+            ShareServer server;
+            server.run(options.server);
+        }
+
+        logger::flush();
+
+        return EXIT_SUCCESS;
+#endif
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "share: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,403 @@
+#include "SpirvStats.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    const uint32_t spirvMagic = 0x07230203;
+
+    // Opcodes from the SPIR-V specification that the analysis looks at.
+    enum Op : uint32_t
+    {
+        OpExtInst = 12,
+        OpTypeBool = 20,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpFunction = 54,
+        OpFunctionParameter = 55,
+        OpFunctionEnd = 56,
+        OpFunctionCall = 57,
+        OpVariable = 59,
+        OpImageTexelPointer = 60,
+        OpLoad = 61,
+        OpStore = 62,
+        OpCopyMemory = 63,
+        OpCopyMemorySized = 64,
+        OpAccessChain = 65,
+        OpPtrAccessChain = 67,
+        OpVectorExtractDynamic = 77,
+        OpTranspose = 84,
+        OpSampledImage = 86,
+        OpImageQuerySamples = 107,
+        OpConvertFToU = 109,
+        OpBitcast = 124,
+        OpSNegate = 126,
+        OpBitCount = 205,
+        OpControlBarrier = 224,
+        OpMemoryBarrier = 225,
+        OpAtomicLoad = 227,
+        OpAtomicStore = 228,
+        OpAtomicXor = 242,
+        OpPhi = 245,
+        OpLoopMerge = 246,
+        OpSelectionMerge = 247,
+        OpLabel = 248,
+        OpBranch = 249,
+        OpBranchConditional = 250,
+        OpSwitch = 251,
+        OpKill = 252,
+        OpReturn = 253,
+        OpReturnValue = 254,
+        OpUnreachable = 255,
+        OpLifetimeStart = 256,
+        OpLifetimeStop = 257,
+        OpNoLine = 317,
+        OpGroupNonUniformElect = 333,
+        OpGroupNonUniformQuadSwap = 366,
+        OpTerminateInvocation = 4416,
+        OpLine = 8,
+    };
+
+    bool hasResult(uint32_t opcode)
+    {
+        switch (opcode)
+        {
+        case OpStore:
+        case OpCopyMemory:
+        case OpCopyMemorySized:
+        case OpAtomicStore:
+        case OpControlBarrier:
+        case OpMemoryBarrier:
+        case OpLoopMerge:
+        case OpSelectionMerge:
+        case OpBranch:
+        case OpBranchConditional:
+        case OpSwitch:
+        case OpKill:
+        case OpReturn:
+        case OpReturnValue:
+        case OpUnreachable:
+        case OpTerminateInvocation:
+        case OpLifetimeStart:
+        case OpLifetimeStop:
+        case OpLine:
+        case OpNoLine:
+        case OpFunctionEnd:
+        case 99: // OpImageWrite.
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    struct Use
+    {
+        uint32_t id;
+        size_t position;
+    };
+
+    struct Loop
+    {
+        size_t headerPosition;
+        uint32_t mergeLabel;
+        size_t mergePosition;
+    };
+
+    // Per-function liveness state, reset at every OpFunction.
+    struct FunctionScan
+    {
+        std::unordered_map<uint32_t, size_t> definitions; // id -> position.
+        std::unordered_map<uint32_t, size_t> weights; // id -> 32-bit components.
+        std::unordered_map<uint32_t, size_t> labels; // label id -> position.
+        std::vector<Use> uses;
+        std::vector<Loop> loops;
+        std::vector<uint32_t> openMerges;
+        size_t currentBlock = 0;
+        size_t position = 0;
+    };
+
+    void finishFunction(FunctionScan& scan, SpirvStats& stats)
+    {
+        for (auto& loop : scan.loops)
+        {
+            auto label = scan.labels.find(loop.mergeLabel);
+            loop.mergePosition = label != scan.labels.end() ? label->second : scan.position;
+        }
+
+        std::unordered_map<uint32_t, size_t> lastUse;
+
+        for (const auto& use : scan.uses)
+        {
+            auto definition = scan.definitions.find(use.id);
+
+            if (definition == scan.definitions.end())
+            {
+                continue;
+            }
+
+            size_t end = use.position;
+
+            for (const auto& loop : scan.loops)
+            {
+                const bool usedInLoop = use.position >= loop.headerPosition && use.position < loop.mergePosition;
+
+                // Values flowing into a loop, and back-edge values feeding header phis, stay live until the loop exits.
+                if (usedInLoop && (definition->second < loop.headerPosition || use.position < definition->second))
+                {
+                    end = std::max(end, loop.mergePosition);
+                }
+            }
+
+            size_t& current = lastUse[use.id];
+            current = std::max(current, end);
+        }
+
+        // Sweep (position, delta) events to find the peak live set.
+        std::vector<std::pair<size_t, long long>> valueEvents;
+        std::vector<std::pair<size_t, long long>> scalarEvents;
+
+        for (const auto& [id, position] : scan.definitions)
+        {
+            size_t weight = scan.weights[id];
+
+            if (weight == 0)
+            {
+                continue;
+            }
+
+            auto use = lastUse.find(id);
+            size_t end = use != lastUse.end() ? std::max(use->second, position) : position;
+
+            valueEvents.push_back({ position, 1 });
+            valueEvents.push_back({ end + 1, -1 });
+            scalarEvents.push_back({ position, static_cast<long long>(weight) });
+            scalarEvents.push_back({ end + 1, -static_cast<long long>(weight) });
+        }
+
+        auto peak = [](std::vector<std::pair<size_t, long long>>& events)
+        {
+            // Ends sort before starts at the same position.
+            std::sort(events.begin(), events.end());
+            long long live = 0;
+            long long best = 0;
+
+            for (const auto& event : events)
+            {
+                live += event.second;
+                best = std::max(best, live);
+            }
+
+            return static_cast<size_t>(best);
+        };
+
+        stats.peakLiveValues = std::max(stats.peakLiveValues, peak(valueEvents));
+        stats.peakLiveScalars = std::max(stats.peakLiveScalars, peak(scalarEvents));
+        scan = FunctionScan{};
+    }
+
+    void classify(uint32_t opcode, SpirvStats& stats)
+    {
+        if (opcode >= OpSNegate && opcode <= OpBitCount)
+        {
+            ++stats.arithmetic;
+        }
+        else if (opcode >= OpConvertFToU && opcode <= OpBitcast)
+        {
+            ++stats.conversions;
+        }
+        else if (opcode >= OpVectorExtractDynamic && opcode <= OpTranspose)
+        {
+            ++stats.composites;
+        }
+        else if (opcode == OpLoad || opcode == OpStore || opcode == OpCopyMemory || opcode == OpCopyMemorySized ||
+            (opcode >= OpAccessChain && opcode <= OpPtrAccessChain))
+        {
+            ++stats.memory;
+        }
+        else if ((opcode >= OpSampledImage && opcode <= OpImageQuerySamples) || opcode == OpImageTexelPointer)
+        {
+            ++stats.imageOps;
+        }
+        else if (opcode >= OpAtomicLoad && opcode <= OpAtomicXor)
+        {
+            ++stats.atomics;
+        }
+        else if (opcode == OpControlBarrier || opcode == OpMemoryBarrier)
+        {
+            ++stats.barriers;
+        }
+        else if (opcode == OpExtInst)
+        {
+            ++stats.extInst;
+        }
+        else if (opcode >= OpGroupNonUniformElect && opcode <= OpGroupNonUniformQuadSwap)
+        {
+            ++stats.subgroup;
+        }
+        else if (opcode == OpFunctionCall)
+        {
+            ++stats.calls;
+        }
+        else if (opcode == OpPhi)
+        {
+            ++stats.phis;
+        }
+    }
+}
+
+SpirvStats analyzeSpirv(const std::vector<uint32_t>& words)
+{
+    if (words.size() < 5 || words[0] != spirvMagic)
+    {
+        throw std::runtime_error("Not a SPIR-V module (bad magic or header).");
+    }
+
+    SpirvStats stats;
+    stats.version = words[1];
+    stats.idBound = words[3];
+
+    std::unordered_map<uint32_t, size_t> typeWeights;
+    FunctionScan scan;
+    bool inFunction = false;
+    size_t offset = 5;
+
+    while (offset < words.size())
+    {
+        const uint32_t wordCount = words[offset] >> 16;
+        const uint32_t opcode = words[offset] & 0xFFFFu;
+
+        if (wordCount == 0 || offset + wordCount > words.size())
+        {
+            throw std::runtime_error("Truncated SPIR-V instruction stream.");
+        }
+
+        const uint32_t* operands = &words[offset + 1];
+        const uint32_t operandCount = wordCount - 1;
+        ++stats.totalInstructions;
+
+        // Type sizes for the register pressure weights.
+        switch (opcode)
+        {
+        case OpTypeBool:
+        case OpTypeInt:
+        case OpTypeFloat:
+            typeWeights[operands[0]] = (opcode != OpTypeBool && operands[1] == 64) ? 2 : 1;
+            break;
+        case OpTypeVector:
+        case OpTypeMatrix:
+            typeWeights[operands[0]] = typeWeights[operands[1]] * operands[2];
+            break;
+        case OpTypeStruct:
+        {
+            size_t total = 0;
+
+            for (uint32_t i = 1; i < operandCount; ++i)
+            {
+                total += typeWeights[operands[i]];
+            }
+
+            typeWeights[operands[0]] = total;
+            break;
+        }
+        case OpTypePointer:
+            typeWeights[operands[0]] = 0;
+            break;
+        default:
+            break;
+        }
+
+        if (opcode == OpFunction)
+        {
+            inFunction = true;
+            ++stats.functions;
+        }
+
+        if (inFunction)
+        {
+            ++stats.functionInstructions;
+            classify(opcode, stats);
+
+            size_t firstOperand = 0;
+
+            if (opcode == OpLabel)
+            {
+                ++stats.blocks;
+                scan.currentBlock = scan.position;
+                scan.labels[operands[0]] = scan.position;
+
+                if (!scan.openMerges.empty() && scan.openMerges.back() == operands[0])
+                {
+                    scan.openMerges.pop_back();
+                }
+
+                firstOperand = operandCount;
+            }
+            else if (hasResult(opcode) && operandCount >= 2)
+            {
+                scan.definitions[operands[1]] = scan.position;
+                scan.weights[operands[1]] = (opcode == OpVariable || opcode == OpFunction) ? 0 : typeWeights[operands[0]];
+                firstOperand = 2;
+            }
+
+            switch (opcode)
+            {
+            case OpLoopMerge:
+                ++stats.loops;
+                scan.loops.push_back({ scan.currentBlock, operands[0], 0 });
+                scan.openMerges.push_back(operands[0]);
+                stats.maxLoopDepth = std::max(stats.maxLoopDepth, scan.openMerges.size());
+                firstOperand = operandCount; // Labels and loop control literals.
+                break;
+            case OpSelectionMerge:
+                ++stats.selections;
+                firstOperand = operandCount;
+                break;
+            case OpBranchConditional:
+                ++stats.conditionalBranches;
+                scan.uses.push_back({ operands[0], scan.position });
+                firstOperand = operandCount;
+                break;
+            case OpSwitch:
+                ++stats.switches;
+                scan.uses.push_back({ operands[0], scan.position });
+                firstOperand = operandCount; // Remaining words are literals and labels.
+                break;
+            case OpBranch:
+                firstOperand = operandCount;
+                break;
+            default:
+                break;
+            }
+
+            for (uint32_t i = static_cast<uint32_t>(firstOperand); i < operandCount; ++i)
+            {
+                // Skip the extended instruction number, which is a literal.
+                if (opcode == OpExtInst && i == 3)
+                {
+                    continue;
+                }
+
+                scan.uses.push_back({ operands[i], scan.position });
+            }
+
+            ++scan.position;
+
+            if (opcode == OpFunctionEnd)
+            {
+                finishFunction(scan, stats);
+                inFunction = false;
+            }
+        }
+
+        offset += wordCount;
+    }
+
+    return stats;
+}
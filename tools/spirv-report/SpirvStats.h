@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Static cost summary of a SPIR-V module.
+struct SpirvStats
+{
+    uint32_t version = 0;
+    uint32_t idBound = 0;
+
+    size_t totalInstructions = 0;
+    size_t functionInstructions = 0; // Instructions inside function bodies.
+    size_t functions = 0;
+    size_t blocks = 0;
+
+    // Function body instruction mix.
+    size_t arithmetic = 0;
+    size_t conversions = 0;
+    size_t composites = 0;
+    size_t memory = 0; // Loads, stores, access chains.
+    size_t imageOps = 0;
+    size_t atomics = 0;
+    size_t barriers = 0;
+    size_t extInst = 0; // GLSL.std.450 math (transcendentals, normalize, ...).
+    size_t subgroup = 0;
+    size_t calls = 0;
+    size_t phis = 0;
+
+    // Control flow.
+    size_t conditionalBranches = 0;
+    size_t switches = 0;
+    size_t selections = 0;
+    size_t loops = 0;
+    size_t maxLoopDepth = 0;
+
+    // Register pressure estimate: peak number of simultaneously live SSA values (and their 32-bit
+    // components) over the linearized function body, with loop-carried values kept live to the loop exit.
+    size_t peakLiveValues = 0;
+    size_t peakLiveScalars = 0;
+};
+
+// Parses a SPIR-V binary and returns its static statistics. Throws on malformed input.
+SpirvStats analyzeSpirv(const std::vector<uint32_t>& words);
@@ -0,0 +1,238 @@
+// Static cost report for the compute kernels.
+//
+// Usage: spirv-report [--out <dir>] [--passes <label>:<spirv-opt flags>]... [--max-instructions N] [--max-live N] [file.spv...]
+//
+// Without input files every embedded kernel variant is analyzed. Each --passes entry runs spirv-opt
+// over every module and writes <out>/<label>/<variant>.spv, so a pass list can be A/B benchmarked by
+// pointing VRAYT_SHADER_DIR at that directory. The limits turn the report into a bloat gate: the tool
+// exits with a non-zero code when a module exceeds them.
+
+#include "SpirvStats.h"
+
+#include "../../src/rt/ShaderLibrary.h"
+#include "../../src/util/Env.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct PassList
+    {
+        std::string label;
+        std::string flags;
+    };
+
+    struct Options
+    {
+        std::string outDir = "spirv-report";
+        std::vector<PassList> passLists;
+        std::vector<std::string> inputs;
+        size_t maxInstructions = 0;
+        size_t maxLive = 0;
+    };
+
+    struct Module
+    {
+        std::string name;
+        std::vector<uint32_t> words;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--out")
+            {
+                options.outDir = next();
+            }
+            else if (arg == "--passes")
+            {
+                std::string value = next();
+                size_t colon = value.find(':');
+
+                if (colon == std::string::npos || colon == 0)
+                {
+                    throw std::runtime_error("--passes expects <label>:<spirv-opt flags>");
+                }
+
+                options.passLists.push_back({ value.substr(0, colon), value.substr(colon + 1) });
+            }
+            else if (arg == "--max-instructions")
+            {
+                options.maxInstructions = std::stoul(next());
+            }
+            else if (arg == "--max-live")
+            {
+                options.maxLive = std::stoul(next());
+            }
+            else
+            {
+                options.inputs.push_back(arg);
+            }
+        }
+
+        return options;
+    }
+
+    std::string spirvOptPath()
+    {
+        std::string sdk = readEnv("VULKAN_SDK");
+
+#if defined(_WIN32)
+        return sdk.empty() ? "spirv-opt.exe" : sdk + "\\Bin\\spirv-opt.exe";
+#else
+        return sdk.empty() ? "spirv-opt" : sdk + "/bin/spirv-opt";
+#endif
+    }
+
+    void writeSpirv(const std::filesystem::path& path, const std::vector<uint32_t>& words)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream outputStream(path, std::ios::binary | std::ios::trunc);
+
+        if (!outputStream)
+        {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+
+        outputStream.write(reinterpret_cast<const char*>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(uint32_t)));
+    }
+
+    std::vector<uint32_t> runSpirvOpt(const std::filesystem::path& input, const std::filesystem::path& output, const std::string& flags)
+    {
+        std::filesystem::create_directories(output.parent_path());
+        std::string command = "\"" + spirvOptPath() + "\" " + flags + " \"" + input.string() + "\" -o \"" + output.string() + "\"";
+
+#if defined(_WIN32)
+        // cmd.exe strips the outer quotes of the whole line.
+        command = "\"" + command + "\"";
+#endif
+
+        if (std::system(command.c_str()) != 0)
+        {
+            throw std::runtime_error("spirv-opt failed: " + command);
+        }
+
+        return shaders::readSpirvFile(output.string());
+    }
+
+    std::string delta(size_t value, size_t base)
+    {
+        if (base == 0 || value == base)
+        {
+            return "";
+        }
+
+        char text[32];
+        std::snprintf(text, sizeof(text), " (%+.1f%%)", (static_cast<double>(value) - static_cast<double>(base)) * 100.0 / static_cast<double>(base));
+
+        return text;
+    }
+
+    void printHeader()
+    {
+        std::printf("%-20s %-12s %8s %7s %6s %6s %6s %6s %6s %6s %5s %5s %6s %8s\n",
+            "module", "config", "instrs", "alu", "ext", "mem", "image", "atomic", "branch", "switch", "loops", "depth", "live", "scalars");
+    }
+
+    void printRow(const std::string& module, const std::string& config, const SpirvStats& stats, const SpirvStats& base)
+    {
+        std::printf("%-20s %-12s %8zu %7zu %6zu %6zu %6zu %6zu %6zu %6zu %5zu %5zu %6zu %8zu%s\n",
+            module.c_str(), config.c_str(),
+            stats.functionInstructions, stats.arithmetic, stats.extInst, stats.memory, stats.imageOps, stats.atomics,
+            stats.conditionalBranches, stats.switches, stats.loops, stats.maxLoopDepth,
+            stats.peakLiveValues, stats.peakLiveScalars,
+            delta(stats.functionInstructions, base.functionInstructions).c_str());
+    }
+
+    bool checkLimits(const Options& options, const std::string& module, const std::string& config, const SpirvStats& stats)
+    {
+        bool ok = true;
+
+        if (options.maxInstructions > 0 && stats.functionInstructions > options.maxInstructions)
+        {
+            std::fprintf(stderr, "%s [%s]: %zu instructions exceeds limit %zu\n", module.c_str(), config.c_str(), stats.functionInstructions, options.maxInstructions);
+            ok = false;
+        }
+        if (options.maxLive > 0 && stats.peakLiveScalars > options.maxLive)
+        {
+            std::fprintf(stderr, "%s [%s]: %zu live scalars exceeds limit %zu\n", module.c_str(), config.c_str(), stats.peakLiveScalars, options.maxLive);
+            ok = false;
+        }
+
+        return ok;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        std::vector<Module> modules;
+
+        if (options.inputs.empty())
+        {
+            for (const auto& variant : shaders::variants())
+            {
+                modules.push_back({ variant.name, shaders::loadSpirv(variant.name) });
+            }
+        }
+        else
+        {
+            for (const auto& input : options.inputs)
+            {
+                modules.push_back({ std::filesystem::path(input).stem().string(), shaders::readSpirvFile(input) });
+            }
+        }
+
+        const std::filesystem::path outDir = options.outDir;
+        bool withinLimits = true;
+        printHeader();
+
+        for (const auto& module : modules)
+        {
+            const std::filesystem::path basePath = outDir / "baseline" / (module.name + ".spv");
+            writeSpirv(basePath, module.words);
+
+            SpirvStats base = analyzeSpirv(module.words);
+            printRow(module.name, "baseline", base, base);
+            withinLimits = checkLimits(options, module.name, "baseline", base) && withinLimits;
+
+            for (const auto& passList : options.passLists)
+            {
+                const std::filesystem::path optimizedPath = outDir / passList.label / (module.name + ".spv");
+                SpirvStats optimized = analyzeSpirv(runSpirvOpt(basePath, optimizedPath, passList.flags));
+                printRow(module.name, passList.label, optimized, base);
+                withinLimits = checkLimits(options, module.name, passList.label, optimized) && withinLimits;
+            }
+        }
+
+        return withinLimits ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const std::exception& error)
+    {
+        std::fprintf(stderr, "spirv-report: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,69 @@
+#include "StreamProtocol.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    JsonValue vec3Json(const glm::vec3& value)
+    {
+        JsonValue items = JsonValue::array();
+        items.push(static_cast<double>(value.x));
+        items.push(static_cast<double>(value.y));
+        items.push(static_cast<double>(value.z));
+
+        return items;
+    }
+
+    glm::vec3 vec3FromJson(const JsonValue& value, const char* name)
+    {
+        const std::vector<JsonValue>& items = value.items();
+
+        if (items.size() != 3)
+        {
+            throw std::runtime_error(std::string(name) + " needs three numbers");
+        }
+
+        return { static_cast<float>(items[0].asNumber()), static_cast<float>(items[1].asNumber()), static_cast<float>(items[2].asNumber()) };
+    }
+}
+
+JsonValue toJson(const StreamView& view)
+{
+    JsonValue json = JsonValue::object();
+    json.set("position", vec3Json(view.position));
+    json.set("target", vec3Json(view.target));
+    json.set("fov", static_cast<double>(view.fov));
+    json.set("aperture", static_cast<double>(view.aperture));
+    json.set("spp", view.samplesPerFrame);
+    json.set("depth", view.maxDepth);
+
+    return json;
+}
+
+void applyViewJson(const JsonValue& message, StreamView& view)
+{
+    StreamView next = view;
+
+    if (message.has("position"))
+    {
+        next.position = vec3FromJson(message["position"], "position");
+    }
+    if (message.has("target"))
+    {
+        next.target = vec3FromJson(message["target"], "target");
+    }
+
+    next.fov = std::clamp(static_cast<float>(message.numberOr("fov", next.fov)), 1.0f, 179.0f);
+    next.aperture = std::max(0.0f, static_cast<float>(message.numberOr("aperture", next.aperture)));
+    next.samplesPerFrame = static_cast<uint32_t>(std::clamp(message.numberOr("spp", next.samplesPerFrame), 1.0, 1024.0));
+    next.maxDepth = static_cast<uint32_t>(std::clamp(message.numberOr("depth", next.maxDepth), 1.0, 64.0));
+
+    if (next.position == next.target)
+    {
+        throw std::runtime_error("position and target must differ");
+    }
+
+    view = next;
+}
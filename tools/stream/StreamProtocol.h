@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "../../src/net/Message.h"
+#include "../../src/util/Json.h"
+
+// Server/viewer messages (net::sendMessage), one JSON object per line:
+//
+//     server -> viewer   {"op": "hello", "view": <StreamView>}
+//     server -> viewer   {"op": "frame", "width": w, "height": h, "tile": t, "tiles": n, "samples": s, "bytes": b}
+//                        + a TileCodec delta against the previous frame sent to this viewer
+//     viewer -> server   {"op": "view", <StreamView members to change>}
+//     viewer -> server   {"op": "resize", "width": w, "height": h}
+//
+// Both sides start from an all-black frame, and a frame of another size restarts from black, so the first frame
+// after connecting or resizing carries every tile.
+
+// The camera and settings viewers drive; every viewer of one server shares them.
+struct StreamView
+{
+    glm::vec3 position{ 13.0f, 2.0f, 3.0f };
+    glm::vec3 target{ 0.0f, 1.0f, 0.0f };
+    float fov = 20.0f;
+    float aperture = 0.05f;
+    uint32_t samplesPerFrame = 4;
+    uint32_t maxDepth = 12;
+
+    bool operator==(const StreamView& other) const = default;
+};
+
+JsonValue toJson(const StreamView& view);
+
+// Applies the members present in message to view; throws on malformed values.
+void applyViewJson(const JsonValue& message, StreamView& view);
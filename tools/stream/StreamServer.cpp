@@ -0,0 +1,311 @@
+#include "StreamServer.h"
+
+#include "../../src/rt/SceneCache.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const uint32_t readbackSlots = 2;
+    const int idleWaitMs = 20;
+    const uint32_t maxStreamExtent = 8192;
+}
+
+void StreamServer::run(const StreamSettings& settings)
+{
+    mView = settings.view;
+    mRenderer.create({ settings.width, settings.height }, settings.validation);
+    RayTracer& tracer = mRenderer.tracer();
+
+    if (!settings.scene.isNull())
+    {
+        tracer.setScene(mRenderer.context(), parseScene(settings.scene));
+    }
+
+    applyView();
+    mRing.create(mRenderer.context(), readbackSlots, mRenderer.outputBytes());
+    mSlotSamples.assign(readbackSlots, 0);
+    mSender.start(1, "stream sender");
+
+    net::Socket listener = net::Socket::listenTcp(settings.listenHost, settings.port);
+    std::printf("Streaming %ux%u on %s:%u\n", settings.width, settings.height, settings.listenHost.c_str(), static_cast<unsigned>(listener.localPort()));
+    std::fflush(stdout);
+
+    const double frameInterval = 1.0 / settings.fps;
+    Timer sinceFrame;
+
+    while (true)
+    {
+        // Accept and read controls without waiting while tracing; wait for them while idle. Frame 0 restarts the
+        // accumulation, so a converged one counts again once the view changes.
+        auto converged = [&]()
+        {
+            return settings.maxSamples > 0 && mFrameIndex > 0 && tracer.completedSamples() >= settings.maxSamples;
+        };
+
+        if (listener.waitReadable(mViewers.empty() || converged() ? idleWaitMs : 0))
+        {
+            acceptViewer(listener.accept());
+        }
+
+        readControls();
+
+        if (mRequestedExtent.width > 0)
+        {
+            applyResize();
+        }
+        if (mViewChanged)
+        {
+            applyView();
+        }
+
+        mReady.clear();
+        mRing.poll(mRenderer.context(), mReady);
+
+        for (uint32_t slot : mReady)
+        {
+            const TileGrid grid{ mRenderer.extent().width, mRenderer.extent().height, settings.tile };
+            mSender.submit([this, slot, grid, samples = mSlotSamples[slot], viewers = mViewers]()
+            {
+                sendFrame(slot, grid, samples, viewers);
+            });
+        }
+
+        if (mViewers.empty() || converged())
+        {
+            // A converged accumulation is sent once more to viewers that have not seen it, such as new ones.
+            if (mFramePending && !mViewers.empty() && mRing.hasFreeSlot())
+            {
+                int32_t slot = -1;
+                mRenderer.context().submitImmediate([&](VkCommandBuffer commandBuffer)
+                {
+                    slot = recordReadback(commandBuffer);
+                });
+                mRing.submit(mRenderer.context(), static_cast<uint32_t>(slot));
+                mFramePending = false;
+            }
+
+            continue;
+        }
+
+        const bool frameDue = sinceFrame.elapsedSeconds() >= frameInterval;
+        int32_t slot = -1;
+
+        mRenderer.renderFrame(mFrameIndex++, [&](VkCommandBuffer commandBuffer)
+        {
+            slot = frameDue ? recordReadback(commandBuffer) : -1;
+        });
+
+        if (slot >= 0)
+        {
+            mRing.submit(mRenderer.context(), static_cast<uint32_t>(slot));
+            sinceFrame.reset();
+        }
+
+        mFramePending = slot < 0;
+    }
+}
+
+void StreamServer::acceptViewer(net::Socket socket)
+{
+    if (!socket.valid())
+    {
+        return;
+    }
+
+    auto viewer = std::make_shared<Viewer>();
+    viewer->socket = std::move(socket);
+    viewer->name = "viewer " + std::to_string(mViewers.size() + 1);
+
+    JsonValue hello = JsonValue::object();
+    hello.set("op", "hello");
+    hello.set("view", toJson(mView));
+
+    if (!net::sendMessage(viewer->socket, hello))
+    {
+        return;
+    }
+
+    logger::info("%s connected", viewer->name);
+    mViewers.push_back(viewer);
+    mFramePending = true;
+}
+
+void StreamServer::readControls()
+{
+    JsonValue message;
+    std::vector<uint8_t> payload;
+
+    for (const auto& viewer : mViewers)
+    {
+        while (viewer->alive)
+        {
+            net::LineReader::Result result = net::LineReader::Result::Closed;
+
+            try
+            {
+                result = net::receiveMessage(viewer->socket, viewer->reader, message, payload, 0);
+            }
+            catch (const std::exception& error)
+            {
+                logger::warn("%s: %s", viewer->name, error.what());
+                viewer->alive = false;
+
+                break;
+            }
+
+            if (result == net::LineReader::Result::Timeout)
+            {
+                break;
+            }
+            if (result == net::LineReader::Result::Closed)
+            {
+                viewer->alive = false;
+
+                break;
+            }
+
+            const std::string op = message.stringOr("op", "");
+
+            try
+            {
+                if (op == "view")
+                {
+                    applyViewJson(message, mView);
+                    mViewChanged = true;
+                }
+                else if (op == "resize")
+                {
+                    const double width = message.numberOr("width", 0.0);
+                    const double height = message.numberOr("height", 0.0);
+
+                    if (width >= 1.0 && height >= 1.0 && width <= maxStreamExtent && height <= maxStreamExtent)
+                    {
+                        mRequestedExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+                    }
+                }
+            }
+            catch (const std::exception& error)
+            {
+                logger::warn("%s: ignoring %s: %s", viewer->name, op, error.what());
+            }
+        }
+    }
+
+    for (const auto& viewer : mViewers)
+    {
+        if (!viewer->alive)
+        {
+            logger::info("%s disconnected", viewer->name);
+        }
+    }
+
+    mViewers.erase(std::remove_if(mViewers.begin(), mViewers.end(), [](const std::shared_ptr<Viewer>& viewer)
+    {
+        return !viewer->alive;
+    }), mViewers.end());
+}
+
+void StreamServer::applyView()
+{
+    RayTracer& tracer = mRenderer.tracer();
+    const glm::vec3 toTarget = mView.target - mView.position;
+    tracer.setCamera(mView.position, glm::normalize(toTarget), glm::length(toTarget));
+    tracer.setFov(mView.fov);
+    tracer.setAperture(mView.aperture);
+    tracer.setSamplesPerPixel(mView.samplesPerFrame);
+    tracer.setMaxDepth(mView.maxDepth);
+    mViewChanged = false;
+    mFrameIndex = 0;
+}
+
+void StreamServer::applyResize()
+{
+    const VkExtent2D extent = mRequestedExtent;
+    mRequestedExtent = {};
+
+    if (extent.width == mRenderer.extent().width && extent.height == mRenderer.extent().height)
+    {
+        return;
+    }
+
+    // The ring is sized for the output, so pending sends finish before it is replaced.
+    mSender.waitIdle();
+    mReady.clear();
+    mRing.poll(mRenderer.context(), mReady);
+
+    for (uint32_t slot : mReady)
+    {
+        mRing.release(slot);
+    }
+
+    mRing.destroy(mRenderer.context());
+    mRenderer.resize(extent);
+    mRing.create(mRenderer.context(), readbackSlots, mRenderer.outputBytes());
+    mFrameIndex = 0;
+    logger::info("Resized the stream to %ux%u", extent.width, extent.height);
+}
+
+int32_t StreamServer::recordReadback(VkCommandBuffer commandBuffer)
+{
+    const int32_t slot = mRing.acquire();
+
+    if (slot >= 0)
+    {
+        mRenderer.recordOutputCopy(commandBuffer, mRing.buffer(static_cast<uint32_t>(slot)));
+        mSlotSamples[slot] = mRenderer.tracer().completedSamples();
+    }
+
+    return slot;
+}
+
+void StreamServer::sendFrame(uint32_t slot, const TileGrid& grid, uint32_t samples, const std::vector<std::shared_ptr<Viewer>>& viewers)
+{
+    // RGBA8 to RGB8; the output is opaque.
+    const uint8_t* pixels = static_cast<const uint8_t*>(mRing.data(slot));
+    std::vector<uint8_t> frame(grid.frameBytes());
+
+    for (size_t i = 0, count = static_cast<size_t>(grid.width) * grid.height; i < count; ++i)
+    {
+        frame[i * 3 + 0] = pixels[i * 4 + 0];
+        frame[i * 3 + 1] = pixels[i * 4 + 1];
+        frame[i * 3 + 2] = pixels[i * 4 + 2];
+    }
+
+    mRing.release(slot);
+    std::vector<uint8_t> delta;
+
+    for (const auto& viewer : viewers)
+    {
+        if (!viewer->alive)
+        {
+            continue;
+        }
+
+        if (viewer->referenceGrid.width != grid.width || viewer->referenceGrid.height != grid.height)
+        {
+            viewer->referenceGrid = grid;
+            viewer->reference.assign(grid.frameBytes(), 0);
+        }
+
+        delta.clear();
+        const uint32_t tiles = encodeFrameDelta(grid, frame.data(), viewer->reference, delta);
+
+        JsonValue header = JsonValue::object();
+        header.set("op", "frame");
+        header.set("width", grid.width);
+        header.set("height", grid.height);
+        header.set("tile", grid.tile);
+        header.set("tiles", tiles);
+        header.set("samples", samples);
+        header.set("bytes", static_cast<uint64_t>(delta.size()));
+
+        if (!net::sendMessage(viewer->socket, header, delta.data(), delta.size()))
+        {
+            viewer->alive = false;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "StreamProtocol.h"
+#include "TileCodec.h"
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/WorkerPool.h"
+#include "../../src/vk/ReadbackRing.h"
+
+struct StreamSettings
+{
+    std::string listenHost = "0.0.0.0";
+    uint16_t port = 7879;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    double fps = 15.0; // Frames sent per second at most.
+    uint32_t tile = 64;
+    uint32_t maxSamples = 4096; // Tracing pauses once the accumulation has this many samples; 0 never pauses.
+    StreamView view;
+    JsonValue scene; // Scene description (see src/rt/SceneCache.h), null for the built-in scene.
+    bool validation = false;
+};
+
+// Progressive renders for remote viewers. The tracer accumulates while at least one viewer is connected; at the
+// frame rate, the displayed output is copied into a readback ring alongside a frame's dispatch, and a sender
+// thread diffs it per viewer and sends the changed tiles. When every ring slot is still being sent, the copy is
+// skipped rather than waited for, so a slow viewer lowers its own frame rate, never the trace's.
+class StreamServer
+{
+public:
+    StreamServer() = default;
+    ~StreamServer() = default;
+
+    // Runs until the process is interrupted. Throws on device errors and when the port cannot be bound.
+    void run(const StreamSettings& settings);
+
+private:
+    struct Viewer
+    {
+        net::Socket socket;
+        net::LineReader reader; // Main thread only.
+        std::string name;
+        TileGrid referenceGrid; // Sender thread only, like reference.
+        std::vector<uint8_t> reference;
+        std::atomic<bool> alive{ true };
+    };
+
+    void acceptViewer(net::Socket socket);
+
+    // Applies the control messages viewers have sent; drops viewers that went away.
+    void readControls();
+
+    void applyView();
+    void applyResize();
+
+    // Records a copy of the output into a free ring slot and returns the slot, or -1 when every slot is still
+    // being sent.
+    int32_t recordReadback(VkCommandBuffer commandBuffer);
+
+    // Converts a finished readback to RGB8 and sends it to the viewers connected when it landed.
+    void sendFrame(uint32_t slot, const TileGrid& grid, uint32_t samples, const std::vector<std::shared_ptr<Viewer>>& viewers);
+
+    HeadlessRenderer mRenderer;
+    ReadbackRing mRing;
+    WorkerPool mSender;
+    std::vector<std::shared_ptr<Viewer>> mViewers; // Main thread only; jobs hold their own references.
+    StreamView mView;
+    bool mViewChanged = false;
+    VkExtent2D mRequestedExtent{};
+    uint32_t mFrameIndex = 0;
+    bool mFramePending = false; // Some viewer has not been sent the current accumulation.
+    std::vector<uint32_t> mSlotSamples;
+    std::vector<uint32_t> mReady;
+};
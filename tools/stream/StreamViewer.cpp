@@ -0,0 +1,473 @@
+#include "StreamViewer.h"
+
+#include "../../src/util/Check.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/constants.hpp>
+
+namespace
+{
+    const int receivePollMs = 200;
+    const double viewSendInterval = 1.0 / 30.0;
+    const double resizeSettleSeconds = 0.25;
+    const float orbitRadiansPerPixel = 0.005f;
+    const float dollyPerSecond = 1.5f;
+}
+
+void StreamViewer::run(const ViewerSettings& settings)
+{
+    mSocket = net::Socket::connectTcp(settings.host, settings.port);
+
+    if (!mSocket.valid())
+    {
+        throw std::runtime_error("Failed to connect to " + settings.host + ":" + std::to_string(settings.port));
+    }
+
+    JsonValue message;
+    std::vector<uint8_t> payload;
+
+    if (net::receiveMessage(mSocket, mReader, message, payload, 10000) != net::LineReader::Result::Line || message.stringOr("op", "") != "hello")
+    {
+        throw std::runtime_error("No hello from " + settings.host);
+    }
+
+    applyViewJson(message["view"], mView);
+
+    if (!mWindow.create(1280, 720, "Stream " + settings.host))
+    {
+        throw std::runtime_error("Failed to create the window");
+    }
+
+    mContext.createInstance(settings.validation);
+    mContext.setupDebugMessenger(settings.validation);
+    mContext.createSurface(mWindow);
+    mContext.pickPhysicalDevice();
+    mContext.createDevice();
+    mContext.createAllocator();
+    mContext.createCommandPoolsAndBuffers(1);
+    mContext.createSyncObjects(1);
+    recreateSwapchain();
+
+    // Frames arrive display-encoded, so they are copied into a UNORM swapchain unchanged.
+    const VkFormat format = mSwapchain.bundle().imageFormat;
+
+    if (!(mSwapchain.bundle().imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+        (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_B8G8R8A8_UNORM))
+    {
+        throw std::runtime_error("The swapchain does not support copies of RGBA8 frames into its images");
+    }
+
+    mReceiver = std::thread([this]()
+    {
+        receiveFrames();
+    });
+
+    // The render follows the window.
+    JsonValue resize = JsonValue::object();
+    resize.set("op", "resize");
+    resize.set("width", mSwapchain.bundle().extent.width);
+    resize.set("height", mSwapchain.bundle().extent.height);
+    net::sendMessage(mSocket, resize);
+
+    Timer frameTimer;
+    Timer sinceViewSent;
+    Timer sinceResize;
+    Timer titleTimer;
+    bool resizePending = false;
+    uint64_t titleBytes = 0;
+
+    while (!mWindow.shouldClose() && mConnected)
+    {
+        mWindow.poll();
+        const double deltaSeconds = frameTimer.elapsedSeconds();
+        frameTimer.reset();
+        updateCamera(deltaSeconds);
+
+        if (mViewDirty && sinceViewSent.elapsedSeconds() >= viewSendInterval)
+        {
+            JsonValue view = toJson(mView);
+            view.set("op", "view");
+            net::sendMessage(mSocket, view);
+            mViewDirty = false;
+            sinceViewSent.reset();
+        }
+
+        if (mWindow.framebufferResized())
+        {
+            mWindow.clearFramebufferResized();
+            recreateSwapchain();
+            resizePending = true;
+            sinceResize.reset();
+        }
+
+        // Only the size the window settles on is rendered.
+        if (resizePending && sinceResize.elapsedSeconds() >= resizeSettleSeconds)
+        {
+            resize.set("width", mSwapchain.bundle().extent.width);
+            resize.set("height", mSwapchain.bundle().extent.height);
+            net::sendMessage(mSocket, resize);
+            resizePending = false;
+        }
+
+        if (titleTimer.elapsedSeconds() >= 1.0)
+        {
+            uint32_t samples = 0;
+            {
+                std::lock_guard<std::mutex> lock(mFrameMutex);
+                samples = mSamples;
+            }
+
+            const uint64_t bytes = mBytesReceived.load();
+            char title[128];
+            std::snprintf(title, sizeof(title), "Stream %s  %u spp  %.1f KiB/s", settings.host.c_str(), samples,
+                static_cast<double>(bytes - titleBytes) / 1024.0 / titleTimer.elapsedSeconds());
+            glfwSetWindowTitle(mWindow.handle(), title);
+            titleBytes = bytes;
+            titleTimer.reset();
+        }
+
+        bool hasNewFrame = false;
+        {
+            std::lock_guard<std::mutex> lock(mFrameMutex);
+            hasNewFrame = mFrameVersion != mPresentedVersion;
+        }
+
+        if (!hasNewFrame || !present())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    mStopping = true;
+    mReceiver.join();
+    mSocket.close();
+
+    mContext.waitIdle();
+    destroyStaging();
+
+    for (VkSemaphore semaphore : mRenderFinished)
+    {
+        vkDestroySemaphore(mContext.device(), semaphore, nullptr);
+    }
+
+    mSwapchain.destroy(mContext);
+    mContext.destroy();
+    mWindow.destroy();
+
+    if (!mConnected)
+    {
+        logger::info("The server closed the stream");
+    }
+}
+
+void StreamViewer::receiveFrames()
+{
+    JsonValue message;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> frame;
+    TileGrid grid;
+
+    while (!mStopping)
+    {
+        net::LineReader::Result result = net::LineReader::Result::Closed;
+
+        try
+        {
+            result = net::receiveMessage(mSocket, mReader, message, payload, receivePollMs);
+        }
+        catch (const std::exception& error)
+        {
+            logger::error("Stream: %s", error.what());
+        }
+
+        if (result == net::LineReader::Result::Timeout)
+        {
+            continue;
+        }
+        if (result == net::LineReader::Result::Closed)
+        {
+            break;
+        }
+        if (message.stringOr("op", "") != "frame")
+        {
+            continue;
+        }
+
+        mBytesReceived += payload.size();
+        TileGrid next;
+        next.width = static_cast<uint32_t>(message.numberOr("width", 0.0));
+        next.height = static_cast<uint32_t>(message.numberOr("height", 0.0));
+        next.tile = static_cast<uint32_t>(message.numberOr("tile", 0.0));
+
+        if (next.width == 0 || next.height == 0 || next.tile == 0)
+        {
+            logger::error("Stream: malformed frame header");
+
+            break;
+        }
+
+        // A new size starts from black, as on the server.
+        if (next.width != grid.width || next.height != grid.height || next.tile != grid.tile)
+        {
+            grid = next;
+            frame.assign(grid.frameBytes(), 0);
+        }
+
+        if (!decodeFrameDelta(grid, payload.data(), payload.size(), frame))
+        {
+            logger::error("Stream: malformed frame");
+
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mFrameMutex);
+        mGrid = grid;
+        mFrame = frame;
+        mSamples = static_cast<uint32_t>(message.numberOr("samples", 0.0));
+        ++mFrameVersion;
+    }
+
+    mConnected = false;
+}
+
+void StreamViewer::updateCamera(double deltaSeconds)
+{
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    mWindow.getCursorPos(cursorX, cursorY);
+    glm::vec3 offset = mView.position - mView.target;
+    float radius = glm::length(offset);
+    bool changed = false;
+
+    if (mWindow.mouseButtonState(GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+    {
+        if (mDragging && (cursorX != mLastCursorX || cursorY != mLastCursorY))
+        {
+            float yaw = std::atan2(offset.x, offset.z) - static_cast<float>(cursorX - mLastCursorX) * orbitRadiansPerPixel;
+            float pitch = std::asin(std::clamp(offset.y / radius, -1.0f, 1.0f)) + static_cast<float>(cursorY - mLastCursorY) * orbitRadiansPerPixel;
+            pitch = std::clamp(pitch, -glm::half_pi<float>() + 0.01f, glm::half_pi<float>() - 0.01f);
+            offset = radius * glm::vec3(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+            changed = true;
+        }
+
+        mDragging = true;
+    }
+    else
+    {
+        mDragging = false;
+    }
+
+    const float dolly = (mWindow.keyState(GLFW_KEY_S) == GLFW_PRESS ? 1.0f : 0.0f) - (mWindow.keyState(GLFW_KEY_W) == GLFW_PRESS ? 1.0f : 0.0f);
+
+    if (dolly != 0.0f)
+    {
+        offset *= std::max(0.05f, 1.0f + dolly * dollyPerSecond * static_cast<float>(deltaSeconds));
+        changed = true;
+    }
+
+    mLastCursorX = cursorX;
+    mLastCursorY = cursorY;
+
+    if (changed)
+    {
+        mView.position = mView.target + offset;
+        mViewDirty = true;
+    }
+}
+
+bool StreamViewer::present()
+{
+    const FrameSync& frameSync = mContext.frames()[0];
+    VK_CHECK(vkWaitForFences(mContext.device(), 1, &frameSync.inFlight, VK_TRUE, UINT64_MAX));
+
+    uint32_t imageIndex = 0;
+    const VkResult acquireResult = mSwapchain.acquireNextImage(mContext, frameSync.imageAvailable, &imageIndex);
+
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        recreateSwapchain();
+
+        return false;
+    }
+
+    VK_CHECK(acquireResult);
+
+    // Staging holds the frame in the swapchain's channel order.
+    const bool bgra = mSwapchain.bundle().imageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+    TileGrid grid;
+    {
+        std::lock_guard<std::mutex> lock(mFrameMutex);
+        grid = mGrid;
+        const VkDeviceSize bytes = static_cast<VkDeviceSize>(grid.width) * grid.height * 4;
+
+        if (bytes > mStagingBytes)
+        {
+            createStaging(bytes);
+        }
+
+        uint8_t* out = static_cast<uint8_t*>(mStagingMapped);
+
+        for (size_t i = 0, count = static_cast<size_t>(grid.width) * grid.height; i < count; ++i)
+        {
+            out[i * 4 + 0] = mFrame[i * 3 + (bgra ? 2 : 0)];
+            out[i * 4 + 1] = mFrame[i * 3 + 1];
+            out[i * 4 + 2] = mFrame[i * 3 + (bgra ? 0 : 2)];
+            out[i * 4 + 3] = 255;
+        }
+
+        mPresentedVersion = mFrameVersion;
+    }
+
+    vmaFlushAllocation(mContext.allocator(), mStagingAlloc, 0, VK_WHOLE_SIZE);
+    VK_CHECK(vkResetFences(mContext.device(), 1, &frameSync.inFlight));
+    VK_CHECK(vkResetCommandBuffer(frameSync.cmdBuf, 0));
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(frameSync.cmdBuf, &beginInfo));
+
+    const VkImage image = mSwapchain.bundle().images[imageIndex];
+    const VkExtent2D extent = mSwapchain.bundle().extent;
+
+    VkImageMemoryBarrier toTransfer{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(frameSync.cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    // Black around a frame that does not match the window yet.
+    const VkClearColorValue black{};
+    vkCmdClearColorImage(frameSync.cmdBuf, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &toTransfer.subresourceRange);
+
+    VkImageMemoryBarrier afterClear = toTransfer;
+    afterClear.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    afterClear.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(frameSync.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &afterClear);
+
+    if (grid.width > 0 && grid.height > 0)
+    {
+        VkBufferImageCopy region{};
+        region.bufferRowLength = grid.width;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { std::min(grid.width, extent.width), std::min(grid.height, extent.height), 1 };
+        vkCmdCopyBufferToImage(frameSync.cmdBuf, mStaging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    VkImageMemoryBarrier toPresent = toTransfer;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toPresent.dstAccessMask = 0;
+    vkCmdPipelineBarrier(frameSync.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &toPresent);
+    VK_CHECK(vkEndCommandBuffer(frameSync.cmdBuf));
+
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &frameSync.imageAvailable;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameSync.cmdBuf;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &mRenderFinished[imageIndex];
+    VK_CHECK(vkQueueSubmit(mContext.graphicsQueue(), 1, &submitInfo, frameSync.inFlight));
+
+    const VkResult presentResult = mSwapchain.present(mContext, mRenderFinished[imageIndex], imageIndex);
+
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+    {
+        recreateSwapchain();
+    }
+    else
+    {
+        VK_CHECK(presentResult);
+    }
+
+    return true;
+}
+
+void StreamViewer::recreateSwapchain()
+{
+    int width = 0;
+    int height = 0;
+    mWindow.getFramebufferSize(width, height);
+
+    // Minimized: nothing to present until the window is back.
+    while ((width == 0 || height == 0) && !mWindow.shouldClose())
+    {
+        mWindow.waitEvents();
+        mWindow.getFramebufferSize(width, height);
+    }
+
+    mContext.waitIdle();
+
+    if (mSwapchain.bundle().swapchain == VK_NULL_HANDLE)
+    {
+        mSwapchain.create(mContext, mWindow);
+    }
+    else
+    {
+        mSwapchain.recreate(mContext, mWindow);
+    }
+
+    for (VkSemaphore semaphore : mRenderFinished)
+    {
+        vkDestroySemaphore(mContext.device(), semaphore, nullptr);
+    }
+
+    mRenderFinished.assign(mSwapchain.bundle().images.size(), VK_NULL_HANDLE);
+    VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+
+    for (VkSemaphore& semaphore : mRenderFinished)
+    {
+        VK_CHECK(vkCreateSemaphore(mContext.device(), &semaphoreInfo, nullptr, &semaphore));
+    }
+
+    // Show the current frame again on the new images.
+    std::lock_guard<std::mutex> lock(mFrameMutex);
+    mPresentedVersion = mFrameVersion - 1;
+}
+
+void StreamViewer::createStaging(VkDeviceSize bytes)
+{
+    mContext.waitIdle();
+    destroyStaging();
+
+    VkBufferCreateInfo bufferInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferInfo.size = bytes;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo info{};
+    VK_CHECK(vmaCreateBuffer(mContext.allocator(), &bufferInfo, &allocInfo, &mStaging, &mStagingAlloc, &info));
+    mStagingMapped = info.pMappedData;
+    mStagingBytes = bytes;
+}
+
+void StreamViewer::destroyStaging()
+{
+    if (mStaging != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(mContext.allocator(), mStaging, mStagingAlloc);
+    }
+
+    mStaging = VK_NULL_HANDLE;
+    mStagingAlloc = VK_NULL_HANDLE;
+    mStagingMapped = nullptr;
+    mStagingBytes = 0;
+}
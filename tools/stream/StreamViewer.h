@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StreamProtocol.h"
+#include "TileCodec.h"
+#include "../../src/platform/Window.h"
+#include "../../src/vk/Swapchain.h"
+#include "../../src/vk/VulkanContext.h"
+
+struct ViewerSettings
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 7879;
+    bool validation = false;
+};
+
+// Minimal window for a stream server: shows the frames it sends and drives its camera. Left drag orbits the
+// target, W/S dolly in and out, and resizing the window resizes the render.
+class StreamViewer
+{
+public:
+    StreamViewer() = default;
+    ~StreamViewer() = default;
+
+    // Returns when the window is closed or the server goes away. Throws when it cannot connect or on device errors.
+    void run(const ViewerSettings& settings);
+
+private:
+    // Network thread: decodes frames into mFrame.
+    void receiveFrames();
+
+    void updateCamera(double deltaSeconds);
+
+    // Uploads the latest frame and presents it; false when the swapchain had to be recreated first.
+    bool present();
+
+    void recreateSwapchain();
+    void createStaging(VkDeviceSize bytes);
+    void destroyStaging();
+
+    Window mWindow;
+    VulkanContext mContext;
+    Swapchain mSwapchain;
+    std::vector<VkSemaphore> mRenderFinished;
+    VkBuffer mStaging = VK_NULL_HANDLE;
+    VmaAllocation mStagingAlloc = VK_NULL_HANDLE;
+    void* mStagingMapped = nullptr;
+    VkDeviceSize mStagingBytes = 0;
+
+    net::Socket mSocket;
+    net::LineReader mReader;
+    std::thread mReceiver;
+    std::atomic<bool> mStopping{ false };
+    std::atomic<bool> mConnected{ true };
+
+    std::mutex mFrameMutex;
+    TileGrid mGrid; // Guarded by mFrameMutex, like mFrame and mSamples.
+    std::vector<uint8_t> mFrame;
+    uint32_t mSamples = 0;
+    uint64_t mFrameVersion = 0;
+    uint64_t mPresentedVersion = 0;
+    std::atomic<uint64_t> mBytesReceived{ 0 };
+
+    StreamView mView;
+    bool mViewDirty = false;
+    double mLastCursorX = 0.0;
+    double mLastCursorY = 0.0;
+    bool mDragging = false;
+};
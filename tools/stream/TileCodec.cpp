@@ -0,0 +1,235 @@
+#include "TileCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const size_t maxLiteral = 128;
+    const size_t minRun = 3;
+    const size_t maxRun = 130;
+
+    void appendU32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        const uint8_t bytes[4] = { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value >> 16),
+            static_cast<uint8_t>(value >> 24) };
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    uint32_t readU32(const uint8_t* data)
+    {
+        return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 |
+            static_cast<uint32_t>(data[3]) << 24;
+    }
+
+    struct TileRect
+    {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    TileRect tileRect(const TileGrid& grid, uint32_t index)
+    {
+        TileRect rect;
+        rect.x = index % grid.tilesX() * grid.tile;
+        rect.y = index / grid.tilesX() * grid.tile;
+        rect.width = std::min(grid.tile, grid.width - rect.x);
+        rect.height = std::min(grid.tile, grid.height - rect.y);
+
+        return rect;
+    }
+
+    bool tileChanged(const TileGrid& grid, const TileRect& rect, const uint8_t* frame, const uint8_t* reference)
+    {
+        for (uint32_t row = 0; row < rect.height; ++row)
+        {
+            const size_t offset = (static_cast<size_t>(rect.y + row) * grid.width + rect.x) * 3;
+
+            if (std::memcmp(frame + offset, reference + offset, static_cast<size_t>(rect.width) * 3) != 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+void rleEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    size_t i = 0;
+    size_t literalStart = 0;
+
+    auto flushLiterals = [&](size_t end)
+    {
+        while (literalStart < end)
+        {
+            const size_t count = std::min(maxLiteral, end - literalStart);
+            out.push_back(static_cast<uint8_t>(count - 1));
+            out.insert(out.end(), data + literalStart, data + literalStart + count);
+            literalStart += count;
+        }
+    };
+
+    while (i < size)
+    {
+        size_t run = 1;
+
+        while (i + run < size && run < maxRun && data[i + run] == data[i])
+        {
+            ++run;
+        }
+
+        if (run < minRun)
+        {
+            i += run;
+
+            continue;
+        }
+
+        flushLiterals(i);
+        out.push_back(static_cast<uint8_t>(run + 125));
+        out.push_back(data[i]);
+        i += run;
+        literalStart = i;
+    }
+
+    flushLiterals(size);
+}
+
+bool rleDecode(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+{
+    size_t in = 0;
+    size_t written = 0;
+
+    while (in < size)
+    {
+        const uint8_t control = data[in++];
+
+        if (control < maxLiteral)
+        {
+            const size_t count = static_cast<size_t>(control) + 1;
+
+            if (in + count > size || written + count > outSize)
+            {
+                return false;
+            }
+
+            std::memcpy(out + written, data + in, count);
+            in += count;
+            written += count;
+        }
+        else
+        {
+            const size_t count = static_cast<size_t>(control) - 125;
+
+            if (in >= size || written + count > outSize)
+            {
+                return false;
+            }
+
+            std::memset(out + written, data[in++], count);
+            written += count;
+        }
+    }
+
+    return written == outSize;
+}
+
+uint32_t encodeFrameDelta(const TileGrid& grid, const uint8_t* frame, std::vector<uint8_t>& reference, std::vector<uint8_t>& out)
+{
+    reference.resize(grid.frameBytes(), 0);
+    const uint32_t tileCount = grid.tilesX() * grid.tilesY();
+    std::vector<uint8_t> delta;
+    uint32_t changed = 0;
+
+    for (uint32_t index = 0; index < tileCount; ++index)
+    {
+        const TileRect rect = tileRect(grid, index);
+
+        if (!tileChanged(grid, rect, frame, reference.data()))
+        {
+            continue;
+        }
+
+        delta.clear();
+
+        for (uint32_t row = 0; row < rect.height; ++row)
+        {
+            const size_t offset = (static_cast<size_t>(rect.y + row) * grid.width + rect.x) * 3;
+            const size_t bytes = static_cast<size_t>(rect.width) * 3;
+
+            for (size_t i = 0; i < bytes; ++i)
+            {
+                delta.push_back(static_cast<uint8_t>(frame[offset + i] - reference[offset + i]));
+            }
+
+            std::memcpy(reference.data() + offset, frame + offset, bytes);
+        }
+
+        // The size is patched in once the tile is encoded.
+        appendU32(out, index);
+        const size_t sizeOffset = out.size();
+        appendU32(out, 0);
+        rleEncode(delta.data(), delta.size(), out);
+        const uint32_t encoded = static_cast<uint32_t>(out.size() - sizeOffset - 4);
+        out[sizeOffset] = static_cast<uint8_t>(encoded);
+        out[sizeOffset + 1] = static_cast<uint8_t>(encoded >> 8);
+        out[sizeOffset + 2] = static_cast<uint8_t>(encoded >> 16);
+        out[sizeOffset + 3] = static_cast<uint8_t>(encoded >> 24);
+        ++changed;
+    }
+
+    return changed;
+}
+
+bool decodeFrameDelta(const TileGrid& grid, const uint8_t* data, size_t size, std::vector<uint8_t>& frame)
+{
+    frame.resize(grid.frameBytes(), 0);
+    const uint32_t tileCount = grid.tilesX() * grid.tilesY();
+    std::vector<uint8_t> delta;
+    size_t in = 0;
+
+    while (in < size)
+    {
+        if (size - in < 8)
+        {
+            return false;
+        }
+
+        const uint32_t index = readU32(data + in);
+        const uint32_t encoded = readU32(data + in + 4);
+        in += 8;
+
+        if (index >= tileCount || encoded > size - in)
+        {
+            return false;
+        }
+
+        const TileRect rect = tileRect(grid, index);
+        const size_t rowBytes = static_cast<size_t>(rect.width) * 3;
+        delta.resize(rowBytes * rect.height);
+
+        if (!rleDecode(data + in, encoded, delta.data(), delta.size()))
+        {
+            return false;
+        }
+
+        in += encoded;
+
+        for (uint32_t row = 0; row < rect.height; ++row)
+        {
+            uint8_t* pixels = frame.data() + (static_cast<size_t>(rect.y + row) * grid.width + rect.x) * 3;
+            const uint8_t* rowDelta = delta.data() + row * rowBytes;
+
+            for (size_t i = 0; i < rowBytes; ++i)
+            {
+                pixels[i] = static_cast<uint8_t>(pixels[i] + rowDelta[i]);
+            }
+        }
+    }
+
+    return true;
+}
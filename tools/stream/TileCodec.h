@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Frame deltas for the stream tool. Frames are tightly packed RGB8, cut into tile x tile squares (the last row and
+// column may be smaller). A delta lists the tiles that differ from the receiver's copy of the previous frame:
+//
+//     per changed tile: uint32 tile index (row-major), uint32 encoded bytes, encoded bytes
+//
+// A tile is encoded as its bytes minus the previous frame's, row by row, then run-length coded: a control byte c
+// below 128 is followed by c + 1 literal bytes, otherwise the next byte repeats c - 125 times (3 to 130). Unchanged
+// pixels become runs of zeros, so a converging progressive image costs little more than its changed pixels.
+struct TileGrid
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tile = 64;
+
+    uint32_t tilesX() const
+    {
+        return (width + tile - 1) / tile;
+    }
+
+    uint32_t tilesY() const
+    {
+        return (height + tile - 1) / tile;
+    }
+
+    size_t frameBytes() const
+    {
+        return static_cast<size_t>(width) * height * 3;
+    }
+};
+
+void rleEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+// Decodes exactly size bytes into out; false when the input is malformed or decodes to another size.
+bool rleDecode(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
+
+// Appends the delta from reference to frame and brings reference up to frame. Returns the changed tile count.
+uint32_t encodeFrameDelta(const TileGrid& grid, const uint8_t* frame, std::vector<uint8_t>& reference, std::vector<uint8_t>& out);
+
+// Applies a delta to frame in place; false when it is malformed for the grid.
+bool decodeFrameDelta(const TileGrid& grid, const uint8_t* data, size_t size, std::vector<uint8_t>& frame);
@@ -0,0 +1,226 @@
+// Progressive renders streamed to remote viewers, so a render box can be driven from a laptop.
+//
+// Usage: stream [--listen HOST] [--port N] [--width W] [--height H] [--fps N] [--tile N] [--max-spp N]
+//               [--spp-per-frame N] [--depth N] [--aperture A] [--fov DEGREES] [--position X,Y,Z] [--target X,Y,Z]
+//               [--scene <scene.json>] [--validation]
+//        stream --view [--connect HOST:PORT] [--validation]
+//
+// The server (default port 7879, all interfaces) traces while a viewer is connected and sends the displayed
+// image at up to --fps frames per second: only the --tile sized tiles that changed since the viewer's previous
+// frame, delta and run-length coded (tools/stream/TileCodec.h). It pauses once the accumulation reaches --max-spp
+// samples (0 never pauses). Viewers send camera, setting and size changes back; all viewers share one camera.
+//
+// --view opens the minimal viewer: left drag orbits the target, W/S dolly, and the render follows the window size.
+// Both ends run on one machine over loopback, for example "stream --port 0" and "stream --view --connect 127.0.0.1:<port>".
+
+#include "StreamServer.h"
+#include "StreamViewer.h"
+
+#include "../../src/util/Logger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    struct Options
+    {
+        bool view = false;
+        StreamSettings server;
+        ViewerSettings viewer;
+        std::string scenePath;
+    };
+
+    glm::vec3 parseVec3(const std::string& text)
+    {
+        glm::vec3 value{};
+
+        if (std::sscanf(text.c_str(), "%f,%f,%f", &value.x, &value.y, &value.z) != 3)
+        {
+            throw std::runtime_error("Expected X,Y,Z instead of " + text);
+        }
+
+        return value;
+    }
+
+    void parseEndpoint(const std::string& text, ViewerSettings& settings)
+    {
+        const size_t colon = text.rfind(':');
+
+        if (colon == std::string::npos || colon == 0)
+        {
+            throw std::runtime_error("Expected HOST:PORT instead of " + text);
+        }
+
+        settings.host = text.substr(0, colon);
+        settings.port = static_cast<uint16_t>(std::stoul(text.substr(colon + 1)));
+    }
+
+    std::string readTextFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        std::ostringstream text;
+        text << file.rdbuf();
+
+        return text.str();
+    }
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        StreamSettings& server = options.server;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--view")
+            {
+                options.view = true;
+            }
+            else if (arg == "--connect")
+            {
+                parseEndpoint(next(), options.viewer);
+            }
+            else if (arg == "--validation")
+            {
+                server.validation = true;
+                options.viewer.validation = true;
+            }
+            else if (arg == "--listen")
+            {
+                server.listenHost = next();
+            }
+            else if (arg == "--port")
+            {
+                server.port = static_cast<uint16_t>(std::stoul(next()));
+            }
+            else if (arg == "--width")
+            {
+                server.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                server.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--fps")
+            {
+                server.fps = std::stod(next());
+            }
+            else if (arg == "--tile")
+            {
+                server.tile = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--max-spp")
+            {
+                server.maxSamples = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp-per-frame")
+            {
+                server.view.samplesPerFrame = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                server.view.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--aperture")
+            {
+                server.view.aperture = std::stof(next());
+            }
+            else if (arg == "--fov")
+            {
+                server.view.fov = std::stof(next());
+            }
+            else if (arg == "--position")
+            {
+                server.view.position = parseVec3(next());
+            }
+            else if (arg == "--target")
+            {
+                server.view.target = parseVec3(next());
+            }
+            else if (arg == "--scene")
+            {
+                options.scenePath = next();
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.view)
+        {
+            return options;
+        }
+
+        if (server.width == 0 || server.height == 0 || server.tile == 0 || server.view.samplesPerFrame == 0 || server.view.maxDepth == 0)
+        {
+            throw std::runtime_error("--width, --height, --tile, --spp-per-frame and --depth must be positive");
+        }
+        if (!(server.fps > 0.0))
+        {
+            throw std::runtime_error("--fps must be positive");
+        }
+        if (server.view.position == server.view.target)
+        {
+            throw std::runtime_error("--position and --target must differ");
+        }
+
+        return options;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+
+        if (options.view)
+        {
+            StreamViewer viewer;
+            viewer.run(options.viewer);
+        }
+        else
+        {
+            if (!options.scenePath.empty())
+            {
+                options.server.scene = JsonValue::parse(readTextFile(options.scenePath));
+            }
+
+            StreamServer server;
+            server.run(options.server);
+        }
+
+        logger::flush();
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "stream: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,229 @@
+// Offline renderer for resolutions beyond a single accumulation image, such as 32k x 16k prints.
+//
+// Usage: tiled [--width W] [--height H] [--tile N] [--spp N] [--spp-per-frame N] [--depth N] [--aperture A]
+//              [--fov DEGREES] [--out <file.pfm|file.exr>] [--float] [--validation]
+//
+// The image is traced as N x N tiles through one N x N accumulation image; each tile renders the matching
+// sub-frustum of the full camera (RayTracer::setViewWindow). Finished tiles are written in place into the
+// output file on a writer thread while the next tile traces, so GPU and host memory stay at about one tile
+// whatever the output size. EXR output is half float unless --float is given.
+
+#include "../../src/rt/HeadlessRenderer.h"
+#include "../../src/util/Logger.h"
+#include "../../src/util/TiledImageWriter.h"
+#include "../../src/util/Timer.h"
+#include "../../src/util/WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    struct Options
+    {
+        uint32_t width = 7680;
+        uint32_t height = 4320;
+        uint32_t tile = 1024;
+        uint32_t spp = 64;
+        uint32_t sppPerFrame = 8;
+        uint32_t maxDepth = 12;
+        float aperture = 0.05f;
+        float fov = 20.0f;
+        std::string outPath = "tiled.exr";
+        bool fullFloat = false;
+        bool validation = false;
+    };
+
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+
+                return argv[++i];
+            };
+
+            if (arg == "--width")
+            {
+                options.width = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--height")
+            {
+                options.height = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--tile")
+            {
+                options.tile = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp")
+            {
+                options.spp = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--spp-per-frame")
+            {
+                options.sppPerFrame = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--depth")
+            {
+                options.maxDepth = static_cast<uint32_t>(std::stoul(next()));
+            }
+            else if (arg == "--aperture")
+            {
+                options.aperture = std::stof(next());
+            }
+            else if (arg == "--fov")
+            {
+                options.fov = std::stof(next());
+            }
+            else if (arg == "--out")
+            {
+                options.outPath = next();
+            }
+            else if (arg == "--float")
+            {
+                options.fullFloat = true;
+            }
+            else if (arg == "--validation")
+            {
+                options.validation = true;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown argument " + arg);
+            }
+        }
+
+        if (options.width == 0 || options.height == 0 || options.tile == 0 || options.spp == 0 || options.sppPerFrame == 0)
+        {
+            throw std::runtime_error("--width, --height, --tile, --spp and --spp-per-frame must be positive");
+        }
+
+        return options;
+    }
+
+    ImageFormat outputFormat(const Options& options)
+    {
+        const std::string extension = std::filesystem::path(options.outPath).extension().string();
+
+        if (extension == ".pfm")
+        {
+            return ImageFormat::Pfm;
+        }
+        if (extension == ".exr")
+        {
+            return options.fullFloat ? ImageFormat::ExrFloat : ImageFormat::ExrHalf;
+        }
+
+        throw std::runtime_error("--out must end in .pfm or .exr");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        Options options = parseOptions(argc, argv);
+        const ImageFormat format = outputFormat(options);
+
+        const uint32_t tile = std::min(options.tile, std::max(options.width, options.height));
+        const uint32_t tilesX = (options.width + tile - 1) / tile;
+        const uint32_t tilesY = (options.height + tile - 1) / tile;
+        const uint32_t dispatches = (options.spp + options.sppPerFrame - 1) / options.sppPerFrame;
+
+        HeadlessRenderer renderer;
+        renderer.create({ tile, tile }, options.validation);
+        RayTracer& tracer = renderer.tracer();
+        tracer.setSamplesPerPixel(options.sppPerFrame);
+        tracer.setMaxDepth(options.maxDepth);
+        tracer.setAperture(options.aperture);
+        tracer.setFov(options.fov);
+
+        auto writer = std::make_shared<TiledImageWriter>();
+        writer->open(options.outPath, options.width, options.height, format);
+
+        // One writer thread keeps the seeks in order; at most one tile waits behind the one being written.
+        WorkerPool writerThread;
+        std::atomic<bool> writeFailed{ false };
+        writerThread.start(1, "tile writer");
+
+        std::printf("Rendering %ux%u as %ux%u tiles of %u, %u spp; accumulation %.1f MiB\n", options.width, options.height, tilesX, tilesY,
+            tile, dispatches * options.sppPerFrame, static_cast<double>(tracer.accumulationBytes()) / (1024.0 * 1024.0));
+
+        Timer totalTimer;
+
+        for (uint32_t tileY = 0; tileY < tilesY; ++tileY)
+        {
+            for (uint32_t tileX = 0; tileX < tilesX; ++tileX)
+            {
+                const uint32_t tileIndex = tileY * tilesX + tileX;
+                const VkOffset2D offset{ static_cast<int32_t>(tileX * tile), static_cast<int32_t>(tileY * tile) };
+                tracer.setViewWindow({ options.width, options.height }, offset);
+                Timer tileTimer;
+
+                // Distinct frame indices per tile, so tiles do not repeat one noise pattern.
+                for (uint32_t dispatch = 0; dispatch < dispatches; ++dispatch)
+                {
+                    renderer.renderFrame(tileIndex * dispatches + dispatch);
+                }
+
+                auto image = std::make_shared<Image>(renderer.readImage());
+
+                if (writerThread.pending() > 1)
+                {
+                    writerThread.waitIdle();
+                }
+
+                writerThread.submit([writer, image, offset, &writeFailed]()
+                {
+                    try
+                    {
+                        writer->writeTile(static_cast<uint32_t>(offset.x), static_cast<uint32_t>(offset.y), *image);
+                    }
+                    catch (const std::exception& error)
+                    {
+                        logger::error("%s", error.what());
+                        writeFailed = true;
+                    }
+                });
+
+                std::printf("tile %u/%u (%d, %d)  %.3f s\n", tileIndex + 1, tilesX * tilesY, offset.x, offset.y, tileTimer.elapsedSeconds());
+            }
+        }
+
+        writerThread.stop();
+        writer->close();
+
+        if (writeFailed)
+        {
+            throw std::runtime_error("Failed to write " + options.outPath);
+        }
+
+        std::printf("Wrote %s in %.1f s\n", options.outPath.c_str(), totalTimer.elapsedSeconds());
+
+        renderer.destroy();
+        logger::flush();
+
+        return EXIT_SUCCESS;
+    }
+    catch (const std::exception& error)
+    {
+        logger::flush();
+        std::fprintf(stderr, "tiled: %s\n", error.what());
+
+        return EXIT_FAILURE;
+    }
+}